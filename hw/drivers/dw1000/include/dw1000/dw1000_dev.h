@@ -96,6 +96,7 @@ typedef enum _dw1000_extension_id_t{
     DW1000_OT,                               //!< Openthread
     DW1000_RTDOA,                            //!< RTDoA
     DW1000_SURVEY,
+    DW1000_TDMA_ALLOC,                       //!< TDMA dynamic slot allocation
     DW1000_APP0 = 1024, 
     DW1000_APP1, 
     DW1000_APP2
@@ -295,7 +296,9 @@ typedef struct _dw1000_dev_instance_t{
     };
     uint64_t timestamp;            //!< Timestamp
     uint64_t rxtimestamp;          //!< Receive timestamp
+    uint32_t irq_cputime;          //!< os_cputime of the last interrupt, read without touching the bus
     uint64_t txtimestamp;          //!< Transmit timestamp
+    uint64_t dx_time;              //!< Delayed start last programmed by dw1000_set_delay_start()
     int32_t carrier_integrator;    //!< Carrier integrator
     int32_t rxttcko;               //!< Integrator
     uint16_t PANID;                //!< personal network inetrface id
@@ -308,7 +311,9 @@ typedef struct _dw1000_dev_instance_t{
     uint8_t otp_temp;              //!< OTP parameter for temperature
     uint8_t xtal_trim;             //!< Crystal trim
     uint32_t sys_cfg_reg;          //!< System config register
+    uint32_t chan_ctrl_reg;        //!< Channel control register
     uint32_t tx_fctrl;             //!< Transmit frame control register parameter 
+    uint16_t tx_frame_len;         //!< Frame length last written to TX_FCTRL, including the CRC
     uint32_t sys_status;           //!< SYS_STATUS_ID for current event
     uint16_t rx_antenna_delay;     //!< Receive antenna delay
     uint16_t tx_antenna_delay;     //!< Transmit antenna delay  
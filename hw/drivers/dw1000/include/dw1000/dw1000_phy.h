@@ -86,6 +86,7 @@ void dw1000_phy_interrupt_mask(struct _dw1000_dev_instance_t * inst, uint32_t bi
 
 
 float dw1000_phy_read_wakeuptemp_SI(struct _dw1000_dev_instance_t * inst);
+float dw1000_phy_read_temp_SI(struct _dw1000_dev_instance_t * inst);
 float dw1000_phy_read_read_wakeupvbat_SI(struct _dw1000_dev_instance_t * inst);
 void dw1000_phy_external_sync(struct _dw1000_dev_instance_t * inst, uint8_t delay, bool enable);
 
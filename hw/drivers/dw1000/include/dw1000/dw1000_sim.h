@@ -0,0 +1,91 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file dw1000_sim.h
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Simulated DW1000
+ *
+ * @details Register level model of the DW1000 for host builds, see dw1000_sim.c.
+ *
+ */
+
+#ifndef _DW1000_SIM_H_
+#define _DW1000_SIM_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <os/os.h>
+#include <dw1000/dw1000_dev.h>
+
+#if MYNEWT_VAL(DW1000_SIM)
+
+//! Radio events reported to the trace callback
+typedef enum _dw1000_sim_event_t{
+    DW1000_SIM_TX_START,            //!< Preamble of a frame leaves the antenna
+    DW1000_SIM_TX_DONE,             //!< Last symbol of the frame sent
+    DW1000_SIM_RX_DONE,             //!< Frame received with a good FCS
+    DW1000_SIM_RX_TIMEOUT,          //!< Frame wait timeout expired
+    DW1000_SIM_RX_LOST,             //!< Frame dropped by the loss model
+    DW1000_SIM_START_LATE           //!< Delayed tx or rx commanded too late (HPDWARN or TXPUTE)
+}dw1000_sim_event_t;
+
+//! Per device counters
+typedef struct _dw1000_sim_stats_t{
+    uint32_t spi_transfers;         //!< Register accesses
+    uint32_t spi_bytes;             //!< Bytes on the bus, headers included
+    uint64_t spi_nsecs;             //!< Time the host spent on the bus
+    uint32_t tx_frames;             //!< Frames sent
+    uint32_t rx_frames;             //!< Frames received
+    uint32_t rx_timeouts;           //!< Frame wait timeouts
+    uint32_t rx_lost;               //!< Frames dropped by the loss model
+    uint32_t start_late;            //!< Late delayed starts
+}dw1000_sim_stats_t;
+
+//! Trace callback, called with interrupts disabled at the simulated time of the event, must not block
+typedef void (dw1000_sim_trace_cb_t)(struct _dw1000_dev_instance_t * inst, dw1000_sim_event_t event, uint64_t nsecs);
+
+void dw1000_sim_init(void);
+void dw1000_sim_irq_init(struct _dw1000_dev_instance_t * inst, void (* irq)(void *), void * arg);
+bool dw1000_sim_step(void);
+uint64_t dw1000_sim_nsecs(void);
+
+void dw1000_sim_set_position(struct _dw1000_dev_instance_t * inst, float x, float y, float z);
+float dw1000_sim_distance(struct _dw1000_dev_instance_t * inst, struct _dw1000_dev_instance_t * remote);
+void dw1000_sim_set_drift(struct _dw1000_dev_instance_t * inst, float ppm);
+void dw1000_sim_set_loss(struct _dw1000_dev_instance_t * inst, float probability);
+void dw1000_sim_set_trace(dw1000_sim_trace_cb_t * cb);
+dw1000_sim_stats_t * dw1000_sim_get_stats(struct _dw1000_dev_instance_t * inst);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DW1000_SIM_H_ */
@@ -282,12 +282,15 @@ dw1000_dev_init(struct os_dev *odev, void *arg)
 int 
 dw1000_dev_config(dw1000_dev_instance_t * inst)
 {
+#if !MYNEWT_VAL(DW1000_SIM)
     int rc;
+#endif
     int timeout = 3;
 
 retry:
     inst->spi_settings.baudrate = MYNEWT_VAL(DW1000_DEVICE_BAUDRATE_LOW);
     hal_dw1000_reset(inst);
+#if !MYNEWT_VAL(DW1000_SIM)
     rc = hal_spi_disable(inst->spi_num);
     assert(rc == 0);
     rc = hal_spi_config(inst->spi_num, &inst->spi_settings);
@@ -295,6 +298,7 @@ retry:
     hal_spi_set_txrx_cb(inst->spi_num, hal_dw1000_spi_txrx_cb, (void*)inst);    
     rc = hal_spi_enable(inst->spi_num);
     assert(rc == 0);
+#endif
 
     inst->device_id = dw1000_read_reg(inst, DEV_ID_ID, 0, sizeof(uint32_t));
     inst->status.initialized = (inst->device_id == DWT_DEVICE_ID);
@@ -315,12 +319,14 @@ retry:
 
     /* It's now safe to increase the SPI baudrate > 4M */
     inst->spi_settings.baudrate = MYNEWT_VAL(DW1000_DEVICE_BAUDRATE_HIGH);
+#if !MYNEWT_VAL(DW1000_SIM)
     rc = hal_spi_disable(inst->spi_num);
     assert(rc == 0);
     rc = hal_spi_config(inst->spi_num, &inst->spi_settings);
     assert(rc == 0);
     rc = hal_spi_enable(inst->spi_num);
     assert(rc == 0);
+#endif
 
     inst->PANID = MYNEWT_VAL(PANID);
     inst->my_short_address = inst->partID & 0xffff;
@@ -355,7 +361,9 @@ retry:
 void 
 dw1000_dev_free(dw1000_dev_instance_t * inst){
     assert(inst);  
+#if !MYNEWT_VAL(DW1000_SIM)
     hal_spi_disable(inst->spi_num);  
+#endif
 
     if (inst->status.selfmalloc)
         free(inst);
@@ -41,8 +41,10 @@
 #include <dw1000/dw1000_hal.h>
 
 #if MYNEWT_VAL(DW1000_DEVICE_0)
+#if !MYNEWT_VAL(DW1000_SIM)
 /* Needed for DMA transfer operations */
 static const uint8_t tx_buffer[MYNEWT_VAL(DW1000_HAL_SPI_BUFFER_SIZE)] __attribute__ ((aligned (8))) = {0};
+#endif
 
 static dw1000_dev_instance_t hal_dw1000_instances[]= {
     #if  MYNEWT_VAL(DW1000_DEVICE_0)
@@ -267,6 +269,9 @@ hal_dw1000_inst(uint8_t idx){
 
 }
 
+/* The spi transport below is provided by dw1000_sim.c in host builds */
+#if !MYNEWT_VAL(DW1000_SIM)
+
 /**
  * API to reset all the gpio pins.
  *
@@ -570,3 +575,5 @@ hal_dw1000_get_rst(struct _dw1000_dev_instance_t * inst)
 }
 
 #endif
+
+#endif
@@ -45,6 +45,7 @@
 #include <dw1000/dw1000_phy.h>
 #include <dw1000/dw1000_stats.h>
 #include <dw1000/dw1000_mac.h>
+#include <dw1000/dw1000_sim.h>
 
 #if MYNEWT_VAL(CCP_ENABLED)
 #include <ccp/ccp.h>
@@ -362,6 +363,7 @@ struct _dw1000_dev_status_t dw1000_mac_config(struct _dw1000_dev_instance_t * in
         (CHAN_CTRL_TX_PCOD_MASK & (((uint32_t)config->tx.preambleCodeIndex) << CHAN_CTRL_TX_PCOD_SHIFT)) | // TX Preamble Code
         (CHAN_CTRL_RX_PCOD_MASK & (((uint32_t)config->rx.preambleCodeIndex) << CHAN_CTRL_RX_PCOD_SHIFT)) ; // RX Preamble Code
 
+    inst->chan_ctrl_reg = regval;
     dw1000_write_reg(inst, CHAN_CTRL_ID, 0, regval, sizeof(uint32_t)) ;
 
     /* Set up TX Preamble Size, PRF and Data Rate */
@@ -529,6 +531,7 @@ inline void dw1000_write_tx_fctrl(struct _dw1000_dev_instance_t * inst, uint16_t
     // Write the frame length to the TX frame control register
     uint32_t tx_fctrl_reg = inst->tx_fctrl | (txFrameLength + 2)  | (((uint32_t)txBufferOffset) << TX_FCTRL_TXBOFFS_SHFT);
     dw1000_write_reg(inst, TX_FCTRL_ID, 0, tx_fctrl_reg, sizeof(uint32_t));
+    inst->tx_frame_len = txFrameLength + 2;
  
     err = os_mutex_release(&inst->mutex); 
     assert(err == OS_OK);  
@@ -616,6 +619,7 @@ inline struct _dw1000_dev_status_t dw1000_set_delay_start(struct _dw1000_dev_ins
     assert(err == OS_OK);
 
     inst->control.delay_start_enabled = true;
+    inst->dx_time = dx_time;
     dw1000_write_reg(inst, DX_TIME_ID, 1, dx_time >> 8, DX_TIME_LEN-1);
 
     err = os_mutex_release(&inst->mutex); 
@@ -737,6 +741,49 @@ dw1000_set_on_error_continue(struct _dw1000_dev_instance_t * inst, bool enable)
 }
 
 
+/**
+ * API to switch the tx and rx preamble codes without a full dw1000_mac_config(). Only the upper half word of
+ * CHAN_CTRL, which holds the codes, is written, and the LDE replica coefficient when the rx code changes.
+ * The channel and PRF are unchanged, so the codes must suit the configured PRF. Call while the transceiver is idle.
+ *
+ * @param inst      pointer to _dw1000_dev_instance_t.
+ * @param tx_code   TX preamble code.
+ * @param rx_code   RX preamble code.
+ * @return dw1000_dev_status_t
+ */
+struct _dw1000_dev_status_t
+dw1000_set_preamble_code(struct _dw1000_dev_instance_t * inst, uint8_t tx_code, uint8_t rx_code)
+{
+#ifdef DW1000_API_ERROR_CHECK
+    assert(((inst->config.prf == DWT_PRF_64M) && (tx_code >= 9) && (tx_code <= 24) && (rx_code >= 9) && (rx_code <= 24)) ||
+           ((inst->config.prf == DWT_PRF_16M) && (tx_code >= 1) && (tx_code <= 8) && (rx_code >= 1) && (rx_code <= 8)));
+#endif
+    uint32_t regval = (inst->chan_ctrl_reg & ~(CHAN_CTRL_TX_PCOD_MASK | CHAN_CTRL_RX_PCOD_MASK)) |
+        (CHAN_CTRL_TX_PCOD_MASK & (((uint32_t)tx_code) << CHAN_CTRL_TX_PCOD_SHIFT)) |   // TX Preamble Code
+        (CHAN_CTRL_RX_PCOD_MASK & (((uint32_t)rx_code) << CHAN_CTRL_RX_PCOD_SHIFT));    // RX Preamble Code
+
+    if (regval == inst->chan_ctrl_reg)
+        return inst->status;
+
+    os_error_t err = os_mutex_pend(&inst->mutex,  OS_TIMEOUT_NEVER); // Block if request pending
+    assert(err == OS_OK);
+
+    bool rx_changed = (regval ^ inst->chan_ctrl_reg) & CHAN_CTRL_RX_PCOD_MASK;
+    inst->chan_ctrl_reg = regval;
+    dw1000_write_reg(inst, CHAN_CTRL_ID, 2, regval >> 16, sizeof(uint16_t));
+    if (rx_changed) {
+        uint16_t reg16 = lde_replicaCoeff[rx_code];
+        if(inst->config.dataRate == DWT_BR_110K)
+            reg16 >>= 3; // lde_replicaCoeff must be divided by 8
+        dw1000_write_reg(inst, LDE_IF_ID, LDE_REPC_OFFSET, reg16, sizeof(uint16_t));
+    }
+
+    err = os_mutex_release(&inst->mutex);
+    assert(err == OS_OK);
+
+    return inst->status;
+}
+
 /**
  * API to set Wait Timeout period.
  *
@@ -1172,9 +1219,13 @@ dw1000_tasks_init(struct _dw1000_dev_instance_t * inst)
                      inst->task_prio, OS_WAIT_FOREVER,
                      inst->task_stack,
                      DW1000_DEV_TASK_STACK_SZ);
+#if MYNEWT_VAL(DW1000_SIM)
+        dw1000_sim_irq_init(inst, dw1000_irq, inst);
+#else
         /* Enable pull-down on IRQ to not get spurious interrupts when dw1000 is sleeping */
         hal_gpio_irq_init(inst->irq_pin, dw1000_irq, inst, HAL_GPIO_TRIG_RISING, HAL_GPIO_PULL_DOWN);
         hal_gpio_irq_enable(inst->irq_pin);
+#endif
     }    
     dw1000_phy_interrupt_mask(inst,          SYS_MASK_MCPLOCK | SYS_MASK_MRXDFR | SYS_MASK_MLDEERR |  SYS_MASK_MTXFRS  | SYS_MASK_ALL_RX_TO   | SYS_MASK_ALL_RX_ERR | SYS_MASK_MTXBERR, false);
     dw1000_write_reg(inst, SYS_STATUS_ID, 0, SYS_STATUS_CPLOCK| SYS_STATUS_RXDFR | SYS_STATUS_LDEERR | SYS_STATUS_TXFRS | SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR | SYS_STATUS_TXBERR, sizeof(uint32_t)); // Clear SLP2INIT event bits
@@ -1191,6 +1242,7 @@ dw1000_tasks_init(struct _dw1000_dev_instance_t * inst)
 static void 
 dw1000_irq(void *arg){
     dw1000_dev_instance_t * inst = arg;
+    inst->irq_cputime = os_cputime_get32();
     os_eventq_put(&inst->eventq, &inst->interrupt_ev);   
 }
 
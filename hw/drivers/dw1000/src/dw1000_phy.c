@@ -303,6 +303,28 @@ float dw1000_phy_read_wakeuptemp_SI(struct _dw1000_dev_instance_t * inst)
    return 1.14 * (dw1000_phy_read_wakeuptemp(inst) - inst->otp_temp) + 23;
 }
 
+/**
+ * API to sample and read the current temperature of the DW1000. Runs a SAR conversion,
+ * call between frames as the sequence touches the analog RF configuration.
+ *
+ * @param inst    Pointer to dw1000_dev_instance_t. 
+ * @return float  value for temperature sensor in SI units (Degrees C).
+ */
+float dw1000_phy_read_temp_SI(struct _dw1000_dev_instance_t * inst)
+{
+    // Enable the SAR and its reference, see dwt_readtempvbat
+    dw1000_write_reg(inst, RF_CONF_ID, 0x11, 0x80, sizeof(uint8_t));
+    dw1000_write_reg(inst, RF_CONF_ID, 0x12, 0x0A, sizeof(uint8_t));
+    dw1000_write_reg(inst, RF_CONF_ID, 0x12, 0x0F, sizeof(uint8_t));
+    // Start a conversion
+    dw1000_write_reg(inst, TX_CAL_ID, TC_SARL_SAR_C, 0x00, sizeof(uint8_t));
+    dw1000_write_reg(inst, TX_CAL_ID, TC_SARL_SAR_C, 0x01, sizeof(uint8_t));
+    os_cputime_delay_usecs(10);
+    uint8_t temp = dw1000_read_reg(inst, TX_CAL_ID, TC_SARL_SAR_LTEMP_OFFSET, sizeof(uint8_t));
+    dw1000_write_reg(inst, TX_CAL_ID, TC_SARL_SAR_C, 0x00, sizeof(uint8_t));
+    return 1.14 * (temp - inst->otp_temp) + 23;
+}
+
 /**
  * API to read the battery voltage of the DW1000 that was sampled
  * on waking from Sleep/Deepsleep. They are not current values, but read on last
@@ -38,6 +38,7 @@
 #include <dw1000/dw1000_regs.h>
 #include <dw1000/dw1000_hal.h>
 #include <dw1000/dw1000_phy.h>
+#include <dw1000/dw1000_sim.h>
 
 #define DIAGMSG(s,u) printf(s,u)
 #ifndef DIAGMSG
@@ -55,6 +56,9 @@ void dw1000_pkg_init(void){
     DIAGMSG("{\"utime\": %lu,\"msg\": \"dw1000_pkg_init\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
 #endif
 
+#if MYNEWT_VAL(DW1000_SIM)
+    dw1000_sim_init();
+#endif
 #if MYNEWT_VAL(DW1000_DEVICE_0)
     dw1000_dev_config(hal_dw1000_inst(0));
 #endif
@@ -0,0 +1,937 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file dw1000_sim.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Simulated DW1000
+ *
+ * @details Register level model of the DW1000 that replaces the spi transport of dw1000_hal.c when DW1000_SIM is set,
+ * so the driver and the ranging libraries run unmodified on a host build. Time is virtual: every register access costs
+ * its spi transfer time, radio events are scheduled from the phy airtime formulas and a low priority task advances the
+ * clock to the next event whenever the other tasks are idle. Each device has its own crystal offset, position and
+ * frame loss probability. The model covers what the MAC uses: immediate and delayed tx and rx, wait-for-response,
+ * frame wait timeout, frame filtering of data frames, the rx timestamp, carrier integrator and diagnostics registers and
+ * the edge triggered interrupt line. Antenna delays are taken as calibrated, timestamps are the local time of the frame
+ * rmarker at the antenna.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <os/os.h>
+#include <syscfg/syscfg.h>
+
+#include <dw1000/dw1000_regs.h>
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_hal.h>
+#include <dw1000/dw1000_mac.h>
+#include <dw1000/dw1000_phy.h>
+#include <dw1000/dw1000_otp.h>
+#include <dw1000/dw1000_sim.h>
+
+#if MYNEWT_VAL(DW1000_SIM)
+
+#if MYNEWT_VAL(DW1000_DEVICE_1)
+#define SIM_NDEVICES 2
+#else
+#define SIM_NDEVICES 1
+#endif
+#define SIM_NFRAMES (4 * SIM_NDEVICES)      //!< Frames in flight, each transmission needs one per receiver
+#define SIM_REG_SIZE 0x8000                 //!< Sub-addressable area of a register file
+#define SIM_MASK40 0xFFFFFFFFFFULL
+#define SIM_NEVER INT64_MAX
+
+#define SIM_DTU_PER_PSEC (499.2e6 * 128 * 1e-12)   //!< Decawave time units per picosecond
+#define SIM_UUS_PSECS (512 / 499.2e6 * 1e12)       //!< UWB microsecond in picoseconds
+#define SIM_SPEED_OF_LIGHT (299792458.0 / 1.000293) //!< Propagation speed in air (m/s)
+
+//! Radio state, mirrors PMSC_STATE
+typedef enum _sim_state_t{
+    SIM_IDLE,
+    SIM_TX_WAIT,            //!< Delayed tx armed, t_event is the preamble start
+    SIM_TX,                 //!< Frame on air, t_event is the last symbol
+    SIM_RX_WAIT,            //!< Delayed or wait-for-response rx armed, t_event turns the receiver on
+    SIM_RX,                 //!< Receiver hunting for a preamble
+    SIM_RXING               //!< Receiver locked on rxing, t_event is the last symbol
+}sim_state_t;
+
+//! Frame on its way to one receiver
+typedef struct _sim_frame_t{
+    bool used;
+    uint8_t src;            //!< Transmitting device
+    uint8_t dst;            //!< Receiving device
+    int64_t t_acq;          //!< Receiver must be hunting by now to acquire the preamble (psec)
+    int64_t t_rmarker;      //!< Rmarker at the receiver antenna (psec)
+    int64_t t_end;          //!< Last symbol at the receiver antenna (psec)
+    uint32_t chan_ctrl;     //!< CHAN_CTRL of the transmitter
+    uint16_t len;           //!< Frame length including the FCS
+    uint8_t data[1024];
+}sim_frame_t;
+
+//! Simulated device
+typedef struct _sim_node_t{
+    struct _dw1000_dev_instance_t * inst;
+    uint8_t * regs[0x40];   //!< Register files, allocated on first access
+    double base;            //!< Local time at t0 (dtu), not wrapped
+    int64_t t0;             //!< Clock anchor (psec)
+    double rate;            //!< Local clock rate (dtu/psec)
+    float ppm;
+    float pos[3];
+    float loss;
+    sim_state_t state;
+    int64_t t_event;        //!< Next state transition (psec)
+    int64_t t_timeout;      //!< Frame wait timeout (psec), SIM_NEVER if none
+    int64_t t_rx_on;        //!< Receiver enable the frame wait timeout counts from (psec)
+    bool w4r;               //!< Turn the receiver on after the frame in flight
+    sim_frame_t * rxing;
+    int64_t t_rmarker;      //!< Rmarker of the frame in flight at the antenna (psec)
+    uint64_t tx_stamp;
+    bool irq_line;
+    bool irq_pending;
+    void (* irq)(void *);
+    void * irq_arg;
+    dw1000_sim_stats_t stats;
+}sim_node_t;
+
+static sim_node_t g_nodes[SIM_NDEVICES];
+static sim_frame_t g_frames[SIM_NFRAMES];
+static int64_t g_now;                       //!< Simulated time (psec)
+static uint32_t g_seed = 0x2545F491;
+static dw1000_sim_trace_cb_t * g_trace;
+static struct os_sem g_spi_sem;
+static struct os_task g_task;
+static os_stack_t g_task_stack[MYNEWT_VAL(DW1000_SIM_TASK_STACK_SZ)]
+    __attribute__((aligned(OS_STACK_ALIGNMENT)));
+
+static void sim_advance(int64_t t);
+
+static sim_node_t *
+sim_node(struct _dw1000_dev_instance_t * inst){
+    assert(inst->idx < SIM_NDEVICES);
+    return &g_nodes[inst->idx];
+}
+
+static uint8_t *
+sim_reg(sim_node_t * node, uint8_t reg){
+    if (node->regs[reg] == NULL){
+        node->regs[reg] = (uint8_t *) calloc(1, SIM_REG_SIZE);
+        assert(node->regs[reg]);
+    }
+    return node->regs[reg];
+}
+
+static uint64_t
+sim_reg_get(sim_node_t * node, uint8_t reg, uint16_t offset, uint8_t nbytes){
+    uint8_t * p = sim_reg(node, reg) + offset;
+    uint64_t val = 0;
+    for (int8_t i = nbytes - 1; i >= 0; i--)
+        val = (val << 8) | p[i];
+    return val;
+}
+
+static void
+sim_reg_set(sim_node_t * node, uint8_t reg, uint16_t offset, uint64_t val, uint8_t nbytes){
+    uint8_t * p = sim_reg(node, reg) + offset;
+    for (uint8_t i = 0; i < nbytes; i++, val >>= 8)
+        p[i] = (uint8_t) val;
+}
+
+static void
+sim_trace(sim_node_t * node, dw1000_sim_event_t event){
+    if (g_trace)
+        g_trace(node->inst, event, g_now / 1000);
+}
+
+/* xorshift32, the runs are reproducible */
+static float
+sim_uniform(void){
+    g_seed ^= g_seed << 13;
+    g_seed ^= g_seed >> 17;
+    g_seed ^= g_seed << 5;
+    return (g_seed >> 8) * (1.0f / 16777216.0f);
+}
+
+static float
+sim_gauss(void){
+    float u = sim_uniform();
+    float v = sim_uniform();
+    return sqrtf(-2.0f * logf(u + 1e-12f)) * cosf(2.0f * (float)M_PI * v);
+}
+
+static double
+sim_local(sim_node_t * node, int64_t t){
+    return node->base + (double)(t - node->t0) * node->rate;
+}
+
+static uint64_t
+sim_stamp(sim_node_t * node, int64_t t){
+    return ((uint64_t) llround(sim_local(node, t))) & SIM_MASK40;
+}
+
+/**
+ * Simulated time at which the 40 bit local clock next reads stamp. Stamps more than half a period ahead are
+ * reported late, the chip would then wait for the counter to wrap.
+ */
+static int64_t
+sim_global(sim_node_t * node, uint64_t stamp, bool * late){
+    double now = sim_local(node, g_now);
+    uint64_t d = (stamp - (uint64_t) now) & SIM_MASK40;
+    *late = d >= (1ULL << 39);
+    return g_now + (int64_t)(((double) d - (now - floor(now))) / node->rate);
+}
+
+static uint64_t
+sim_status(sim_node_t * node){
+    return sim_reg_get(node, SYS_STATUS_ID, 0, 5);
+}
+
+static void
+sim_irq_update(sim_node_t * node){
+    uint32_t mask = sim_reg_get(node, SYS_MASK_ID, 0, 4);
+    bool line = (sim_status(node) & mask) != 0;
+    if (line && !node->irq_line)
+        node->irq_pending = true;
+    node->irq_line = line;
+}
+
+static void
+sim_set_status(sim_node_t * node, uint64_t bits){
+    sim_reg_set(node, SYS_STATUS_ID, 0, sim_status(node) | bits, 5);
+    sim_irq_update(node);
+}
+
+static void
+sim_clear_status(sim_node_t * node, uint64_t bits){
+    sim_reg_set(node, SYS_STATUS_ID, 0, sim_status(node) & ~bits, 5);
+    sim_irq_update(node);
+}
+
+static void
+sim_frame_free(sim_frame_t * frame){
+    frame->used = false;
+}
+
+static void
+sim_rx_on(sim_node_t * node, int64_t t){
+    node->state = SIM_RX;
+    node->t_event = SIM_NEVER;
+    node->t_timeout = SIM_NEVER;
+    node->t_rx_on = t;
+    if (sim_reg_get(node, SYS_CFG_ID, 0, 4) & SYS_CFG_RXWTOE){
+        uint16_t fwto = sim_reg_get(node, RX_FWTO_ID, RX_FWTO_OFFSET, 2);
+        node->t_timeout = t + (int64_t)(fwto * SIM_UUS_PSECS);
+    }
+}
+
+static void
+sim_trxoff(sim_node_t * node){
+    if (node->state == SIM_TX){
+        /* Frames already on their way stop with the transmitter */
+        for (uint16_t i = 0; i < SIM_NFRAMES; i++){
+            sim_frame_t * frame = &g_frames[i];
+            if (!frame->used || frame->src != node->inst->idx)
+                continue;
+            sim_node_t * rx = &g_nodes[frame->dst];
+            if (rx->rxing == frame){
+                rx->rxing = NULL;
+                rx->state = SIM_RX;
+                rx->t_event = SIM_NEVER;
+            }
+            sim_frame_free(frame);
+        }
+    }
+    if (node->rxing){
+        sim_frame_free(node->rxing);
+        node->rxing = NULL;
+    }
+    node->state = SIM_IDLE;
+    node->t_event = SIM_NEVER;
+    node->t_timeout = SIM_NEVER;
+    node->w4r = false;
+}
+
+static void
+sim_start_tx(sim_node_t * node, bool delayed, bool w4r){
+    dw1000_dev_instance_t * inst = node->inst;
+
+    sim_trxoff(node);
+    node->w4r = w4r;
+
+    int64_t shr = dw1000_phy_SHR_duration(&inst->attrib) * 1000000LL;
+
+    if (delayed){
+        bool late;
+        uint64_t dx = sim_reg_get(node, DX_TIME_ID, 0, 5) & ~0x1FFULL;
+        node->tx_stamp = (dx + sim_reg_get(node, TX_ANTD_ID, 0, 2)) & SIM_MASK40;
+        node->t_rmarker = sim_global(node, node->tx_stamp, &late);
+        node->t_event = node->t_rmarker - shr;
+        uint64_t warn = (late) ? SYS_STATUS_HPDWARN : 0;
+        if (!late && node->t_event < g_now){
+            warn = SYS_STATUS_TXPUTE;
+            node->t_event = g_now;
+        }
+        sim_clear_status(node, SYS_STATUS_HPDWARN | SYS_STATUS_TXPUTE);
+        if (warn){
+            node->stats.start_late++;
+            sim_trace(node, DW1000_SIM_START_LATE);
+            sim_set_status(node, warn);
+        }
+    }else{
+        node->t_event = g_now;
+        node->t_rmarker = g_now + shr;
+        node->tx_stamp = sim_stamp(node, node->t_rmarker);
+    }
+    node->state = SIM_TX_WAIT;
+}
+
+static void
+sim_start_rx(sim_node_t * node, bool delayed){
+    if (node->state == SIM_TX || node->state == SIM_TX_WAIT || node->state == SIM_RXING)
+        return;
+    if (delayed){
+        bool late;
+        uint64_t dx = sim_reg_get(node, DX_TIME_ID, 0, 5) & ~0x1FFULL;
+        int64_t t = sim_global(node, dx, &late);
+        sim_clear_status(node, SYS_STATUS_HPDWARN);
+        if (late){
+            node->stats.start_late++;
+            sim_trace(node, DW1000_SIM_START_LATE);
+            sim_set_status(node, SYS_STATUS_HPDWARN);
+        }
+        node->state = SIM_RX_WAIT;
+        node->t_event = t;
+        node->t_timeout = SIM_NEVER;
+    }else
+        sim_rx_on(node, g_now);
+}
+
+static void
+sim_sys_ctrl(sim_node_t * node, uint32_t ctrl){
+    if (ctrl & SYS_CTRL_TRXOFF){
+        sim_trxoff(node);
+        return;
+    }
+    if (ctrl & SYS_CTRL_TXSTRT)
+        sim_start_tx(node, ctrl & SYS_CTRL_TXDLYS, ctrl & SYS_CTRL_WAIT4RESP);
+    else if (ctrl & SYS_CTRL_RXENAB)
+        sim_start_rx(node, ctrl & SYS_CTRL_RXDLYE);
+}
+
+/**
+ * Preamble of the frame leaves the antenna, a copy is sent on its way to every other device.
+ */
+static void
+sim_tx_begin(sim_node_t * node){
+    dw1000_dev_instance_t * inst = node->inst;
+    uint32_t fctrl = sim_reg_get(node, TX_FCTRL_ID, 0, 4);
+    uint16_t len = fctrl & TX_FCTRL_FLE_MASK;
+    uint16_t offset = (fctrl >> TX_FCTRL_TXBOFFS_SHFT) & 0x3FF;
+    int64_t shr = dw1000_phy_SHR_duration(&inst->attrib) * 1000000LL;
+    int64_t airtime = dw1000_phy_frame_duration(&inst->attrib, (len > 2) ? len - 2 : 0) * 1000000LL;
+
+    node->state = SIM_TX;
+    node->t_event = g_now + airtime;
+    sim_reg_set(node, TX_TIME_ID, TX_TIME_TX_STAMP_OFFSET, node->tx_stamp, 5);
+    sim_reg_set(node, TX_TIME_ID, TX_TIME_TX_RAWST_OFFSET, (node->tx_stamp - sim_reg_get(node, TX_ANTD_ID, 0, 2)) & SIM_MASK40, 5);
+    sim_trace(node, DW1000_SIM_TX_START);
+
+    for (uint8_t i = 0; i < SIM_NDEVICES; i++){
+        if (i == inst->idx || g_nodes[i].inst == NULL)
+            continue;
+        sim_frame_t * frame = NULL;
+        for (uint16_t j = 0; j < SIM_NFRAMES && frame == NULL; j++)
+            if (!g_frames[j].used)
+                frame = &g_frames[j];
+        assert(frame);
+        int64_t tof = (int64_t)(dw1000_sim_distance(inst, g_nodes[i].inst) / SIM_SPEED_OF_LIGHT * 1e12);
+        *frame = (sim_frame_t){
+            .used = true,
+            .src = inst->idx,
+            .dst = i,
+            .t_acq = g_now + tof + shr / 2,
+            .t_rmarker = node->t_rmarker + tof,
+            .t_end = g_now + tof + airtime,
+            .chan_ctrl = sim_reg_get(node, CHAN_CTRL_ID, 0, 4),
+            .len = len
+        };
+        memcpy(frame->data, sim_reg(node, TX_BUFFER_ID) + offset, (len > 2) ? len - 2 : 0);
+    }
+}
+
+static void
+sim_tx_end(sim_node_t * node){
+    node->stats.tx_frames++;
+    sim_trace(node, DW1000_SIM_TX_DONE);
+    if (node->w4r){
+        uint32_t w4r = sim_reg_get(node, ACK_RESP_T_ID, 0, 4) & ACK_RESP_T_W4R_TIM_MASK;
+        node->w4r = false;
+        node->state = SIM_RX_WAIT;
+        node->t_event = g_now + (int64_t)(w4r * SIM_UUS_PSECS);
+        node->t_timeout = SIM_NEVER;
+    }else{
+        node->state = SIM_IDLE;
+        node->t_event = SIM_NEVER;
+    }
+    sim_set_status(node, SYS_STATUS_TXFRB | SYS_STATUS_TXPRS | SYS_STATUS_TXPHS | SYS_STATUS_TXFRS);
+}
+
+static bool
+sim_filter(sim_node_t * node, sim_frame_t * frame){
+    uint32_t cfg = sim_reg_get(node, SYS_CFG_ID, 0, 4);
+    uint32_t chan_ctrl = sim_reg_get(node, CHAN_CTRL_ID, 0, 4);
+
+    if (((frame->chan_ctrl & CHAN_CTRL_TX_CHAN_MASK) >> CHAN_CTRL_TX_CHAN_SHIFT) != ((chan_ctrl & CHAN_CTRL_RX_CHAN_MASK) >> CHAN_CTRL_RX_CHAN_SHIFT))
+        return false;
+    if (((frame->chan_ctrl & CHAN_CTRL_TX_PCOD_MASK) >> CHAN_CTRL_TX_PCOD_SHIFT) != ((chan_ctrl & CHAN_CTRL_RX_PCOD_MASK) >> CHAN_CTRL_RX_PCOD_SHIFT))
+        return false;
+    if (!(cfg & SYS_CFG_FFE))
+        return true;
+
+    /* Data frames with a short destination address only */
+    uint16_t fctrl = frame->data[0] | frame->data[1] << 8;
+    if (frame->len < 9 || (fctrl & 0x7) != 1 || !(cfg & SYS_CFG_FFAD) || ((fctrl >> 10) & 0x3) != 2)
+        return false;
+    uint16_t pan = frame->data[3] | frame->data[4] << 8;
+    uint16_t dst = frame->data[5] | frame->data[6] << 8;
+    uint16_t my_pan = sim_reg_get(node, PANADR_ID, 2, 2);
+    uint16_t my_addr = sim_reg_get(node, PANADR_ID, 0, 2);
+    return (pan == my_pan || pan == 0xFFFF) && (dst == my_addr || dst == 0xFFFF);
+}
+
+static void
+sim_rx_acquire(sim_frame_t * frame){
+    sim_node_t * node = &g_nodes[frame->dst];
+    if (node->state != SIM_RX || !sim_filter(node, frame)){
+        sim_frame_free(frame);
+        return;
+    }
+    if (sim_uniform() < node->loss){
+        node->stats.rx_lost++;
+        sim_trace(node, DW1000_SIM_RX_LOST);
+        sim_frame_free(frame);
+        return;
+    }
+    node->state = SIM_RXING;
+    node->rxing = frame;
+    node->t_event = frame->t_end;
+    frame->t_acq = SIM_NEVER;
+}
+
+/**
+ * Fills the rx registers the MAC reads on RXFCG: frame, timestamps, carrier integrator, time tracking offset and a
+ * line of sight link budget for the diagnostics.
+ */
+static void
+sim_rx_end(sim_node_t * node){
+    dw1000_dev_instance_t * inst = node->inst;
+    sim_frame_t * frame = node->rxing;
+    sim_node_t * tx = &g_nodes[frame->src];
+
+    uint64_t stamp = (uint64_t)(llround(sim_local(node, frame->t_rmarker) + MYNEWT_VAL(DW1000_SIM_RX_NOISE) * sim_gauss())) & SIM_MASK40;
+    uint16_t pacc = inst->attrib.nsync;
+    float d = dw1000_sim_distance(inst, tx->inst);
+    float A = (inst->config.prf == DWT_PRF_16M) ? 113.77f : 121.74f;
+    float pl = 20.0f * log10f(4.0f * (float)M_PI * ((d > 0.1f) ? d : 0.1f) * MYNEWT_VAL(DW1000_DEVICE_FREQ) * 1e6f / (float)SIM_SPEED_OF_LIGHT);
+    float rssi = MYNEWT_VAL(DW1000_DEVICE_TX_PWR) + 2 * MYNEWT_VAL(DW1000_DEVICE_ANT_GAIN) - pl;
+    float power = powf(10.0f, (rssi + A) / 10.0f) * pacc * pacc;
+    float cir_pwr = power / 0x20000;
+    float fp_amp = sqrtf(power / 3);
+
+    memcpy(sim_reg(node, RX_BUFFER_ID), frame->data, (frame->len > 2) ? frame->len - 2 : 0);
+    sim_reg_set(node, RX_FINFO_ID, RX_FINFO_OFFSET, (frame->len & RX_FINFO_RXFL_MASK_1023) | ((uint32_t) pacc << RX_FINFO_RXPACC_SHIFT), 4);
+    sim_reg_set(node, RX_TIME_ID, RX_TIME_RX_STAMP_OFFSET, stamp, 5);
+    sim_reg_set(node, RX_TIME_ID, RX_TIME_FP_INDEX_OFFSET, 745 << 6, 2);
+    sim_reg_set(node, RX_TIME_ID, RX_TIME_FP_AMPL1_OFFSET, (fp_amp < 0xFFFF) ? (uint16_t) fp_amp : 0xFFFF, 2);
+    sim_reg_set(node, RX_TIME_ID, RX_TIME_FP_RAWST_OFFSET, (stamp + sim_reg_get(node, LDE_IF_ID, LDE_RXANTD_OFFSET, 2)) & SIM_MASK40, 5);
+    sim_reg_set(node, RX_FQUAL_ID, 0,
+        40 | ((uint64_t)((fp_amp < 0xFFFF) ? fp_amp : 0xFFFF) << 16) | ((uint64_t)((fp_amp < 0xFFFF) ? fp_amp : 0xFFFF) << 32)
+            | ((uint64_t)((cir_pwr < 0xFFFF) ? cir_pwr : 0xFFFF) << 48), 8);
+
+    /* Offset of the remote crystal relative to the local one, positive when the remote runs fast */
+    float ratio = (tx->ppm - node->ppm) * 1e-6f;
+    int32_t integrator = lroundf(ratio / dw1000_calc_clock_offset_ratio(inst, 1));
+    int32_t ttcko = lroundf(-ratio * ((inst->config.prf == DWT_PRF_16M) ? 0x01F00000 : 0x01FC0000));
+    sim_reg_set(node, DRX_CONF_ID, DRX_CARRIER_INT_OFFSET, (uint32_t) integrator & 0x1FFFFF, 3);
+    sim_reg_set(node, RX_TTCKO_ID, 0, (uint32_t) ttcko & 0x7FFFF, 3);
+
+    sim_frame_free(frame);
+    node->rxing = NULL;
+    node->state = SIM_IDLE;
+    node->t_event = SIM_NEVER;
+    node->t_timeout = SIM_NEVER;
+    node->stats.rx_frames++;
+    sim_trace(node, DW1000_SIM_RX_DONE);
+    sim_set_status(node, SYS_STATUS_RXPRD | SYS_STATUS_RXSFDD | SYS_STATUS_LDEDONE | SYS_STATUS_RXPHD | SYS_STATUS_RXDFR | SYS_STATUS_RXFCG);
+}
+
+static void
+sim_rx_timeout(sim_node_t * node){
+    if (node->rxing){
+        sim_frame_free(node->rxing);
+        node->rxing = NULL;
+    }
+    node->state = SIM_IDLE;
+    node->t_event = SIM_NEVER;
+    node->t_timeout = SIM_NEVER;
+    node->stats.rx_timeouts++;
+    sim_trace(node, DW1000_SIM_RX_TIMEOUT);
+    sim_set_status(node, SYS_STATUS_RXRFTO);
+}
+
+/**
+ * Earliest pending radio event, SIM_NEVER if the radios are all idle or hunting without a timeout.
+ */
+static int64_t
+sim_next_event(void){
+    int64_t t = SIM_NEVER;
+    for (uint8_t i = 0; i < SIM_NDEVICES; i++){
+        sim_node_t * node = &g_nodes[i];
+        if (node->t_event < t)
+            t = node->t_event;
+        if (node->t_timeout < t)
+            t = node->t_timeout;
+    }
+    for (uint16_t i = 0; i < SIM_NFRAMES; i++)
+        if (g_frames[i].used && g_frames[i].t_acq < t)
+            t = g_frames[i].t_acq;
+    return t;
+}
+
+/**
+ * Runs the event due at t.
+ */
+static void
+sim_run_event(int64_t t){
+    for (uint16_t i = 0; i < SIM_NFRAMES; i++){
+        if (g_frames[i].used && g_frames[i].t_acq == t){
+            sim_rx_acquire(&g_frames[i]);
+            return;
+        }
+    }
+    for (uint8_t i = 0; i < SIM_NDEVICES; i++){
+        sim_node_t * node = &g_nodes[i];
+        if (node->t_timeout == t){
+            if (node->state == SIM_RX || node->state == SIM_RXING)
+                sim_rx_timeout(node);
+            else
+                node->t_timeout = SIM_NEVER;
+            return;
+        }
+        if (node->t_event != t)
+            continue;
+        switch(node->state){
+            case SIM_TX_WAIT: sim_tx_begin(node); break;
+            case SIM_TX: sim_tx_end(node); break;
+            case SIM_RX_WAIT: sim_rx_on(node, t); break;
+            case SIM_RXING: sim_rx_end(node); break;
+            default: node->t_event = SIM_NEVER; break;
+        }
+        return;
+    }
+}
+
+/**
+ * Moves the simulated time to t, running the radio events due on the way. Called with interrupts disabled.
+ */
+static void
+sim_advance(int64_t t){
+    int64_t next;
+    while ((next = sim_next_event()) <= t){
+        if (next > g_now)
+            g_now = next;
+        sim_run_event(next);
+    }
+    if (t > g_now)
+        g_now = t;
+}
+
+/**
+ * Raises the interrupts latched by the last access or event. The handler runs after the interrupt latency, outside
+ * the critical section.
+ */
+static void
+sim_irq_deliver(void){
+    for (uint8_t i = 0; i < SIM_NDEVICES; i++){
+        sim_node_t * node = &g_nodes[i];
+        if (!node->irq_pending || node->irq == NULL)
+            continue;
+        os_sr_t sr;
+        OS_ENTER_CRITICAL(sr);
+        node->irq_pending = false;
+        sim_advance(g_now + MYNEWT_VAL(DW1000_SIM_IRQ_LATENCY) * 1000LL);
+        OS_EXIT_CRITICAL(sr);
+        node->irq(node->irq_arg);
+    }
+}
+
+/**
+ * Charges the bus time of a transfer and decodes its header.
+ */
+static uint16_t
+sim_transfer(sim_node_t * node, const uint8_t * cmd, uint8_t cmd_size, uint16_t length, uint8_t * reg){
+    uint32_t baudrate = node->inst->spi_settings.baudrate;
+    uint64_t nsecs = MYNEWT_VAL(DW1000_SIM_SPI_OVERHEAD) + (uint64_t)(cmd_size + length) * 8 * 1000000 / ((baudrate) ? baudrate : 1);
+
+    node->stats.spi_transfers++;
+    node->stats.spi_bytes += cmd_size + length;
+    node->stats.spi_nsecs += nsecs;
+    sim_advance(g_now + nsecs * 1000);
+
+    *reg = cmd[0] & 0x3F;
+    uint16_t subaddress = (cmd_size > 1) ? cmd[1] & 0x7F : 0;
+    if (cmd_size > 2)
+        subaddress |= (uint16_t) cmd[2] << 7;
+    assert(subaddress + length <= SIM_REG_SIZE);
+    return subaddress;
+}
+
+static void
+sim_read(struct _dw1000_dev_instance_t * inst, const uint8_t * cmd, uint8_t cmd_size, uint8_t * buffer, uint16_t length){
+    sim_node_t * node = sim_node(inst);
+    uint8_t reg;
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    uint16_t subaddress = sim_transfer(node, cmd, cmd_size, length, &reg);
+    switch(reg){
+        case DEV_ID_ID:
+            sim_reg_set(node, DEV_ID_ID, 0, DWT_DEVICE_ID, 4);
+            break;
+        case SYS_TIME_ID:
+            sim_reg_set(node, SYS_TIME_ID, 0, sim_stamp(node, g_now) & ~0x1FFULL, 5);
+            break;
+        case SYS_STATUS_ID:
+            sim_reg_set(node, SYS_STATUS_ID, 0, (sim_status(node) & ~SYS_STATUS_IRQS) | node->irq_line, 5);
+            break;
+        case SYS_STATE_ID:{
+            static const uint8_t pmsc[] = {
+                [SIM_IDLE] = PMSC_STATE_IDLE, [SIM_TX_WAIT] = PMSC_STATE_TX_WAIT, [SIM_TX] = PMSC_STATE_TX,
+                [SIM_RX_WAIT] = PMSC_STATE_RX_WAIT, [SIM_RX] = PMSC_STATE_RX, [SIM_RXING] = PMSC_STATE_RX
+            };
+            sim_reg_set(node, SYS_STATE_ID, PMSC_STATE_OFFSET, pmsc[node->state], 1);
+            break;
+        }
+        default:
+            break;
+    }
+    memcpy(buffer, sim_reg(node, reg) + subaddress, length);
+    OS_EXIT_CRITICAL(sr);
+    sim_irq_deliver();
+}
+
+static void
+sim_write(struct _dw1000_dev_instance_t * inst, const uint8_t * cmd, uint8_t cmd_size, uint8_t * buffer, uint16_t length){
+    sim_node_t * node = sim_node(inst);
+    uint8_t reg;
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    uint16_t subaddress = sim_transfer(node, cmd, cmd_size, length, &reg);
+    switch(reg){
+        case SYS_STATUS_ID:{
+            /* Write one to clear */
+            uint8_t * p = sim_reg(node, SYS_STATUS_ID);
+            for (uint16_t i = 0; i < length && subaddress + i < 5; i++)
+                p[subaddress + i] &= ~buffer[i];
+            sim_irq_update(node);
+            break;
+        }
+        case SYS_CTRL_ID:{
+            uint32_t ctrl = 0;
+            for (uint16_t i = 0; i < length && subaddress + i < SYS_CTRL_LEN; i++)
+                ctrl |= (uint32_t) buffer[i] << (8 * (subaddress + i));
+            sim_sys_ctrl(node, ctrl);
+            break;
+        }
+        case OTP_IF_ID:
+            memcpy(sim_reg(node, reg) + subaddress, buffer, length);
+            if (sim_reg_get(node, OTP_IF_ID, OTP_CTRL, 2) & OTP_CTRL_OTPREAD){
+                /* Part and lot ids give each device its own short address */
+                uint16_t address = sim_reg_get(node, OTP_IF_ID, OTP_ADDR, 2);
+                uint32_t value = (address == OTP_PARTID_ADDRESS) ? 0x1000 + inst->idx + 1
+                               : (address == OTP_LOTID_ADDRESS) ? 0x51A0 : 0;
+                sim_reg_set(node, OTP_IF_ID, OTP_RDAT, value, 4);
+            }
+            break;
+        default:
+            memcpy(sim_reg(node, reg) + subaddress, buffer, length);
+            if (reg == SYS_MASK_ID)
+                sim_irq_update(node);
+            /* The counter runs from the receiver enable, a new timeout applies to the listen in progress */
+            if (reg == RX_FWTO_ID && (node->state == SIM_RX || node->state == SIM_RXING)
+                    && (sim_reg_get(node, SYS_CFG_ID, 0, 4) & SYS_CFG_RXWTOE)){
+                int64_t t = node->t_rx_on + (int64_t)(sim_reg_get(node, RX_FWTO_ID, RX_FWTO_OFFSET, 2) * SIM_UUS_PSECS);
+                node->t_timeout = (t > g_now) ? t : g_now;
+            }
+            break;
+    }
+    OS_EXIT_CRITICAL(sr);
+    sim_irq_deliver();
+}
+
+void
+hal_dw1000_reset(struct _dw1000_dev_instance_t * inst)
+{
+    sim_node_t * node = sim_node(inst);
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    sim_trxoff(node);
+    for (uint8_t i = 0; i < sizeof(node->regs)/sizeof(node->regs[0]); i++)
+        if (node->regs[i])
+            memset(node->regs[i], 0, SIM_REG_SIZE);
+    sim_reg_set(node, SYS_CFG_ID, 0, SYS_CFG_DIS_DRXB | SYS_CFG_HIRQ_POL, 4);
+    sim_reg_set(node, PANADR_ID, 0, 0xFFFFFFFF, 4);
+    node->irq_line = node->irq_pending = false;
+    sim_advance(g_now + 5000000000LL);
+    OS_EXIT_CRITICAL(sr);
+}
+
+void
+hal_dw1000_read(struct _dw1000_dev_instance_t * inst, const uint8_t * cmd, uint8_t cmd_size, uint8_t * buffer, uint16_t length)
+{
+    sim_read(inst, cmd, cmd_size, buffer, length);
+}
+
+void
+hal_dw1000_read_noblock(struct _dw1000_dev_instance_t * inst, const uint8_t * cmd, uint8_t cmd_size, uint8_t * buffer, uint16_t length)
+{
+    sim_read(inst, cmd, cmd_size, buffer, length);
+}
+
+void
+hal_dw1000_write(struct _dw1000_dev_instance_t * inst, const uint8_t * cmd, uint8_t cmd_size, uint8_t * buffer, uint16_t length)
+{
+    sim_write(inst, cmd, cmd_size, buffer, length);
+}
+
+void
+hal_dw1000_write_noblock(struct _dw1000_dev_instance_t * inst, const uint8_t * cmd, uint8_t cmd_size, uint8_t * buffer, uint16_t length)
+{
+    sim_write(inst, cmd, cmd_size, buffer, length);
+}
+
+/* Simulated transfers complete before they return */
+os_error_t
+hal_dw1000_rw_noblock_wait(struct _dw1000_dev_instance_t * inst, os_time_t timeout)
+{
+    return OS_OK;
+}
+
+void
+hal_dw1000_spi_txrx_cb(void *arg, int len)
+{
+}
+
+void
+hal_dw1000_wakeup(struct _dw1000_dev_instance_t * inst)
+{
+}
+
+int
+hal_dw1000_get_rst(struct _dw1000_dev_instance_t * inst)
+{
+    return 1;
+}
+
+/**
+ * API to connect the interrupt line of a simulated device, replaces hal_gpio_irq_init.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ * @param irq   Interrupt handler, called on a rising edge of SYS_STATUS & SYS_MASK.
+ * @param arg   Argument of irq.
+ * @return void
+ */
+void
+dw1000_sim_irq_init(struct _dw1000_dev_instance_t * inst, void (* irq)(void *), void * arg)
+{
+    sim_node_t * node = sim_node(inst);
+    node->irq = irq;
+    node->irq_arg = arg;
+}
+
+/**
+ * API to run the next radio event and the interrupts it raises.
+ *
+ * @return true if an event was run, false if nothing is scheduled
+ */
+bool
+dw1000_sim_step(void)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    int64_t t = sim_next_event();
+    if (t != SIM_NEVER)
+        sim_advance(t);
+    OS_EXIT_CRITICAL(sr);
+    sim_irq_deliver();
+    return t != SIM_NEVER;
+}
+
+/**
+ * API to read the simulated time.
+ *
+ * @return nanoseconds since the start of the simulation
+ */
+uint64_t
+dw1000_sim_nsecs(void)
+{
+    return g_now / 1000;
+}
+
+/**
+ * API to place a device.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ * @param x     Coordinates (m)
+ * @return void
+ */
+void
+dw1000_sim_set_position(struct _dw1000_dev_instance_t * inst, float x, float y, float z)
+{
+    sim_node_t * node = sim_node(inst);
+    node->pos[0] = x;
+    node->pos[1] = y;
+    node->pos[2] = z;
+}
+
+/**
+ * API to read the true distance between two devices.
+ *
+ * @param inst      Pointer to dw1000_dev_instance_t.
+ * @param remote    Pointer to dw1000_dev_instance_t.
+ * @return distance (m)
+ */
+float
+dw1000_sim_distance(struct _dw1000_dev_instance_t * inst, struct _dw1000_dev_instance_t * remote)
+{
+    sim_node_t * a = sim_node(inst);
+    sim_node_t * b = sim_node(remote);
+    float dx = a->pos[0] - b->pos[0];
+    float dy = a->pos[1] - b->pos[1];
+    float dz = a->pos[2] - b->pos[2];
+    return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+/**
+ * API to set the crystal offset of a device. The clock is re-anchored at the current time so the offset can be
+ * changed while running, e.g. to follow a temperature ramp.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ * @param ppm   Offset from the nominal 63.8976 GHz (ppm)
+ * @return void
+ */
+void
+dw1000_sim_set_drift(struct _dw1000_dev_instance_t * inst, float ppm)
+{
+    sim_node_t * node = sim_node(inst);
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    node->base = sim_local(node, g_now);
+    node->t0 = g_now;
+    node->ppm = ppm;
+    node->rate = SIM_DTU_PER_PSEC * (1.0 + ppm * 1e-6);
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * API to set the probability that a frame addressed to this device is lost.
+ *
+ * @param inst          Pointer to dw1000_dev_instance_t.
+ * @param probability   0 to 1
+ * @return void
+ */
+void
+dw1000_sim_set_loss(struct _dw1000_dev_instance_t * inst, float probability)
+{
+    sim_node(inst)->loss = probability;
+}
+
+/**
+ * API to register the radio event trace callback, NULL to remove it.
+ *
+ * @param cb    Callback
+ * @return void
+ */
+void
+dw1000_sim_set_trace(dw1000_sim_trace_cb_t * cb)
+{
+    g_trace = cb;
+}
+
+/**
+ * API to access the counters of a device.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ * @return dw1000_sim_stats_t
+ */
+dw1000_sim_stats_t *
+dw1000_sim_get_stats(struct _dw1000_dev_instance_t * inst)
+{
+    return &sim_node(inst)->stats;
+}
+
+static void
+sim_task(void * arg)
+{
+    while (1) {
+        if (!dw1000_sim_step())
+            os_time_delay(1);
+    }
+}
+
+/**
+ * API to create the simulated devices and the task that advances time. Called from dw1000_pkg_init in place of
+ * the BSP device creation.
+ *
+ * @return void
+ */
+void
+dw1000_sim_init(void)
+{
+    os_error_t err = os_sem_init(&g_spi_sem, 0x1);
+    assert(err == OS_OK);
+
+    for (uint8_t i = 0; i < SIM_NDEVICES; i++){
+        sim_node_t * node = &g_nodes[i];
+        struct dw1000_dev_cfg cfg = {
+            .spi_sem = &g_spi_sem,
+            .spi_num = 0
+        };
+        memset(node, 0, sizeof(sim_node_t));
+        node->inst = hal_dw1000_inst(i);
+        node->base = 0x1000000000ULL * (i + 1);
+        node->rate = SIM_DTU_PER_PSEC;
+        node->t_event = SIM_NEVER;
+        node->t_timeout = SIM_NEVER;
+        int rc = dw1000_dev_init((struct os_dev *) node->inst, &cfg);
+        assert(rc == OS_OK);
+    }
+    os_task_init(&g_task, "dw1000_sim", sim_task, NULL, MYNEWT_VAL(DW1000_SIM_TASK_PRIO), OS_WAIT_FOREVER,
+        g_task_stack, MYNEWT_VAL(DW1000_SIM_TASK_STACK_SZ));
+}
+
+#endif
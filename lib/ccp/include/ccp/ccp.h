@@ -34,6 +34,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -43,10 +44,16 @@ extern "C" {
 #include <dw1000/dw1000_dev.h>
 #include <dw1000/dw1000_mac.h>
 #include <dw1000/dw1000_ftypes.h>
+#if MYNEWT_VAL(CCP_RELAY_PLANNER_ENABLED)
+#include <ccp/ccp_relay.h>
+#endif
 #if MYNEWT_VAL(FS_XTALT_AUTOTUNE_ENABLED)
 #include <dsp/sosfilt.h>
 #include <dsp/polyval.h>
 #endif
+#if MYNEWT_VAL(FS_XTALT_CALIB_ENABLED)
+#include <ccp/ccp_xtalt.h>
+#endif
 
 #if MYNEWT_VAL(CCP_STATS)
 STATS_SECT_START(ccp_stat_section)
@@ -65,6 +72,11 @@ STATS_SECT_START(ccp_stat_section)
     STATS_SECT_ENTRY(tx_relay_ok)
     STATS_SECT_ENTRY(rx_timeout)
     STATS_SECT_ENTRY(reset)
+    STATS_SECT_ENTRY(holdover)
+    STATS_SECT_ENTRY(holdover_exhausted)
+    STATS_SECT_ENTRY(takeover)
+    STATS_SECT_ENTRY(rx_takeover)
+    STATS_SECT_ENTRY(stepdown)
 STATS_SECT_END
 #endif
 
@@ -100,10 +112,25 @@ typedef union {
         ccp_timestamp_t transmission_timestamp; //!< Transmission timestamp
         uint8_t rpt_count;                      //!< Repeat level
         uint8_t rpt_max;                        //!< Repeat max level
+#if MYNEWT_VAL(CCP_STANDBY_ENABLED)
+        /* The flags byte is the last field so that the frame of a node without CCP_STANDBY_ENABLED is a prefix of
+         * this one. It makes sizeof(ccp_blink_frame_t) one byte longer, 31 bytes instead of 30, and with it the ccp
+         * airtime the slave listen window and the relay slots are sized from. Nodes of a network should agree on the
+         * option, mixed nodes still decode each other's epochs, see CCP_BLINK_MIN_LEN. */
+        uint8_t flags;                          //!< CCP_FLAG_* bits, absent from frames of nodes without CCP_STANDBY_ENABLED
+#endif
     }__attribute__((__packed__, aligned(1)));
     uint8_t array[sizeof(struct _ccp_blink_frame_t)];
 }ccp_blink_frame_t;
 
+#if MYNEWT_VAL(CCP_STANDBY_ENABLED)
+#define CCP_FLAG_TAKEOVER   0x01        //!< Sent by a standby master continuing the master's timebase
+//! Shortest blink accepted, nodes without CCP_STANDBY_ENABLED send no flags byte and ignore it on receive
+#define CCP_BLINK_MIN_LEN   offsetof(struct _ccp_blink_frame_t, flags)
+#else
+#define CCP_BLINK_MIN_LEN   sizeof(ccp_blink_frame_t)
+#endif
+
 //! Timestamps and blink frame format  of ccp frame.
 typedef union {
 //! Frame format of ccp frame.
@@ -131,18 +158,39 @@ typedef struct _dw1000_ccp_status_t{
 typedef enum _dw1000_ccp_role_t{
     CCP_ROLE_MASTER,                        //!< Clock calibration packet master mode
     CCP_ROLE_SLAVE,                         //!< Clock calibration packet slave mode
-    CCP_ROLE_RELAY                          //!< Clock calibration packet master replay mode
+    CCP_ROLE_RELAY,                         //!< Clock calibration packet master replay mode
+    CCP_ROLE_STANDBY                        //!< Slave that takes over as master when the master goes silent
 }dw1000_ccp_role_t;
 
 //! Callback for fetching clock source tof compensation
 typedef uint32_t (*dw1000_ccp_tof_compensation_cb_t)(uint16_t short_addr);
 
+//! Callback for an epoch extrapolated in holdover, called from the ccp task
+typedef void (*dw1000_ccp_holdover_cb_t)(struct _dw1000_dev_instance_t * inst);
+
+//! Holdover state of a slave bridging missed ccp epochs.
+typedef struct _dw1000_ccp_holdover_t{
+    uint16_t active:1;                //!< Current epoch was extrapolated, not received
+    uint16_t count;                   //!< Consecutive extrapolated epochs
+    uint32_t uncertainty;             //!< Accumulated epoch uncertainty (dtu)
+}dw1000_ccp_holdover_t;
+
+//! Hot-standby master state.
+typedef struct _dw1000_ccp_standby_t{
+    uint16_t active:1;                //!< Took over, transmitting in the master's timebase
+    uint16_t missed;                  //!< Consecutive missed master epochs
+    uint64_t local_tx;                //!< Local transmission time of the last ccp frame sent
+}dw1000_ccp_standby_t;
+
 //! ccp config parameters.  
 typedef struct _dw1000_ccp_config_t{
     uint16_t postprocess:1;           //!< CCP postprocess
     uint16_t fs_xtalt_autotune:1;     //!< Autotune XTALT to Clock Master
     uint16_t role:4;                  //!< dw1000_ccp_role_t
     uint16_t tx_holdoff_dly;          //!< Relay nodes holdoff
+#if MYNEWT_VAL(CCP_STANDBY_ENABLED)
+    uint16_t standby_rank;            //!< Takeover order among standby masters, distinct per standby, 0 goes first
+#endif
 }dw1000_ccp_config_t;
 
 //! ccp instance parameters.
@@ -157,6 +205,9 @@ typedef struct _dw1000_ccp_instance_t{
 
 #if MYNEWT_VAL(FS_XTALT_AUTOTUNE_ENABLED)
     struct _sos_instance_t * xtalt_sos;         //!< Sturcture of xtalt_sos
+#endif
+#if MYNEWT_VAL(FS_XTALT_CALIB_ENABLED)
+    ccp_xtalt_calib_t xtalt;                    //!< Learned trim versus temperature
 #endif
     dw1000_mac_interface_t cbs;                     //!< MAC Layer Callbacks
     uint64_t master_euid;                           //!< Clock Master EUID, used to reset wcs if master changes
@@ -168,6 +219,17 @@ typedef struct _dw1000_ccp_instance_t{
     uint64_t local_epoch;                           //!< ccp event referenced to local systime
     uint32_t os_epoch;                              //!< ccp event referenced to ostime
     dw1000_ccp_tof_compensation_cb_t tof_comp_cb;   //!< tof compensation callback
+#if MYNEWT_VAL(CCP_HOLDOVER_EPOCHS)
+    dw1000_ccp_holdover_t holdover;                 //!< Holdover state
+    dw1000_ccp_holdover_cb_t holdover_cb;           //!< Holdover epoch callback
+#endif
+#if MYNEWT_VAL(CCP_STANDBY_ENABLED)
+    dw1000_ccp_standby_t standby;                   //!< Standby master state
+#endif
+#if MYNEWT_VAL(CCP_RELAY_PLANNER_ENABLED)
+    ccp_relay_neighbour_t neighbours[MYNEWT_VAL(CCP_RELAY_NEIGHBOURS)]; //!< ccp transmitters heard
+    ccp_relay_assignment_t relay;                   //!< Applied relay plan, slot 0 when not planned
+#endif
     uint32_t period;                                //!< Pulse repetition period
     uint16_t nframes;                               //!< Number of buffers defined to store the data 
     uint16_t idx;                                   //!< Circular buffer index pointer  
@@ -187,6 +249,13 @@ dw1000_ccp_instance_t * dw1000_ccp_init(dw1000_dev_instance_t * inst,  uint16_t
 void dw1000_ccp_free(dw1000_ccp_instance_t * inst);
 void dw1000_ccp_set_postprocess(dw1000_ccp_instance_t * inst, os_event_fn * ccp_postprocess); 
 void dw1000_ccp_set_tof_comp_cb(dw1000_ccp_instance_t * inst, dw1000_ccp_tof_compensation_cb_t tof_comp_cb);
+void dw1000_ccp_epoch(dw1000_ccp_instance_t * inst, ccp_frame_t * frame);
+bool dw1000_ccp_relay_frame(dw1000_ccp_instance_t * inst, ccp_frame_t * tx_frame, uint64_t * dx_time);
+#if MYNEWT_VAL(CCP_HOLDOVER_EPOCHS)
+void dw1000_ccp_set_holdover_cb(dw1000_ccp_instance_t * inst, dw1000_ccp_holdover_cb_t holdover_cb);
+uint16_t dw1000_ccp_holdover_guard(dw1000_ccp_instance_t * inst);
+void dw1000_ccp_holdover(dw1000_dev_instance_t * inst);
+#endif
 void dw1000_ccp_start(dw1000_dev_instance_t * inst, dw1000_ccp_role_t role);
 void dw1000_ccp_stop(dw1000_dev_instance_t * inst);
 
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/**
+ * @file ccp_relay.h
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Planned ccp relay tree
+ *
+ * @details Every node keeps a table of the ccp transmitters it hears, with their cascade depth and rssi, and
+ * hands it out as a ccp_relay_report_t. The clock master or panmaster feeds the reports to the planner, which
+ * builds a minimum depth relay tree preferring the strongest links and gives each relay a transmit slot, in
+ * units of tx_holdoff_dly after the epoch. Slots are absolute, every relay times its frame from the epoch
+ * whatever its depth, so relays that can be heard by a common node never share a slot, and a relay always
+ * transmits after its parent. Each node applies its ccp_relay_assignment_t with ccp_relay_apply(). Reports and
+ * assignments are packed so they can be carried over any management link, with CCP_RELAY_NMGR_ENABLED they are
+ * exchanged over newtmgr, ccp_relay_nmgr_collect() gathers the reports on the planning node, plans once they are
+ * in and ccp_relay_distribute() pushes the plan to the nodes.
+ */
+
+#ifndef _CCP_RELAY_H_
+#define _CCP_RELAY_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <os/os.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CCP_RELAY_DEPTH_INVALID 0xff
+
+#define MGMT_GROUP_ID_CCP_RELAY   (66)
+#define CCP_RELAY_NMGR_ID_REPORT  0
+#define CCP_RELAY_NMGR_ID_ASSIGN  1
+#define CCP_RELAY_NMGR_ID_SOLICIT 2
+
+//! Neighbour as seen by a node.
+typedef struct _ccp_relay_neighbour_t{
+    uint16_t addr;                  //!< Transmitter short address, 0 marks a free entry
+    uint8_t depth;                  //!< rpt_count of its frames, 0 for the master
+    float rssi;                     //!< Smoothed rssi (dBm)
+    uint32_t last_seen;             //!< os_cputime of last frame
+}ccp_relay_neighbour_t;
+
+//! Neighbour table of one node, as reported to the planner.
+typedef struct _ccp_relay_report_t{
+    uint16_t addr;                  //!< Reporting node
+    uint8_t n;                      //!< Valid entries
+    struct _ccp_relay_report_entry_t{
+        uint16_t addr;
+        uint8_t depth;
+        int8_t rssi;                //!< dBm
+    }__attribute__((__packed__)) neighbours[MYNEWT_VAL(CCP_RELAY_NEIGHBOURS)];
+}__attribute__((__packed__)) ccp_relay_report_t;
+
+//! Planned role of one node.
+typedef struct _ccp_relay_assignment_t{
+    uint16_t addr;                  //!< Node
+    uint16_t parent;                //!< Transmitter to follow
+    uint8_t depth;                  //!< Hops from the master, CCP_RELAY_DEPTH_INVALID if unreachable
+    uint8_t slot;                   //!< Relay transmit slot, 0 if the node does not relay
+}__attribute__((__packed__)) ccp_relay_assignment_t;
+
+//! Planner node.
+typedef struct _ccp_relay_node_t{
+    ccp_relay_report_t report;
+    ccp_relay_assignment_t assignment;
+}ccp_relay_node_t;
+
+//! Planner state, sized by MYNEWT_VAL(CCP_RELAY_MAX_NODES).
+typedef struct _ccp_relay_planner_t{
+    uint16_t master;                //!< Clock master short address
+    uint16_t n;                     //!< Nodes reported
+    uint8_t nslots;                 //!< Highest slot used by the last plan
+    ccp_relay_node_t nodes[MYNEWT_VAL(CCP_RELAY_MAX_NODES)];
+}ccp_relay_planner_t;
+
+struct _dw1000_ccp_instance_t;
+struct _dw1000_dev_instance_t;
+
+void ccp_relay_observe(struct _dw1000_ccp_instance_t * ccp, uint16_t addr, uint8_t depth, float rssi);
+void ccp_relay_report(struct _dw1000_ccp_instance_t * ccp, ccp_relay_report_t * report);
+void ccp_relay_apply(struct _dw1000_ccp_instance_t * ccp, const ccp_relay_assignment_t * assignment);
+
+void ccp_relay_planner_init(ccp_relay_planner_t * planner, uint16_t master);
+int ccp_relay_planner_add(ccp_relay_planner_t * planner, const ccp_relay_report_t * report);
+int ccp_relay_plan(ccp_relay_planner_t * planner);
+const ccp_relay_assignment_t * ccp_relay_planner_get(ccp_relay_planner_t * planner, uint16_t addr);
+#if MYNEWT_VAL(CCP_RELAY_NMGR_ENABLED)
+int ccp_relay_distribute(struct _dw1000_dev_instance_t * inst, ccp_relay_planner_t * planner);
+int ccp_relay_nmgr_collect(struct _dw1000_dev_instance_t * inst);
+int ccp_relay_nmgr_plan(struct _dw1000_dev_instance_t * inst);
+void ccp_relay_nmgr_pkg_init(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CCP_RELAY_H_ */
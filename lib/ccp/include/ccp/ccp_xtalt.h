@@ -0,0 +1,73 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/**
+ * @file ccp_xtalt.h
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Learned crystal trim versus temperature
+ *
+ * @details With FS_XTALT_AUTOTUNE_ENABLED the slave pulls its crystal onto the clock master. Each settled
+ * autotune step also yields the trim code that would null the offset at the current die temperature. The
+ * temperature is sampled by the slave timer ahead of the step, while the radio is idle, as the SAR
+ * conversion cannot run from the rx interrupt. The observations are averaged into temperature bins of MYNEWT_VAL(FS_XTALT_CALIB_BIN) degrees and persisted through
+ * sys/config as xtalt/<idx>. On dw1000_ccp_start the trim for the current temperature, interpolated between
+ * the learned bins, is written before the first ccp frame so the autotune loop starts close to lock.
+ */
+
+#ifndef _CCP_XTALT_H_
+#define _CCP_XTALT_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <os/os.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Learned trim curve of one device.
+typedef struct _ccp_xtalt_calib_t{
+    uint8_t trim[MYNEWT_VAL(FS_XTALT_CALIB_NBINS)];     //!< Trim code per bin, 3 fractional bits
+    uint8_t weight[MYNEWT_VAL(FS_XTALT_CALIB_NBINS)];   //!< Observations averaged, 0 marks an empty bin
+    uint8_t saved[MYNEWT_VAL(FS_XTALT_CALIB_NBINS)];    //!< Trim code last persisted
+    float temp;                                         //!< Die temperature sampled with the radio idle (degrees C)
+    bool sampled;                                       //!< temp is waiting for the next autotune step
+    struct os_event save_ev;                            //!< Persists the curve from the default eventq
+}ccp_xtalt_calib_t;
+
+struct _dw1000_ccp_instance_t;
+
+void ccp_xtalt_pkg_init(void);
+void ccp_xtalt_register(struct _dw1000_ccp_instance_t * ccp);
+void ccp_xtalt_sample(struct _dw1000_ccp_instance_t * ccp);
+void ccp_xtalt_observe(struct _dw1000_ccp_instance_t * ccp, float trim);
+int ccp_xtalt_lookup(struct _dw1000_ccp_instance_t * ccp, float temp, float * trim);
+int ccp_xtalt_apply(struct _dw1000_ccp_instance_t * ccp);
+void ccp_xtalt_clear(struct _dw1000_ccp_instance_t * ccp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CCP_XTALT_H_ */
@@ -46,6 +46,9 @@
 #if MYNEWT_VAL(WCS_ENABLED)
 #include <wcs/wcs.h>
 #endif
+#if MYNEWT_VAL(TELEMETRY_ENABLED)
+#include <telemetry/telemetry.h>
+#endif
 
 //#define DIAGMSG(s,u) printf(s,u)
 #ifndef DIAGMSG
@@ -105,6 +108,11 @@ STATS_NAME_START(ccp_stat_section)
     STATS_NAME(ccp_stat_section, tx_relay_ok)
     STATS_NAME(ccp_stat_section, rx_timeout)
     STATS_NAME(ccp_stat_section, reset)
+    STATS_NAME(ccp_stat_section, holdover)
+    STATS_NAME(ccp_stat_section, holdover_exhausted)
+    STATS_NAME(ccp_stat_section, takeover)
+    STATS_NAME(ccp_stat_section, rx_takeover)
+    STATS_NAME(ccp_stat_section, stepdown)
 STATS_NAME_END(ccp_stat_section)
 
 #define CCP_STATS_INC(__X) STATS_INC(inst->ccp->stat, __X)
@@ -125,6 +133,16 @@ static void ccp_tasks_init(struct _dw1000_ccp_instance_t * inst);
 static void ccp_timer_irq(void * arg);
 static void ccp_master_timer_ev_cb(struct os_event *ev);
 static void ccp_slave_timer_ev_cb(struct os_event *ev);
+#if MYNEWT_VAL(CCP_HOLDOVER_EPOCHS) || MYNEWT_VAL(CCP_STANDBY_ENABLED)
+static void ccp_extrapolate(struct _dw1000_dev_instance_t * inst);
+#endif
+#if MYNEWT_VAL(CCP_STANDBY_ENABLED)
+#if !MYNEWT_VAL(WCS_ENABLED)
+#error "CCP_STANDBY_ENABLED requires WCS_ENABLED"
+#endif
+static void ccp_takeover(struct _dw1000_dev_instance_t * inst);
+static void ccp_stepdown(struct _dw1000_dev_instance_t * inst);
+#endif
 
 #if !MYNEWT_VAL(WCS_ENABLED)
 static void ccp_postprocess(struct os_event * ev);
@@ -187,7 +205,15 @@ ccp_master_timer_ev_cb(struct os_event *ev) {
 
     dw1000_dev_instance_t * inst = (dw1000_dev_instance_t *)ev->ev_arg;
     dw1000_ccp_instance_t * ccp = inst->ccp; 
-    
+
+#if MYNEWT_VAL(CCP_STANDBY_ENABLED)
+    if (ccp->config.role == CCP_ROLE_STANDBY){
+        /* Stepped down, see ccp_stepdown() */
+        os_callout_init(&ccp->event_cb, &ccp->eventq, ccp_slave_timer_ev_cb, (void *) inst);
+        ccp_slave_timer_ev_cb(ev);
+        return;
+    }
+#endif
     CCP_STATS_INC(master_cnt);
 
     if (dw1000_ccp_send(inst, DWT_BLOCKING).start_tx_error){
@@ -218,6 +244,10 @@ ccp_slave_timer_ev_cb(struct os_event *ev) {
 
     dw1000_dev_instance_t * inst = (dw1000_dev_instance_t *)ev->ev_arg;
     dw1000_ccp_instance_t * ccp = inst->ccp;
+    uint16_t guard = 0;
+#if MYNEWT_VAL(CCP_HOLDOVER_EPOCHS)
+    guard = dw1000_ccp_holdover_guard(ccp);
+#endif
 
     /* Sync lost since earlier, just set a long rx timeout and
      * keep listening */
@@ -231,7 +261,7 @@ ccp_slave_timer_ev_cb(struct os_event *ev) {
 #if MYNEWT_VAL(WCS_ENABLED)
     wcs_instance_t * wcs = ccp->wcs;
     uint64_t dx_time = ccp->local_epoch +
-        (uint64_t) roundf((1.0l + wcs->skew) * (double)((uint64_t)ccp->period << 16)) -
+        wcs_dtu_interval_to_local(wcs, (uint64_t)ccp->period << 16) -
         ((uint64_t)ceilf(dw1000_usecs_to_dwt_usecs(dw1000_phy_SHR_duration(&inst->attrib))) << 16);
 #else
     uint64_t dx_time = ccp->local_epoch 
@@ -239,22 +269,56 @@ ccp_slave_timer_ev_cb(struct os_event *ev) {
              - ((uint64_t)ceilf(dw1000_usecs_to_dwt_usecs(dw1000_phy_SHR_duration(&inst->attrib))) << 16);
 #endif
 
-    uint16_t timeout = dw1000_phy_frame_duration(&inst->attrib, sizeof(ccp_blink_frame_t))
+    uint32_t timeout = dw1000_phy_frame_duration(&inst->attrib, sizeof(ccp_blink_frame_t))
                         + MYNEWT_VAL(XTALT_GUARD);
 
-#if MYNEWT_VAL(CCP_MAX_CASCADE_RPTS) != 0
+#if MYNEWT_VAL(CCP_RELAY_PLANNER_ENABLED)
+    /* Planned relays may use any of the relay slots */
+    timeout += (ccp->config.tx_holdoff_dly + dw1000_phy_frame_duration(&inst->attrib, sizeof(ccp_blink_frame_t))) * MYNEWT_VAL(CCP_RELAY_SLOTS);
+#elif MYNEWT_VAL(CCP_MAX_CASCADE_RPTS) != 0
     /* Adjust timeout if we're using cascading ccp in anchors */
     timeout += (ccp->config.tx_holdoff_dly + dw1000_phy_frame_duration(&inst->attrib, sizeof(ccp_blink_frame_t))) * MYNEWT_VAL(CCP_MAX_CASCADE_RPTS);
 #endif
-    dw1000_set_rx_timeout(inst, timeout);
+    /* In holdover the epoch is only known to within the guard, open the window early and close it late */
+    dx_time -= (uint64_t)guard << 16;
+    timeout += 2 * guard;
+#if MYNEWT_VAL(FS_XTALT_CALIB_ENABLED)
+    /* The autotune step of this epoch observes the die temperature, sample it now while the radio is off */
+    if (ccp->config.fs_xtalt_autotune && (ccp->xtalt_sos->clk + 1) % FS_XTALT_SETTLINGTIME == 0){
+        dw1000_phy_forcetrxoff(inst);
+        ccp_xtalt_sample(ccp);
+    }
+#endif
+    dw1000_set_rx_timeout(inst, (timeout > UINT16_MAX) ? UINT16_MAX : (uint16_t) timeout);
     dw1000_set_delay_start(inst, dx_time);
 
+#if MYNEWT_VAL(CCP_HOLDOVER_EPOCHS) || MYNEWT_VAL(CCP_STANDBY_ENABLED)
+    bool valid = ccp->status.valid;
+    uint16_t idx = ccp->idx;
+#endif
     dw1000_ccp_status_t status = dw1000_ccp_listen(inst, DWT_BLOCKING);
     if(status.start_rx_error){
         /* Sync lost, set a long rx timeout */
         dw1000_set_rx_timeout(inst, (uint16_t) 0xffff);
         dw1000_ccp_listen(inst, DWT_BLOCKING);
     }
+#if MYNEWT_VAL(CCP_STANDBY_ENABLED)
+    else if (valid && ccp->idx == idx && ccp->config.role == CCP_ROLE_STANDBY){
+        /* Master epoch missed, follow the master's grid and take over once it stays silent. Standbys wait
+         * one more epoch per rank, the first to take over is heard by the others and resets their count */
+        ccp_extrapolate(inst);
+        ccp->status.valid = 1;
+        if (++ccp->standby.missed >= MYNEWT_VAL(CCP_STANDBY_EPOCHS) + ccp->config.standby_rank)
+            ccp_takeover(inst);
+    }
+#endif
+#if MYNEWT_VAL(CCP_HOLDOVER_EPOCHS)
+    else if (valid && ccp->idx == idx){
+        /* Epoch missed, bridge it from the clock model */
+        dw1000_ccp_holdover(inst);
+        guard = dw1000_ccp_holdover_guard(ccp);
+    }
+#endif
 
 reset_timer:
     // Schedule event
@@ -263,10 +327,165 @@ reset_timer:
             - MYNEWT_VAL(OS_LATENCY)
             + (uint32_t)dw1000_dwt_usecs_to_usecs(ccp->period)
             - dw1000_phy_frame_duration(&inst->attrib, sizeof(ccp_blink_frame_t))
+            - (uint32_t)dw1000_dwt_usecs_to_usecs(guard)
             )
         );
 }
 
+#if MYNEWT_VAL(CCP_HOLDOVER_EPOCHS) || MYNEWT_VAL(CCP_STANDBY_ENABLED)
+/**
+ * @fn ccp_extrapolate(struct _dw1000_dev_instance_t * inst)
+ * @brief Advances the epoch by one period without a received frame. The local epoch advances by the period
+ * converted to the local clock with wcs_dtu_interval_to_local(), the same model the slave listen window uses.
+ * The master epoch and os epoch advance by the nominal period. The sequence number advances as the master's
+ * does, tdma hyperframes are phased on it.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ * @return void
+ */
+static void
+ccp_extrapolate(struct _dw1000_dev_instance_t * inst){
+
+    dw1000_ccp_instance_t * ccp = inst->ccp;
+
+    uint64_t interval = (uint64_t)ccp->period << 16;
+#if MYNEWT_VAL(WCS_ENABLED)
+    interval = wcs_dtu_interval_to_local(ccp->wcs, interval);
+#endif
+    ccp->local_epoch = (ccp->local_epoch + interval) & 0x0FFFFFFFFFFUL;
+    ccp->master_epoch.timestamp += (uint64_t)ccp->period << 16;
+    ccp->os_epoch += os_cputime_usecs_to_ticks((uint32_t)dw1000_dwt_usecs_to_usecs(ccp->period));
+    ccp->seq_num++;
+}
+#endif
+
+#if MYNEWT_VAL(CCP_HOLDOVER_EPOCHS)
+/**
+ * @fn dw1000_ccp_holdover(struct _dw1000_dev_instance_t * inst)
+ * @brief Extrapolates the missed epoch from the previous one, see ccp_extrapolate(). With WCS_QUALITY_ENABLED
+ * the uncertainty is MYNEWT_VAL(CCP_HOLDOVER_SIGMAS) times the time error wcs_quality_time_error() predicts after
+ * free running since the last received epoch. Until the clock quality has an estimate, or without it, the
+ * uncertainty grows with the time since the last received epoch at MYNEWT_VAL(CCP_HOLDOVER_DRIFT). After
+ * MYNEWT_VAL(CCP_HOLDOVER_EPOCHS) extrapolated epochs holdover gives up and the slave falls back to a long listen.
+ * Called by the slave timer when a valid slave hears no ccp frame in its window.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ * @return void
+ */
+void
+dw1000_ccp_holdover(struct _dw1000_dev_instance_t * inst){
+
+    dw1000_ccp_instance_t * ccp = inst->ccp;
+
+    if (ccp->holdover.count >= MYNEWT_VAL(CCP_HOLDOVER_EPOCHS)) {
+        CCP_STATS_INC(holdover_exhausted);
+        ccp->holdover.active = 0;
+        ccp->status.rx_timeout_error = 1;
+        return;
+    }
+    CCP_STATS_INC(holdover);
+    ccp_extrapolate(inst);
+
+    uint64_t interval = (uint64_t)ccp->period << 16;
+    ccp->holdover.count++;
+    ccp->holdover.active = 1;
+    uint64_t uncertainty = ccp->holdover.count * interval * MYNEWT_VAL(CCP_HOLDOVER_DRIFT) / 1000000000UL;
+#if MYNEWT_VAL(WCS_ENABLED) && MYNEWT_VAL(WCS_QUALITY_ENABLED)
+    wcs_quality_t * quality = &ccp->wcs->quality;
+    if (quality->tau0)
+        uncertainty = (uint64_t)(MYNEWT_VAL(CCP_HOLDOVER_SIGMAS) * wcs_quality_time_error(quality, ccp->holdover.count));
+#endif
+    ccp->holdover.uncertainty = (uncertainty > UINT32_MAX) ? UINT32_MAX : (uint32_t) uncertainty;
+
+    /* The extrapolated epoch stands in for the received one */
+    ccp->status.rx_timeout_error = 0;
+    ccp->status.valid = 1;
+
+    if (ccp->holdover_cb)
+        ccp->holdover_cb(inst);
+}
+
+/**
+ * @fn dw1000_ccp_holdover_guard(dw1000_ccp_instance_t * inst)
+ * @brief API returning the extra guard time around the current epoch, zero unless in holdover.
+ *
+ * @param inst  Pointer to dw1000_ccp_instance_t.
+ * @return guard in dwt usecs
+ */
+uint16_t
+dw1000_ccp_holdover_guard(dw1000_ccp_instance_t * inst){
+    if (!inst->holdover.active)
+        return 0;
+    uint32_t guard = (inst->holdover.uncertainty >> 16) + 1;
+    return (guard > UINT16_MAX/4) ? UINT16_MAX/4 : (uint16_t) guard;
+}
+
+/**
+ * @fn dw1000_ccp_set_holdover_cb(dw1000_ccp_instance_t * inst, dw1000_ccp_holdover_cb_t holdover_cb)
+ * @brief Sets the callback invoked for each epoch extrapolated in holdover, i.e. in place of the
+ * rx_complete_cb of a ccp frame. Used by tdma to keep the superframe running.
+ *
+ * @param inst         Pointer to dw1000_ccp_instance_t.
+ * @param holdover_cb  holdover callback
+ *
+ * @return void
+ */
+void
+dw1000_ccp_set_holdover_cb(dw1000_ccp_instance_t * inst, dw1000_ccp_holdover_cb_t holdover_cb)
+{
+    inst->holdover_cb = holdover_cb;
+}
+#endif
+
+#if MYNEWT_VAL(CCP_STANDBY_ENABLED)
+/**
+ * @fn ccp_takeover(struct _dw1000_dev_instance_t * inst)
+ * @brief Standby master takes over transmission. The current, extrapolated, epoch becomes the previous frame
+ * of the master role, so the first frame goes out one period later on the master's grid, carrying the master's
+ * euid, timebase and sequence. Slaves see no master change and keep their wcs state. The master role then
+ * runs as usual except that the local transmission time follows from the frozen wcs clock model,
+ * see dw1000_ccp_send().
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ * @return void
+ */
+static void
+ccp_takeover(struct _dw1000_dev_instance_t * inst){
+
+    dw1000_ccp_instance_t * ccp = inst->ccp;
+    ccp_frame_t * frame = ccp->frames[(ccp->idx)%ccp->nframes];
+
+    CCP_STATS_INC(takeover);
+    frame->transmission_timestamp = ccp->master_epoch;
+    ccp->standby.active = 1;
+    ccp->standby.local_tx = ccp->local_epoch;
+    ccp->config.role = CCP_ROLE_MASTER;
+    ccp->status.rx_timeout_error = 0;
+    os_callout_init(&ccp->event_cb, &ccp->eventq, ccp_master_timer_ev_cb, (void *) inst);
+}
+
+/**
+ * @fn ccp_stepdown(struct _dw1000_dev_instance_t * inst)
+ * @brief Standby master that took over hands transmission back, on hearing the master's euid on a frame without
+ * CCP_FLAG_TAKEOVER, directly or through a relay. Called from rx_complete_cb() in interrupt context, only the
+ * role and state change here. The next master timer event finds the standby role and moves the timer back
+ * to the slave event, see ccp_master_timer_ev_cb(), which resynchronises with a long listen.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ * @return void
+ */
+static void
+ccp_stepdown(struct _dw1000_dev_instance_t * inst){
+
+    dw1000_ccp_instance_t * ccp = inst->ccp;
+
+    CCP_STATS_INC(stepdown);
+    ccp->standby = (dw1000_ccp_standby_t){0};
+    ccp->config.role = CCP_ROLE_STANDBY;
+    ccp->status.rx_timeout_error = 1;
+}
+#endif
+
 /**
  * @fn ccp_task(void *arg)
  * @brief The ccp event queue being run to process timer events.
@@ -375,6 +594,9 @@ dw1000_ccp_init(struct _dw1000_dev_instance_t * inst, uint16_t nframes){
         .fs_xtalt_autotune = true,
 #endif
         .tx_holdoff_dly = MYNEWT_VAL(CCP_RPT_HOLDOFF_DLY),
+#if MYNEWT_VAL(CCP_STANDBY_ENABLED)
+        .standby_rank = MYNEWT_VAL(CCP_STANDBY_RANK),
+#endif
     };
 
     os_error_t err = os_sem_init(&inst->ccp->sem, 0x1);
@@ -403,6 +625,9 @@ dw1000_ccp_init(struct _dw1000_dev_instance_t * inst, uint16_t nframes){
 
 #if MYNEWT_VAL(FS_XTALT_AUTOTUNE_ENABLED)
     inst->ccp->xtalt_sos = sosfilt_init(NULL, sizeof(g_fs_xtalt_b)/sizeof(float)/BIQUAD_N);
+#endif
+#if MYNEWT_VAL(FS_XTALT_CALIB_ENABLED)
+    ccp_xtalt_register(inst->ccp);
 #endif
     inst->ccp->status.initialized = 1;
 
@@ -465,6 +690,12 @@ void ccp_pkg_init(void){
 #if MYNEWT_VAL(DW1000_PKG_INIT_LOG)
     printf("{\"utime\": %lu,\"msg\": \"ccp_pkg_init\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
 #endif
+#if MYNEWT_VAL(FS_XTALT_CALIB_ENABLED)
+    ccp_xtalt_pkg_init();
+#endif
+#if MYNEWT_VAL(CCP_RELAY_PLANNER_ENABLED) && MYNEWT_VAL(CCP_RELAY_NMGR_ENABLED)
+    ccp_relay_nmgr_pkg_init();
+#endif
 
 #if MYNEWT_VAL(DW1000_DEVICE_0)
     dw1000_ccp_init(hal_dw1000_inst(0), 2);
@@ -520,6 +751,15 @@ ccp_postprocess(struct os_event * ev){
 
 #if MYNEWT_VAL(CCP_VERBOSE)
     float clock_offset = dw1000_calc_clock_offset_ratio(ccp->parent, frame->carrier_integrator);
+#if MYNEWT_VAL(TELEMETRY_ENABLED)
+    telemetry_ccp_t record = {
+        .transmission_timestamp = frame->transmission_timestamp.timestamp,
+        .delta = delta,
+        .clock_offset = clock_offset,
+        .seq_num = frame->seq_num
+    };
+    telemetry_write(TELEMETRY_CCP, &record, sizeof(record));
+#else
     printf("{\"utime\": %lu,\"ccp\":[\"%llX\",\"%llX\"],\"clock_offset\": %lu,\"seq_num\" :%d}\n",
         os_cputime_ticks_to_usecs(os_cputime_get32()),
         (uint64_t)frame->transmission_timestamp,
@@ -528,65 +768,41 @@ ccp_postprocess(struct os_event * ev){
         frame->seq_num
     );
 #endif
+#endif
 }
 #endif
 
 /**
- * @fn rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
- * @brief Precise timing is achieved using the reception_timestamp and tracking intervals along with
- * the correction factor. For timescale processing, a postprocessing  callback is placed in the eventq.
- * This callback with FS_XTALT_AUTOTUNE_ENABLED set, uses the RX_TTCKO_ID register to compensate for crystal offset and drift. This is an
- * adaptive loop with a time constant of minutes. By aligning the crystals within the network RF TX power is optimum.
- * Note: Precise RTLS timing still relies on timescale algorithm.
- *
- * The fs_xtalt adjustments align crystals to 1us (1PPM) while timescale processing resolves timestamps to sub 1ns.
- *
- * @param inst   Pointer to dw1000_dev_instance_t.
- * @param cbs    Pointer to dw1000_mac_interface_t.
+ * @fn dw1000_ccp_epoch(dw1000_ccp_instance_t * ccp, ccp_frame_t * frame)
+ * @brief Takes the epoch of a slave or relay from a received ccp frame. The receiver copies the blink into
+ * the next frame buffer, ccp->frames[(ccp->idx+1)%ccp->nframes], and fills in its reception_timestamp,
+ * carrier_integrator and rxttcko. The frame index then advances, a change of master resets wcs, and the epoch
+ * is corrected for time of flight and, for relayed frames, the repeat delay. No radio access, rx_complete_cb()
+ * calls it from interrupt context and the host network simulator of lib/netsim drives it directly.
  *
+ * @param ccp    Pointer to dw1000_ccp_instance_t.
+ * @param frame  Pointer to the received ccp_frame_t.
  * @return void
  */
-static bool
-rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
-{
-    if (inst->fctrl_array[0] != FCNTL_IEEE_BLINK_CCP_64){
-        if(os_sem_get_count(&inst->ccp->sem) == 0){
-            dw1000_set_rx_timeout(inst, (uint16_t) 0xffff);
-            return true;
-        }
-        return false;
-    }
-
-    if(os_sem_get_count(&inst->ccp->sem) != 0){
-        //unsolicited inbound
-        CCP_STATS_INC(rx_unsolicited);
-        return false;
-    }
-
-    if (inst->ccp->config.role == CCP_ROLE_MASTER) {
-        return true;
-    }
-    DIAGMSG("{\"utime\": %lu,\"msg\": \"ccp:rx_complete_cb\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
-
-    dw1000_ccp_instance_t * ccp = inst->ccp;
-    ccp_frame_t * frame = ccp->frames[(ccp->idx+1)%ccp->nframes];  // speculative frame advance
-
-    if (inst->frame_len >= sizeof(ccp_blink_frame_t) && inst->frame_len <= sizeof(frame->array))
-        memcpy(frame->array, inst->rxbuf, sizeof(ccp_blink_frame_t));
-    else
-        return false;
+void
+dw1000_ccp_epoch(dw1000_ccp_instance_t * ccp, ccp_frame_t * frame){
 
-    if (inst->status.lde_error)
-        return false;
+    struct _dw1000_dev_instance_t * inst = ccp->parent;
+    assert(frame == ccp->frames[(ccp->idx+1)%ccp->nframes]);
 
-    /* A good ccp packet has been received, stop the receiver */
-    dw1000_stop_rx(inst); //Prevent timeout event
-    
     ccp->idx++; // confirmed frame advance  
     ccp->seq_num = frame->seq_num;
     ccp->os_epoch = os_cputime_get32();
     CCP_STATS_INC(rx_complete);
     ccp->status.rx_timeout_error = 0;
+#if MYNEWT_VAL(CCP_HOLDOVER_EPOCHS)
+    ccp->holdover = (dw1000_ccp_holdover_t){0};
+#endif
+#if MYNEWT_VAL(CCP_STANDBY_ENABLED)
+    ccp->standby.missed = 0;
+    if (frame->flags & CCP_FLAG_TAKEOVER)
+        CCP_STATS_INC(rx_takeover);
+#endif
 
     if (frame->transmission_timestamp.timestamp < ccp->master_epoch.timestamp ||
         frame->euid != ccp->master_euid) {
@@ -601,20 +817,14 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
     }
 
     ccp->master_epoch.timestamp = frame->transmission_timestamp.timestamp;
-    ccp->local_epoch = frame->reception_timestamp = inst->rxtimestamp;
+    ccp->local_epoch = frame->reception_timestamp;
     ccp->period = (frame->transmission_interval >> 16);
-    frame->carrier_integrator = inst->carrier_integrator;
-    if (inst->config.rxttcko_enable) {
-        frame->rxttcko = inst->rxttcko;
-    } else {
-        frame->rxttcko = 0;
-    }
 
     /* Compensate for time of flight */
-    if (inst->ccp->tof_comp_cb) {
-        uint32_t tof_comp = inst->ccp->tof_comp_cb(frame->short_address);
+    if (ccp->tof_comp_cb) {
+        uint32_t tof_comp = ccp->tof_comp_cb(frame->short_address);
 #if MYNEWT_VAL(WCS_ENABLED)
-        tof_comp *= (1.0l - ccp->wcs->skew);
+        tof_comp *= (1.0l + ccp->wcs->skew);
 #endif
         ccp->local_epoch -= tof_comp;
         frame->reception_timestamp = ccp->local_epoch;
@@ -631,7 +841,7 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
 
 #if MYNEWT_VAL(WCS_ENABLED)
         /* Compensate for skew before correcting our local timestamp for repeat delay. */
-        repeat_dly *= (1.0l - ccp->wcs->skew);
+        repeat_dly *= (1.0l + ccp->wcs->skew);
 #endif
         ccp->local_epoch = (ccp->local_epoch - repeat_dly) & 0x0FFFFFFFFFFUL;
         frame->reception_timestamp = ccp->local_epoch;
@@ -641,34 +851,153 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
         frame->carrier_integrator = 0;
         frame->rxttcko = 0;
     }
+}
 
-    /* Cascade relay of ccp packet */
-    if (ccp->config.role == CCP_ROLE_RELAY && ccp->status.valid && frame->rpt_count < frame->rpt_max) {
-        ccp_frame_t tx_frame;
-        memcpy(tx_frame.array, frame->array, sizeof(ccp_frame_t));
-
-        /* Only replace the short id, retain the euid to know which master this originates from */
-        tx_frame.short_address = inst->my_short_address;
-        tx_frame.rpt_count++;
-        uint64_t tx_timestamp = frame->reception_timestamp;
-        tx_timestamp += tx_frame.rpt_count*((uint64_t)inst->ccp->config.tx_holdoff_dly<<16);
-        tx_timestamp &= 0x0FFFFFFFE00UL;
-        dw1000_set_delay_start(inst, tx_timestamp);
-
-        /* Need to add antenna delay */
-        tx_timestamp += inst->tx_antenna_delay;
-
-        /* Calculate the transmission time of our packet in the masters reference */
-        uint64_t tx_delay = (tx_timestamp - frame->reception_timestamp);
+/**
+ * @fn dw1000_ccp_relay_frame(dw1000_ccp_instance_t * ccp, ccp_frame_t * tx_frame, uint64_t * dx_time)
+ * @brief Builds the frame a relay repeats of the epoch just taken with dw1000_ccp_epoch(). The repeat is timed
+ * from the epoch in the relay's slot, its transmission timestamp and interval are expressed in the master's
+ * timebase so listeners can recover the master epoch. No radio access.
+ *
+ * @param ccp       Pointer to dw1000_ccp_instance_t.
+ * @param tx_frame  Pointer to ccp_frame_t, the frame to send.
+ * @param dx_time   Delayed start of the frame, without antenna delay.
+ * @return true if the frame is to be repeated
+ */
+bool
+dw1000_ccp_relay_frame(dw1000_ccp_instance_t * ccp, ccp_frame_t * tx_frame, uint64_t * dx_time){
+
+    struct _dw1000_dev_instance_t * inst = ccp->parent;
+    ccp_frame_t * frame = ccp->frames[ccp->idx%ccp->nframes];
+
+    bool relay = ccp->config.role == CCP_ROLE_RELAY && ccp->status.valid && frame->rpt_count < frame->rpt_max;
+    uint8_t relay_slot = frame->rpt_count + 1;
+#if MYNEWT_VAL(CCP_RELAY_PLANNER_ENABLED)
+    /* A planned relay sends in its own slot. The slot is timed from the epoch, so whichever frame the epoch
+     * was taken from will do as long as it went out in an earlier slot, the parent's frame may well be heard
+     * after that of a relay on another branch */
+    if (ccp->relay.slot) {
+        uint64_t repeat_dly = (frame->rpt_count) ? ((uint64_t)ccp->period << 16) - frame->transmission_interval : 0;
+        relay_slot = ccp->relay.slot;
+        relay &= repeat_dly < relay_slot*((uint64_t)ccp->config.tx_holdoff_dly<<16);
+    }
+#endif
+    if (!relay)
+        return false;
+
+    memcpy(tx_frame->array, frame->array, sizeof(ccp_frame_t));
+
+    /* Only replace the short id, retain the euid to know which master this originates from */
+    tx_frame->short_address = inst->my_short_address;
+    tx_frame->rpt_count++;
+    /* Relays are timed from the epoch, not from the frame they repeat, so a slot is the same instant
+     * at every depth and does not accumulate the delays of the relays upstream */
+    uint64_t tx_timestamp = ccp->local_epoch;
+    tx_timestamp += relay_slot*((uint64_t)ccp->config.tx_holdoff_dly<<16);
+    tx_timestamp &= 0x0FFFFFFFE00UL;
+    *dx_time = tx_timestamp;
+
+    /* Need to add antenna delay */
+    tx_timestamp += inst->tx_antenna_delay;
+
+    /* Calculate the transmission time of our packet in the masters reference */
+    uint64_t tx_delay = (tx_timestamp - ccp->local_epoch) & 0x0FFFFFFFFFFUL;
 #if MYNEWT_VAL(WCS_ENABLED)
-        tx_delay *= (1.0l - ccp->wcs->skew);
+    tx_delay *= (1.0l - ccp->wcs->skew);
 #endif
-        tx_frame.transmission_timestamp.timestamp += tx_delay;
+    tx_frame->transmission_timestamp.timestamp = ccp->master_epoch.timestamp + tx_delay;
 
-        /* Adjust the transmission interval so listening units can calculate the
-         * original master's timestamp */
-        tx_frame.transmission_interval = frame->transmission_interval - tx_delay;
+    /* Adjust the transmission interval so listening units can calculate the
+     * original master's timestamp */
+    tx_frame->transmission_interval = ((uint64_t)ccp->period << 16) - tx_delay;
+    return true;
+}
 
+/**
+ * @fn rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
+ * @brief Precise timing is achieved using the reception_timestamp and tracking intervals along with
+ * the correction factor. For timescale processing, a postprocessing  callback is placed in the eventq.
+ * This callback with FS_XTALT_AUTOTUNE_ENABLED set, uses the RX_TTCKO_ID register to compensate for crystal offset and drift. This is an
+ * adaptive loop with a time constant of minutes. By aligning the crystals within the network RF TX power is optimum.
+ * Note: Precise RTLS timing still relies on timescale algorithm.
+ *
+ * The fs_xtalt adjustments align crystals to 1us (1PPM) while timescale processing resolves timestamps to sub 1ns.
+ *
+ * @param inst   Pointer to dw1000_dev_instance_t.
+ * @param cbs    Pointer to dw1000_mac_interface_t.
+ *
+ * @return void
+ */
+static bool
+rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
+{
+    if (inst->fctrl_array[0] != FCNTL_IEEE_BLINK_CCP_64){
+        if(os_sem_get_count(&inst->ccp->sem) == 0){
+            dw1000_set_rx_timeout(inst, (uint16_t) 0xffff);
+            return true;
+        }
+        return false;
+    }
+
+#if MYNEWT_VAL(CCP_RELAY_PLANNER_ENABLED)
+    if (inst->frame_len >= CCP_BLINK_MIN_LEN && !inst->status.lde_error){
+        ccp_blink_frame_t * blink = (ccp_blink_frame_t *) inst->rxbuf;
+        ccp_relay_observe(inst->ccp, blink->short_address, blink->rpt_count, dw1000_get_rssi(inst));
+    }
+#endif
+
+#if MYNEWT_VAL(CCP_STANDBY_ENABLED)
+    if (inst->ccp->standby.active && inst->frame_len >= CCP_BLINK_MIN_LEN && !inst->status.lde_error){
+        ccp_blink_frame_t * blink = (ccp_blink_frame_t *) inst->rxbuf;
+        bool takeover = inst->frame_len >= sizeof(ccp_blink_frame_t) && (blink->flags & CCP_FLAG_TAKEOVER);
+        if (!takeover && blink->euid == inst->ccp->master_euid)
+            ccp_stepdown(inst);
+    }
+#endif
+
+    if(os_sem_get_count(&inst->ccp->sem) != 0){
+        //unsolicited inbound
+        CCP_STATS_INC(rx_unsolicited);
+        return false;
+    }
+
+    if (inst->ccp->config.role == CCP_ROLE_MASTER) {
+        return true;
+    }
+    DIAGMSG("{\"utime\": %lu,\"msg\": \"ccp:rx_complete_cb\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
+
+    dw1000_ccp_instance_t * ccp = inst->ccp;
+    ccp_frame_t * frame = ccp->frames[(ccp->idx+1)%ccp->nframes];  // speculative frame advance
+
+    if (inst->frame_len >= CCP_BLINK_MIN_LEN && inst->frame_len <= sizeof(frame->array))
+        memcpy(frame->array, inst->rxbuf, sizeof(ccp_blink_frame_t));
+    else
+        return false;
+#if MYNEWT_VAL(CCP_STANDBY_ENABLED)
+    if (inst->frame_len < sizeof(ccp_blink_frame_t))
+        frame->flags = 0;
+#endif
+
+    if (inst->status.lde_error)
+        return false;
+
+    /* A good ccp packet has been received, stop the receiver */
+    dw1000_stop_rx(inst); //Prevent timeout event
+    
+    frame->reception_timestamp = inst->rxtimestamp;
+    frame->carrier_integrator = inst->carrier_integrator;
+    if (inst->config.rxttcko_enable) {
+        frame->rxttcko = inst->rxttcko;
+    } else {
+        frame->rxttcko = 0;
+    }
+    dw1000_ccp_epoch(ccp, frame);
+
+    /* Cascade relay of ccp packet */
+    ccp_frame_t tx_frame;
+    uint64_t dx_time;
+    if (dw1000_ccp_relay_frame(ccp, &tx_frame, &dx_time)) {
+        dw1000_set_delay_start(inst, dx_time);
         dw1000_write_tx(inst, tx_frame.array, 0, sizeof(ccp_blink_frame_t));
         dw1000_write_tx_fctrl(inst, sizeof(ccp_blink_frame_t), 0);
         ccp->status.start_tx_error = dw1000_start_tx(inst).start_tx_error;
@@ -689,8 +1018,14 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
         float fs_xtalt_offset = sosfilt(ccp->xtalt_sos,  1e6 * ccp->wcs->skew, g_fs_xtalt_b, g_fs_xtalt_a);
         if(ccp->xtalt_sos->clk % FS_XTALT_SETTLINGTIME == 0){
             int8_t reg = dw1000_read_reg(inst, FS_CTRL_ID, FS_XTALT_OFFSET, sizeof(uint8_t)) & FS_XTALT_MASK;
-            int8_t trim_code = (int8_t) roundf(polyval(g_fs_xtalt_poly, fs_xtalt_offset, sizeof(g_fs_xtalt_poly)/sizeof(float))
-                                - polyval(g_fs_xtalt_poly, 0, sizeof(g_fs_xtalt_poly)/sizeof(float)));
+            float trim_delta = polyval(g_fs_xtalt_poly, fs_xtalt_offset, sizeof(g_fs_xtalt_poly)/sizeof(float))
+                                - polyval(g_fs_xtalt_poly, 0, sizeof(g_fs_xtalt_poly)/sizeof(float));
+            int8_t trim_code = (int8_t) roundf(trim_delta);
+#if MYNEWT_VAL(FS_XTALT_CALIB_ENABLED)
+            // The first output still carries the filter's start-up transient
+            if (ccp->xtalt_sos->clk > FS_XTALT_SETTLINGTIME)
+                ccp_xtalt_observe(ccp, reg - trim_delta);
+#endif
             if(reg - trim_code < 0)
                 reg = 0;
             else if(reg - trim_code > FS_XTALT_MASK)
@@ -733,6 +1068,10 @@ ccp_tx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t
 
     ccp->os_epoch = os_cputime_get32();
     ccp->local_epoch = frame->transmission_timestamp.lo;
+#if MYNEWT_VAL(CCP_STANDBY_ENABLED)
+    if (ccp->standby.active)
+        ccp->local_epoch = ccp->standby.local_tx;
+#endif
     ccp->master_epoch = frame->transmission_timestamp;
     ccp->period = (frame->transmission_interval >> 16);
 
@@ -855,13 +1194,31 @@ dw1000_ccp_send(struct _dw1000_dev_instance_t * inst, dw1000_dev_modes_t mode)
     uint64_t timestamp = previous_frame->transmission_timestamp.timestamp
                         + ((uint64_t)inst->ccp->period << 16);
 
-    timestamp = timestamp & 0xFFFFFFFFFFFFFE00ULL; /* Mask off the last 9 bits */
-    dw1000_set_delay_start(inst, timestamp);
+    uint64_t dx_time = timestamp & 0xFFFFFFFFFFFFFE00ULL; /* Mask off the last 9 bits */
+#if MYNEWT_VAL(CCP_STANDBY_ENABLED)
+    frame->flags = ccp->standby.active ? CCP_FLAG_TAKEOVER : 0;
+    if (ccp->standby.active){
+        /* Master's grid in the master's timebase, local time from the clock model */
+        uint64_t local = (ccp->local_epoch + wcs_dtu_interval_to_local(ccp->wcs, (uint64_t)ccp->period << 16)) & 0x0FFFFFFFFFFUL;
+        dx_time = local & 0x0FFFFFFFE00UL;
+        timestamp -= local - dx_time;
+        ccp->standby.local_tx = dx_time + inst->tx_antenna_delay;
+    }else{
+        timestamp = dx_time;
+    }
+#else
+    timestamp = dx_time;
+#endif
+    dw1000_set_delay_start(inst, dx_time);
     timestamp += inst->tx_antenna_delay;
     frame->transmission_timestamp.timestamp = timestamp;
     
     frame->seq_num = ++ccp->seq_num;
     frame->euid = inst->euid;
+#if MYNEWT_VAL(CCP_STANDBY_ENABLED)
+    if (ccp->standby.active)
+        frame->euid = ccp->master_euid;
+#endif
     frame->short_address = inst->my_short_address;
     frame->transmission_interval = ((uint64_t)inst->ccp->period << 16);
 
@@ -873,6 +1230,10 @@ dw1000_ccp_send(struct _dw1000_dev_instance_t * inst, dw1000_dev_modes_t mode)
         CCP_STATS_INC(tx_start_error);
         previous_frame->transmission_timestamp.timestamp = (frame->transmission_timestamp.timestamp 
                         + ((uint64_t)inst->ccp->period << 16));
+#if MYNEWT_VAL(CCP_STANDBY_ENABLED)
+        if (ccp->standby.active)
+            ccp->local_epoch = (ccp->standby.local_tx + wcs_dtu_interval_to_local(ccp->wcs, (uint64_t)ccp->period << 16)) & 0x0FFFFFFFFFFUL;
+#endif
         ccp->idx++;
         err =  os_sem_release(&ccp->sem);
         assert(err == OS_OK);
@@ -946,6 +1307,16 @@ dw1000_ccp_start(struct _dw1000_dev_instance_t * inst, dw1000_ccp_role_t role){
     ccp->status.valid = false;
     ccp_frame_t * frame = ccp->frames[(ccp->idx)%ccp->nframes];
     ccp->config.role = role;
+#if MYNEWT_VAL(CCP_HOLDOVER_EPOCHS)
+    ccp->holdover = (dw1000_ccp_holdover_t){0};
+#endif
+#if MYNEWT_VAL(CCP_STANDBY_ENABLED)
+    ccp->standby = (dw1000_ccp_standby_t){0};
+#endif
+#if MYNEWT_VAL(FS_XTALT_CALIB_ENABLED)
+    if (role != CCP_ROLE_MASTER)
+        ccp_xtalt_apply(ccp);
+#endif
 
     /* Setup CCP to send/listen for the first packet ASAP */
     uint64_t ts = (dw1000_read_systime(inst) - (((uint64_t)ccp->period)<<16))&0xFFFFFFFFFFULL;
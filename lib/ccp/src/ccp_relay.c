@@ -0,0 +1,336 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file ccp_relay.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Planned ccp relay tree
+ *
+ * @details Neighbour tracking and plan application run on every node, the planner itself only on the node
+ * collecting the reports. The planner works on fixed tables and is quadratic in the number of nodes, it is
+ * meant to be rerun when the reports change, not per epoch.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <os/os.h>
+#include <os/os_cputime.h>
+
+#if MYNEWT_VAL(CCP_ENABLED) && MYNEWT_VAL(CCP_RELAY_PLANNER_ENABLED)
+#include <dw1000/dw1000_dev.h>
+#include <ccp/ccp.h>
+#if MYNEWT_VAL(TOFDB_ENABLED)
+#include <tofdb/tofdb.h>
+#endif
+
+#define CCP_RELAY_RSSI_GAIN 0.25f
+#define CCP_RELAY_NOT_HEARD INT16_MIN
+
+/**
+ * @fn ccp_relay_observe(struct _dw1000_ccp_instance_t * ccp, uint16_t addr, uint8_t depth, float rssi)
+ * @brief Records a ccp frame heard from addr, called from rx_complete_cb. The least recently heard
+ * transmitter is evicted when the table is full. Without rxdiag_enable the rssi is unknown and the link
+ * is recorded at MYNEWT_VAL(CCP_RELAY_MIN_RSSI), usable but least preferred.
+ *
+ * @param ccp    Pointer to dw1000_ccp_instance_t.
+ * @param addr   Transmitter short address.
+ * @param depth  rpt_count of the frame.
+ * @param rssi   rssi of the frame (dBm).
+ * @return void
+ */
+void
+ccp_relay_observe(struct _dw1000_ccp_instance_t * ccp, uint16_t addr, uint8_t depth, float rssi){
+
+    ccp_relay_neighbour_t * entry = NULL;
+    ccp_relay_neighbour_t * victim = NULL;
+
+    if (addr == 0)
+        return;
+    if (!isfinite(rssi))
+        rssi = MYNEWT_VAL(CCP_RELAY_MIN_RSSI);
+
+    for (uint16_t i = 0; i < MYNEWT_VAL(CCP_RELAY_NEIGHBOURS); i++) {
+        ccp_relay_neighbour_t * n = &ccp->neighbours[i];
+        if (n->addr == addr) {
+            entry = n;
+            break;
+        }
+        if (victim == NULL || n->addr == 0 ||
+            (victim->addr != 0 && (int32_t)(n->last_seen - victim->last_seen) < 0))
+            victim = n;
+    }
+    if (entry == NULL) {
+        entry = victim;
+        entry->addr = addr;
+        entry->rssi = rssi;
+    } else {
+        entry->rssi += CCP_RELAY_RSSI_GAIN * (rssi - entry->rssi);
+    }
+    entry->depth = depth;
+    entry->last_seen = os_cputime_get32();
+}
+
+/**
+ * @fn ccp_relay_report(struct _dw1000_ccp_instance_t * ccp, ccp_relay_report_t * report)
+ * @brief Fills report with the transmitters heard by this node.
+ *
+ * @param ccp     Pointer to dw1000_ccp_instance_t.
+ * @param report  Pointer to ccp_relay_report_t.
+ * @return void
+ */
+void
+ccp_relay_report(struct _dw1000_ccp_instance_t * ccp, ccp_relay_report_t * report){
+
+    memset(report, 0, sizeof(ccp_relay_report_t));
+    report->addr = ccp->parent->my_short_address;
+
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    for (uint16_t i = 0; i < MYNEWT_VAL(CCP_RELAY_NEIGHBOURS); i++) {
+        ccp_relay_neighbour_t * n = &ccp->neighbours[i];
+        if (n->addr == 0)
+            continue;
+        report->neighbours[report->n].addr = n->addr;
+        report->neighbours[report->n].depth = n->depth;
+        report->neighbours[report->n].rssi = (n->rssi < INT8_MIN) ? INT8_MIN : (n->rssi > INT8_MAX) ? INT8_MAX : (int8_t) lroundf(n->rssi);
+        report->n++;
+    }
+    OS_EXIT_CRITICAL(sr);
+}
+
+#if MYNEWT_VAL(TOFDB_ENABLED)
+static uint32_t
+tofdb_tof_comp(uint16_t short_addr){
+    uint32_t tof = 0;
+    tofdb_get_tof(short_addr, &tof);
+    return tof;
+}
+#endif
+
+/**
+ * @fn ccp_relay_apply(struct _dw1000_ccp_instance_t * ccp, const ccp_relay_assignment_t * assignment)
+ * @brief Applies the planned role. A node with a slot becomes a relay that repeats the epoch it takes,
+ * transmitting slot * tx_holdoff_dly after the epoch, any other slave or relay becomes a slave.
+ * The master and standby roles are left alone. With the tof database available it is also installed as
+ * tof compensation, unless the application set its own, so every hop is compensated.
+ *
+ * @param ccp         Pointer to dw1000_ccp_instance_t.
+ * @param assignment  Pointer to ccp_relay_assignment_t for this node.
+ * @return void
+ */
+void
+ccp_relay_apply(struct _dw1000_ccp_instance_t * ccp, const ccp_relay_assignment_t * assignment){
+
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    ccp->relay = *assignment;
+    if (ccp->config.role == CCP_ROLE_SLAVE || ccp->config.role == CCP_ROLE_RELAY)
+        ccp->config.role = (assignment->slot) ? CCP_ROLE_RELAY : CCP_ROLE_SLAVE;
+    OS_EXIT_CRITICAL(sr);
+
+#if MYNEWT_VAL(TOFDB_ENABLED)
+    if (ccp->tof_comp_cb == NULL)
+        dw1000_ccp_set_tof_comp_cb(ccp, tofdb_tof_comp);
+#endif
+}
+
+/**
+ * @fn ccp_relay_planner_init(ccp_relay_planner_t * planner, uint16_t master)
+ * @brief Clears the planner.
+ *
+ * @param planner  Pointer to ccp_relay_planner_t.
+ * @param master   Clock master short address, the root of the tree.
+ * @return void
+ */
+void
+ccp_relay_planner_init(ccp_relay_planner_t * planner, uint16_t master){
+    memset(planner, 0, sizeof(ccp_relay_planner_t));
+    planner->master = master;
+}
+
+static int
+node_index(ccp_relay_planner_t * planner, uint16_t addr){
+    for (uint16_t i = 0; i < planner->n; i++)
+        if (planner->nodes[i].report.addr == addr)
+            return i;
+    return -1;
+}
+
+static int16_t
+link_rssi(const ccp_relay_report_t * report, uint16_t addr){
+    for (uint8_t i = 0; i < report->n; i++)
+        if (report->neighbours[i].addr == addr)
+            return report->neighbours[i].rssi;
+    return CCP_RELAY_NOT_HEARD;
+}
+
+/**
+ * @fn ccp_relay_planner_add(ccp_relay_planner_t * planner, const ccp_relay_report_t * report)
+ * @brief Adds or replaces the report of a node.
+ *
+ * @param planner  Pointer to ccp_relay_planner_t.
+ * @param report   Pointer to ccp_relay_report_t.
+ * @return OS_OK, OS_EINVAL for a malformed report, OS_ENOMEM when the planner is full.
+ */
+int
+ccp_relay_planner_add(ccp_relay_planner_t * planner, const ccp_relay_report_t * report){
+
+    if (report->addr == 0 || report->n > MYNEWT_VAL(CCP_RELAY_NEIGHBOURS))
+        return OS_EINVAL;
+
+    int idx = node_index(planner, report->addr);
+    if (idx < 0) {
+        if (planner->n == MYNEWT_VAL(CCP_RELAY_MAX_NODES))
+            return OS_ENOMEM;
+        idx = planner->n++;
+    }
+    planner->nodes[idx].report = *report;
+    return OS_OK;
+}
+
+static bool
+is_parent(ccp_relay_planner_t * planner, uint16_t addr){
+    for (uint16_t i = 0; i < planner->n; i++)
+        if (planner->nodes[i].assignment.depth != CCP_RELAY_DEPTH_INVALID && planner->nodes[i].assignment.parent == addr)
+            return true;
+    return false;
+}
+
+/* Two relays interfere if either hears the other or any node hears both */
+static bool
+interfere(ccp_relay_planner_t * planner, uint16_t a, uint16_t b){
+    int ia = node_index(planner, a);
+    int ib = node_index(planner, b);
+    if (link_rssi(&planner->nodes[ia].report, b) != CCP_RELAY_NOT_HEARD ||
+        link_rssi(&planner->nodes[ib].report, a) != CCP_RELAY_NOT_HEARD)
+        return true;
+    for (uint16_t k = 0; k < planner->n; k++)
+        if (link_rssi(&planner->nodes[k].report, a) != CCP_RELAY_NOT_HEARD &&
+            link_rssi(&planner->nodes[k].report, b) != CCP_RELAY_NOT_HEARD)
+            return true;
+    return false;
+}
+
+/**
+ * @fn ccp_relay_plan(ccp_relay_planner_t * planner)
+ * @brief Builds the relay tree from the reports. Nodes are placed breadth first from the master, each on
+ * the strongest link to a node one level up, which gives the minimum depth tree. Depth is bounded by
+ * MYNEWT_VAL(CCP_MAX_CASCADE_RPTS) and links weaker than MYNEWT_VAL(CCP_RELAY_MIN_RSSI) are not used.
+ * Relays are then given the lowest slot above their parent's that no interfering relay uses.
+ * Unreachable nodes are left at CCP_RELAY_DEPTH_INVALID.
+ *
+ * @param planner  Pointer to ccp_relay_planner_t.
+ * @return OS_OK, OS_ENOMEM if MYNEWT_VAL(CCP_RELAY_SLOTS) slots do not suffice.
+ */
+int
+ccp_relay_plan(ccp_relay_planner_t * planner){
+
+    int rc = OS_OK;
+    planner->nslots = 0;
+
+    for (uint16_t i = 0; i < planner->n; i++) {
+        ccp_relay_node_t * node = &planner->nodes[i];
+        node->assignment = (ccp_relay_assignment_t){
+            .addr = node->report.addr,
+            .parent = (node->report.addr == planner->master) ? planner->master : 0,
+            .depth = (node->report.addr == planner->master) ? 0 : CCP_RELAY_DEPTH_INVALID,
+            .slot = 0
+        };
+    }
+
+    for (uint8_t depth = 1; depth == 1 || depth <= MYNEWT_VAL(CCP_MAX_CASCADE_RPTS); depth++) {
+        for (uint16_t i = 0; i < planner->n; i++) {
+            ccp_relay_node_t * node = &planner->nodes[i];
+            if (node->assignment.depth != CCP_RELAY_DEPTH_INVALID)
+                continue;
+            int16_t best = CCP_RELAY_NOT_HEARD;
+            for (uint8_t e = 0; e < node->report.n; e++) {
+                uint16_t addr = node->report.neighbours[e].addr;
+                int16_t rssi = node->report.neighbours[e].rssi;
+                if (rssi < MYNEWT_VAL(CCP_RELAY_MIN_RSSI) || rssi <= best)
+                    continue;
+                if (depth == 1) {
+                    if (addr != planner->master)
+                        continue;
+                } else {
+                    int j = node_index(planner, addr);
+                    // Nodes placed in this pass are at depth, not depth - 1
+                    if (j < 0 || planner->nodes[j].assignment.depth != depth - 1)
+                        continue;
+                }
+                best = rssi;
+                node->assignment.parent = addr;
+            }
+            if (best != CCP_RELAY_NOT_HEARD)
+                node->assignment.depth = depth;
+        }
+    }
+
+    for (uint8_t depth = 1; depth < MYNEWT_VAL(CCP_MAX_CASCADE_RPTS); depth++) {
+        for (uint16_t i = 0; i < planner->n; i++) {
+            ccp_relay_node_t * node = &planner->nodes[i];
+            if (node->assignment.depth != depth || !is_parent(planner, node->assignment.addr))
+                continue;
+            uint8_t slot = 0;
+            if (node->assignment.parent != planner->master)
+                slot = planner->nodes[node_index(planner, node->assignment.parent)].assignment.slot;
+            if (slot == 0 && depth > 1) {
+                // Parent could not be given a slot
+                continue;
+            }
+            for (slot++; slot <= MYNEWT_VAL(CCP_RELAY_SLOTS); slot++) {
+                bool conflict = false;
+                for (uint16_t k = 0; k < planner->n && !conflict; k++)
+                    conflict = planner->nodes[k].assignment.slot == slot &&
+                               interfere(planner, node->assignment.addr, planner->nodes[k].assignment.addr);
+                if (!conflict)
+                    break;
+            }
+            if (slot > MYNEWT_VAL(CCP_RELAY_SLOTS)) {
+                rc = OS_ENOMEM;
+                continue;
+            }
+            node->assignment.slot = slot;
+            if (slot > planner->nslots)
+                planner->nslots = slot;
+        }
+    }
+    return rc;
+}
+
+/**
+ * @fn ccp_relay_planner_get(ccp_relay_planner_t * planner, uint16_t addr)
+ * @brief Returns the assignment of a node from the last ccp_relay_plan().
+ *
+ * @param planner  Pointer to ccp_relay_planner_t.
+ * @param addr     Node short address.
+ * @return Pointer to ccp_relay_assignment_t, NULL for an unknown node.
+ */
+const ccp_relay_assignment_t *
+ccp_relay_planner_get(ccp_relay_planner_t * planner, uint16_t addr){
+    int idx = node_index(planner, addr);
+    return (idx < 0) ? NULL : &planner->nodes[idx].assignment;
+}
+
+#endif
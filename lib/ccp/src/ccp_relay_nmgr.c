@@ -0,0 +1,471 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file ccp_relay_nmgr.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Newtmgr transport of the ccp relay plan
+ *
+ * @details Registers the MGMT_GROUP_ID_CCP_RELAY group. A read of CCP_RELAY_NMGR_ID_REPORT returns the packed
+ * ccp_relay_report_t of the node, a write of CCP_RELAY_NMGR_ID_ASSIGN applies an assignment addressed to it.
+ * The uwb transport drops responses, so the planning node collects reports with writes instead:
+ * ccp_relay_nmgr_collect() broadcasts a CCP_RELAY_NMGR_ID_SOLICIT write, every node answers with a
+ * CCP_RELAY_NMGR_ID_REPORT write of its report to the planner, which adds it to its planner. After
+ * MYNEWT_VAL(CCP_RELAY_NMGR_COLLECT_MS) the planner adds its own report, runs ccp_relay_plan() and pushes the
+ * plan with ccp_relay_distribute(), which queues one write per placed node on the uwb newtmgr transport.
+ * Handlers act on the instance the request arrived on, requests over other transports on instance 0.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <os/os.h>
+#include <sysinit/sysinit.h>
+
+#if MYNEWT_VAL(CCP_ENABLED) && MYNEWT_VAL(CCP_RELAY_PLANNER_ENABLED) && MYNEWT_VAL(CCP_RELAY_NMGR_ENABLED)
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_hal.h>
+#include <ccp/ccp.h>
+#include <mgmt/mgmt.h>
+#include <newtmgr/newtmgr.h>
+#include <tinycbor/cbor.h>
+#include <tinycbor/cbor_mbuf_writer.h>
+#include <tinycbor/cbor_mbuf_reader.h>
+#include <cborattr/cborattr.h>
+#include <nmgr_uwb/nmgr_uwb.h>
+
+static int ccp_relay_nmgr_report(struct mgmt_cbuf *);
+static int ccp_relay_nmgr_collect_report(struct mgmt_cbuf *);
+static int ccp_relay_nmgr_assign(struct mgmt_cbuf *);
+static int ccp_relay_nmgr_solicit(struct mgmt_cbuf *);
+
+static const struct mgmt_handler ccp_relay_nmgr_handlers[] = {
+    [CCP_RELAY_NMGR_ID_REPORT] = {
+        .mh_read = ccp_relay_nmgr_report,
+        .mh_write = ccp_relay_nmgr_collect_report
+    },
+    [CCP_RELAY_NMGR_ID_ASSIGN] = {
+        .mh_read = NULL,
+        .mh_write = ccp_relay_nmgr_assign
+    },
+    [CCP_RELAY_NMGR_ID_SOLICIT] = {
+        .mh_read = NULL,
+        .mh_write = ccp_relay_nmgr_solicit
+    }
+};
+
+#define CCP_RELAY_HANDLER_CNT                                           \
+    sizeof(ccp_relay_nmgr_handlers) / sizeof(ccp_relay_nmgr_handlers[0])
+
+static struct mgmt_group ccp_relay_nmgr_group = {
+    .mg_handlers = (struct mgmt_handler *)ccp_relay_nmgr_handlers,
+    .mg_handlers_count = CCP_RELAY_HANDLER_CNT,
+    .mg_group_id = MGMT_GROUP_ID_CCP_RELAY,
+};
+
+static uint8_t ccp_relay_nmgr_seq;
+
+//! Collection of the planning node, allocated by the first ccp_relay_nmgr_collect()
+static struct _ccp_relay_nmgr_collection_t{
+    struct _dw1000_dev_instance_t * inst;   //!< Planning instance
+    struct os_callout callout;              //!< Ends the collection window
+    uint16_t collecting:1;                  //!< Reports are accepted
+    ccp_relay_planner_t planner;
+} * g_collection;
+
+/**
+ * @fn ccp_relay_nmgr_inst(struct mgmt_cbuf * cb)
+ * @brief Instance a request arrived on. The uwb transport records it in the user header of the request mbuf,
+ * other transports, the serial console for instance, leave no user header and address instance 0.
+ *
+ * @param cb  Pointer to mgmt_cbuf of the request.
+ * @return Pointer to dw1000_dev_instance_t.
+ */
+static struct _dw1000_dev_instance_t *
+ccp_relay_nmgr_inst(struct mgmt_cbuf * cb){
+
+    struct os_mbuf * req = ((struct nmgr_cbuf *) cb)->reader.m;
+    if (req == NULL || OS_MBUF_USRHDR_LEN(req) != sizeof(struct nmgr_uwb_usr_hdr))
+        return hal_dw1000_inst(0);
+    struct nmgr_uwb_usr_hdr * hdr = (struct nmgr_uwb_usr_hdr *) OS_MBUF_USRHDR(req);
+    return hal_dw1000_inst(hdr->inst_idx);
+}
+
+static int
+ccp_relay_nmgr_rc(struct mgmt_cbuf * cb, int rc){
+    CborError g_err = CborNoError;
+    g_err |= cbor_encode_text_stringz(&cb->encoder, "rc");
+    g_err |= cbor_encode_int(&cb->encoder, rc);
+    return (g_err) ? MGMT_ERR_ENOMEM : 0;
+}
+
+/**
+ * @fn ccp_relay_nmgr_report(struct mgmt_cbuf * cb)
+ * @brief Read handler, returns the neighbour table of this node as the packed ccp_relay_report_t under "r".
+ *
+ * @param cb  Pointer to mgmt_cbuf.
+ * @return 0 on success, MGMT_ERR_ENOMEM if the response could not be encoded.
+ */
+static int
+ccp_relay_nmgr_report(struct mgmt_cbuf * cb){
+
+    ccp_relay_report_t report;
+    ccp_relay_report(ccp_relay_nmgr_inst(cb)->ccp, &report);
+
+    CborError g_err = CborNoError;
+    g_err |= cbor_encode_text_stringz(&cb->encoder, "rc");
+    g_err |= cbor_encode_int(&cb->encoder, MGMT_ERR_EOK);
+    g_err |= cbor_encode_text_stringz(&cb->encoder, "r");
+    g_err |= cbor_encode_byte_string(&cb->encoder, (const uint8_t *)&report,
+                offsetof(ccp_relay_report_t, neighbours) + report.n * sizeof(report.neighbours[0]));
+    return (g_err) ? MGMT_ERR_ENOMEM : 0;
+}
+
+/**
+ * @fn ccp_relay_nmgr_assign(struct mgmt_cbuf * cb)
+ * @brief Write handler, applies the assignment carried as "a" address, "p" parent, "d" depth and "s" slot.
+ * Assignments for other nodes are acknowledged and ignored, so the plan can also be sent to the broadcast
+ * address one node at a time.
+ *
+ * @param cb  Pointer to mgmt_cbuf.
+ * @return 0 on success, MGMT_ERR_EINVAL for a malformed request.
+ */
+static int
+ccp_relay_nmgr_assign(struct mgmt_cbuf * cb){
+
+    uint64_t addr = UINT64_MAX, parent = UINT64_MAX, depth = UINT64_MAX, slot = UINT64_MAX;
+    const struct cbor_attr_t attrs[] = {
+        [0] = {
+            .attribute = "a",
+            .type = CborAttrUnsignedIntegerType,
+            .addr.uinteger = &addr,
+            .nodefault = true
+        },
+        [1] = {
+            .attribute = "p",
+            .type = CborAttrUnsignedIntegerType,
+            .addr.uinteger = &parent,
+            .nodefault = true
+        },
+        [2] = {
+            .attribute = "d",
+            .type = CborAttrUnsignedIntegerType,
+            .addr.uinteger = &depth,
+            .nodefault = true
+        },
+        [3] = {
+            .attribute = "s",
+            .type = CborAttrUnsignedIntegerType,
+            .addr.uinteger = &slot,
+            .nodefault = true
+        },
+        [4] = { 0 },
+    };
+
+    int rc = cbor_read_object(&cb->it, attrs);
+    if (rc || addr > UINT16_MAX || parent > UINT16_MAX || depth > UINT8_MAX || slot > MYNEWT_VAL(CCP_RELAY_SLOTS))
+        return MGMT_ERR_EINVAL;
+
+    dw1000_dev_instance_t * inst = ccp_relay_nmgr_inst(cb);
+    if (addr == inst->my_short_address) {
+        ccp_relay_assignment_t assignment = {
+            .addr = addr,
+            .parent = parent,
+            .depth = depth,
+            .slot = slot
+        };
+        ccp_relay_apply(inst->ccp, &assignment);
+    }
+    return ccp_relay_nmgr_rc(cb, MGMT_ERR_EOK);
+}
+
+/**
+ * @fn ccp_relay_nmgr_collect_report(struct mgmt_cbuf * cb)
+ * @brief Write handler of the planning node, adds the packed ccp_relay_report_t carried under "r" to the
+ * planner. Reports outside a collection window are acknowledged and dropped.
+ *
+ * @param cb  Pointer to mgmt_cbuf.
+ * @return 0 on success, MGMT_ERR_EINVAL for a malformed report, MGMT_ERR_ENOMEM when the planner is full.
+ */
+static int
+ccp_relay_nmgr_collect_report(struct mgmt_cbuf * cb){
+
+    ccp_relay_report_t report;
+    size_t len = 0;
+    const struct cbor_attr_t attrs[] = {
+        [0] = {
+            .attribute = "r",
+            .type = CborAttrByteStringType,
+            .addr.bytes.data = (uint8_t *)&report,
+            .addr.bytes.len = &len,
+            .len = sizeof(report),
+            .nodefault = true
+        },
+        [1] = { 0 },
+    };
+
+    int rc = cbor_read_object(&cb->it, attrs);
+    if (rc || len < offsetof(ccp_relay_report_t, neighbours)
+        || len != offsetof(ccp_relay_report_t, neighbours) + report.n * sizeof(report.neighbours[0]))
+        return MGMT_ERR_EINVAL;
+
+    if (g_collection == NULL || !g_collection->collecting)
+        return ccp_relay_nmgr_rc(cb, MGMT_ERR_EOK);
+
+    switch (ccp_relay_planner_add(&g_collection->planner, &report)) {
+        case OS_OK:
+            return ccp_relay_nmgr_rc(cb, MGMT_ERR_EOK);
+        case OS_ENOMEM:
+            return MGMT_ERR_ENOMEM;
+        default:
+            return MGMT_ERR_EINVAL;
+    }
+}
+
+static struct os_mbuf *
+ccp_relay_nmgr_request(uint8_t id, CborEncoder * encoder, CborEncoder * map, struct cbor_mbuf_writer * writer){
+
+    struct os_mbuf * om = os_msys_get_pkthdr(NMGR_UWB_MTU_STD - sizeof(struct nmgr_hdr), 0);
+    if (om == NULL)
+        return NULL;
+
+    struct nmgr_hdr * hdr = (struct nmgr_hdr *) os_mbuf_extend(om, sizeof(struct nmgr_hdr));
+    if (hdr == NULL) {
+        os_mbuf_free_chain(om);
+        return NULL;
+    }
+    hdr->nh_len = 0;
+    hdr->nh_flags = 0;
+    hdr->nh_op = NMGR_OP_WRITE;
+    hdr->nh_group = htons(MGMT_GROUP_ID_CCP_RELAY);
+    hdr->nh_seq = ccp_relay_nmgr_seq++;
+    hdr->nh_id = id;
+
+    cbor_mbuf_writer_init(writer, om);
+    cbor_encoder_init(encoder, &writer->enc, 0);
+    if (cbor_encoder_create_map(encoder, map, CborIndefiniteLength)) {
+        os_mbuf_free_chain(om);
+        return NULL;
+    }
+    return om;
+}
+
+static int
+ccp_relay_nmgr_queue(struct _dw1000_dev_instance_t * inst, uint16_t addr, struct os_mbuf * om, CborEncoder * encoder, CborEncoder * map, CborError g_err){
+
+    g_err |= cbor_encoder_close_container(encoder, map);
+    if (g_err) {
+        os_mbuf_free_chain(om);
+        return OS_ENOMEM;
+    }
+    struct nmgr_hdr * hdr = (struct nmgr_hdr *) om->om_data;
+    hdr->nh_len = htons(cbor_encode_bytes_written(encoder));
+    return uwb_nmgr_queue_tx(inst, addr, NMGR_CMD_STATE_SEND, om);
+}
+
+/**
+ * @fn ccp_relay_nmgr_solicit(struct mgmt_cbuf * cb)
+ * @brief Write handler, queues the report of this node to the planning node "m" as a CCP_RELAY_NMGR_ID_REPORT
+ * write. The report goes out with the next uwb newtmgr transmission of the node.
+ *
+ * @param cb  Pointer to mgmt_cbuf.
+ * @return 0 on success, MGMT_ERR_EINVAL for a malformed request, MGMT_ERR_ENOMEM if the report was not queued.
+ */
+static int
+ccp_relay_nmgr_solicit(struct mgmt_cbuf * cb){
+
+    uint64_t master = UINT64_MAX;
+    const struct cbor_attr_t attrs[] = {
+        [0] = {
+            .attribute = "m",
+            .type = CborAttrUnsignedIntegerType,
+            .addr.uinteger = &master,
+            .nodefault = true
+        },
+        [1] = { 0 },
+    };
+
+    int rc = cbor_read_object(&cb->it, attrs);
+    if (rc || master > UINT16_MAX)
+        return MGMT_ERR_EINVAL;
+
+    dw1000_dev_instance_t * inst = ccp_relay_nmgr_inst(cb);
+    if (master != inst->my_short_address) {
+        ccp_relay_report_t report;
+        ccp_relay_report(inst->ccp, &report);
+
+        struct cbor_mbuf_writer writer;
+        CborEncoder encoder, map;
+        struct os_mbuf * om = ccp_relay_nmgr_request(CCP_RELAY_NMGR_ID_REPORT, &encoder, &map, &writer);
+        if (om == NULL)
+            return MGMT_ERR_ENOMEM;
+        CborError g_err = CborNoError;
+        g_err |= cbor_encode_text_stringz(&map, "r");
+        g_err |= cbor_encode_byte_string(&map, (const uint8_t *)&report,
+                    offsetof(ccp_relay_report_t, neighbours) + report.n * sizeof(report.neighbours[0]));
+        if (ccp_relay_nmgr_queue(inst, master, om, &encoder, &map, g_err))
+            return MGMT_ERR_ENOMEM;
+    }
+    return ccp_relay_nmgr_rc(cb, MGMT_ERR_EOK);
+}
+
+static int
+send_assignment(struct _dw1000_dev_instance_t * inst, const ccp_relay_assignment_t * assignment){
+
+    struct cbor_mbuf_writer writer;
+    CborEncoder encoder, map;
+    struct os_mbuf * om = ccp_relay_nmgr_request(CCP_RELAY_NMGR_ID_ASSIGN, &encoder, &map, &writer);
+    if (om == NULL)
+        return OS_ENOMEM;
+
+    CborError g_err = CborNoError;
+    g_err |= cbor_encode_text_stringz(&map, "a");
+    g_err |= cbor_encode_uint(&map, assignment->addr);
+    g_err |= cbor_encode_text_stringz(&map, "p");
+    g_err |= cbor_encode_uint(&map, assignment->parent);
+    g_err |= cbor_encode_text_stringz(&map, "d");
+    g_err |= cbor_encode_uint(&map, assignment->depth);
+    g_err |= cbor_encode_text_stringz(&map, "s");
+    g_err |= cbor_encode_uint(&map, assignment->slot);
+    return ccp_relay_nmgr_queue(inst, assignment->addr, om, &encoder, &map, g_err);
+}
+
+/**
+ * @fn ccp_relay_distribute(struct _dw1000_dev_instance_t * inst, ccp_relay_planner_t * planner)
+ * @brief Sends the last plan to the nodes. The assignment of this node is applied directly, every other
+ * placed node is sent a CCP_RELAY_NMGR_ID_ASSIGN write. Unreachable nodes are skipped, they keep their
+ * current role until a later plan places them.
+ *
+ * @param inst     Pointer to dw1000_dev_instance_t.
+ * @param planner  Pointer to ccp_relay_planner_t after ccp_relay_plan().
+ * @return OS_OK, or the error of the first write that could not be queued.
+ */
+int
+ccp_relay_distribute(struct _dw1000_dev_instance_t * inst, ccp_relay_planner_t * planner){
+
+    int rc = OS_OK;
+    for (uint16_t i = 0; i < planner->n; i++) {
+        const ccp_relay_assignment_t * assignment = &planner->nodes[i].assignment;
+        if (assignment->depth == CCP_RELAY_DEPTH_INVALID)
+            continue;
+        if (assignment->addr == inst->my_short_address) {
+            ccp_relay_apply(inst->ccp, assignment);
+            continue;
+        }
+        int err = send_assignment(inst, assignment);
+        if (err && rc == OS_OK)
+            rc = err;
+    }
+    return rc;
+}
+
+/**
+ * @fn ccp_relay_nmgr_plan(struct _dw1000_dev_instance_t * inst)
+ * @brief Closes the collection window, adds the report of the planning node, plans the relay tree from the
+ * reports collected and distributes it. Called when MYNEWT_VAL(CCP_RELAY_NMGR_COLLECT_MS) have passed since
+ * ccp_relay_nmgr_collect(), may be called earlier to plan with the reports in so far.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t, the planning node.
+ * @return OS_OK, OS_EINVAL without a collection, the error of ccp_relay_plan() or of ccp_relay_distribute().
+ */
+int
+ccp_relay_nmgr_plan(struct _dw1000_dev_instance_t * inst){
+
+    if (g_collection == NULL || g_collection->inst != inst)
+        return OS_EINVAL;
+    os_callout_stop(&g_collection->callout);
+    g_collection->collecting = 0;
+
+    ccp_relay_report_t report;
+    ccp_relay_report(inst->ccp, &report);
+    int rc = ccp_relay_planner_add(&g_collection->planner, &report);
+    if (rc == OS_OK)
+        rc = ccp_relay_plan(&g_collection->planner);
+    if (rc == OS_OK)
+        rc = ccp_relay_distribute(inst, &g_collection->planner);
+    return rc;
+}
+
+static void
+ccp_relay_nmgr_plan_ev(struct os_event * ev){
+    ccp_relay_nmgr_plan((struct _dw1000_dev_instance_t *) ev->ev_arg);
+}
+
+/**
+ * @fn ccp_relay_nmgr_collect(struct _dw1000_dev_instance_t * inst)
+ * @brief Starts a collection on the planning node, normally the clock master. The planner is cleared, a
+ * CCP_RELAY_NMGR_ID_SOLICIT write is queued to the broadcast address and the plan is made and distributed
+ * MYNEWT_VAL(CCP_RELAY_NMGR_COLLECT_MS) later on the default event queue, see ccp_relay_nmgr_plan().
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t, the planning node.
+ * @return OS_OK, OS_ENOMEM if the planner could not be allocated or the request not queued.
+ */
+int
+ccp_relay_nmgr_collect(struct _dw1000_dev_instance_t * inst){
+
+    if (g_collection == NULL) {
+        g_collection = (struct _ccp_relay_nmgr_collection_t *) malloc(sizeof(struct _ccp_relay_nmgr_collection_t));
+        if (g_collection == NULL)
+            return OS_ENOMEM;
+        os_callout_init(&g_collection->callout, os_eventq_dflt_get(), ccp_relay_nmgr_plan_ev, NULL);
+    }
+    os_callout_stop(&g_collection->callout);
+    g_collection->inst = inst;
+    g_collection->callout.c_ev.ev_arg = (void *) inst;
+    ccp_relay_planner_init(&g_collection->planner, inst->my_short_address);
+    g_collection->collecting = 1;
+
+    struct cbor_mbuf_writer writer;
+    CborEncoder encoder, map;
+    struct os_mbuf * om = ccp_relay_nmgr_request(CCP_RELAY_NMGR_ID_SOLICIT, &encoder, &map, &writer);
+    if (om == NULL)
+        return OS_ENOMEM;
+    CborError g_err = CborNoError;
+    g_err |= cbor_encode_text_stringz(&map, "m");
+    g_err |= cbor_encode_uint(&map, inst->my_short_address);
+    int rc = ccp_relay_nmgr_queue(inst, BROADCAST_ADDRESS, om, &encoder, &map, g_err);
+    if (rc)
+        return rc;
+
+    os_callout_reset(&g_collection->callout, os_time_ms_to_ticks32(MYNEWT_VAL(CCP_RELAY_NMGR_COLLECT_MS)));
+    return OS_OK;
+}
+
+/**
+ * @fn ccp_relay_nmgr_pkg_init(void)
+ * @brief Registers the ccp relay newtmgr group, called from ccp_pkg_init().
+ *
+ * @return void
+ */
+void
+ccp_relay_nmgr_pkg_init(void){
+    int rc;
+
+    /* Ensure this function only gets called by sysinit. */
+    SYSINIT_ASSERT_ACTIVE();
+
+    rc = mgmt_group_register(&ccp_relay_nmgr_group);
+    SYSINIT_PANIC_ASSERT(rc == 0);
+}
+
+#endif
@@ -0,0 +1,351 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file ccp_xtalt.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Learned crystal trim versus temperature
+ *
+ * @details Each bin holds a running average of the trim codes observed in its temperature range, the
+ * averaging weight saturates at MYNEWT_VAL(FS_XTALT_CALIB_WEIGHT) so the curve keeps following crystal
+ * ageing. A bin is persisted when it is first learned or has moved by half a trim code since it was last
+ * saved, which bounds the flash writes to a handful per bin over the life of the device.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <os/os.h>
+
+#if MYNEWT_VAL(CCP_ENABLED) && MYNEWT_VAL(FS_XTALT_CALIB_ENABLED)
+#include <config/config.h>
+
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_phy.h>
+#include <dw1000/dw1000_regs.h>
+#include <ccp/ccp.h>
+#include <ccp/ccp_xtalt.h>
+
+#define NBINS MYNEWT_VAL(FS_XTALT_CALIB_NBINS)
+#define FRAC 8.0f                   // Fixed point scale of the stored trim codes
+#define SAVE_THRESHOLD 4            // Half a trim code
+
+static struct _dw1000_ccp_instance_t * g_ccps[3];
+
+static char *ccp_xtalt_get(int argc, char **argv, char *val, int val_len_max);
+static int ccp_xtalt_set(int argc, char **argv, char *val);
+static int ccp_xtalt_commit(void);
+static int ccp_xtalt_export(void (*export_func)(char *name, char *val), enum conf_export_tgt tgt);
+
+static struct conf_handler ccp_xtalt_handler = {
+    .ch_name = "xtalt",
+    .ch_get = ccp_xtalt_get,
+    .ch_set = ccp_xtalt_set,
+    .ch_commit = ccp_xtalt_commit,
+    .ch_export = ccp_xtalt_export,
+};
+
+static struct _dw1000_ccp_instance_t *
+ccp_find(const char * name){
+    char * end;
+    unsigned long idx = strtoul(name, &end, 10);
+    if (*name == '\0' || *end != '\0' || idx >= sizeof(g_ccps)/sizeof(g_ccps[0]))
+        return NULL;
+    return g_ccps[idx];
+}
+
+/* The curve is persisted as the base64 of trim[] followed by weight[] */
+static char *
+curve_to_str(ccp_xtalt_calib_t * calib, char * val, int val_len_max){
+    uint8_t buf[2 * NBINS];
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    memcpy(buf, calib->trim, NBINS);
+    memcpy(buf + NBINS, calib->weight, NBINS);
+    OS_EXIT_CRITICAL(sr);
+    return conf_str_from_bytes(buf, sizeof(buf), val, val_len_max);
+}
+
+static char *
+ccp_xtalt_get(int argc, char **argv, char *val, int val_len_max)
+{
+    struct _dw1000_ccp_instance_t * ccp = (argc == 1) ? ccp_find(argv[0]) : NULL;
+    if (ccp == NULL)
+        return NULL;
+    return curve_to_str(&ccp->xtalt, val, val_len_max);
+}
+
+static int
+ccp_xtalt_set(int argc, char **argv, char *val)
+{
+    struct _dw1000_ccp_instance_t * ccp = (argc == 1) ? ccp_find(argv[0]) : NULL;
+    if (ccp == NULL)
+        return OS_ENOENT;
+
+    uint8_t buf[2 * NBINS];
+    int len = sizeof(buf);
+    int rc = conf_bytes_from_str(val, buf, &len);
+    if (rc)
+        return rc;
+    if (len != sizeof(buf))
+        return OS_EINVAL;       // Stored with a different FS_XTALT_CALIB_NBINS
+
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    memcpy(ccp->xtalt.trim, buf, NBINS);
+    memcpy(ccp->xtalt.weight, buf + NBINS, NBINS);
+    memcpy(ccp->xtalt.saved, ccp->xtalt.trim, NBINS);
+    OS_EXIT_CRITICAL(sr);
+    return 0;
+}
+
+static int
+ccp_xtalt_commit(void)
+{
+    // The curve may load after ccp was started, catch up on any slave already listening
+    for (uint8_t i = 0; i < sizeof(g_ccps)/sizeof(g_ccps[0]); i++){
+        if (g_ccps[i] && g_ccps[i]->config.role != CCP_ROLE_MASTER && !g_ccps[i]->status.valid)
+            ccp_xtalt_apply(g_ccps[i]);
+    }
+    return 0;
+}
+
+static int
+ccp_xtalt_export(void (*export_func)(char *name, char *val), enum conf_export_tgt tgt)
+{
+    char name[16];
+    char val[CONF_STR_FROM_BYTES_LEN(2 * NBINS)];
+    for (uint8_t i = 0; i < sizeof(g_ccps)/sizeof(g_ccps[0]); i++){
+        if (g_ccps[i] == NULL)
+            continue;
+        snprintf(name, sizeof(name), "%s/%u", ccp_xtalt_handler.ch_name, i);
+        export_func(name, curve_to_str(&g_ccps[i]->xtalt, val, sizeof(val)));
+    }
+    return 0;
+}
+
+static void
+save_ev_cb(struct os_event * ev){
+    struct _dw1000_ccp_instance_t * ccp = (struct _dw1000_ccp_instance_t *) ev->ev_arg;
+    char name[16];
+    char val[CONF_STR_FROM_BYTES_LEN(2 * NBINS)];
+    snprintf(name, sizeof(name), "%s/%u", ccp_xtalt_handler.ch_name, ccp->parent->idx);
+    conf_save_one(name, curve_to_str(&ccp->xtalt, val, sizeof(val)));
+}
+
+static int16_t
+temp_to_bin(float temp){
+    int16_t bin = (int16_t) floorf((temp - MYNEWT_VAL(FS_XTALT_CALIB_TMIN)) / MYNEWT_VAL(FS_XTALT_CALIB_BIN));
+    if (bin < 0)
+        return 0;
+    if (bin >= NBINS)
+        return NBINS - 1;
+    return bin;
+}
+
+static float
+bin_to_temp(int16_t bin){
+    return MYNEWT_VAL(FS_XTALT_CALIB_TMIN) + (bin + 0.5f) * MYNEWT_VAL(FS_XTALT_CALIB_BIN);
+}
+
+/**
+ * @fn ccp_xtalt_register(struct _dw1000_ccp_instance_t * ccp)
+ * @brief API to put the crystal trim of a ccp instance under calibration, called from dw1000_ccp_init.
+ * The persisted curve, if any, is loaded when sys/config loads.
+ *
+ * @param ccp  Pointer to dw1000_ccp_instance_t.
+ *
+ * @return void
+ */
+void
+ccp_xtalt_register(struct _dw1000_ccp_instance_t * ccp){
+    assert(ccp->parent->idx < sizeof(g_ccps)/sizeof(g_ccps[0]));
+    ccp->xtalt.save_ev.ev_cb = save_ev_cb;
+    ccp->xtalt.save_ev.ev_arg = (void *) ccp;
+    g_ccps[ccp->parent->idx] = ccp;
+}
+
+/**
+ * @fn ccp_xtalt_clear(struct _dw1000_ccp_instance_t * ccp)
+ * @brief API to forget the learned curve, i.e. after the crystal or board was changed. The cleared curve
+ * is persisted.
+ *
+ * @param ccp  Pointer to dw1000_ccp_instance_t.
+ *
+ * @return void
+ */
+void
+ccp_xtalt_clear(struct _dw1000_ccp_instance_t * ccp){
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    memset(ccp->xtalt.trim, 0, sizeof(ccp->xtalt.trim));
+    memset(ccp->xtalt.weight, 0, sizeof(ccp->xtalt.weight));
+    memset(ccp->xtalt.saved, 0, sizeof(ccp->xtalt.saved));
+    OS_EXIT_CRITICAL(sr);
+    os_eventq_put(os_eventq_dflt_get(), &ccp->xtalt.save_ev);
+}
+
+/**
+ * @fn ccp_xtalt_sample(struct _dw1000_ccp_instance_t * ccp)
+ * @brief API to sample the die temperature for the next autotune step. The SAR conversion touches the
+ * analog RF configuration, call from task context while the radio is idle.
+ *
+ * @param ccp  Pointer to dw1000_ccp_instance_t.
+ *
+ * @return void
+ */
+void
+ccp_xtalt_sample(struct _dw1000_ccp_instance_t * ccp){
+    float temp = dw1000_phy_read_temp_SI(ccp->parent);
+
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    ccp->xtalt.temp = temp;
+    ccp->xtalt.sampled = true;
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * @fn ccp_xtalt_observe(struct _dw1000_ccp_instance_t * ccp, float trim)
+ * @brief API to add an observation of the trim code that nulls the offset to the clock master at the
+ * temperature last sampled by ccp_xtalt_sample, called from the autotune step in rx_complete_cb. Each sample
+ * is observed once, the observation is dropped when there is none.
+ *
+ * @param ccp   Pointer to dw1000_ccp_instance_t.
+ * @param trim  Trim code, fractional.
+ *
+ * @return void
+ */
+void
+ccp_xtalt_observe(struct _dw1000_ccp_instance_t * ccp, float trim){
+    ccp_xtalt_calib_t * calib = &ccp->xtalt;
+    bool save = false;
+
+    if (trim < 0)
+        trim = 0;
+    else if (trim > FS_XTALT_MASK)
+        trim = FS_XTALT_MASK;
+
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    if (!calib->sampled){
+        OS_EXIT_CRITICAL(sr);
+        return;
+    }
+    calib->sampled = false;
+    int16_t bin = temp_to_bin(calib->temp);
+
+    if (calib->weight[bin] < MYNEWT_VAL(FS_XTALT_CALIB_WEIGHT))
+        calib->weight[bin]++;
+    float estimate = calib->trim[bin] / FRAC;
+    estimate += (trim - estimate) / calib->weight[bin];
+    calib->trim[bin] = (uint8_t) roundf(estimate * FRAC);
+
+    if (calib->weight[bin] == 1 || abs((int16_t)calib->trim[bin] - calib->saved[bin]) >= SAVE_THRESHOLD){
+        calib->saved[bin] = calib->trim[bin];
+        save = true;
+    }
+    OS_EXIT_CRITICAL(sr);
+
+    if (save)
+        os_eventq_put(os_eventq_dflt_get(), &calib->save_ev);
+}
+
+/**
+ * @fn ccp_xtalt_lookup(struct _dw1000_ccp_instance_t * ccp, float temp, float * trim)
+ * @brief API to read the learned trim code at a temperature. Interpolates linearly between the nearest
+ * learned bins either side and holds the outermost learned bin beyond them.
+ *
+ * @param ccp   Pointer to dw1000_ccp_instance_t.
+ * @param temp  Die temperature (degrees C).
+ * @param trim  Trim code, fractional.
+ *
+ * @return OS_OK, OS_ENOENT if nothing has been learned yet.
+ */
+int
+ccp_xtalt_lookup(struct _dw1000_ccp_instance_t * ccp, float temp, float * trim){
+    ccp_xtalt_calib_t * calib = &ccp->xtalt;
+    int16_t bin = temp_to_bin(temp);
+    int16_t lo, hi;
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+
+    for (lo = bin; lo >= 0 && calib->weight[lo] == 0; lo--);
+    for (hi = bin; hi < NBINS && calib->weight[hi] == 0; hi++);
+
+    if (lo < 0 && hi == NBINS){
+        OS_EXIT_CRITICAL(sr);
+        return OS_ENOENT;
+    }
+    if (lo < 0)
+        lo = hi;
+    if (hi == NBINS)
+        hi = lo;
+
+    float t_lo = bin_to_temp(lo), t_hi = bin_to_temp(hi);
+    if (lo == hi || temp <= t_lo)
+        *trim = calib->trim[lo] / FRAC;
+    else if (temp >= t_hi)
+        *trim = calib->trim[hi] / FRAC;
+    else
+        *trim = (calib->trim[lo] + (calib->trim[hi] - calib->trim[lo]) * (temp - t_lo) / (t_hi - t_lo)) / FRAC;
+    OS_EXIT_CRITICAL(sr);
+    return OS_OK;
+}
+
+/**
+ * @fn ccp_xtalt_apply(struct _dw1000_ccp_instance_t * ccp)
+ * @brief API to write the learned trim code for the current die temperature, called from dw1000_ccp_start
+ * before the first ccp frame of a slave.
+ *
+ * @param ccp  Pointer to dw1000_ccp_instance_t.
+ *
+ * @return OS_OK, OS_ENOENT if nothing has been learned yet.
+ */
+int
+ccp_xtalt_apply(struct _dw1000_ccp_instance_t * ccp){
+    dw1000_dev_instance_t * inst = ccp->parent;
+    float trim;
+
+    int rc = ccp_xtalt_lookup(ccp, dw1000_phy_read_temp_SI(inst), &trim);
+    if (rc != OS_OK)
+        return rc;
+
+    inst->xtal_trim = ((uint8_t) roundf(trim)) & FS_XTALT_MASK;
+    dw1000_write_reg(inst, FS_CTRL_ID, FS_XTALT_OFFSET, (3 << 5) | inst->xtal_trim, sizeof(uint8_t));
+    return OS_OK;
+}
+
+/**
+ * @fn ccp_xtalt_pkg_init(void)
+ * @brief API to register the xtalt config handler, called from ccp_pkg_init.
+ *
+ * @return void
+ */
+void
+ccp_xtalt_pkg_init(void){
+    int rc = conf_register(&ccp_xtalt_handler);
+    assert(rc == 0);
+}
+#endif
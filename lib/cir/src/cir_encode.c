@@ -24,8 +24,11 @@
 #include <stdio.h>
 #include <cir/cir_encode.h>
 #include <cir/cir.h>
+#if MYNEWT_VAL(TELEMETRY_ENABLED)
+#include <telemetry/telemetry.h>
+#endif
 
-#if MYNEWT_VAL(CIR_VERBOSE)
+#if MYNEWT_VAL(CIR_VERBOSE) || MYNEWT_VAL(PMEM_VERBOSE)
 
 #define JSON_BUF_SIZE (1024)
 static char _buf[JSON_BUF_SIZE];
@@ -59,6 +62,45 @@ json_write(void *buf, char* data, int len) {
     return len;
 }
 
+#if MYNEWT_VAL(TELEMETRY_ENABLED)
+_Static_assert(sizeof(struct _cir_complex_t) == sizeof(telemetry_cir_sample_t), "cir samples are sent as stored");
+
+/**
+ * Sends the samples as TELEMETRY_CIR records, split into as many records as needed.
+ *
+ * @param cir       Pointer to cir_instance_t.
+ * @param name      Stream name, "cir", "pmem0" ...
+ * @param flags     TELEMETRY_CIR_FP if fp_idx and fp_power are valid.
+ * @param array     Samples.
+ * @param nsize     Number of samples.
+ * @return void
+ */
+static void
+cir_telemetry(cir_instance_t * cir, const char * name, uint8_t flags, const struct _cir_complex_t * array, uint16_t nsize){
+    telemetry_cir_t record = {
+        .flags = flags,
+        .fp_idx = cir->fp_idx,
+        .fp_power = cir->fp_power
+    };
+    strncpy(record.name, name, sizeof(record.name));
+
+    for (uint16_t offset = 0; offset < nsize; offset += record.n){
+        uint16_t n = nsize - offset;
+        if (n > (UINT8_MAX - sizeof(telemetry_cir_t)) / sizeof(telemetry_cir_sample_t)) {
+            n = (UINT8_MAX - sizeof(telemetry_cir_t)) / sizeof(telemetry_cir_sample_t);
+            record.flags |= TELEMETRY_MORE;
+        } else
+            record.flags &= ~TELEMETRY_MORE;
+        record.n = n;
+        record.offset = offset;
+        const void * payload[] = {&record, &array[offset]};
+        const uint8_t len[] = {sizeof(record), n * sizeof(telemetry_cir_sample_t)};
+        telemetry_writev(TELEMETRY_CIR, payload, len, 2);
+    }
+}
+#endif
+
+#if MYNEWT_VAL(CIR_VERBOSE)
 void 
 cir_encode(cir_instance_t * cir, char * name, uint16_t nsize){
 
@@ -67,6 +109,11 @@ cir_encode(cir_instance_t * cir, char * name, uint16_t nsize){
     int rc;
     uint32_t utime = os_cputime_ticks_to_usecs(os_cputime_get32());
 
+#if MYNEWT_VAL(TELEMETRY_ENABLED)
+    cir_telemetry(cir, name, TELEMETRY_CIR_FP, cir->cir.array, nsize);
+    return;
+#endif
+
     /* reset the state of the internal test */
     memset(&encoder, 0, sizeof(encoder));
     encoder.je_write = json_write;
@@ -107,7 +154,9 @@ cir_encode(cir_instance_t * cir, char * name, uint16_t nsize){
     assert(rc == 0);
     json_fflush();
 }
+#endif
 
+#if MYNEWT_VAL(PMEM_VERBOSE)
 void 
 pmem_encode(cir_instance_t * cir, char * name, uint16_t nsize){
 
@@ -116,6 +165,11 @@ pmem_encode(cir_instance_t * cir, char * name, uint16_t nsize){
     int rc;
     uint32_t utime = os_cputime_ticks_to_usecs(os_cputime_get32());
 
+#if MYNEWT_VAL(TELEMETRY_ENABLED)
+    cir_telemetry(cir, name, 0, cir->pmem.array, nsize);
+    return;
+#endif
+
     /* reset the state of the internal test */
     memset(&encoder, 0, sizeof(encoder));
     encoder.je_write = json_write;
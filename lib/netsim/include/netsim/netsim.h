@@ -0,0 +1,161 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file netsim.h
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Host network simulator of ccp, wcs and tdma
+ *
+ * @details Runs the ccp, wcs and tdma code of hundreds of nodes against a frame level radio model, in
+ * simulated time. Nodes sit on a grid, every crystal has its own offset and temperature ramp, frames are
+ * lost at random and collide when they overlap at a receiver. The relay tree comes from the ccp relay planner.
+ * Each node sends in its tdma slot every superframe, the sync error of its clock model, the timing error of
+ * its slot and slot overruns are scored against the master clock. See netsim.c.
+ */
+
+#ifndef _NETSIM_H_
+#define _NETSIM_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <dw1000/dw1000_dev.h>
+#include <ccp/ccp.h>
+
+#define NETSIM_ADDR_BASE 0x1000         //!< Short address of node 0, the clock master
+#define NETSIM_HIST_BINS 128            //!< Quarter octave bins from 1 ps
+
+//! Network scenario.
+typedef struct _netsim_config_t{
+    uint16_t nnodes;                //!< Nodes, node 0 is the clock master
+    uint16_t columns;               //!< Nodes per row of the grid
+    float spacing;                  //!< Grid spacing (m)
+    float range;                    //!< Link falls to MYNEWT_VAL(CCP_RELAY_MIN_RSSI) at this distance and is lost beyond (m)
+    float loss;                     //!< Probability a frame is lost on a link
+    float ppm;                      //!< Crystal offsets are drawn from +-ppm
+    float ramp;                     //!< Temperature ramps are drawn from +-ramp (ppm/s)
+    float ramp_start;               //!< Master time the ramps start (s)
+    float ramp_secs;                //!< Duration of the ramps (s)
+    float noise;                    //!< Standard deviation of the reception timestamps (dtu)
+    uint16_t tof_comp:1;            //!< Compensate ccp frames for time of flight, as tofdb would
+    uint16_t nslots;                //!< tdma slots per superframe
+    uint16_t frame_len;             //!< Length of the frame each node sends in its slot (bytes)
+    float guard;                    //!< The frame starts this long into its slot (usecs)
+    float threshold;                //!< A node has converged once its sync error stays within (nsecs)
+    float warmup;                   //!< Master time before sync and slot errors are scored (s)
+    uint32_t seed;                  //!< Random generator seed, nonzero
+}netsim_config_t;
+
+//! Distribution of an error.
+typedef struct _netsim_hist_t{
+    uint32_t n;                     //!< Samples
+    double sum;                     //!< Sum of the samples (ps)
+    double sum2;                    //!< Sum of the squared samples (ps^2)
+    double max;                     //!< Largest magnitude (ps)
+    uint32_t bins[NETSIM_HIST_BINS];//!< Magnitudes, bin k holds [2^(k/4), 2^((k+1)/4)) ps, the last bin everything above
+}netsim_hist_t;
+
+//! Network behaviour over the simulated time.
+typedef struct _netsim_report_t{
+    double secs;                    //!< Master time simulated (s)
+    uint32_t epochs;                //!< ccp frames sent by the master
+    uint16_t reachable;             //!< Nodes the relay planner placed, the master included
+    uint16_t relays;                //!< Nodes given a relay slot
+    uint8_t depth;                  //!< Deepest node placed
+    uint8_t relay_slots;            //!< Highest relay slot used
+    uint32_t relayed;               //!< ccp frames repeated by relays
+    uint32_t received;              //!< ccp frames taken as epochs
+    uint32_t lost;                  //!< ccp frame arrivals lost on the link
+    uint32_t collisions;            //!< ccp frame arrivals lost to overlapping frames
+    uint32_t holdover;              //!< Epochs extrapolated in holdover
+    uint32_t slots;                 //!< tdma slots sent
+    uint32_t skipped;               //!< tdma slots not sent for want of a valid epoch
+    uint32_t overruns;              //!< Slots whose frame left the slot, in master time
+    netsim_hist_t sync_error;       //!< Clock model against the master clock, at the slot instants
+    netsim_hist_t slot_error;       //!< Frame timing against the slot, in master time
+    uint16_t converged;             //!< Nodes whose sync error stayed within the threshold to the end
+    double convergence_mean;        //!< Mean time to converge of the converged nodes (s)
+    double convergence_max;         //!< Longest time to converge (s)
+}netsim_report_t;
+
+//! Node in range of another.
+typedef struct _netsim_link_t{
+    uint16_t idx;                   //!< Node
+    float rssi;                     //!< (dBm)
+}netsim_link_t;
+
+//! Simulated node.
+typedef struct _netsim_node_t{
+    struct _dw1000_dev_instance_t * inst;   //!< Device of the node, holds its ccp and tdma instances
+    float x, y;                     //!< Position (m)
+    double offset;                  //!< Local less master time at t = 0 (dtu)
+    float ppm;                      //!< Crystal offset before the ramp (ppm)
+    float ramp;                     //!< Temperature ramp (ppm/s)
+    uint16_t slot;                  //!< tdma slot
+    uint16_t nlinks;                //!< Nodes in range
+    netsim_link_t * links;          //!< Nodes in range, nearest first
+    uint16_t received:1;            //!< Took the epoch of the current ccp frame
+    uint16_t transmitting:1;        //!< Sending in the current group of frames
+    uint16_t hits;                  //!< Frames arriving in the current group
+    uint16_t from;                  //!< Group entry of the last arrival
+    double converged;               //!< Master time the sync error came within the threshold, negative when outside (s)
+}netsim_node_t;
+
+//! Frame on air.
+typedef struct _netsim_tx_t{
+    double time;                    //!< Master time of the RMARKER (dtu)
+    uint16_t idx;                   //!< Sender
+    ccp_frame_t frame;
+}netsim_tx_t;
+
+//! Simulator instance.
+typedef struct _netsim_instance_t{
+    netsim_config_t config;
+    netsim_report_t report;
+    ccp_relay_planner_t planner;
+    double time;                    //!< Master time of the current ccp frame (dtu)
+    uint64_t master_tx;             //!< Transmission timestamp of the master's last ccp frame
+    uint16_t first_slot;            //!< First tdma slot clear of the relay slots
+    uint32_t seed;                  //!< Random generator state
+    netsim_tx_t * tx;               //!< Frames pending in the current epoch
+    uint16_t ntx;
+    netsim_tx_t * group;            //!< Frames overlapping on air, being delivered
+    uint16_t ngroup;
+    uint16_t nnodes;
+    netsim_node_t nodes[];
+}netsim_instance_t;
+
+netsim_instance_t * netsim_init(struct _dw1000_dev_instance_t * inst, const netsim_config_t * config);
+void netsim_free(netsim_instance_t * sim);
+void netsim_run(netsim_instance_t * sim, double secs);
+double netsim_hist_quantile(const netsim_hist_t * hist, float q);
+double netsim_hist_rms(const netsim_hist_t * hist);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _NETSIM_H_ */
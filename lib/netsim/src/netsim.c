@@ -0,0 +1,696 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file netsim.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Host network simulator of ccp, wcs and tdma
+ *
+ * @details Time is kept as master time in dtu, the master's own clock less its offset, and advances a ccp
+ * period at a time with no timers or tasks involved, so hours of network time take seconds. The local clock of
+ * a node is its offset plus master time plus the integral of its crystal offset, which is constant but for a
+ * linear ramp. Each node has a device instance holding a ccp, wcs and tdma instance, only the radio is modelled:
+ *
+ * - The master frame follows dw1000_ccp_send(). Every node takes the first ccp frame it hears, stamped with its
+ *   local clock at the arrival plus gaussian noise, through dw1000_ccp_epoch() as rx_complete_cb() does, and
+ *   relays it as dw1000_ccp_relay_frame() decides. The clock model is then updated by wcs_update_cb().
+ * - Frames overlapping at a receiver are all lost, there is no capture. The slave listen window is not
+ *   modelled, a node hears any frame of the epoch.
+ * - Nodes missing an epoch extrapolate it with dw1000_ccp_holdover() as the slave timer does.
+ * - Nodes sit on a grid row by row, the master in the middle.
+ * - The neighbour tables are seeded from the geometry with ccp_relay_observe(), as a network flooding ccp frames
+ *   would fill them, nearest transmitters of least depth first. The relay planner then runs once on the reports.
+ * - Every node but the master sends a frame in its own tdma slot, past the relay slots, at tdma_tx_slot_start().
+ *
+ * Only one instance can run at a time, the tof compensation callback has no argument.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include <os/os.h>
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_mac.h>
+#include <dw1000/dw1000_phy.h>
+#include <ccp/ccp.h>
+#include <wcs/wcs.h>
+#include <tdma/tdma.h>
+#include <netsim/netsim.h>
+
+#if !MYNEWT_VAL(WCS_ENABLED) || !MYNEWT_VAL(CCP_RELAY_PLANNER_ENABLED)
+#error "netsim requires WCS_ENABLED and CCP_RELAY_PLANNER_ENABLED"
+#endif
+
+#define NETSIM_DTU MYNEWT_VAL(WCS_DTU_SI)      //!< dtu per second
+#define NETSIM_PS (1e12 / NETSIM_DTU)          //!< ps per dtu
+#define NETSIM_C 299702547.0                   //!< Speed of light in air (m/s)
+#define NETSIM_NFRAMES 2
+#define MASK40 0x0FFFFFFFFFFUL
+
+static netsim_instance_t * g_sim;
+static netsim_node_t * g_receiver;
+
+static uint32_t
+netsim_rand(netsim_instance_t * sim){
+    sim->seed ^= sim->seed << 13;
+    sim->seed ^= sim->seed >> 17;
+    sim->seed ^= sim->seed << 5;
+    return sim->seed;
+}
+
+//! Uniform on (0, 1)
+static double
+netsim_uniform(netsim_instance_t * sim){
+    return (netsim_rand(sim) + 1.0) / 4294967297.0;
+}
+
+static double
+netsim_gauss(netsim_instance_t * sim){
+    double u = netsim_uniform(sim);
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * netsim_uniform(sim));
+}
+
+//! Signed distance from b to a modulo 2^40
+static int64_t
+netsim_diff40(uint64_t a, uint64_t b){
+    return (int64_t)(((a - b) & MASK40) << 24) >> 24;
+}
+
+static float
+netsim_distance(netsim_node_t * a, netsim_node_t * b){
+    return hypotf(a->x - b->x, a->y - b->y);
+}
+
+//! Time of flight between two nodes (dtu)
+static double
+netsim_tof(netsim_node_t * a, netsim_node_t * b){
+    return netsim_distance(a, b) / NETSIM_C * NETSIM_DTU;
+}
+
+//! Crystal offset of a node at master time t (ppm)
+static double
+netsim_ppm(netsim_instance_t * sim, netsim_node_t * node, double t){
+    double ramp = t - sim->config.ramp_start;
+    ramp = (ramp < 0) ? 0 : (ramp > sim->config.ramp_secs) ? sim->config.ramp_secs : ramp;
+    return node->ppm + node->ramp * ramp;
+}
+
+//! Local clock of a node at master time (dtu), unbounded
+static double
+netsim_local(netsim_instance_t * sim, netsim_node_t * node, double time){
+    double t = time / NETSIM_DTU;
+    double a = sim->config.ramp_start;
+    double b = sim->config.ramp_secs;
+    // Integral of the ramp over [0, t]
+    double ramp = 0;
+    if (t > a + b)
+        ramp = b * b / 2 + b * (t - a - b);
+    else if (t > a)
+        ramp = (t - a) * (t - a) / 2;
+    return node->offset + time + 1e-6 * NETSIM_DTU * (node->ppm * t + node->ramp * ramp);
+}
+
+/**
+ * @fn netsim_time(netsim_instance_t * sim, netsim_node_t * node, uint64_t local, double near)
+ * @brief Master time at which the 40 bit local clock of a node reads local, the reading nearest to master
+ * time near. Inverts netsim_local() with a few Newton steps.
+ *
+ * @param sim    Pointer to netsim_instance_t.
+ * @param node   Pointer to netsim_node_t.
+ * @param local  Local 40 bit timestamp.
+ * @param near   Master time close to the result (dtu).
+ * @return master time (dtu)
+ */
+static double
+netsim_time(netsim_instance_t * sim, netsim_node_t * node, uint64_t local, double near){
+    double estimate = netsim_local(sim, node, near);
+    double target = estimate + netsim_diff40(local, (uint64_t) llround(estimate) & MASK40);
+    double time = near;
+    for (uint8_t i = 0; i < 3; i++)
+        time -= (netsim_local(sim, node, time) - target) / (1.0 + 1e-6 * netsim_ppm(sim, node, time / NETSIM_DTU));
+    return time;
+}
+
+static uint32_t
+netsim_tof_comp(uint16_t short_addr){
+    uint16_t idx = short_addr - NETSIM_ADDR_BASE;
+    assert(idx < g_sim->nnodes);
+    return (uint32_t) lround(netsim_tof(g_receiver, &g_sim->nodes[idx]));
+}
+
+static void
+netsim_hist_add(netsim_hist_t * hist, double value){
+    double a = fabs(value);
+    int bin = (a < 1.0) ? 0 : (int) floor(4 * log2(a));
+
+    hist->n++;
+    hist->sum += value;
+    hist->sum2 += value * value;
+    hist->max = (a > hist->max) ? a : hist->max;
+    hist->bins[(bin < NETSIM_HIST_BINS) ? bin : NETSIM_HIST_BINS - 1]++;
+}
+
+/**
+ * @fn netsim_hist_quantile(const netsim_hist_t * hist, float q)
+ * @brief Magnitude below which a fraction q of the samples lie, to the upper edge of its bin.
+ *
+ * @param hist  Pointer to netsim_hist_t.
+ * @param q     Fraction, 0 to 1.
+ * @return magnitude (ps), at most the largest magnitude seen
+ */
+double
+netsim_hist_quantile(const netsim_hist_t * hist, float q){
+    uint32_t target = (uint32_t) ceil(q * hist->n);
+    uint32_t count = 0;
+
+    for (uint16_t k = 0; k < NETSIM_HIST_BINS - 1; k++){
+        count += hist->bins[k];
+        if (count >= target && count > 0){
+            double edge = exp2((k + 1) / 4.0);
+            return (edge < hist->max) ? edge : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+/**
+ * @fn netsim_hist_rms(const netsim_hist_t * hist)
+ * @brief Root mean square of the samples.
+ *
+ * @param hist  Pointer to netsim_hist_t.
+ * @return rms (ps)
+ */
+double
+netsim_hist_rms(const netsim_hist_t * hist){
+    return (hist->n) ? sqrt(hist->sum2 / hist->n) : 0;
+}
+
+/**
+ * @fn netsim_node_init(netsim_instance_t * sim, uint16_t idx, struct _dw1000_dev_instance_t * device)
+ * @brief Builds the device of a node after the simulated device, and its ccp, wcs and tdma instances. The instances
+ * are set up as their init functions would, without the tasks, timers and mac callbacks, which the simulator
+ * stands in for.
+ *
+ * @param sim       Pointer to netsim_instance_t.
+ * @param idx       Node.
+ * @param device    Device whose configuration, phy attributes and antenna delays the node copies.
+ * @return void
+ */
+static void
+netsim_node_init(netsim_instance_t * sim, uint16_t idx, struct _dw1000_dev_instance_t * device){
+
+    netsim_node_t * node = &sim->nodes[idx];
+    dw1000_dev_instance_t * inst = (dw1000_dev_instance_t *) calloc(1, sizeof(dw1000_dev_instance_t));
+    assert(inst);
+    inst->idx = device->idx;
+    inst->task_prio = device->task_prio;
+    inst->my_short_address = NETSIM_ADDR_BASE + idx;
+    inst->euid = (device->euid & ~0xFFFFULL) | inst->my_short_address;
+    inst->tx_antenna_delay = device->tx_antenna_delay;
+    inst->rx_antenna_delay = device->rx_antenna_delay;
+    inst->config = device->config;
+    inst->attrib = device->attrib;
+    node->inst = inst;
+
+    dw1000_ccp_instance_t * ccp = (dw1000_ccp_instance_t *) calloc(1, sizeof(dw1000_ccp_instance_t) + NETSIM_NFRAMES * sizeof(ccp_frame_t *));
+    assert(ccp);
+    ccp->status.selfmalloc = 1;
+    ccp->nframes = NETSIM_NFRAMES;
+    for (uint16_t i = 0; i < ccp->nframes; i++){
+        ccp->frames[i] = (ccp_frame_t *) calloc(1, sizeof(ccp_frame_t));
+        assert(ccp->frames[i]);
+        ccp->frames[i]->fctrl = FCNTL_IEEE_BLINK_CCP_64;
+        ccp->frames[i]->rpt_max = MYNEWT_VAL(CCP_MAX_CASCADE_RPTS);
+    }
+    ccp->parent = inst;
+    inst->ccp = ccp;
+    ccp->period = MYNEWT_VAL(CCP_PERIOD);
+    ccp->config = (dw1000_ccp_config_t){
+        .role = (idx == 0) ? CCP_ROLE_MASTER : CCP_ROLE_SLAVE,
+        .tx_holdoff_dly = MYNEWT_VAL(CCP_RPT_HOLDOFF_DLY),
+    };
+    os_error_t err = os_sem_init(&ccp->sem, 0x1);
+    assert(err == OS_OK);
+    ccp->wcs = wcs_init(NULL, ccp);
+    // No json stream per node and epoch
+    ccp->wcs->config.postprocess = false;
+    dw1000_ccp_set_postprocess(ccp, &wcs_update_cb);
+    ccp->status.initialized = 1;
+
+    tdma_instance_t * tdma = (tdma_instance_t *) calloc(1, sizeof(tdma_instance_t) + sim->config.nslots * sizeof(tdma_slot_t *));
+    assert(tdma);
+    tdma->status.selfmalloc = 1;
+    tdma->parent = inst;
+    tdma->nslots = sim->config.nslots;
+    tdma->status.initialized = 1;
+    inst->tdma = tdma;
+
+    // The master sits mid grid, in place of the node there
+    uint16_t columns = sim->config.columns;
+    uint16_t centre = ((sim->nnodes + columns - 1) / columns / 2) * columns + columns / 2;
+    centre = (centre < sim->nnodes) ? centre : sim->nnodes - 1;
+    uint16_t cell = (idx == 0) ? centre : (idx == centre) ? 0 : idx;
+    node->x = (cell % columns) * sim->config.spacing;
+    node->y = (cell / columns) * sim->config.spacing;
+    node->offset = netsim_uniform(sim) * (double)(1ULL << 40);
+    if (idx != 0){
+        node->ppm = sim->config.ppm * (2 * netsim_uniform(sim) - 1);
+        node->ramp = sim->config.ramp * (2 * netsim_uniform(sim) - 1);
+    }
+    node->converged = -1;
+}
+
+static int
+netsim_link_cmp(const void * a, const void * b){
+    float ra = ((const netsim_link_t *) a)->rssi;
+    float rb = ((const netsim_link_t *) b)->rssi;
+    return (ra < rb) - (ra > rb);
+}
+
+/**
+ * @fn netsim_links(netsim_instance_t * sim)
+ * @brief Lists the nodes in range of each node, strongest first. Free space, the rssi falls to
+ * MYNEWT_VAL(CCP_RELAY_MIN_RSSI) at the configured range.
+ *
+ * @param sim  Pointer to netsim_instance_t.
+ * @return void
+ */
+static void
+netsim_links(netsim_instance_t * sim){
+
+    for (uint16_t i = 0; i < sim->nnodes; i++){
+        netsim_node_t * node = &sim->nodes[i];
+        node->links = (netsim_link_t *) calloc(sim->nnodes, sizeof(netsim_link_t));
+        assert(node->links);
+        for (uint16_t j = 0; j < sim->nnodes; j++){
+            float d = netsim_distance(node, &sim->nodes[j]);
+            if (j == i || d > sim->config.range)
+                continue;
+            node->links[node->nlinks++] = (netsim_link_t){
+                .idx = j,
+                .rssi = MYNEWT_VAL(CCP_RELAY_MIN_RSSI) + 20 * log10f(sim->config.range / d)
+            };
+        }
+        qsort(node->links, node->nlinks, sizeof(netsim_link_t), netsim_link_cmp);
+    }
+}
+
+/**
+ * @fn netsim_plan(netsim_instance_t * sim)
+ * @brief Seeds the neighbour tables, nearest transmitters of least depth first, as ccp frames flooded through
+ * the network would. The depth of a transmitter is its hop count from the master, the rpt_count of its frames.
+ * The relay planner then places the nodes from their reports and each node applies its assignment.
+ *
+ * @param sim  Pointer to netsim_instance_t.
+ * @return void
+ */
+static void
+netsim_plan(netsim_instance_t * sim){
+
+    uint8_t * depth = (uint8_t *) malloc(sim->nnodes);
+    uint16_t * queue = (uint16_t *) malloc(sim->nnodes * sizeof(uint16_t));
+    assert(depth && queue);
+    memset(depth, CCP_RELAY_DEPTH_INVALID, sim->nnodes);
+
+    uint16_t head = 0, tail = 0;
+    depth[0] = 0;
+    queue[tail++] = 0;
+    while (head < tail){
+        netsim_node_t * node = &sim->nodes[queue[head++]];
+        for (uint16_t l = 0; l < node->nlinks; l++){
+            uint16_t j = node->links[l].idx;
+            if (depth[j] == CCP_RELAY_DEPTH_INVALID){
+                depth[j] = depth[node - sim->nodes] + 1;
+                queue[tail++] = j;
+            }
+        }
+    }
+
+    ccp_relay_planner_init(&sim->planner, NETSIM_ADDR_BASE);
+    for (uint16_t i = 0; i < sim->nnodes; i++){
+        netsim_node_t * node = &sim->nodes[i];
+        uint16_t n = 0;
+        for (uint8_t d = 0; d <= MYNEWT_VAL(CCP_MAX_CASCADE_RPTS); d++){
+            for (uint16_t l = 0; l < node->nlinks && n < MYNEWT_VAL(CCP_RELAY_NEIGHBOURS); l++){
+                netsim_link_t * link = &node->links[l];
+                if (depth[link->idx] != d)
+                    continue;
+                ccp_relay_observe(node->inst->ccp, NETSIM_ADDR_BASE + link->idx, d, link->rssi);
+                n++;
+            }
+        }
+        ccp_relay_report_t report;
+        ccp_relay_report(node->inst->ccp, &report);
+        int rc = ccp_relay_planner_add(&sim->planner, &report);
+        assert(rc == OS_OK);
+    }
+    free(queue);
+    free(depth);
+
+    // Slots may run out, the relays left without one are reported as such
+    ccp_relay_plan(&sim->planner);
+
+    for (uint16_t i = 0; i < sim->nnodes; i++){
+        dw1000_ccp_instance_t * ccp = sim->nodes[i].inst->ccp;
+        const ccp_relay_assignment_t * assignment = ccp_relay_planner_get(&sim->planner, NETSIM_ADDR_BASE + i);
+        assert(assignment);
+        ccp_relay_apply(ccp, assignment);
+        // The simulator stands in for tofdb
+        dw1000_ccp_set_tof_comp_cb(ccp, (sim->config.tof_comp) ? netsim_tof_comp : NULL);
+        if (assignment->depth == CCP_RELAY_DEPTH_INVALID)
+            continue;
+        sim->report.reachable++;
+        sim->report.relays += (assignment->slot != 0);
+        sim->report.depth = (assignment->depth > sim->report.depth) ? assignment->depth : sim->report.depth;
+    }
+    sim->report.relay_slots = sim->planner.nslots;
+}
+
+/**
+ * @fn netsim_init(struct _dw1000_dev_instance_t * inst, const netsim_config_t * config)
+ * @brief Builds a network. The nodes copy the device configuration of inst, which is not otherwise used.
+ * tdma slots are handed out round robin from the first slot past the relay slots.
+ *
+ * @param inst    Pointer to _dw1000_dev_instance_t.
+ * @param config  Pointer to netsim_config_t.
+ * @return netsim_instance_t *
+ */
+netsim_instance_t *
+netsim_init(struct _dw1000_dev_instance_t * inst, const netsim_config_t * config){
+    assert(inst && config);
+    assert(config->nnodes > 1 && config->nnodes <= MYNEWT_VAL(CCP_RELAY_MAX_NODES));
+    assert(config->columns && config->nslots && config->seed);
+    assert(g_sim == NULL);
+
+    netsim_instance_t * sim = (netsim_instance_t *) calloc(1, sizeof(netsim_instance_t) + config->nnodes * sizeof(netsim_node_t));
+    assert(sim);
+    sim->config = *config;
+    sim->nnodes = config->nnodes;
+    sim->seed = config->seed;
+    sim->tx = (netsim_tx_t *) calloc(sim->nnodes, sizeof(netsim_tx_t));
+    sim->group = (netsim_tx_t *) calloc(sim->nnodes, sizeof(netsim_tx_t));
+    assert(sim->tx && sim->group);
+
+    for (uint16_t i = 0; i < sim->nnodes; i++)
+        netsim_node_init(sim, i, inst);
+    netsim_links(sim);
+    netsim_plan(sim);
+
+    double slot = (double)((uint64_t)MYNEWT_VAL(CCP_PERIOD) << 16) / config->nslots;
+    double relay = (MYNEWT_VAL(CCP_RELAY_SLOTS) + 1) * (double)((uint64_t)MYNEWT_VAL(CCP_RPT_HOLDOFF_DLY) << 16)
+                 + dw1000_phy_frame_duration(&inst->attrib, sizeof(ccp_blink_frame_t)) * NETSIM_DTU * 1e-6;
+    sim->first_slot = (uint16_t) ceil(relay / slot);
+    assert(sim->first_slot < config->nslots);
+    for (uint16_t i = 1; i < sim->nnodes; i++)
+        sim->nodes[i].slot = sim->first_slot + (i - 1) % (config->nslots - sim->first_slot);
+
+    sim->master_tx = (uint64_t) llround(sim->nodes[0].offset);
+    g_sim = sim;
+    return sim;
+}
+
+/**
+ * @fn netsim_free(netsim_instance_t * sim)
+ * @brief Frees the network.
+ *
+ * @param sim  Pointer to netsim_instance_t.
+ * @return void
+ */
+void
+netsim_free(netsim_instance_t * sim){
+    assert(sim);
+
+    for (uint16_t i = 0; i < sim->nnodes; i++){
+        dw1000_dev_instance_t * inst = sim->nodes[i].inst;
+        free(inst->tdma);
+        dw1000_ccp_free(inst->ccp);
+        free(inst);
+        free(sim->nodes[i].links);
+    }
+    free(sim->tx);
+    free(sim->group);
+    free(sim);
+    g_sim = NULL;
+}
+
+/**
+ * @fn netsim_receive(netsim_instance_t * sim, netsim_node_t * node, const netsim_tx_t * tx)
+ * @brief A node takes the epoch of a ccp frame, as rx_complete_cb() does with what the receiver reports, relays it
+ * if it is to and runs the postprocess callout.
+ *
+ * @param sim   Pointer to netsim_instance_t.
+ * @param node  Receiver.
+ * @param tx    Frame.
+ * @return void
+ */
+static void
+netsim_receive(netsim_instance_t * sim, netsim_node_t * node, const netsim_tx_t * tx){
+
+    dw1000_dev_instance_t * inst = node->inst;
+    dw1000_ccp_instance_t * ccp = inst->ccp;
+    netsim_node_t * sender = &sim->nodes[tx->idx];
+    double time = tx->time + netsim_tof(node, sender);
+    double t = time / NETSIM_DTU;
+
+    ccp_frame_t * frame = ccp->frames[(ccp->idx+1)%ccp->nframes];
+    memcpy(frame->array, tx->frame.array, sizeof(ccp_blink_frame_t));
+    double local = netsim_local(sim, node, time) + sim->config.noise * netsim_gauss(sim);
+    frame->reception_timestamp = (uint64_t) llround(local) & MASK40;
+    float ratio = (netsim_ppm(sim, sender, t) - netsim_ppm(sim, node, t)) * 1e-6f;
+    frame->carrier_integrator = lroundf(ratio / dw1000_calc_clock_offset_ratio(inst, 1));
+    frame->rxttcko = 0;
+
+    g_receiver = node;
+    dw1000_ccp_epoch(ccp, frame);
+    node->received = 1;
+    sim->report.received++;
+
+    ccp_frame_t tx_frame;
+    uint64_t dx_time;
+    if (dw1000_ccp_relay_frame(ccp, &tx_frame, &dx_time)){
+        netsim_tx_t * relay = &sim->tx[sim->ntx++];
+        relay->idx = node - sim->nodes;
+        relay->time = netsim_time(sim, node, (dx_time + inst->tx_antenna_delay) & MASK40, time);
+        relay->frame = tx_frame;
+        sim->report.relayed++;
+    }
+
+    if (ccp->config.postprocess && ccp->status.valid)
+        wcs_update_cb(&ccp->callout_postprocess.c_ev);
+}
+
+/**
+ * @fn netsim_deliver(netsim_instance_t * sim, double airtime)
+ * @brief Delivers the earliest pending ccp frame together with the frames overlapping it on air. A receiver
+ * takes a frame that arrives alone, more than one and they are all lost. Nodes sending or already holding the
+ * epoch do not listen.
+ *
+ * @param sim      Pointer to netsim_instance_t.
+ * @param airtime  ccp frame duration (dtu).
+ * @return void
+ */
+static void
+netsim_deliver(netsim_instance_t * sim, double airtime){
+
+    double start = sim->tx[0].time;
+    for (uint16_t i = 1; i < sim->ntx; i++)
+        start = (sim->tx[i].time < start) ? sim->tx[i].time : start;
+
+    uint16_t n = 0;
+    sim->ngroup = 0;
+    for (uint16_t i = 0; i < sim->ntx; i++){
+        if (sim->tx[i].time < start + airtime){
+            sim->group[sim->ngroup++] = sim->tx[i];
+            sim->nodes[sim->tx[i].idx].transmitting = 1;
+        }else
+            sim->tx[n++] = sim->tx[i];
+    }
+    sim->ntx = n;
+
+    for (uint16_t g = 0; g < sim->ngroup; g++){
+        netsim_node_t * sender = &sim->nodes[sim->group[g].idx];
+        for (uint16_t l = 0; l < sender->nlinks; l++){
+            netsim_node_t * node = &sim->nodes[sender->links[l].idx];
+            if (node->received || node->transmitting)
+                continue;
+            if (netsim_uniform(sim) < sim->config.loss){
+                sim->report.lost++;
+                continue;
+            }
+            node->hits++;
+            node->from = g;
+        }
+    }
+
+    for (uint16_t i = 0; i < sim->nnodes; i++){
+        netsim_node_t * node = &sim->nodes[i];
+        if (node->hits == 1)
+            netsim_receive(sim, node, &sim->group[node->from]);
+        else if (node->hits > 1)
+            sim->report.collisions += node->hits;
+        node->hits = 0;
+    }
+    for (uint16_t g = 0; g < sim->ngroup; g++)
+        sim->nodes[sim->group[g].idx].transmitting = 0;
+}
+
+/**
+ * @fn netsim_slot(netsim_instance_t * sim, netsim_node_t * node, bool valid)
+ * @brief A node sends in its tdma slot of the current superframe. The frame is timed with tdma_tx_slot_start()
+ * and the delayed start of the DW1000, which drops the low 9 bits. Its timing and the sync error of the clock model
+ * are scored in master time.
+ *
+ * @param sim    Pointer to netsim_instance_t.
+ * @param node   Pointer to netsim_node_t.
+ * @param valid  The node holds a valid epoch for the superframe.
+ * @return void
+ */
+static void
+netsim_slot(netsim_instance_t * sim, netsim_node_t * node, bool valid){
+
+    netsim_report_t * report = &sim->report;
+    dw1000_dev_instance_t * inst = node->inst;
+    double slot = (double)((uint64_t)MYNEWT_VAL(CCP_PERIOD) << 16) / sim->config.nslots;
+    double shr = dw1000_phy_SHR_duration(&inst->attrib) * NETSIM_DTU * 1e-6;
+    double airtime = dw1000_phy_frame_duration(&inst->attrib, sim->config.frame_len) * NETSIM_DTU * 1e-6;
+    double start = sim->time + node->slot * slot;
+    double lead = sim->config.guard * NETSIM_DTU * 1e-6 + shr;
+    double ideal = start + lead;
+    double t = ideal / NETSIM_DTU;
+    bool scored = t >= sim->config.warmup;
+
+    if (!valid){
+        node->converged = -1;
+        report->skipped += scored;
+        return;
+    }
+
+    uint64_t dx_time = tdma_tx_slot_start(inst, node->slot + (float)(lead / slot));
+    double rmarker = netsim_time(sim, node, ((dx_time & 0x0FFFFFFFE00UL) + inst->tx_antenna_delay) & MASK40, ideal);
+
+    uint64_t local = (uint64_t) llround(netsim_local(sim, node, ideal)) & MASK40;
+    uint64_t master = (uint64_t) llround(netsim_local(sim, &sim->nodes[0], ideal)) & MASK40;
+    double sync = netsim_diff40(wcs_local_to_master(inst->ccp->wcs, local), master) * NETSIM_PS;
+
+    if (fabs(sync) > sim->config.threshold * 1e3)
+        node->converged = -1;
+    else if (node->converged < 0)
+        node->converged = t;
+
+    if (!scored)
+        return;
+    report->slots++;
+    report->overruns += (rmarker - shr < start || rmarker - shr + airtime > start + slot);
+    netsim_hist_add(&report->sync_error, sync);
+    netsim_hist_add(&report->slot_error, (rmarker - ideal) * NETSIM_PS);
+}
+
+/**
+ * @fn netsim_epoch(netsim_instance_t * sim)
+ * @brief Runs one ccp period. The master sends its frame as dw1000_ccp_send() would, the frame and its relays
+ * are delivered, nodes that missed it go into holdover, then every node sends in its slot.
+ *
+ * @param sim  Pointer to netsim_instance_t.
+ * @return void
+ */
+static void
+netsim_epoch(netsim_instance_t * sim){
+
+    netsim_node_t * master = &sim->nodes[0];
+    dw1000_ccp_instance_t * ccp = master->inst->ccp;
+
+    uint64_t timestamp = sim->master_tx + ((uint64_t)ccp->period << 16);
+    uint64_t dx_time = timestamp & 0xFFFFFFFFFFFFFE00ULL;
+    sim->master_tx = dx_time + master->inst->tx_antenna_delay;
+    sim->time = netsim_time(sim, master, sim->master_tx & MASK40, sim->time + ((uint64_t)ccp->period << 16));
+
+    ccp_frame_t * frame = ccp->frames[(++ccp->idx)%ccp->nframes];
+    frame->rpt_count = 0;
+    frame->rpt_max = MYNEWT_VAL(CCP_MAX_CASCADE_RPTS);
+    frame->transmission_timestamp.timestamp = sim->master_tx;
+    frame->seq_num = ++ccp->seq_num;
+    frame->euid = master->inst->euid;
+    frame->short_address = master->inst->my_short_address;
+    frame->transmission_interval = ((uint64_t)ccp->period << 16);
+    ccp->local_epoch = sim->master_tx & MASK40;
+    sim->report.epochs++;
+
+    for (uint16_t i = 0; i < sim->nnodes; i++)
+        sim->nodes[i].received = 0;
+    master->received = 1;
+
+    sim->tx[0] = (netsim_tx_t){.time = sim->time, .idx = 0};
+    memcpy(sim->tx[0].frame.array, frame->array, sizeof(ccp_frame_t));
+    sim->ntx = 1;
+    double airtime = dw1000_phy_frame_duration(&master->inst->attrib, sizeof(ccp_blink_frame_t)) * NETSIM_DTU * 1e-6;
+    while (sim->ntx)
+        netsim_deliver(sim, airtime);
+
+    for (uint16_t i = 1; i < sim->nnodes; i++){
+        netsim_node_t * node = &sim->nodes[i];
+        dw1000_ccp_instance_t * slave = node->inst->ccp;
+        bool valid = node->received;
+#if MYNEWT_VAL(CCP_HOLDOVER_EPOCHS)
+        if (!node->received && slave->status.valid && !slave->status.rx_timeout_error){
+            // As the slave timer does on a window without a ccp frame
+            dw1000_ccp_holdover(node->inst);
+            valid = slave->holdover.active;
+            sim->report.holdover += valid;
+        }
+#endif
+        netsim_slot(sim, node, valid && slave->status.valid);
+    }
+}
+
+/**
+ * @fn netsim_run(netsim_instance_t * sim, double secs)
+ * @brief Runs the network for secs of master time and brings the report up to date.
+ *
+ * @param sim   Pointer to netsim_instance_t.
+ * @param secs  Master time to run (s).
+ * @return void
+ */
+void
+netsim_run(netsim_instance_t * sim, double secs){
+    assert(sim);
+
+    double end = sim->time + secs * NETSIM_DTU;
+    while (sim->time < end)
+        netsim_epoch(sim);
+
+    netsim_report_t * report = &sim->report;
+    report->secs = sim->time / NETSIM_DTU;
+    report->converged = 0;
+    report->convergence_mean = report->convergence_max = 0;
+    for (uint16_t i = 1; i < sim->nnodes; i++){
+        double converged = sim->nodes[i].converged;
+        if (converged < 0)
+            continue;
+        report->converged++;
+        report->convergence_mean += converged;
+        report->convergence_max = (converged > report->convergence_max) ? converged : report->convergence_max;
+    }
+    if (report->converged)
+        report->convergence_mean /= report->converged;
+}
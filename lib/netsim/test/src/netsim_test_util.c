@@ -0,0 +1,116 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file netsim_test_util.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Hours of ccp, wcs and tdma on a simulated network of hundreds of nodes
+ *
+ * @details A grid of nodes with the clock master in the middle, relayed as the ccp relay planner decides, with drifting
+ * crystals, a temperature ramp and frame loss, see netsim.c. The network is run for NETSIM_TEST_SECS of master time
+ * and its report printed as json. Clocks are tracked with the configured wcs filter, the timescale filter unless
+ * WCS_FLOAT_ESTIMATOR is set.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "netsim_test.h"
+
+static const netsim_config_t g_config = {
+    .nnodes = MYNEWT_VAL(NETSIM_TEST_NODES),
+    .columns = MYNEWT_VAL(NETSIM_TEST_COLUMNS),
+    .spacing = MYNEWT_VAL(NETSIM_TEST_SPACING),
+    .range = MYNEWT_VAL(NETSIM_TEST_RANGE),
+    .loss = MYNEWT_VAL(NETSIM_TEST_LOSS),
+    .ppm = MYNEWT_VAL(NETSIM_TEST_PPM),
+    .ramp = MYNEWT_VAL(NETSIM_TEST_RAMP),
+    .ramp_start = MYNEWT_VAL(NETSIM_TEST_RAMP_START),
+    .ramp_secs = MYNEWT_VAL(NETSIM_TEST_RAMP_SECS),
+    .noise = MYNEWT_VAL(NETSIM_TEST_NOISE),
+    .tof_comp = 1,
+    .nslots = MYNEWT_VAL(NETSIM_TEST_NSLOTS),
+    .frame_len = MYNEWT_VAL(NETSIM_TEST_FRAME_LEN),
+    .guard = MYNEWT_VAL(NETSIM_TEST_GUARD),
+    .threshold = MYNEWT_VAL(NETSIM_TEST_THRESHOLD),
+    .warmup = MYNEWT_VAL(NETSIM_TEST_WARMUP),
+    .seed = 0x2545F491
+};
+
+static void
+netsim_test_print(netsim_report_t * report, uint32_t usecs){
+    printf("{\"test\": \"netsim\", \"secs\": %d, \"wall_msecs\": %d, \"speedup\": %d, \"epochs\": %d, \"reachable\": %d, \"relays\": %d, "
+        "\"depth\": %d, \"relay_slots\": %d, \"relayed\": %d, \"received\": %d, \"lost\": %d, \"collisions\": %d, \"holdover\": %d}\n",
+        (int) report->secs, (int)(usecs / 1000), (int)(report->secs * 1e6 / (usecs + 1)), (int) report->epochs, report->reachable, report->relays,
+        report->depth, report->relay_slots, (int) report->relayed, (int) report->received, (int) report->lost,
+        (int) report->collisions, (int) report->holdover
+    );
+    printf("{\"test\": \"netsim\", \"sync_error_ps\": {\"p50\": %d, \"p90\": %d, \"p99\": %d, \"max\": %d, \"rms\": %d}, "
+        "\"slot_error_ps\": {\"mean\": %d, \"p99\": %d, \"max\": %d}}\n",
+        (int) netsim_hist_quantile(&report->sync_error, 0.5f), (int) netsim_hist_quantile(&report->sync_error, 0.9f),
+        (int) netsim_hist_quantile(&report->sync_error, 0.99f), (int) report->sync_error.max,
+        (int) netsim_hist_rms(&report->sync_error), (int)(report->slot_error.sum / report->slot_error.n),
+        (int) netsim_hist_quantile(&report->slot_error, 0.99f), (int) report->slot_error.max
+    );
+    printf("{\"test\": \"netsim\", \"slots\": %d, \"skipped\": %d, \"overruns\": %d, \"converged\": %d, "
+        "\"convergence_msecs\": {\"mean\": %d, \"max\": %d}}\n",
+        (int) report->slots, (int) report->skipped, (int) report->overruns, report->converged,
+        (int)(report->convergence_mean * 1000), (int)(report->convergence_max * 1000)
+    );
+}
+
+/*!
+ * The network runs for NETSIM_TEST_SECS. Every node is placed by the relay planner, sends in every superframe and
+ * converges, the sync error stays within bounds through the ramps and no slot overruns. The speed against real
+ * time is reported, not asserted, it depends on the load of the host.
+ */
+static void
+netsim_network_test(void){
+    netsim_instance_t * sim = netsim_init(hal_dw1000_inst(0), &g_config);
+    netsim_report_t * report = &sim->report;
+
+    uint32_t start = os_cputime_get32();
+    netsim_run(sim, MYNEWT_VAL(NETSIM_TEST_SECS));
+    uint32_t usecs = os_cputime_ticks_to_usecs(os_cputime_get32() - start);
+    netsim_test_print(report, usecs);
+
+    TEST_ASSERT(report->secs >= MYNEWT_VAL(NETSIM_TEST_SECS));
+    TEST_ASSERT(report->reachable == g_config.nnodes);
+    TEST_ASSERT(report->relays > 0 && report->depth > 1);
+    TEST_ASSERT(report->skipped == 0);
+    TEST_ASSERT(report->converged == g_config.nnodes - 1);
+    TEST_ASSERT(netsim_hist_quantile(&report->sync_error, 0.99f) <= MYNEWT_VAL(NETSIM_TEST_SYNC_P99) * 1e3);
+    TEST_ASSERT(report->overruns == 0);
+
+    netsim_free(sim);
+}
+
+void
+netsim_test_handler(void *arg)
+{
+    sysinit();
+
+    netsim_network_test();
+
+    tu_restart();
+}
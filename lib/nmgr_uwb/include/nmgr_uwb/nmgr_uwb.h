@@ -64,6 +64,12 @@ typedef union {
     uint8_t array[sizeof(struct _ieee_std_frame_t)];  //!< Array of size standard frame
 } nmgr_uwb_frame_header_t;
 
+//! User header of a request mbuf, the receiving instance and the frame header to address the response
+struct nmgr_uwb_usr_hdr{
+    uint8_t inst_idx;
+    nmgr_uwb_frame_header_t uwb_hdr;
+}__attribute__((__packed__,aligned(1)));
+
 typedef struct _nmgr_uwb_instance_t {
     struct _dw1000_dev_instance_t* parent;
     uint8_t frame_seq_num;
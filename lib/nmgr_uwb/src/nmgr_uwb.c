@@ -55,11 +55,6 @@
 #define DIAGMSG(s,u)
 #endif
 
-struct nmgr_uwb_usr_hdr{
-    uint8_t inst_idx;
-    nmgr_uwb_frame_header_t uwb_hdr;
-}__attribute__((__packed__,aligned(1)));
-
 static bool rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
 static bool tx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
 static bool rx_timeout_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
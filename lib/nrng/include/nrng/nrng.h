@@ -40,6 +40,15 @@ extern "C" {
 #include <rng/rng.h>
 #include <rng/slots.h>
 #endif
+#if MYNEWT_VAL(NRNG_GUARD_ENABLED)
+#include <nrng/nrng_guard.h>
+#endif
+
+#if MYNEWT_VAL(NRNG_NSLOTS) > 256
+#error "NRNG_NSLOTS exceeds the 8 bit slot id of the response frame"
+#endif
+#define NRNG_SLOT_WORDS SLOT_MAP_WORDS(MYNEWT_VAL(NRNG_NSLOTS))   //!< Words in a slot map
+#define NRNG_MAP_SIZE (NRNG_SLOT_WORDS * sizeof(uint32_t))          //!< Largest encoded slot map
 
 #if MYNEWT_VAL(NRNG_STATS)
     STATS_SECT_START(nrng_stat_section)
@@ -54,6 +63,7 @@ extern "C" {
     STATS_SECT_ENTRY(tx_error)
     STATS_SECT_ENTRY(start_tx_error)
     STATS_SECT_ENTRY(reset)
+    STATS_SECT_ENTRY(schedule_error)
 STATS_SECT_END
 
 #define NRNG_STATS_INC(__X) STATS_INC(inst->nrng->stat, __X)
@@ -71,6 +81,13 @@ typedef union {
     struct _nrng_request_frame_t{
         struct _ieee_rng_request_frame_t;
         struct _slot_payload_t; //!< slot bitfields for request
+#if MYNEWT_VAL(NRNG_GUARD_ENABLED)
+        uint16_t guard_delay;   //!< tx_guard_delay of the response schedule (UWB usec), 0 selects the responder default
+#endif
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+        uint8_t pcode_group;    //!< Responders per preamble code group, 0 keeps the channel code
+        uint8_t pcodes[MYNEWT_VAL(NRNG_PCODE_NCODES)]; //!< Preamble code of each group in turn, 0 for the channel code
+#endif
     }__attribute__((__packed__,aligned(1)));
     uint8_t array[sizeof(struct _nrng_request_frame_t)]; //!< Array of size nrng request frame
 } nrng_request_frame_t;
@@ -117,8 +134,9 @@ typedef struct _dw1000_nrng_instance_t{
 #endif
     uint16_t nframes;
     uint16_t nnodes;
-    uint16_t slot_mask;
-    uint16_t valid_mask;
+    uint32_t slot_mask[NRNG_SLOT_WORDS];        //!< Slots requested by the last request
+    uint16_t slot_rank[NRNG_SLOT_WORDS];        //!< Rank table of slot_mask, see slot_map_rank_table()
+    uint32_t valid_mask[NRNG_SLOT_WORDS];       //!< Slots with a valid response, see dw1000_nrng_get_ranges()
     uint16_t cell_id;
     uint16_t resp_count;
     uint16_t t1_final_flag;
@@ -131,19 +149,39 @@ typedef struct _dw1000_nrng_instance_t{
     dw1000_rng_control_t control;
     dw1000_rng_config_t config;
     uint16_t idx;
+    uint32_t exchange_usecs;                    //!< Request to completion time of the last exchange, in usec
+#if MYNEWT_VAL(NRNG_GUARD_ENABLED)
+    dw1000_nrng_guard_t guard;                  //!< Initiator guard tuning, see nrng_guard.c
+#endif
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+    uint8_t pcode_group;                        //!< Responders per preamble code group, 0 disables
+    uint8_t pcodes[MYNEWT_VAL(NRNG_PCODE_NCODES)]; //!< Preamble code of each group in turn
+    uint8_t pcode_active:1;                     //!< Responder tx code switched for the pending response
+    uint16_t pcode_next;                        //!< Initiator, first slot position of the group after the one listened to
+#endif
     nrng_frame_t * frames[];
 }dw1000_nrng_instance_t;
 
 dw1000_nrng_instance_t * dw1000_nrng_init(dw1000_dev_instance_t * inst, dw1000_rng_config_t * config, dw1000_nrng_device_type_t type, uint16_t nframes, uint16_t nnodes);
 dw1000_dev_status_t dw1000_nrng_request_delay_start(dw1000_dev_instance_t * inst, uint16_t dst_address, uint64_t delay, dw1000_rng_modes_t code, uint16_t start_slot_id, uint16_t end_slot_id);
 dw1000_dev_status_t dw1000_nrng_request(dw1000_dev_instance_t * inst, uint16_t dst_address, dw1000_rng_modes_t code, uint16_t start_slot_id, uint16_t end_slot_id);
+dw1000_dev_status_t dw1000_nrng_request_map(dw1000_dev_instance_t * inst, uint16_t dst_address, dw1000_rng_modes_t code, const uint32_t slot_map[], uint16_t cell_id);
+dw1000_dev_status_t dw1000_nrng_request_map_delay_start(dw1000_dev_instance_t * inst, uint16_t dst_address, uint64_t delay, dw1000_rng_modes_t code, const uint32_t slot_map[], uint16_t cell_id);
 float dw1000_nrng_twr_to_tof_frames(struct _dw1000_dev_instance_t * inst, nrng_frame_t *first_frame, nrng_frame_t *final_frame);
 void dw1000_nrng_set_frames(dw1000_dev_instance_t* inst, uint16_t nframes);
 dw1000_dev_status_t dw1000_nrng_config(struct _dw1000_dev_instance_t* inst, dw1000_rng_config_t * config);
 dw1000_rng_config_t * dw1000_nrng_get_config(dw1000_dev_instance_t * inst, dw1000_rng_modes_t code);
 dw1000_dev_status_t dw1000_nrng_listen(dw1000_dev_instance_t * inst, dw1000_dev_modes_t mode);
+nrng_frame_t * dw1000_nrng_get_frame(dw1000_dev_instance_t * inst, uint16_t slot, uint16_t base);
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+void dw1000_nrng_set_pcodes(dw1000_dev_instance_t * inst, uint8_t group, const uint8_t pcodes[]);
+uint8_t dw1000_nrng_pcode(const uint8_t pcodes[], uint8_t group, uint16_t idx);
+void dw1000_nrng_pcode_rx(dw1000_dev_instance_t * inst, uint16_t idx);
+uint16_t dw1000_nrng_pcode_timeout(dw1000_dev_instance_t * inst, dw1000_rng_config_t * config);
+#endif
 uint32_t dw1000_nrng_get_ranges(dw1000_dev_instance_t * inst, float ranges[], uint16_t nranges, uint16_t base);
 uint32_t usecs_to_response(dw1000_dev_instance_t * inst, uint16_t nslots, dw1000_rng_config_t * config, uint32_t duration);
+uint32_t dw1000_nrng_guard_delay(dw1000_dev_instance_t * inst, dw1000_rng_config_t * config);
 
 #ifdef __cplusplus
 }
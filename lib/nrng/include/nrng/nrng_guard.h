@@ -0,0 +1,74 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/**
+ * @file nrng_guard.h
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Self-tuning nrng response spacing
+ *
+ * @details The initiator measures the arrival jitter of the responses against their schedule and its own
+ * latency to rearm the receiver, and tightens the guard of its nrng instance towards what the exchange
+ * needs. The config shared by all instances keeps the syscfg default. The guard is carried in the request
+ * so responders follow it. An rx_error widens it back towards the default.
+ */
+
+#ifndef _NRNG_GUARD_H_
+#define _NRNG_GUARD_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <os/os.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <dw1000/dw1000_dev.h>
+#include <rng/rng.h>
+
+//! Guard tuning state of one nrng instance
+typedef struct _dw1000_nrng_guard_t{
+    dw1000_rng_config_t * config;           //!< Config whose responses are tuned, left untouched
+    uint32_t tx_guard_delay;                //!< Tuned guard of this instance (UWB usec)
+    uint32_t max_guard;                     //!< Upper bound, normally the syscfg default (UWB usec)
+    uint8_t seq_num;                        //!< Exchange being measured
+    uint16_t nsamples;                      //!< Responses received in this exchange
+    uint16_t ref_idx;                       //!< Slot position of the first response
+    uint64_t ref_timestamp;                 //!< Rx timestamp of the first response
+    uint32_t jitter;                        //!< Peak arrival error within this exchange (UWB usec)
+    uint32_t latency;                       //!< Peak rearm latency within this exchange (UWB usec)
+    uint32_t jitter_peak;                   //!< Decaying peak over exchanges (UWB usec)
+    uint32_t latency_peak;                  //!< Decaying peak over exchanges (UWB usec)
+    uint32_t nwiden;                        //!< Widening events
+}dw1000_nrng_guard_t;
+
+void dw1000_nrng_guard_init(dw1000_nrng_guard_t * guard, dw1000_rng_config_t * config);
+void dw1000_nrng_guard_sample(dw1000_dev_instance_t * inst, dw1000_nrng_guard_t * guard, uint16_t idx);
+void dw1000_nrng_guard_update(dw1000_nrng_guard_t * guard);
+void dw1000_nrng_guard_widen(dw1000_nrng_guard_t * guard);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _NRNG_GUARD_H_ */
@@ -74,6 +74,7 @@ STATS_NAME_START(nrng_stat_section)
     STATS_NAME(nrng_stat_section, tx_error)
     STATS_NAME(nrng_stat_section, start_tx_error)
     STATS_NAME(nrng_stat_section, reset)
+    STATS_NAME(nrng_stat_section, schedule_error)
 STATS_NAME_END(nrng_stat_section)
 #endif
 
@@ -191,40 +192,165 @@ dw1000_nrng_set_frames(dw1000_dev_instance_t * inst, uint16_t nframes){
         }
 }
 
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
 /**
- * API to configure dw1000 to start transmission after certain delay.
+ * @fn dw1000_nrng_set_pcodes(dw1000_dev_instance_t * inst, uint8_t group, const uint8_t pcodes[])
+ * @brief API to have responders answer on distinct preamble codes. Consecutive groups of responders in the
+ * response schedule take the codes in turn, and the initiator follows by switching its rx code at each group
+ * boundary. Responses stay in sequential slots as the initiator hears one code at a time, but exchanges of
+ * neighbouring cells with disjoint code sets no longer corrupt each other.
+ *
+ * @param inst      Pointer to dw1000_dev_instance_t.
+ * @param group     Responders per group, 0 keeps the channel code.
+ * @param pcodes    NRNG_PCODE_NCODES preamble codes, 0 for the channel code. The codes must suit the configured PRF.
+ *
+ * @return void
+ */
+void
+dw1000_nrng_set_pcodes(dw1000_dev_instance_t * inst, uint8_t group, const uint8_t pcodes[]){
+    assert(inst->nrng);
+    inst->nrng->pcode_group = group;
+    memcpy(inst->nrng->pcodes, pcodes, sizeof(inst->nrng->pcodes));
+}
+
+/**
+ * @fn dw1000_nrng_pcode(const uint8_t pcodes[], uint8_t group, uint16_t idx)
+ * @brief Help function for the preamble code of a slot position within the response schedule.
+ *
+ * @param pcodes    NRNG_PCODE_NCODES preamble codes.
+ * @param group     Responders per group.
+ * @param idx       Slot position.
+ *
+ * @return preamble code, 0 for the channel code
+ */
+uint8_t
+dw1000_nrng_pcode(const uint8_t pcodes[], uint8_t group, uint16_t idx){
+    if (group == 0)
+        return 0;
+    return pcodes[(idx / group) % MYNEWT_VAL(NRNG_PCODE_NCODES)];
+}
+
+/**
+ * @fn dw1000_nrng_pcode_rx(dw1000_dev_instance_t * inst, uint16_t idx)
+ * @brief API for the initiator to listen on the code of the group holding slot position idx, positions beyond
+ * the schedule restore the channel code. The code applies from the next receiver enable, so call it with the
+ * receiver idle: before the request, from rx_timeout_cb where the MAC has turned the receiver off, or once the
+ * exchange is over. Restart the listen with dw1000_start_rx().
+ *
+ * @param inst      Pointer to dw1000_dev_instance_t.
+ * @param idx       Slot position of the next expected response.
+ *
+ * @return void
+ */
+void
+dw1000_nrng_pcode_rx(dw1000_dev_instance_t * inst, uint16_t idx){
+    dw1000_nrng_instance_t * nrng = inst->nrng;
+    uint8_t code = (idx < nrng->nnodes) ? dw1000_nrng_pcode(nrng->pcodes, nrng->pcode_group, idx) : 0;
+
+    // First slot position of the following group
+    uint16_t next = nrng->pcode_group ? (idx / nrng->pcode_group + 1) * nrng->pcode_group : nrng->nnodes;
+    nrng->pcode_next = (idx < nrng->nnodes && next < nrng->nnodes) ? next : nrng->nnodes;
+
+    dw1000_set_preamble_code(inst, inst->config.tx.preambleCodeIndex, code ? code : inst->config.rx.preambleCodeIndex);
+}
+
+/**
+ * @fn pcode_timeout(dw1000_dev_instance_t * inst, dw1000_rng_config_t * config, uint32_t elapsed)
+ * @brief Help function for the rx timeout closing the current code group. Responses follow the schedule of the
+ * responders from the request RMARKER, a group ends half a guard before the preamble of the next group and the
+ * last group ends with the exchange.
+ *
+ * @param inst      Pointer to dw1000_dev_instance_t.
+ * @param config    Pointer to dw1000_rng_config_t.
+ * @param elapsed   Time since the request RMARKER (UWB usec).
+ *
+ * @return timeout in usec
+ */
+static uint16_t
+pcode_timeout(dw1000_dev_instance_t * inst, dw1000_rng_config_t * config, uint32_t elapsed){
+
+    dw1000_nrng_instance_t * nrng = inst->nrng;
+    uint32_t guard_delay = dw1000_nrng_guard_delay(inst, config);
+    uint32_t slot = guard_delay + dw1000_usecs_to_dwt_usecs(dw1000_phy_frame_duration(&inst->attrib, sizeof(nrng_response_frame_t)));
+    uint32_t end = config->tx_holdoff_delay + nrng->pcode_next * slot;
+
+    if (nrng->pcode_next < nrng->nnodes)
+        end -= dw1000_usecs_to_dwt_usecs(dw1000_phy_SHR_duration(&inst->attrib)) + guard_delay / 2;
+    else
+        end += config->rx_timeout_delay;   // TOF allowance.
+
+    int32_t timeout = (int32_t)(end - elapsed);
+    if (timeout < 1)
+        return 1;
+    return (timeout > UINT16_MAX) ? UINT16_MAX : timeout;
+}
+
+/**
+ * @fn dw1000_nrng_pcode_timeout(dw1000_dev_instance_t * inst, dw1000_rng_config_t * config)
+ * @brief API for the initiator to time its listen to the end of the current code group once the request is sent.
+ * The group boundary depends only on the schedule, missing responses do not delay the switch to the next code.
+ *
+ * @param inst      Pointer to dw1000_dev_instance_t.
+ * @param config    Pointer to dw1000_rng_config_t.
+ *
+ * @return timeout in usec, for dw1000_set_rx_timeout()
+ */
+uint16_t
+dw1000_nrng_pcode_timeout(dw1000_dev_instance_t * inst, dw1000_rng_config_t * config){
+    uint64_t elapsed = (dw1000_read_systime(inst) - dw1000_read_txtime(inst)) & 0x0FFFFFFFFFFULL;
+    return pcode_timeout(inst, config, elapsed >> 16);
+}
+#endif
+
+/**
+ * API to look up the response of a slot to the last request in constant time.
+ *
+ * @param inst          Pointer to dw1000_dev_instance_t. 
+ * @param slot          Slot id of the responder.
+ * @param base          base address of curcular buffer
+ *
+ * @return nrng_frame_t, NULL if the slot was not requested
+ */
+nrng_frame_t *
+dw1000_nrng_get_frame(dw1000_dev_instance_t * inst, uint16_t slot, uint16_t base){
+
+    dw1000_nrng_instance_t * nrng = inst->nrng;
+
+    if (slot >= 32 * NRNG_SLOT_WORDS || !slot_map_test(nrng->slot_mask, slot))
+        return NULL;
+    uint16_t idx = slot_map_rank_cached(nrng->slot_mask, nrng->slot_rank, slot);
+    return nrng->frames[(base + idx)%nrng->nframes];
+}
+
+/**
+ * API to collect the ranges of the last request. Ranges are returned in ascending slot order, the
+ * complete set of valid slots is left in nrng->valid_mask.
  *
  * @param inst          Pointer to dw1000_dev_instance_t. 
  * @param ranges        []] to return results  
- * @param nranges       side of  ranges[]
+ * @param nranges       side of  ranges[], slots at or beyond nranges are ignored
  * @param code          base address of curcular buffer
  *
- * @return valid mask
+ * @return valid mask of the first 32 slots
  */
 uint32_t
 dw1000_nrng_get_ranges(dw1000_dev_instance_t * inst, float ranges[], uint16_t nranges, uint16_t base){
 
     dw1000_nrng_instance_t * nrng = inst->nrng;
     uint32_t mask = 0;
-
-    // Which slots responded with a valid frames
-    for (uint16_t i=0; i < nranges; i++){
-        if (nrng->slot_mask & 1UL << i){
-            // the set of all requested slots
-            uint16_t idx = BitIndex(nrng->slot_mask, 1UL << i, SLOT_POSITION); 
-            nrng_frame_t * frame = nrng->frames[(base + idx)%nrng->nframes];
-            if (frame->code == DWT_SS_TWR_NRNG_FINAL && frame->seq_num == nrng->seq_num){
-                // the set of all positive responses
-                mask |= 1UL << i;
-            }
-        }
-    }
-    // Construct output vector 
-    uint16_t j = 0;
-    for (uint16_t i=0; i < nranges; i++){
-        if (mask & 1UL << i){
-            uint16_t idx = BitIndex(nrng->slot_mask, 1UL << i, SLOT_POSITION); 
-            nrng_frame_t * frame = nrng->frames[(base + idx)%nrng->nframes];
+    uint16_t idx = 0, j = 0;
+
+    memset(nrng->valid_mask, 0, sizeof(nrng->valid_mask));
+    // Requested slots respond in ascending order, the position within the map is the frame index
+    SLOT_MAP_FOREACH(nrng->slot_mask, NRNG_SLOT_WORDS, slot){
+        nrng_frame_t * frame = nrng->frames[(base + idx++)%nrng->nframes];
+        if (frame->code == DWT_SS_TWR_NRNG_FINAL && frame->seq_num == nrng->seq_num){
+            // the set of all positive responses
+            slot_map_set(nrng->valid_mask, slot);
+            if (slot >= nranges)
+                continue;
+            if (slot < 32)
+                mask |= 1UL << slot;
             ranges[j++] = dw1000_rng_tof_to_meters(dw1000_nrng_twr_to_tof_frames(nrng->parent, frame, frame));
         }
     }
@@ -346,36 +472,83 @@ dw1000_nrng_request_delay_start(dw1000_dev_instance_t * inst, uint16_t dst_addre
  */
 uint32_t
 usecs_to_response(dw1000_dev_instance_t * inst, uint16_t nslots, dw1000_rng_config_t * config, uint32_t duration){
-    uint32_t ret = nslots * ( duration + (uint32_t) dw1000_dwt_usecs_to_usecs(config->tx_guard_delay));
+    uint32_t ret = nslots * ( duration + (uint32_t) dw1000_dwt_usecs_to_usecs(dw1000_nrng_guard_delay(inst, config)));
     return ret;
 }
 
 /**
- * @fn dw1000_nrng_request(dw1000_dev_instance_t * inst, uint16_t dst_address, dw1000_rng_modes_t code, uint16_t slot_mask, uint16_t cell_id){
- * @brief API to initialise nrng request.
+ * @fn dw1000_nrng_guard_delay(dw1000_dev_instance_t * inst, dw1000_rng_config_t * config)
+ * @brief API to get the response guard in use. An initiator tuning the guard of config, see nrng_guard.c, uses its
+ * own tuned value, everything else uses config->tx_guard_delay.
+ *
+ * @param inst         Pointer to dw1000_dev_instance_t.
+ * @param config       Pointer to dw1000_rng_config_t.
+ *
+ * @return guard in UWB usec
+ */
+uint32_t
+dw1000_nrng_guard_delay(dw1000_dev_instance_t * inst, dw1000_rng_config_t * config){
+#if MYNEWT_VAL(NRNG_GUARD_ENABLED)
+    dw1000_nrng_instance_t * nrng = inst->nrng;
+    if (nrng->device_type == DWT_NRNG_INITIATOR && nrng->guard.config == config)
+        return nrng->guard.tx_guard_delay;
+#endif
+    return config->tx_guard_delay;
+}
+
+/**
+ * @fn response_timeout(dw1000_dev_instance_t * inst, dw1000_rng_config_t * config)
+ * @brief Help function to calculate the rx timeout covering the responses of nrng->nnodes slots.
  *
  * @param inst          Pointer to dw1000_dev_instance_t.
- * @param dst_address   Address of the receiver to whom range request to be sent.
- * @param code          Represents mode of ranging DWT_SS_TWR enables single sided two way ranging DWT_DS_TWR enables double sided
- * two way ranging DWT_DS_TWR_EXT enables double sided two way ranging with extended frame.
- * @param slot_mast     nrng_request_frame_t of masked slot number
- * @param cell_id       nrng_request_frame_t of cell id number
+ * @param config        Pointer to dw1000_rng_config_t.
  *
- * @return dw1000_dev_status_t
+ * @return timeout in usec
  */
-dw1000_dev_status_t
-dw1000_nrng_request(dw1000_dev_instance_t * inst, uint16_t dst_address, dw1000_rng_modes_t code, uint16_t slot_mask, uint16_t cell_id){
+static uint32_t
+response_timeout(dw1000_dev_instance_t * inst, dw1000_rng_config_t * config){
 
-    // This function executes on the device that initiates a request
-    assert(inst->nrng);
     dw1000_nrng_instance_t * nrng = inst->nrng;
 
-    os_error_t err = os_sem_pend(&nrng->sem,  OS_TIMEOUT_NEVER);
-    assert(err == OS_OK);
-    NRNG_STATS_INC(nrng_request);
+    return config->tx_holdoff_delay                     // Remote side turn arround time.
+            + usecs_to_response(inst,                   // Remaining timeout
+                nrng->nnodes,                           // no. of expected frames
+                config,
+                dw1000_phy_frame_duration(&inst->attrib, sizeof(nrng_response_frame_t)) // in usec
+            ) + config->rx_timeout_delay;               // TOF allowance.
+}
 
-    dw1000_rng_config_t * config = dw1000_nrng_get_config(inst, code);
-    nrng->nnodes = NumberOfBits(slot_mask); // Number of nodes involved in request
+/**
+ * @fn request_frame(dw1000_dev_instance_t * inst, uint16_t dst_address, dw1000_rng_modes_t code)
+ * @brief Help function to claim the request frame once nrng->slot_mask is set. The schedule is rejected when the
+ * responses overflow the frame pool, the 16 bit rx timeout or, with CCP_ENABLED, the superframe.
+ *
+ * @param inst          Pointer to dw1000_dev_instance_t.
+ * @param dst_address   Address of the receiver to whom range request to be sent.
+ * @param code          dw1000_rng_modes_t of the request.
+ *
+ * @return nrng_request_frame_t, NULL if the slot map does not fit
+ */
+static nrng_request_frame_t *
+request_frame(dw1000_dev_instance_t * inst, uint16_t dst_address, dw1000_rng_modes_t code){
+
+    dw1000_nrng_instance_t * nrng = inst->nrng;
+
+    nrng->nnodes = slot_map_rank_table(nrng->slot_mask, NRNG_SLOT_WORDS, nrng->slot_rank); // Number of nodes involved in request
+    uint32_t timeout = response_timeout(inst, dw1000_nrng_get_config(inst, code));
+    bool fits = nrng->nnodes < nrng->nframes && timeout <= UINT16_MAX;
+#if MYNEWT_VAL(CCP_ENABLED)
+    if (inst->ccp && inst->ccp->period)
+        fits = fits && timeout < (uint32_t)dw1000_dwt_usecs_to_usecs(inst->ccp->period);
+#endif
+    if (!fits){
+        // Split larger slot maps across requests
+        NRNG_STATS_INC(schedule_error);
+        nrng->status.schedule_error = 1;
+        nrng->nnodes = 0;
+        return NULL;
+    }
+    nrng->status.schedule_error = 0;
     nrng->idx += nrng->nnodes;
     nrng_request_frame_t * frame = (nrng_request_frame_t *) nrng->frames[nrng->idx%nrng->nframes];
 
@@ -383,28 +556,56 @@ dw1000_nrng_request(dw1000_dev_instance_t * inst, uint16_t dst_address, dw1000_r
     frame->code = code;
     frame->src_address = inst->my_short_address;
     frame->dst_address = dst_address;
-
-#if MYNEWT_VAL(CELL_ENABLED)
-    frame->ptype = PTYPE_CELL;
-    frame->cell_id = nrng->cell_id = cell_id;
-    frame->slot_mask = nrng->slot_mask = slot_mask;
-#else
-    frame->ptype = PTYPE_RANGE;
-    frame->end_slot_id = cell_id;
-    frame->start_slot_id = slot_mask;
+#if MYNEWT_VAL(NRNG_GUARD_ENABLED)
+    frame->guard_delay = dw1000_nrng_guard_delay(inst, dw1000_nrng_get_config(inst, code));
+#endif
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+    frame->pcode_group = nrng->pcode_group;
+    memcpy(frame->pcodes, nrng->pcodes, sizeof(frame->pcodes));
 #endif
+    return frame;
+}
 
-    dw1000_write_tx(inst, frame->array, 0, sizeof(nrng_request_frame_t));
-    dw1000_write_tx_fctrl(inst, sizeof(nrng_request_frame_t), 0);
+/**
+ * @fn request_abort(dw1000_dev_instance_t * inst)
+ * @brief Help function to give up a request whose slot map was rejected by request_frame().
+ *
+ * @param inst          Pointer to dw1000_dev_instance_t.
+ *
+ * @return dw1000_dev_status_t, start_tx_error set as the request was never sent
+ */
+static dw1000_dev_status_t
+request_abort(dw1000_dev_instance_t * inst){
+
+    os_error_t err = os_sem_release(&inst->nrng->sem);
+    assert(err == OS_OK);
+    inst->status.start_tx_error = 1;
+    return inst->status;
+}
+
+/**
+ * @fn request_start(dw1000_dev_instance_t * inst, dw1000_rng_modes_t code, uint16_t len, uint32_t utime)
+ * @brief Help function to transmit a request already written to the tx buffer and wait for the responses.
+ *
+ * @param inst          Pointer to dw1000_dev_instance_t.
+ * @param code          dw1000_rng_modes_t of the request.
+ * @param len           Length of the request frame, without the payload.
+ * @param utime         os_cputime at the start of the request.
+ *
+ * @return dw1000_dev_status_t
+ */
+static dw1000_dev_status_t
+request_start(dw1000_dev_instance_t * inst, dw1000_rng_modes_t code, uint16_t len, uint32_t utime){
+
+    dw1000_nrng_instance_t * nrng = inst->nrng;
+    dw1000_rng_config_t * config = dw1000_nrng_get_config(inst, code);
+
+    // Responses are slotted by their fixed length, only the broadcast request carries a payload
+    len += dw1000_rng_payload_write(inst, code, len);
+    dw1000_write_tx_fctrl(inst, len, 0);
     dw1000_set_wait4resp(inst, true);
 
-    uint16_t timeout = config->tx_holdoff_delay         // Remote side turn arround time.
-                        + usecs_to_response(inst,       // Remaining timeout
-                            nrng->nnodes,               // no. of expected frames
-                            config,
-                            dw1000_phy_frame_duration(&inst->attrib, sizeof(nrng_response_frame_t)) // in usec
-                        ) + config->rx_timeout_delay;     // TOF allowance.
-    dw1000_set_rx_timeout(inst, timeout);
+    dw1000_set_rx_timeout(inst, response_timeout(inst, config));  // Checked against UINT16_MAX in request_frame()
 
     if (nrng->control.delay_start_enabled)
         dw1000_set_delay_start(inst, nrng->delay); 
@@ -416,16 +617,28 @@ dw1000_nrng_request(dw1000_dev_instance_t * inst, uint16_t dst_address, dw1000_r
     if(inst->config.dblbuffon_enabled) 
         assert(inst->config.rxauto_enable == 0);
     //dw1000_set_dblrxbuff(inst, true);  
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+    dw1000_nrng_pcode_rx(inst, 0);  // Listen for the first group
+    if (nrng->pcode_group)          // The receiver turns on as the request ends
+        dw1000_set_rx_timeout(inst, pcode_timeout(inst, config,
+            dw1000_usecs_to_dwt_usecs(dw1000_phy_frame_duration(&inst->attrib, len) - dw1000_phy_SHR_duration(&inst->attrib))));
+#endif
     
     if (dw1000_start_tx(inst).start_tx_error){
         NRNG_STATS_INC(start_tx_error);
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+        dw1000_nrng_pcode_rx(inst, nrng->nnodes);
+#endif
         if (os_sem_get_count(&nrng->sem) == 0) {
-            err = os_sem_release(&nrng->sem);
+            os_error_t err = os_sem_release(&nrng->sem);
             assert(err == OS_OK);
         }
     }else{
-        err = os_sem_pend(&nrng->sem, OS_TIMEOUT_NEVER); // Wait for completion of transactions
+        os_error_t err = os_sem_pend(&nrng->sem, OS_TIMEOUT_NEVER); // Wait for completion of transactions
         assert(err == OS_OK);
+        // Failed exchanges end early on a timeout or error and would skew the figure
+        if (!(inst->status.start_rx_error || inst->status.rx_error || inst->status.rx_timeout_error))
+            nrng->exchange_usecs = os_cputime_ticks_to_usecs(os_cputime_get32() - utime);
         err = os_sem_release(&nrng->sem);
         assert(err == OS_OK);
     }
@@ -433,6 +646,125 @@ dw1000_nrng_request(dw1000_dev_instance_t * inst, uint16_t dst_address, dw1000_r
     return inst->status;
 }
 
+/**
+ * @fn dw1000_nrng_request(dw1000_dev_instance_t * inst, uint16_t dst_address, dw1000_rng_modes_t code, uint16_t slot_mask, uint16_t cell_id){
+ * @brief API to initialise nrng request.
+ *
+ * @param inst          Pointer to dw1000_dev_instance_t.
+ * @param dst_address   Address of the receiver to whom range request to be sent.
+ * @param code          Represents mode of ranging DWT_SS_TWR enables single sided two way ranging DWT_DS_TWR enables double sided
+ * two way ranging DWT_DS_TWR_EXT enables double sided two way ranging with extended frame.
+ * @param slot_mast     nrng_request_frame_t of masked slot number
+ * @param cell_id       nrng_request_frame_t of cell id number
+ *
+ * @return dw1000_dev_status_t
+ */
+dw1000_dev_status_t
+dw1000_nrng_request(dw1000_dev_instance_t * inst, uint16_t dst_address, dw1000_rng_modes_t code, uint16_t slot_mask, uint16_t cell_id){
+
+    // This function executes on the device that initiates a request
+    assert(inst->nrng);
+    dw1000_nrng_instance_t * nrng = inst->nrng;
+
+    os_error_t err = os_sem_pend(&nrng->sem,  OS_TIMEOUT_NEVER);
+    assert(err == OS_OK);
+    NRNG_STATS_INC(nrng_request);
+    uint32_t utime = os_cputime_get32();
+
+    memset(nrng->slot_mask, 0, sizeof(nrng->slot_mask));
+#if MYNEWT_VAL(CELL_ENABLED)
+    nrng->slot_mask[0] = slot_mask;
+    nrng_request_frame_t * frame = request_frame(inst, dst_address, code);
+    if (frame == NULL)
+        return request_abort(inst);
+    frame->ptype = PTYPE_CELL;
+    frame->cell_id = nrng->cell_id = cell_id;
+    frame->slot_mask = slot_mask;
+#else
+    // nnodes counts the bits of slot_mask as it always has. Responders test the whole bitfield, so callers
+    // must not set slots through cell_id (end_slot_id) and slot_mask bits 14, 15 do not reach the air.
+    nrng->slot_mask[0] = slot_mask;
+    nrng_request_frame_t * frame = request_frame(inst, dst_address, code);
+    if (frame == NULL)
+        return request_abort(inst);
+    frame->ptype = PTYPE_RANGE;
+    frame->end_slot_id = cell_id;
+    frame->start_slot_id = slot_mask;
+#endif
+
+    dw1000_write_tx(inst, frame->array, 0, sizeof(nrng_request_frame_t));
+    return request_start(inst, code, sizeof(nrng_request_frame_t), utime);
+}
+
+/**
+ * @fn dw1000_nrng_request_map(dw1000_dev_instance_t * inst, uint16_t dst_address, dw1000_rng_modes_t code, const uint32_t slot_map[], uint16_t cell_id)
+ * @brief API to initialise a nrng request to up to NRNG_NSLOTS slots. The slot map follows the request frame in its
+ * compact form, see slot_map_encode(), and responders answer in ascending slot order.
+ *
+ * @param inst          Pointer to dw1000_dev_instance_t.
+ * @param dst_address   Address of the receiver to whom range request to be sent.
+ * @param code          Represents mode of ranging.
+ * @param slot_map      NRNG_SLOT_WORDS words, bit n of word n/32 requests slot n.
+ * @param cell_id       Cell id, ignored by responders unless CELL_ENABLED.
+ *
+ * @return dw1000_dev_status_t
+ */
+dw1000_dev_status_t
+dw1000_nrng_request_map(dw1000_dev_instance_t * inst, uint16_t dst_address, dw1000_rng_modes_t code, const uint32_t slot_map[], uint16_t cell_id){
+
+    assert(inst->nrng);
+    dw1000_nrng_instance_t * nrng = inst->nrng;
+
+    os_error_t err = os_sem_pend(&nrng->sem,  OS_TIMEOUT_NEVER);
+    assert(err == OS_OK);
+    NRNG_STATS_INC(nrng_request);
+    uint32_t utime = os_cputime_get32();
+
+    memcpy(nrng->slot_mask, slot_map, sizeof(nrng->slot_mask));
+    nrng_request_frame_t * frame = request_frame(inst, dst_address, code);
+    if (frame == NULL)
+        return request_abort(inst);
+
+    uint8_t map[NRNG_MAP_SIZE];
+    bool rle;
+    uint16_t len = slot_map_encode(nrng->slot_mask, NRNG_SLOT_WORDS, map, sizeof(map), &rle);
+
+    frame->ptype = PTYPE_MAP;
+    frame->cell_id = nrng->cell_id = cell_id;
+    frame->map_rle = rle;
+    frame->map_len = len;
+
+    dw1000_write_tx(inst, frame->array, 0, sizeof(nrng_request_frame_t));
+    dw1000_write_tx(inst, map, sizeof(nrng_request_frame_t), len);
+    return request_start(inst, code, sizeof(nrng_request_frame_t) + len, utime);
+}
+
+/**
+ * @fn dw1000_nrng_request_map_delay_start(dw1000_dev_instance_t * inst, uint16_t dst_address, uint64_t delay, dw1000_rng_modes_t code, const uint32_t slot_map[], uint16_t cell_id)
+ * @brief API to start a slot map request after certain delay, see dw1000_nrng_request_map().
+ *
+ * @param inst          Pointer to dw1000_dev_instance_t.
+ * @param dst_address   Address of the receiver to whom range request to be sent.
+ * @param delay         Time until which request has to be resumed.
+ * @param code          Represents mode of ranging.
+ * @param slot_map      NRNG_SLOT_WORDS words, bit n of word n/32 requests slot n.
+ * @param cell_id       Cell id.
+ *
+ * @return dw1000_dev_status_t
+ */
+dw1000_dev_status_t
+dw1000_nrng_request_map_delay_start(dw1000_dev_instance_t * inst, uint16_t dst_address, uint64_t delay,
+                                dw1000_rng_modes_t code, const uint32_t slot_map[], uint16_t cell_id)
+{
+    dw1000_nrng_instance_t * nrng = inst->nrng;
+
+    nrng->control.delay_start_enabled = 1;
+    nrng->delay = delay;
+    dw1000_nrng_request_map(inst, dst_address, code, slot_map, cell_id);
+    nrng->control.delay_start_enabled = 0;
+
+    return inst->status;
+}
 
 /**
  * API to initialise range request.
@@ -532,7 +864,8 @@ complete_ev_cb(struct os_event *ev) {
 
     dw1000_dev_instance_t * inst = (dw1000_dev_instance_t *)ev->ev_arg;
     nrng_encode(inst->nrng, inst->nrng->seq_num, inst->nrng->idx);
-    inst->nrng->slot_mask = 0; 
+    memset(inst->nrng->slot_mask, 0, sizeof(inst->nrng->slot_mask));
+    memset(inst->nrng->slot_rank, 0, sizeof(inst->nrng->slot_rank));
 }
 
 struct os_callout nrng_callout;
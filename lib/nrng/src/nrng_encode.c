@@ -26,6 +26,16 @@
 #include <json/json.h>
 #include <dw1000/dw1000_mac.h>
 #include <nrng/nrng_encode.h>
+#if MYNEWT_VAL(TELEMETRY_ENABLED)
+#include <telemetry/telemetry.h>
+#endif
+
+#if MYNEWT_VAL(RNG_FILTER_ENABLED)
+#include <rng_filter/rng_filter.h>
+#if MYNEWT_VAL(WCS_ENABLED)
+#include <wcs/wcs.h>
+#endif
+#endif
 
 #if MYNEWT_VAL(NRNG_VERBOSE)
 
@@ -60,6 +70,47 @@ json_write(void *buf, char* data, int len) {
     return len;
 }
 
+#if MYNEWT_VAL(RNG_FILTER_ENABLED)
+/**
+ * Feeds the range of a responder to its filter, weighted by the line of sight likelihood of its
+ * response, and the carrier offset of the response as range-rate.
+ *
+ * @return false if the range was rejected and is not to be reported
+ */
+static bool
+nrng_filter(dw1000_nrng_instance_t * nrng, nrng_frame_t * frame){
+
+    dw1000_dev_instance_t * inst = nrng->parent;
+    float range = dw1000_rng_tof_to_meters(dw1000_nrng_twr_to_tof_frames(inst, frame, frame));
+    float los = (inst->config.rxdiag_enable) ?
+            dw1000_estimate_los(dw1000_calc_rssi(inst, &frame->diag), dw1000_calc_fppl(inst, &frame->diag)) : 1.0f;
+    rng_filter_result_t result;
+
+    if (rng_filter_update(frame->src_address, range, los, &result) != OS_OK || result.rejected)
+        return false;
+    if (frame->carrier_integrator){
+        float ratio = dw1000_calc_clock_offset_ratio(inst, frame->carrier_integrator);
+        // The oscillator offset is seeded from the clock model when there is one, else from the peer's carrier
+        float osc = ratio;
+#if MYNEWT_VAL(WCS_ENABLED)
+        if (inst->ccp->wcs->status.valid)
+            osc = -inst->ccp->wcs->skew;
+#endif
+        rng_filter_update_rate(frame->src_address, ratio, osc, NULL);
+    }
+    return true;
+}
+#endif
+
+static float
+nrng_range(dw1000_nrng_instance_t * nrng, nrng_frame_t * frame){
+#if MYNEWT_VAL(RNG_FILTER_ENABLED)
+    rng_filter_result_t result;
+    if (rng_filter_get(frame->src_address, &result) == OS_OK)
+        return result.range;
+#endif
+    return dw1000_rng_tof_to_meters(dw1000_nrng_twr_to_tof_frames(nrng->parent, frame, frame));
+}
 
 void
 nrng_encode(dw1000_nrng_instance_t * nrng, uint8_t seq_num, uint16_t base){
@@ -68,21 +119,64 @@ nrng_encode(dw1000_nrng_instance_t * nrng, uint8_t seq_num, uint16_t base){
     struct json_value value;
     int rc;
     uint32_t utime = os_cputime_ticks_to_usecs(os_cputime_get32());
-    uint32_t valid_mask = 0;
-
-    // Workout which slots responded with a valid frames
-    for (uint16_t i=0; i < 16; i++){
-        if (nrng->slot_mask & 1UL << i){
-            uint16_t idx = BitIndex(nrng->slot_mask, 1UL << i, SLOT_POSITION); 
-            nrng_frame_t * frame = nrng->frames[(base + idx)%nrng->nframes];
-            if (frame->code == DWT_SS_TWR_NRNG_FINAL && frame->seq_num == seq_num){
-                valid_mask |= 1UL << i;
-            }
-        }
+    uint16_t pos = 0;
+
+    // Workout which slots responded with a valid frames, responses are stored in ascending slot order
+    memset(nrng->valid_mask, 0, sizeof(nrng->valid_mask));
+    SLOT_MAP_FOREACH(nrng->slot_mask, NRNG_SLOT_WORDS, slot){
+        nrng_frame_t * frame = nrng->frames[(base + pos++)%nrng->nframes];
+        if (frame->code == DWT_SS_TWR_NRNG_FINAL && frame->seq_num == seq_num)
+            slot_map_set(nrng->valid_mask, slot);
     }
-    // tdoa results are reference to slot 0, so reject it slot 0 did not respond. An alternative approach is needed @Niklas
-    if (valid_mask == 0 || (valid_mask & 1) == 0) 
+    // tdoa results are reference to the first requested slot, so reject if it did not respond. An alternative approach is needed @Niklas
+    int32_t first = slot_map_next(nrng->slot_mask, NRNG_SLOT_WORDS, 0);
+    if (first < 0 || !slot_map_test(nrng->valid_mask, first))
        return;
+    nrng_frame_t * master = nrng->frames[(base)%nrng->nframes];
+
+#if MYNEWT_VAL(RNG_FILTER_ENABLED)
+    // Outliers are dropped from the report, the first slot still serves as tdoa reference
+    pos = 0;
+    SLOT_MAP_FOREACH(nrng->slot_mask, NRNG_SLOT_WORDS, slot){
+        nrng_frame_t * frame = nrng->frames[(base + pos++)%nrng->nframes];
+        if (slot_map_test(nrng->valid_mask, slot) && !nrng_filter(nrng, frame)) {
+            slot_map_clear(nrng->valid_mask, slot);
+            frame->code = DWT_SS_TWR_NRNG_EXT_END;
+        }
+    }
+#endif
+
+#if MYNEWT_VAL(TELEMETRY_ENABLED)
+    telemetry_nrng_slot_t slots[(UINT8_MAX - sizeof(telemetry_nrng_t)) / sizeof(telemetry_nrng_slot_t)];
+    telemetry_nrng_t record = {
+        .seq_num = seq_num,
+        .n = 0,
+        .flags = MYNEWT_VAL(NRNG_HUMAN_READABLE_RANGES) ? TELEMETRY_NRNG_MM : 0,
+        .mask_words = NRNG_SLOT_WORDS
+    };
+    const void * payload[] = {&record, slots};
+
+    pos = 0;
+    SLOT_MAP_FOREACH(nrng->slot_mask, NRNG_SLOT_WORDS, slot){
+        nrng_frame_t * frame = nrng->frames[(base + pos++)%nrng->nframes];
+        if (!slot_map_test(nrng->valid_mask, slot))
+            continue;
+        if (record.n == sizeof(slots)/sizeof(slots[0])) {
+            const uint8_t len[] = {sizeof(record), record.n * sizeof(telemetry_nrng_slot_t)};
+            record.flags |= TELEMETRY_MORE;
+            telemetry_writev(TELEMETRY_NRNG, payload, len, 2);
+            record.n = 0;
+        }
+        slots[record.n].slot = slot;
+        slots[record.n].range = nrng_range(nrng, frame);
+        slots[record.n++].tdoa = (int32_t)(master->reception_timestamp - frame->reception_timestamp);
+        frame->code = DWT_SS_TWR_NRNG_EXT_END;
+    }
+    const uint8_t len[] = {sizeof(record), record.n * sizeof(telemetry_nrng_slot_t)};
+    record.flags &= ~TELEMETRY_MORE;
+    telemetry_writev(TELEMETRY_NRNG, payload, len, 2);
+    return;
+#endif
 
     /* reset the state of the internal test */
     memset(&encoder, 0, sizeof(encoder));
@@ -98,41 +192,46 @@ nrng_encode(dw1000_nrng_instance_t * nrng, uint8_t seq_num, uint16_t base){
     JSON_VALUE_UINT(&value, seq_num);
     rc |= json_encode_object_entry(&encoder, "seq", &value);
 
-    JSON_VALUE_UINT(&value, valid_mask);
+#if NRNG_SLOT_WORDS == 1
+    JSON_VALUE_UINT(&value, nrng->valid_mask[0]);
     rc |= json_encode_object_entry(&encoder, "mask", &value);
+#else
+    rc |= json_encode_array_name(&encoder, "mask");
+    rc |= json_encode_array_start(&encoder);
+    for (uint16_t i=0; i < NRNG_SLOT_WORDS; i++){
+        JSON_VALUE_UINT(&value, nrng->valid_mask[i]);
+        rc |= json_encode_array_value(&encoder, &value);
+    }
+    rc |= json_encode_array_finish(&encoder);
+#endif
     rc |= json_encode_array_name(&encoder, "rng");
     rc |= json_encode_array_start(&encoder);
 
-    for (uint16_t i=0; i < 16; i++){
-        if (valid_mask & 1UL << i){
-            uint16_t idx = BitIndex(nrng->slot_mask, 1UL << i, SLOT_POSITION); 
-            nrng_frame_t * frame = nrng->frames[(base + idx)%nrng->nframes];
-            if (frame->code == DWT_SS_TWR_NRNG_FINAL && frame->seq_num == seq_num){
-                float range = dw1000_rng_tof_to_meters(dw1000_nrng_twr_to_tof_frames(nrng->parent, frame, frame));
+    pos = 0;
+    SLOT_MAP_FOREACH(nrng->slot_mask, NRNG_SLOT_WORDS, slot){
+        nrng_frame_t * frame = nrng->frames[(base + pos++)%nrng->nframes];
+        if (slot_map_test(nrng->valid_mask, slot)){
+            float range = nrng_range(nrng, frame);
 #if MYNEWT_VAL(NRNG_HUMAN_READABLE_RANGES)
-                JSON_VALUE_UINT(&value, (uint32_t)(range*1000));
+            JSON_VALUE_UINT(&value, (uint32_t)(range*1000));
 #else
-                JSON_VALUE_UINT(&value, *(uint32_t *)&range);
+            JSON_VALUE_UINT(&value, *(uint32_t *)&range);
 #endif
-                rc |= json_encode_array_value(&encoder, &value);
-                if (i%64==0) _json_fflush();
-            }
+            rc |= json_encode_array_value(&encoder, &value);
+            if (slot%64==0) _json_fflush();
         }
     }
     rc |= json_encode_array_finish(&encoder);
     rc |= json_encode_array_name(&encoder, "tdoa");
     rc |= json_encode_array_start(&encoder);
-    for (uint16_t i=0; i < 16; i++){
-        if (valid_mask & 1UL << i){
-            uint16_t idx = BitIndex(nrng->slot_mask , 1UL << i, SLOT_POSITION); 
-            nrng_frame_t * master = nrng->frames[(base)%nrng->nframes];
-            nrng_frame_t * frame = nrng->frames[(base + idx)%nrng->nframes];
-            if (frame->code == DWT_SS_TWR_NRNG_FINAL && frame->seq_num == seq_num){
-                JSON_VALUE_INT(&value, (int32_t)(master->reception_timestamp - frame->reception_timestamp));
-                rc |= json_encode_array_value(&encoder, &value);
-                if (i%64==0) _json_fflush();
-                frame->code = DWT_SS_TWR_NRNG_EXT_END;
-            }
+    pos = 0;
+    SLOT_MAP_FOREACH(nrng->slot_mask, NRNG_SLOT_WORDS, slot){
+        nrng_frame_t * frame = nrng->frames[(base + pos++)%nrng->nframes];
+        if (slot_map_test(nrng->valid_mask, slot)){
+            JSON_VALUE_INT(&value, (int32_t)(master->reception_timestamp - frame->reception_timestamp));
+            rc |= json_encode_array_value(&encoder, &value);
+            if (slot%64==0) _json_fflush();
+            frame->code = DWT_SS_TWR_NRNG_EXT_END;
         }
     }
     rc |= json_encode_array_finish(&encoder);
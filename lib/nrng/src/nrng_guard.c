@@ -0,0 +1,167 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/**
+ * @file nrng_guard.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Self-tuning nrng response spacing
+ *
+ * @details The static tx_guard_delay is sized for the worst case anchor. Responders schedule their
+ * response at tx_holdoff_delay + slot * (tx_guard_delay + frame duration) from the request, so the
+ * initiator knows when each response is due. For every exchange it records the largest deviation of the
+ * arrivals from that schedule, taken from the rx timestamps, and the largest latency from the rx interrupt
+ * at the end of a response to the point its handler returns, taken from os_cputime so the rx handler does no
+ * extra bus access. The guard converges to the decaying peak of their sum plus NRNG_GUARD_MARGIN, tightening
+ * by 1/8 of the difference per exchange and widening at once. The tuned guard is kept in the nrng instance of
+ * the initiator, the shared config keeps the syscfg default.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <os/os.h>
+
+#if MYNEWT_VAL(NRNG_GUARD_ENABLED)
+
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_phy.h>
+#include <dw1000/dw1000_mac.h>
+#include <rng/rng.h>
+#include <nrng/nrng.h>
+#include <nrng/nrng_guard.h>
+
+/**
+ * @fn dw1000_nrng_guard_init(dw1000_nrng_guard_t * guard, dw1000_rng_config_t * config)
+ * @brief API to attach guard tuning to a config, the current tx_guard_delay becomes the upper bound and the
+ * starting point. The config itself is never written.
+ *
+ * @param guard     Pointer to dw1000_nrng_guard_t.
+ * @param config    Pointer to dw1000_rng_config_t.
+ *
+ * @return void
+ */
+void
+dw1000_nrng_guard_init(dw1000_nrng_guard_t * guard, dw1000_rng_config_t * config){
+    assert(guard);
+    assert(config);
+
+    memset(guard, 0, sizeof(dw1000_nrng_guard_t));
+    guard->config = config;
+    guard->max_guard = guard->tx_guard_delay = config->tx_guard_delay;
+}
+
+/**
+ * @fn dw1000_nrng_guard_sample(dw1000_dev_instance_t * inst, dw1000_nrng_guard_t * guard, uint16_t idx)
+ * @brief API to record the arrival of a response, called by the initiator from the rx_complete_cb
+ * once the response is handled.
+ *
+ * @param inst      Pointer to dw1000_dev_instance_t.
+ * @param guard     Pointer to dw1000_nrng_guard_t.
+ * @param idx       Slot position of the response within the schedule.
+ *
+ * @return void
+ */
+void
+dw1000_nrng_guard_sample(dw1000_dev_instance_t * inst, dw1000_nrng_guard_t * guard, uint16_t idx){
+
+    dw1000_nrng_instance_t * nrng = inst->nrng;
+
+    if (guard->nsamples == 0 || guard->seq_num != nrng->seq_num) {
+        guard->seq_num = nrng->seq_num;
+        guard->nsamples = 0;
+        guard->ref_idx = idx;
+        guard->ref_timestamp = inst->rxtimestamp;
+        guard->jitter = guard->latency = 0;
+    } else if (idx > guard->ref_idx) {
+        uint64_t period = (uint64_t)guard->tx_guard_delay
+                + dw1000_usecs_to_dwt_usecs(dw1000_phy_frame_duration(&inst->attrib, sizeof(nrng_response_frame_t)));
+        int64_t error = (int64_t)((inst->rxtimestamp - guard->ref_timestamp) & 0xFFFFFFFFFFULL)
+                - (int64_t)(((idx - guard->ref_idx) * period) << 16);
+        uint32_t jitter = (uint32_t)(((error < 0) ? -error : error) >> 16) + 1;
+        if (jitter > guard->jitter)
+            guard->jitter = jitter;
+    }
+    guard->nsamples++;
+
+    // The receiver must be rearmed before the next preamble, the interrupt marks the end of this frame
+    uint32_t latency = dw1000_usecs_to_dwt_usecs(os_cputime_ticks_to_usecs(os_cputime_get32() - inst->irq_cputime));
+    if (latency > guard->latency)
+        guard->latency = latency;
+}
+
+/**
+ * @fn dw1000_nrng_guard_update(dw1000_nrng_guard_t * guard)
+ * @brief API to retune the guard at the end of an exchange, called by the initiator on completion.
+ * Exchanges with fewer than two responses carry no spacing information and are ignored.
+ *
+ * @param guard     Pointer to dw1000_nrng_guard_t.
+ *
+ * @return void
+ */
+void
+dw1000_nrng_guard_update(dw1000_nrng_guard_t * guard){
+
+    if (guard->nsamples < 2)
+        return;
+    guard->nsamples = 0;
+
+    guard->jitter_peak -= guard->jitter_peak / 16;
+    if (guard->jitter > guard->jitter_peak)
+        guard->jitter_peak = guard->jitter;
+    guard->latency_peak -= guard->latency_peak / 16;
+    if (guard->latency > guard->latency_peak)
+        guard->latency_peak = guard->latency;
+
+    uint32_t target = guard->jitter_peak + guard->latency_peak + MYNEWT_VAL(NRNG_GUARD_MARGIN);
+    if (target < MYNEWT_VAL(NRNG_GUARD_MIN))
+        target = MYNEWT_VAL(NRNG_GUARD_MIN);
+    if (target > guard->max_guard)
+        target = guard->max_guard;
+
+    uint32_t current = guard->tx_guard_delay;
+    if (target >= current)
+        current = target;
+    else
+        current -= (current - target + 7) / 8;
+    guard->tx_guard_delay = current;
+}
+
+/**
+ * @fn dw1000_nrng_guard_widen(dw1000_nrng_guard_t * guard)
+ * @brief API to widen the guard halfway back to the upper bound, called on rx_error since
+ * overlapping responses show up as frame errors.
+ *
+ * @param guard     Pointer to dw1000_nrng_guard_t.
+ *
+ * @return void
+ */
+void
+dw1000_nrng_guard_widen(dw1000_nrng_guard_t * guard){
+
+    uint32_t current = guard->tx_guard_delay;
+    guard->tx_guard_delay = current + (guard->max_guard - current + 1) / 2;
+    guard->nsamples = 0;
+    guard->nwiden++;
+}
+
+#endif
@@ -59,6 +59,9 @@ STATS_SECT_START(rng_stat_section)
     STATS_SECT_ENTRY(tx_error)
     STATS_SECT_ENTRY(rx_timeout)
     STATS_SECT_ENTRY(reset)
+    STATS_SECT_ENTRY(session_open)
+    STATS_SECT_ENTRY(session_full)
+    STATS_SECT_ENTRY(session_expired)
 STATS_SECT_END
 #endif
 
@@ -87,6 +90,10 @@ typedef enum _dw1000_rng_modes_t{
     DWT_SS_TWR_EXT_T1,               //!< Response for single sided TWR in extended mode
     DWT_SS_TWR_EXT_FINAL,            //!< Final response of single sided TWR in extended mode
     DWT_SS_TWR_EXT_END,              //!< End of single sided TWR in extended mode
+    DWT_SS_TWR_WCS,                  //!< Two message single sided TWR between WCS synchronized nodes
+    DWT_SS_TWR_WCS_T1,               //!< Response carrying master referenced timestamps
+    DWT_SS_TWR_WCS_RESULT,           //!< Compressed result broadcast
+    DWT_SS_TWR_WCS_END,              //!< End of two message single sided TWR
     DWT_DS_TWR = 0x20,                      //!< Double sided TWR 
     DWT_DS_TWR_T1,                   //!< Response for double sided TWR 
     DWT_DS_TWR_T2,                   //!< Response for double sided TWR 
@@ -131,6 +138,8 @@ typedef struct _dw1000_rng_status_t{
     uint16_t initialized:1;          //!< Instance allocated
     uint16_t mac_error:1;            //!< Error caused due to frame filtering
     uint16_t invalid_code_error:1;   //!< Error due to invalid code
+    uint16_t schedule_error:1;       //!< Requested slots do not fit the frames, the rx timeout or the superframe
+    uint16_t listening:1;            //!< dw1000_rng_listen() outstanding, requests may open sessions
 }dw1000_rng_status_t;
 
 //!  TWR final frame format
@@ -165,6 +174,30 @@ typedef union {
     uint8_t array[sizeof(struct _twr_frame_t)];        //!< Array of size twr_frame
 } twr_frame_t;
 
+//! Responder session context, one per interleaved exchange
+typedef struct _dw1000_rng_session_t{
+    uint16_t active:1;                      //!< Session in use
+    uint16_t code;                          //!< Code of the last frame received for this session
+    uint16_t addr;                          //!< Initiator short address
+    uint16_t seq_num;                       //!< Initiator sequence number
+    uint16_t idx;                           //!< rng->idx of the last frame received for this session
+    uint16_t prev_idx;                      //!< rng->idx of the frame before that
+    uint32_t expiry;                        //!< os_cputime at which the session is abandoned
+}dw1000_rng_session_t;
+
+//! Fills buf with TLV entries for a frame of the given code, returns the number of bytes used.
+typedef uint16_t (dw1000_rng_payload_producer_t)(struct _dw1000_dev_instance_t * inst, uint16_t code, uint8_t * buf, uint16_t len);
+//! Called for each TLV entry received from src_address.
+typedef void (dw1000_rng_payload_consumer_t)(struct _dw1000_dev_instance_t * inst, uint16_t src_address, uint8_t type, uint8_t * value, uint8_t len);
+
+//! Piggybacked application payload, a TLV area appended to the fixed part of ranging frames
+typedef struct _dw1000_rng_payload_t{
+    dw1000_rng_payload_producer_t * producer;   //!< TX side, NULL when disabled
+    dw1000_rng_payload_consumer_t * consumer;   //!< RX side, NULL when disabled
+    uint16_t len;                               //!< Maximum TLV area length in bytes
+    uint16_t usecs;                             //!< Airtime of a full TLV area, added to rx timeouts
+}dw1000_rng_payload_t;
+
 //! Structure of range instance
 typedef struct _dw1000_rng_instance_t{
     struct _dw1000_dev_instance_t * parent; //!< Structure of DW1000_dev_instance
@@ -180,6 +213,12 @@ typedef struct _dw1000_rng_instance_t{
     dw1000_rng_status_t status;             //!< Structure of range status
     uint16_t idx;                           //!< Indicates number of instances for the chosen bsp
     uint16_t nframes;                       //!< Number of buffers defined to store the ranging data
+    uint32_t exchange_usecs;                //!< Request to completion time of the last exchange, in usec
+    dw1000_rng_payload_t payload;           //!< Piggybacked application payload
+#if MYNEWT_VAL(RNG_NSESSIONS) > 1
+    dw1000_rng_session_t * session;         //!< Session of the frame at idx
+    dw1000_rng_session_t sessions[MYNEWT_VAL(RNG_NSESSIONS)]; //!< Session pool
+#endif
     twr_frame_t * frames[];                 //!< Pointer to twr buffers
 }dw1000_rng_instance_t;
 
@@ -198,6 +237,18 @@ float dw1000_rng_twr_to_tof(twr_frame_t *fframe, twr_frame_t *nframe);
 float dw1000_rng_twr_to_tof(dw1000_rng_instance_t * rng, uint16_t idx);
 #endif
 float dw1000_rng_tof_to_meters(float ToF);
+twr_frame_t * dw1000_rng_previous_frame(dw1000_rng_instance_t * rng);
+void dw1000_rng_set_payload(dw1000_dev_instance_t * inst, dw1000_rng_payload_producer_t * producer, dw1000_rng_payload_consumer_t * consumer, uint16_t budget);
+uint16_t dw1000_rng_payload_rx_usecs(dw1000_dev_instance_t * inst);
+bool dw1000_rng_payload_fits(dw1000_dev_instance_t * inst, uint16_t offset);
+uint16_t dw1000_rng_payload_write(dw1000_dev_instance_t * inst, uint16_t code, uint16_t offset);
+void dw1000_rng_payload_read(dw1000_dev_instance_t * inst, uint16_t offset);
+int dw1000_rng_tlv_put(uint8_t * buf, uint16_t len, uint16_t * offset, uint8_t type, const void * value, uint8_t vlen);
+#if MYNEWT_VAL(RNG_NSESSIONS) > 1
+dw1000_rng_session_t * dw1000_rng_session_find(dw1000_rng_instance_t * rng, uint16_t addr, uint16_t seq_num);
+void dw1000_rng_session_close(dw1000_rng_instance_t * rng, dw1000_rng_session_t * session);
+uint16_t dw1000_rng_sessions_active(dw1000_rng_instance_t * rng);
+#endif
 float dw1000_rng_is_los(float rssi, float fppl);
 
 float dw1000_rng_path_loss(float Pt, float G, float fc, float R);
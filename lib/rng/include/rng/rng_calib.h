@@ -0,0 +1,74 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/**
+ * @file rng_calib.h
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Turnaround calibration
+ *
+ * @details Measures the latency from the rx timestamp of a request to arming the delayed response and
+ * sets tx_holdoff_delay of the registered config to a percentile of that latency plus a margin. A
+ * start_tx_error backs the holdoff off. Rx timeouts spanning the remote turnaround keep the worst-case
+ * holdoff, see dw1000_rng_calib_max_holdoff(). Results are persisted through sys/config as rngcal/<name>.
+ * Only modes whose holdoff is private to a pair of nodes register. The nrng response schedule and the
+ * initiator's timeout assume one holdoff shared by every node, so nrng responders are not calibrated.
+ */
+
+#ifndef _RNG_CALIB_H_
+#define _RNG_CALIB_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <os/os.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <dw1000/dw1000_dev.h>
+#include <rng/rng.h>
+
+//! Calibration state of one dw1000_rng_config_t
+typedef struct _dw1000_rng_calib_t{
+    const char * name;                      //!< Config key, rngcal/<name>
+    dw1000_rng_config_t * config;           //!< Calibrated config
+    uint32_t max_holdoff;                   //!< Upper bound, normally the syscfg default (UWB usec)
+    uint16_t active:1;                      //!< Collecting samples
+    uint16_t nsamples;                      //!< Samples in hist
+    uint16_t hist[MYNEWT_VAL(RNG_CALIB_NBINS)]; //!< Latency histogram, RNG_CALIB_BIN wide bins
+    struct os_event save_ev;                //!< Persists the holdoff from the default eventq
+    SLIST_ENTRY(_dw1000_rng_calib_t) next;
+}dw1000_rng_calib_t;
+
+void dw1000_rng_calib_pkg_init(void);
+void dw1000_rng_calib_register(dw1000_rng_calib_t * calib);
+void dw1000_rng_calib_restart(dw1000_rng_calib_t * calib);
+void dw1000_rng_calib_sample(dw1000_dev_instance_t * inst, dw1000_rng_calib_t * calib);
+void dw1000_rng_calib_tx_error(dw1000_rng_calib_t * calib);
+uint32_t dw1000_rng_calib_max_holdoff(dw1000_rng_config_t * config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RNG_CALIB_H_ */
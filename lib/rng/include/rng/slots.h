@@ -32,6 +32,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -45,7 +46,8 @@ typedef enum _slot_mode_t{
 typedef enum _slot_ptype_t{     
     PTYPE_CELL=0,         //!< Cell network
     PTYPE_BITFIELD,       //!< single cell network
-    PTYPE_RANGE           //!< specify slots as a range
+    PTYPE_RANGE,          //!< specify slots as a range
+    PTYPE_MAP             //!< slot map of map_len bytes follows the frame, see slot_map_encode()
 }slot_ptype_t;
 
 typedef struct _slot_payload_t{
@@ -60,6 +62,11 @@ typedef struct _slot_payload_t{
             uint32_t start_slot_id:14;
             uint32_t end_slot_id:16;
         };
+        struct {
+            uint32_t :14;               //!< cell_id
+            uint32_t map_rle:1;         //!< Slot map is a list of runs, otherwise a bitmap
+            uint32_t map_len:15;        //!< Slot map length in bytes
+        };
     };
 }slot_payload_t;
 
@@ -67,6 +74,43 @@ uint32_t NumberOfBits(uint32_t bitfield);
 uint32_t BitIndex(uint32_t mask, uint32_t slot, slot_mode_t mode);
 uint32_t BitPosition(uint32_t n);
 
+//! Number of 32 bit words in a slot map of nslots
+#define SLOT_MAP_WORDS(nslots) (((nslots) + 31) / 32)
+
+//! Iterate over the set slots of a map in ascending order
+#define SLOT_MAP_FOREACH(map, nwords, slot) \
+    for (int32_t slot = slot_map_next(map, nwords, 0); slot >= 0; slot = slot_map_next(map, nwords, slot + 1))
+
+static inline bool
+slot_map_test(const uint32_t map[], uint16_t slot){
+    return (map[slot >> 5] >> (slot & 31)) & 1;
+}
+
+static inline void
+slot_map_set(uint32_t map[], uint16_t slot){
+    map[slot >> 5] |= 1UL << (slot & 31);
+}
+
+static inline void
+slot_map_clear(uint32_t map[], uint16_t slot){
+    map[slot >> 5] &= ~(1UL << (slot & 31));
+}
+
+//! Position of slot within the schedule in constant time, table from slot_map_rank_table()
+static inline uint16_t
+slot_map_rank_cached(const uint32_t map[], const uint16_t table[], uint16_t slot){
+    return table[slot >> 5] + __builtin_popcount(map[slot >> 5] & ((1UL << (slot & 31)) - 1));
+}
+
+uint16_t slot_map_count(const uint32_t map[], uint16_t nwords);
+uint16_t slot_map_rank(const uint32_t map[], uint16_t slot);
+uint16_t slot_map_rank_table(const uint32_t map[], uint16_t nwords, uint16_t table[]);
+int32_t slot_map_select(const uint32_t map[], const uint16_t table[], uint16_t nwords, uint16_t rank);
+int32_t slot_map_next(const uint32_t map[], uint16_t nwords, uint16_t from);
+uint16_t slot_map_encode(const uint32_t map[], uint16_t nwords, uint8_t buf[], uint16_t size, bool * rle);
+uint16_t slot_map_decode(const uint8_t buf[], uint16_t len, bool rle, uint32_t map[], uint16_t nwords);
+int32_t slot_map_position(const uint8_t buf[], uint16_t len, bool rle, uint16_t slot);
+
 #ifdef __cplusplus
 }
 #endif
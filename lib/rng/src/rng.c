@@ -51,6 +51,9 @@
 #if MYNEWT_VAL(RNG_ENABLED)
 #include <rng/rng.h>
 #include <rng/rng_encode.h>
+#if MYNEWT_VAL(RNG_CALIB_ENABLED)
+#include <rng/rng_calib.h>
+#endif
 #endif
 #if MYNEWT_VAL(TWR_SS_EXT_ENABLED)
 #include <twr_ss_ext/twr_ss_ext.h>
@@ -82,6 +85,9 @@ STATS_NAME_START(rng_stat_section)
     STATS_NAME(rng_stat_section, tx_error)
     STATS_NAME(rng_stat_section, rx_timeout)
     STATS_NAME(rng_stat_section, reset)
+    STATS_NAME(rng_stat_section, session_open)
+    STATS_NAME(rng_stat_section, session_full)
+    STATS_NAME(rng_stat_section, session_expired)
 STATS_NAME_END(rng_stat_section)
 
 #define RNG_STATS_INC(__X) STATS_INC(inst->rng->stat, __X)
@@ -98,6 +104,10 @@ static bool rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t
 static bool tx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
 static bool reset_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
 static bool rx_timeout_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
+#if MYNEWT_VAL(RNG_NSESSIONS) > 1
+static uint32_t sessions_expire(dw1000_dev_instance_t * inst, uint32_t now);
+#endif
+static uint16_t previous_idx(dw1000_rng_instance_t * rng, uint16_t idx);
 #if MYNEWT_VAL(RNG_VERBOSE)
 static bool complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
 #endif
@@ -124,67 +134,38 @@ static dw1000_rng_config_t g_config = {
     .rx_timeout_delay = MYNEWT_VAL(RNG_RX_TIMEOUT)       // Receive response timeout in usec
 };
 
+//! Every concurrent session holds a request and a response frame in the pool
+#define RNG_NFRAMES ((2 * MYNEWT_VAL(RNG_NSESSIONS) > 4) ? 2 * MYNEWT_VAL(RNG_NSESSIONS) : 4)
+
 #if MYNEWT_VAL(DW1000_DEVICE_0)
-static twr_frame_t g_twr_0[] = {
-    [0] = {
-        .fctrl = FCNTL_IEEE_RANGE_16,               // frame control (0x8841 to indicate a data frame using 16-bit addressing).
-        .PANID = MYNEWT_VAL(PANID),                 // PAN ID (0xDECA)
-        .code = DWT_TWR_INVALID
-    },
-    [1] = {
-        .fctrl = FCNTL_IEEE_RANGE_16,               // frame control (0x8841 to indicate a data frame using 16-bit addressing).
-        .PANID = MYNEWT_VAL(PANID),                 // PAN ID (0xDECA)
-        .code = DWT_TWR_INVALID,
-    },
-    [2] = {
+static twr_frame_t g_twr_0[RNG_NFRAMES] = {
+    [0 ... RNG_NFRAMES - 1] = {
         .fctrl = FCNTL_IEEE_RANGE_16,               // frame control (0x8841 to indicate a data frame using 16-bit addressing).
         .PANID = MYNEWT_VAL(PANID),                 // PAN ID (0xDECA)
         .code = DWT_TWR_INVALID
-    },
-    [3] = {
-        .fctrl = FCNTL_IEEE_RANGE_16,                // frame control (0x8841 to indicate a data frame using 16-bit addressing).
-        .PANID = MYNEWT_VAL(PANID),                  // PAN ID (0xDECA)
-        .code = DWT_TWR_INVALID,
     }
 };
+_Static_assert(sizeof(g_twr_0)/sizeof(twr_frame_t) >= 2 * MYNEWT_VAL(RNG_NSESSIONS), "g_twr_0 is short of RNG_NSESSIONS");
 #endif
 #if MYNEWT_VAL(DW1000_DEVICE_1)
-static twr_frame_t g_twr_1[] = {
-    [0] = {
-        .fctrl = FCNTL_IEEE_RANGE_16,                // frame control (0x8841 to indicate a data frame using 16-bit addressing).
-        .PANID = MYNEWT_VAL(PANID),                  // PAN ID (0xDECA)
-        .code = DWT_TWR_INVALID
-    },
-    [1] = {
-        .fctrl = FCNTL_IEEE_RANGE_16,                // frame control (0x8841 to indicate a data frame using 16-bit addressing).
-        .PANID = MYNEWT_VAL(PANID),                  // PAN ID (0xDECA)
-        .code = DWT_TWR_INVALID,
-    },
-    [2] = {
+static twr_frame_t g_twr_1[RNG_NFRAMES] = {
+    [0 ... RNG_NFRAMES - 1] = {
         .fctrl = FCNTL_IEEE_RANGE_16,                // frame control (0x8841 to indicate a data frame using 16-bit addressing).
         .PANID = MYNEWT_VAL(PANID),                  // PAN ID (0xDECA)
         .code = DWT_TWR_INVALID
-    },
-    [3] = {
-        .fctrl = FCNTL_IEEE_RANGE_16,                // frame control (0x8841 to indicate a data frame using 16-bit addressing).
-        .PANID = MYNEWT_VAL(PANID),                  // PAN ID (0xDECA)
-        .code = DWT_TWR_INVALID,
     }
 };
+_Static_assert(sizeof(g_twr_1)/sizeof(twr_frame_t) >= 2 * MYNEWT_VAL(RNG_NSESSIONS), "g_twr_1 is short of RNG_NSESSIONS");
 #endif
 #if MYNEWT_VAL(DW1000_DEVICE_2)
-static twr_frame_t g_twr_2[] = {
-    [0] = {
+static twr_frame_t g_twr_2[2 * MYNEWT_VAL(RNG_NSESSIONS)] = {
+    [0 ... 2 * MYNEWT_VAL(RNG_NSESSIONS) - 1] = {
         .fctrl = FCNTL_IEEE_RANGE_16,                // frame control (0x8841 to indicate a data frame using 16-bit addressing).
         .PANID = MYNEWT_VAL(PANID),                 // PAN ID (0xDECA)
         .code = DWT_TWR_INVALID
-    },
-    [1] = {
-        .fctrl = FCNTL_IEEE_RANGE_16,                // frame control (0x8841 to indicate a data frame using 16-bit addressing).
-        .PANID = MYNEWT_VAL(PANID),                 // PAN ID (0xDECA)
-        .code = DWT_TWR_INVALID,
     }
 };
+_Static_assert(sizeof(g_twr_2)/sizeof(twr_frame_t) >= 2 * MYNEWT_VAL(RNG_NSESSIONS), "g_twr_2 is short of RNG_NSESSIONS");
 #endif
 
 static dw1000_mac_interface_t g_cbs[] = {
@@ -326,7 +307,9 @@ rng_pkg_init(void){
     dw1000_rng_set_frames(hal_dw1000_inst(2), g_twr_2, sizeof(g_twr_2)/sizeof(twr_frame_t));
     dw1000_mac_append_interface(hal_dw1000_inst(2), &g_cbs[2]);
 #endif
-
+#if MYNEWT_VAL(RNG_CALIB_ENABLED)
+    dw1000_rng_calib_pkg_init();
+#endif
 }
 
 /**
@@ -385,6 +368,11 @@ dw1000_rng_get_config(dw1000_dev_instance_t * inst, dw1000_rng_modes_t code){
             config = twr_ss_config(inst);
             break;
 #endif
+#if MYNEWT_VAL(TWR_SS_WCS_ENABLED)
+        case  DWT_SS_TWR_WCS:                 //!< Two message single sided TWR
+            config = twr_ss_config(inst);
+            break;
+#endif
 #if MYNEWT_VAL(TWR_SS_EXT_ENABLED)
         case DWT_SS_TWR_EXT:
             config = twr_ss_ext_config(inst);  //!< Single side TWR in extended mode
@@ -424,13 +412,20 @@ dw1000_rng_request(dw1000_dev_instance_t * inst, uint16_t dst_address, dw1000_rn
     RNG_STATS_INC(rng_request);
     os_error_t err = os_sem_pend(&inst->rng->sem,  OS_TIMEOUT_NEVER);
     assert(err == OS_OK);
+    inst->rng->status.listening = 0;
+    uint32_t utime = os_cputime_get32();
 
+#if MYNEWT_VAL(TWR_SS_WCS_ENABLED)
+    // Responders can only reference their timestamps to the master once the timescale is valid
+    if (code == DWT_SS_TWR_WCS && !inst->ccp->wcs->status.valid)
+        code = DWT_SS_TWR;
+#endif
     dw1000_rng_config_t * config = dw1000_rng_get_config(inst, code);
 
     dw1000_rng_instance_t * rng = inst->rng;
     twr_frame_t * frame  = inst->rng->frames[(rng->idx+1)%rng->nframes];
 
-    if (code == DWT_SS_TWR || code == DWT_SS_TWR_EXT)
+    if (code == DWT_SS_TWR || code == DWT_SS_TWR_EXT || code == DWT_SS_TWR_WCS)
         rng->seq_num+=1;
     else
         rng->seq_num+=2;
@@ -445,13 +440,20 @@ dw1000_rng_request(dw1000_dev_instance_t * inst, uint16_t dst_address, dw1000_rn
     cir_enable(inst->cir, true);
 #endif
 
-    dw1000_write_tx(inst, frame->array, 0, sizeof(ieee_rng_request_frame_t));
-    dw1000_write_tx_fctrl(inst, sizeof(ieee_rng_request_frame_t), 0);
+    uint16_t len = sizeof(ieee_rng_request_frame_t);
+    dw1000_write_tx(inst, frame->array, 0, len);
+    len += dw1000_rng_payload_write(inst, code, len);
+    dw1000_write_tx_fctrl(inst, len, 0);
     dw1000_set_wait4resp(inst, true);    
    // dw1000_set_wait4resp_delay(inst, config->tx_holdoff_delay - dw1000_phy_SHR_duration(&inst->attrib));
     uint16_t timeout = dw1000_phy_frame_duration(&inst->attrib, sizeof(ieee_rng_response_frame_t))
+                    + dw1000_rng_payload_rx_usecs(inst)
                     + config->rx_timeout_delay // At least 2 * ToF, 1us ~= 300m
+#if MYNEWT_VAL(RNG_CALIB_ENABLED)
+                    + dw1000_rng_calib_max_holdoff(config);
+#else
                     + config->tx_holdoff_delay;
+#endif
 
     dw1000_set_rx_timeout(inst, timeout);
 
@@ -465,6 +467,9 @@ dw1000_rng_request(dw1000_dev_instance_t * inst, uint16_t dst_address, dw1000_rn
 
     err = os_sem_pend(&inst->rng->sem, OS_TIMEOUT_NEVER); // Wait for completion of transactions
     assert(err == OS_OK);
+    // Failed exchanges end early on a timeout or error and would skew the figure
+    if (!(inst->status.start_tx_error || inst->status.start_rx_error || inst->status.rx_error || inst->status.rx_timeout_error))
+        rng->exchange_usecs = os_cputime_ticks_to_usecs(os_cputime_get32() - utime);
     err = os_sem_release(&inst->rng->sem);
     assert(err == OS_OK);
 
@@ -485,6 +490,7 @@ dw1000_rng_listen(dw1000_dev_instance_t * inst, dw1000_dev_modes_t mode){
 
     os_error_t err = os_sem_pend(&inst->rng->sem,  OS_TIMEOUT_NEVER);
     assert(err == OS_OK);
+    inst->rng->status.listening = 1;
 
     // Download the CIR on the response    
 #if MYNEWT_VAL(CIR_ENABLED)   
@@ -493,6 +499,7 @@ dw1000_rng_listen(dw1000_dev_instance_t * inst, dw1000_dev_modes_t mode){
     
     RNG_STATS_INC(rng_listen);
     if(dw1000_start_rx(inst).start_rx_error){
+        inst->rng->status.listening = 0;
         err = os_sem_release(&inst->rng->sem);
         assert(err == OS_OK);
         RNG_STATS_INC(rx_error);
@@ -605,6 +612,10 @@ dw1000_rng_twr_to_tof(twr_frame_t *fframe, twr_frame_t *nframe){
             ToF = ((first_frame->response_timestamp - first_frame->request_timestamp)
                     -  (first_frame->transmission_timestamp - first_frame->reception_timestamp))/2.;
         break;
+        case DWT_SS_TWR_WCS ... DWT_SS_TWR_WCS_END:
+            ToF = ((first_frame->response_timestamp - first_frame->request_timestamp)
+                    -  (first_frame->transmission_timestamp - first_frame->reception_timestamp))/2.;
+        break;
         case DWT_DS_TWR ... DWT_DS_TWR_END:
         case DWT_DS_TWR_EXT ... DWT_DS_TWR_EXT_END:
             T1R = (first_frame->response_timestamp - first_frame->request_timestamp);
@@ -639,7 +650,7 @@ dw1000_rng_twr_to_tof(dw1000_rng_instance_t * rng, uint16_t idx){
 
     dw1000_dev_instance_t * inst = rng->parent;
 
-    twr_frame_t * first_frame = rng->frames[(uint16_t)(idx-1)%rng->nframes];
+    twr_frame_t * first_frame = rng->frames[previous_idx(rng, idx)%rng->nframes];
     twr_frame_t * frame = rng->frames[(idx)%rng->nframes];
 
     switch(frame->code){
@@ -655,6 +666,11 @@ dw1000_rng_twr_to_tof(dw1000_rng_instance_t * rng, uint16_t idx){
                     -  (frame->transmission_timestamp - frame->reception_timestamp) * (1.0f - skew))/2.;
             }
             break;
+        case DWT_SS_TWR_WCS ... DWT_SS_TWR_WCS_END:
+            // All four timestamps are already referenced to the master clock, no skew correction applies
+            ToF = ((frame->response_timestamp - frame->request_timestamp)
+                    -  (frame->transmission_timestamp - frame->reception_timestamp))/2.;
+            break;
         case DWT_DS_TWR ... DWT_DS_TWR_END:
         case DWT_DS_TWR_EXT ... DWT_DS_TWR_EXT_END:
             T1R = (first_frame->response_timestamp - first_frame->request_timestamp);
@@ -752,7 +768,18 @@ rx_timeout_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
     if(os_sem_get_count(&rng->sem) == 1)
         return false;
 
+#if MYNEWT_VAL(RNG_NSESSIONS) > 1
+    // Keep listening while other exchanges are still in flight
+    uint32_t remaining = sessions_expire(inst, os_cputime_get32());
+    if (remaining){
+        dw1000_set_rx_timeout(inst, (uint16_t)((remaining > 0xffff) ? 0xffff : remaining));
+        if (dw1000_start_rx(inst).start_rx_error == 0)
+            return true;
+    }
+#endif
+
     if(os_sem_get_count(&rng->sem) == 0){
+        rng->status.listening = 0;
         os_error_t err = os_sem_release(&rng->sem);
         assert(err == OS_OK);
         RNG_STATS_INC(rx_timeout);
@@ -797,6 +824,11 @@ rx_timeout_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
 static bool
 reset_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs){
 
+#if MYNEWT_VAL(RNG_NSESSIONS) > 1
+    memset(inst->rng->sessions, 0, sizeof(inst->rng->sessions));
+    inst->rng->session = NULL;
+#endif
+    inst->rng->status.listening = 0;
     if(os_sem_get_count(&inst->rng->sem) == 0){
         os_error_t err = os_sem_release(&inst->rng->sem);
         assert(err == OS_OK);
@@ -807,6 +839,202 @@ reset_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs){
         return false;
 }
 
+/**
+ * @fn previous_idx(dw1000_rng_instance_t * rng, uint16_t idx)
+ * @brief Index of the frame preceding idx within the same exchange. Sessions keep their indices after they
+ * close, so the session that received idx still identifies its pair until it is reused.
+ *
+ * @param rng   Pointer to dw1000_rng_instance_t.
+ * @param idx   Position of rng frame.
+ *
+ * @return index of the preceding frame
+ */
+static uint16_t
+previous_idx(dw1000_rng_instance_t * rng, uint16_t idx){
+#if MYNEWT_VAL(RNG_NSESSIONS) > 1
+    for (uint16_t i = 0; i < MYNEWT_VAL(RNG_NSESSIONS); i++){
+        dw1000_rng_session_t * session = &rng->sessions[i];
+        if (session->idx == idx && session->prev_idx != idx)
+            return session->prev_idx;
+    }
+#endif
+    return (uint16_t)(idx-1);
+}
+
+/**
+ * @fn dw1000_rng_previous_frame(dw1000_rng_instance_t * rng)
+ * @brief API to access the frame preceding rng->idx within the same exchange. With RNG_NSESSIONS > 1
+ * exchanges interleave in rng->frames and the preceding frame is tracked by the session.
+ *
+ * @param rng   Pointer to dw1000_rng_instance_t.
+ *
+ * @return twr_frame_t
+ */
+twr_frame_t *
+dw1000_rng_previous_frame(dw1000_rng_instance_t * rng){
+    return rng->frames[previous_idx(rng, rng->idx)%rng->nframes];
+}
+
+#if MYNEWT_VAL(RNG_NSESSIONS) > 1
+/**
+ * @fn dw1000_rng_session_find(dw1000_rng_instance_t * rng, uint16_t addr, uint16_t seq_num)
+ * @brief API to look up the active session of an initiator.
+ *
+ * @param rng       Pointer to dw1000_rng_instance_t.
+ * @param addr      Initiator short address.
+ * @param seq_num   Sequence number of the exchange.
+ *
+ * @return dw1000_rng_session_t, NULL if not found
+ */
+dw1000_rng_session_t *
+dw1000_rng_session_find(dw1000_rng_instance_t * rng, uint16_t addr, uint16_t seq_num){
+    for (uint16_t i = 0; i < MYNEWT_VAL(RNG_NSESSIONS); i++){
+        dw1000_rng_session_t * session = &rng->sessions[i];
+        if (session->active && session->addr == addr && session->seq_num == seq_num)
+            return session;
+    }
+    return NULL;
+}
+
+/**
+ * @fn dw1000_rng_session_close(dw1000_rng_instance_t * rng, dw1000_rng_session_t * session)
+ * @brief API to return a session to the pool.
+ *
+ * @param rng       Pointer to dw1000_rng_instance_t.
+ * @param session   Pointer to dw1000_rng_session_t.
+ *
+ * @return void
+ */
+void
+dw1000_rng_session_close(dw1000_rng_instance_t * rng, dw1000_rng_session_t * session){
+    assert(session);
+    session->active = 0;
+}
+
+/**
+ * @fn dw1000_rng_sessions_active(dw1000_rng_instance_t * rng)
+ * @brief API to count sessions in flight.
+ *
+ * @param rng   Pointer to dw1000_rng_instance_t.
+ *
+ * @return number of active sessions
+ */
+uint16_t
+dw1000_rng_sessions_active(dw1000_rng_instance_t * rng){
+    uint16_t n = 0;
+    for (uint16_t i = 0; i < MYNEWT_VAL(RNG_NSESSIONS); i++)
+        n += rng->sessions[i].active;
+    return n;
+}
+
+/**
+ * @fn sessions_expire(dw1000_dev_instance_t * inst, uint32_t now)
+ * @brief Closes sessions past their expiry.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ * @param now   Current os_cputime.
+ *
+ * @return usecs until the last remaining session expires, 0 if none remain
+ */
+static uint32_t
+sessions_expire(dw1000_dev_instance_t * inst, uint32_t now){
+    dw1000_rng_instance_t * rng = inst->rng;
+    int32_t remaining = 0;
+    for (uint16_t i = 0; i < MYNEWT_VAL(RNG_NSESSIONS); i++){
+        dw1000_rng_session_t * session = &rng->sessions[i];
+        if (!session->active)
+            continue;
+        int32_t dt = (int32_t)(session->expiry - now);
+        if (dt <= 0){
+            session->active = 0;
+            RNG_STATS_INC(session_expired);
+        }else if (dt > remaining)
+            remaining = dt;
+    }
+    return (remaining) ? os_cputime_ticks_to_usecs(remaining) : 0;
+}
+
+/**
+ * @fn session_accept(dw1000_dev_instance_t * inst)
+ * @brief Matches an inbound ranging frame to its session. Requests open a session from the pool while a
+ * dw1000_rng_listen() is outstanding, the frame after which the responder expects nothing more (SS final,
+ * DS T2) closes it.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ *
+ * @return dw1000_rng_session_t, NULL if the frame belongs to no session
+ */
+static dw1000_rng_session_t *
+session_accept(dw1000_dev_instance_t * inst){
+
+    dw1000_rng_instance_t * rng = inst->rng;
+    ieee_rng_request_frame_t * frame = (ieee_rng_request_frame_t *) inst->rxbuf;
+    dw1000_rng_session_t * session = NULL;
+    uint32_t now = os_cputime_get32();
+
+    // Frames rx_complete_cb drops must not open a session, it would linger until RNG_SESSION_TIMEOUT
+    if (inst->frame_len < sizeof(ieee_rng_request_frame_t) || inst->frame_len > sizeof(twr_frame_t)
+        || frame->dst_address != inst->my_short_address)
+        return NULL;
+
+    sessions_expire(inst, now);
+    switch(frame->code){
+        case DWT_SS_TWR:
+        case DWT_SS_TWR_EXT:
+        case DWT_SS_TWR_WCS:
+        case DWT_DS_TWR:
+        case DWT_DS_TWR_EXT:
+            session = dw1000_rng_session_find(rng, frame->src_address, frame->seq_num);
+            // New initiators are only taken on while the application has a listen outstanding
+            if (session == NULL && !(rng->status.listening && os_sem_get_count(&rng->sem) == 0))
+                return NULL;
+            for (uint16_t i = 0; session == NULL && i < MYNEWT_VAL(RNG_NSESSIONS); i++){
+                if (!rng->sessions[i].active){
+                    session = &rng->sessions[i];
+                    *session = (dw1000_rng_session_t){
+                        .active = 1,
+                        .addr = frame->src_address,
+                        .seq_num = frame->seq_num,
+                        .idx = (uint16_t)(rng->idx + 1),
+                        .prev_idx = (uint16_t)(rng->idx + 1)
+                    };
+                    RNG_STATS_INC(session_open);
+                }
+            }
+            if (session == NULL){
+                RNG_STATS_INC(session_full);
+                return NULL;
+            }
+            break;
+        default:
+            if (frame->code < DWT_SS_TWR || frame->code > DWT_DS_TWR_EXT_END)
+                return NULL;
+            session = dw1000_rng_session_find(rng, frame->src_address, frame->seq_num);
+            if (session == NULL)    // DS initiators advance seq_num on T2
+                session = dw1000_rng_session_find(rng, frame->src_address, (uint8_t)(frame->seq_num - 1));
+            if (session == NULL)
+                return NULL;
+            break;
+    }
+    session->code = frame->code;
+    session->expiry = now + os_cputime_usecs_to_ticks(MYNEWT_VAL(RNG_SESSION_TIMEOUT));
+
+    switch(frame->code){
+        case DWT_SS_TWR_FINAL:
+        case DWT_SS_TWR_EXT_FINAL:
+        case DWT_SS_TWR_WCS:
+        case DWT_DS_TWR_T2:
+        case DWT_DS_TWR_EXT_T2:
+            // Nothing further is expected from the initiator, the frame index stays valid for this event
+            dw1000_rng_session_close(rng, session);
+            break;
+        default:
+            break;
+    }
+    return session;
+}
+#endif
+
 /**
  * @fn rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
  * @brief API for receive complete callback.
@@ -822,11 +1050,22 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
     if (inst->fctrl != FCNTL_IEEE_RANGE_16)
         return false;
 
+#if MYNEWT_VAL(RNG_NSESSIONS) > 1
+    dw1000_rng_session_t * session = session_accept(inst);
+    if(os_sem_get_count(&inst->rng->sem) == 1){
+        // Frame of an interleaved exchange arriving after another session released the semaphore
+        if (session == NULL || os_sem_pend(&inst->rng->sem, 0) != OS_OK){
+            RNG_STATS_INC(rx_unsolicited);
+            return false;
+        }
+    }
+#else
     if(os_sem_get_count(&inst->rng->sem) == 1){
         // unsolicited inbound
         RNG_STATS_INC(rx_unsolicited);
         return false;
     }
+#endif
     dw1000_rng_instance_t * rng = inst->rng; 
 
     if (inst->frame_len < sizeof(ieee_rng_request_frame_t))
@@ -842,11 +1081,19 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
                 else
                     break;
                 // IEEE 802.15.4 standard ranging frames, software MAC filtering
-                if (inst->config.framefilter_enabled == false && frame->dst_address != inst->my_short_address){
+                if (inst->config.framefilter_enabled == false && frame->dst_address != inst->my_short_address
+                    && !(frame->code == DWT_SS_TWR_WCS_RESULT && frame->dst_address == BROADCAST_ADDRESS)){
                     return true;
                 }else{
                     RNG_STATS_INC(rx_complete); 
                     rng->idx++;     // confirmed frame advance  
+#if MYNEWT_VAL(RNG_NSESSIONS) > 1
+                    rng->session = session;
+                    if (session){
+                        session->prev_idx = session->idx;
+                        session->idx = rng->idx;
+                    }
+#endif
                     return false;   // Allow sub extensions to handle event
                 }
             }
@@ -0,0 +1,255 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/**
+ * @file rng_calib.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Turnaround calibration
+ *
+ * @details The syscfg holdoff delays are sized for the slowest code path. Each registered config
+ * collects a histogram of the latency from the request rx timestamp to arming the delayed response,
+ * both in dw1000 time, and once RNG_CALIB_NSAMPLES exchanges are in, tx_holdoff_delay is set to
+ * RNG_CALIB_PERCENTILE of that latency plus RNG_CALIB_MARGIN, bounded by the syscfg default. A missed
+ * delayed tx raises the holdoff by RNG_CALIB_BACKOFF and restarts the measurement.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <os/os.h>
+
+#if MYNEWT_VAL(RNG_CALIB_ENABLED)
+#include <config/config.h>
+
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_mac.h>
+#include <rng/rng.h>
+#include <rng/rng_calib.h>
+
+static SLIST_HEAD(, _dw1000_rng_calib_t) g_calibs = SLIST_HEAD_INITIALIZER(g_calibs);
+
+static char *rng_calib_get(int argc, char **argv, char *val, int val_len_max);
+static int rng_calib_set(int argc, char **argv, char *val);
+static int rng_calib_export(void (*export_func)(char *name, char *val), enum conf_export_tgt tgt);
+
+static struct conf_handler rng_calib_handler = {
+    .ch_name = "rngcal",
+    .ch_get = rng_calib_get,
+    .ch_set = rng_calib_set,
+    .ch_export = rng_calib_export,
+};
+
+static dw1000_rng_calib_t *
+calib_find(const char * name){
+    dw1000_rng_calib_t * calib;
+    SLIST_FOREACH(calib, &g_calibs, next){
+        if (!strcmp(name, calib->name))
+            return calib;
+    }
+    return NULL;
+}
+
+static char *
+rng_calib_get(int argc, char **argv, char *val, int val_len_max)
+{
+    dw1000_rng_calib_t * calib = (argc == 1) ? calib_find(argv[0]) : NULL;
+    if (calib == NULL)
+        return NULL;
+    snprintf(val, val_len_max, "%lu", (unsigned long) calib->config->tx_holdoff_delay);
+    return val;
+}
+
+static int
+rng_calib_set(int argc, char **argv, char *val)
+{
+    dw1000_rng_calib_t * calib = (argc == 1) ? calib_find(argv[0]) : NULL;
+    if (calib == NULL)
+        return OS_ENOENT;
+
+    int32_t holdoff;
+    int rc = conf_value_from_str(val, CONF_INT32, (void*)&holdoff, 0);
+    if (rc)
+        return rc;
+    if (holdoff <= 0 || holdoff > calib->max_holdoff)
+        return OS_EINVAL;
+    calib->config->tx_holdoff_delay = holdoff;
+    return 0;
+}
+
+static int
+rng_calib_export(void (*export_func)(char *name, char *val), enum conf_export_tgt tgt)
+{
+    char name[32];
+    char val[12];
+    dw1000_rng_calib_t * calib;
+    SLIST_FOREACH(calib, &g_calibs, next){
+        snprintf(name, sizeof(name), "%s/%s", rng_calib_handler.ch_name, calib->name);
+        snprintf(val, sizeof(val), "%lu", (unsigned long) calib->config->tx_holdoff_delay);
+        export_func(name, val);
+    }
+    return 0;
+}
+
+static void
+save_ev_cb(struct os_event * ev){
+    dw1000_rng_calib_t * calib = (dw1000_rng_calib_t *) ev->ev_arg;
+    char name[32];
+    char val[12];
+    snprintf(name, sizeof(name), "%s/%s", rng_calib_handler.ch_name, calib->name);
+    snprintf(val, sizeof(val), "%lu", (unsigned long) calib->config->tx_holdoff_delay);
+    conf_save_one(name, val);
+}
+
+/**
+ * @fn dw1000_rng_calib_restart(dw1000_rng_calib_t * calib)
+ * @brief API to discard the collected samples and start a new measurement.
+ *
+ * @param calib  Pointer to dw1000_rng_calib_t.
+ *
+ * @return void
+ */
+void
+dw1000_rng_calib_restart(dw1000_rng_calib_t * calib){
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    memset(calib->hist, 0, sizeof(calib->hist));
+    calib->nsamples = 0;
+    calib->active = 1;
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * @fn dw1000_rng_calib_register(dw1000_rng_calib_t * calib)
+ * @brief API to put a ranging config under calibration, called from the pkg_init of the ranging mode.
+ * The persisted holdoff, if any, is applied when sys/config loads.
+ *
+ * @param calib  Pointer to dw1000_rng_calib_t with name and config set.
+ *
+ * @return void
+ */
+void
+dw1000_rng_calib_register(dw1000_rng_calib_t * calib){
+    assert(calib->name && calib->config);
+    if (calib->max_holdoff == 0)
+        calib->max_holdoff = calib->config->tx_holdoff_delay;
+    calib->save_ev.ev_cb = save_ev_cb;
+    calib->save_ev.ev_arg = (void *) calib;
+    SLIST_INSERT_HEAD(&g_calibs, calib, next);
+    dw1000_rng_calib_restart(calib);
+}
+
+/**
+ * @fn dw1000_rng_calib_sample(dw1000_dev_instance_t * inst, dw1000_rng_calib_t * calib)
+ * @brief API to record the turnaround latency of the frame being answered, called once dw1000_start_tx()
+ * of a delayed response has returned without error. The response is already armed so the systime read
+ * does not delay it; the sample includes arming the tx, which errs on the safe side.
+ *
+ * @param inst   Pointer to dw1000_dev_instance_t.
+ * @param calib  Pointer to dw1000_rng_calib_t.
+ *
+ * @return void
+ */
+void
+dw1000_rng_calib_sample(dw1000_dev_instance_t * inst, dw1000_rng_calib_t * calib){
+
+    if (!calib->active)
+        return;
+
+    // dw1000 time wraps at 40 bits, one UWB usec is 1 << 16 ticks
+    uint32_t latency = (uint32_t)(((dw1000_read_systime(inst) - inst->rxtimestamp) & 0xFFFFFFFFFFULL) >> 16);
+    uint16_t bin = latency / MYNEWT_VAL(RNG_CALIB_BIN);
+    if (bin >= MYNEWT_VAL(RNG_CALIB_NBINS))
+        bin = MYNEWT_VAL(RNG_CALIB_NBINS) - 1;
+    calib->hist[bin]++;
+
+    if (++calib->nsamples < MYNEWT_VAL(RNG_CALIB_NSAMPLES))
+        return;
+
+    uint32_t target = (calib->nsamples * MYNEWT_VAL(RNG_CALIB_PERCENTILE) + 99) / 100;
+    uint32_t sum = 0;
+    for (bin = 0; bin < MYNEWT_VAL(RNG_CALIB_NBINS) - 1; bin++){
+        sum += calib->hist[bin];
+        if (sum >= target)
+            break;
+    }
+    uint32_t holdoff = (bin + 1) * MYNEWT_VAL(RNG_CALIB_BIN) + MYNEWT_VAL(RNG_CALIB_MARGIN);
+    calib->config->tx_holdoff_delay = (holdoff < calib->max_holdoff) ? holdoff : calib->max_holdoff;
+    calib->active = 0;
+    os_eventq_put(os_eventq_dflt_get(), &calib->save_ev);
+}
+
+/**
+ * @fn dw1000_rng_calib_max_holdoff(dw1000_rng_config_t * config)
+ * @brief API to get the worst-case holdoff of a config. The remote side may run an uncalibrated, or
+ * differently calibrated, holdoff so rx timeouts that span its turnaround use this bound rather than
+ * the tuned config->tx_holdoff_delay.
+ *
+ * @param config  Pointer to dw1000_rng_config_t.
+ *
+ * @return holdoff in UWB usec
+ */
+uint32_t
+dw1000_rng_calib_max_holdoff(dw1000_rng_config_t * config){
+
+    dw1000_rng_calib_t * calib;
+    SLIST_FOREACH(calib, &g_calibs, next){
+        if (calib->config == config)
+            return calib->max_holdoff;
+    }
+    return config->tx_holdoff_delay;
+}
+
+/**
+ * @fn dw1000_rng_calib_tx_error(dw1000_rng_calib_t * calib)
+ * @brief API to back off the holdoff after a late delayed tx, called from the start_tx_error path.
+ *
+ * @param calib  Pointer to dw1000_rng_calib_t.
+ *
+ * @return void
+ */
+void
+dw1000_rng_calib_tx_error(dw1000_rng_calib_t * calib){
+
+    uint32_t holdoff = calib->config->tx_holdoff_delay + MYNEWT_VAL(RNG_CALIB_BACKOFF);
+    if (holdoff > calib->max_holdoff)
+        holdoff = calib->max_holdoff;
+    if (holdoff != calib->config->tx_holdoff_delay){
+        calib->config->tx_holdoff_delay = holdoff;
+        os_eventq_put(os_eventq_dflt_get(), &calib->save_ev);
+    }
+    dw1000_rng_calib_restart(calib);
+}
+
+/**
+ * @fn dw1000_rng_calib_pkg_init(void)
+ * @brief API to register the rngcal config handler, called from rng_pkg_init.
+ *
+ * @return void
+ */
+void
+dw1000_rng_calib_pkg_init(void){
+    int rc = conf_register(&rng_calib_handler);
+    assert(rc == 0);
+}
+#endif
@@ -25,63 +25,140 @@
 #include <rng/rng.h>
 #include <dw1000/dw1000_mac.h>
 #include <rng/rng_encode.h>
+#if MYNEWT_VAL(TELEMETRY_ENABLED)
+#include <telemetry/telemetry.h>
+#endif
+
+#if MYNEWT_VAL(RNG_FILTER_ENABLED)
+#include <rng_filter/rng_filter.h>
+#if MYNEWT_VAL(WCS_ENABLED)
+#include <wcs/wcs.h>
+#endif
+#endif
 
 #if MYNEWT_VAL(RNG_VERBOSE)
 
+#if MYNEWT_VAL(TELEMETRY_ENABLED)
+static void
+rng_telemetry(twr_frame_t * frame, float time_of_flight, float range, bool azimuth){
+    telemetry_rng_t record = {
+        .code = frame->code,
+        .flags = (azimuth) ? TELEMETRY_RNG_AZIMUTH : 0,
+        .tof = time_of_flight,
+        .range = range,
+        .azimuth = (azimuth) ? frame->spherical.azimuth : 0.0f,
+        .res_req = frame->response_timestamp - frame->request_timestamp,
+        .rec_tra = frame->transmission_timestamp - frame->reception_timestamp
+    };
+    telemetry_write(TELEMETRY_RNG, &record, sizeof(record));
+}
+#endif
+
+#if MYNEWT_VAL(RNG_FILTER_ENABLED)
 /*!
- * @fn rng_encodestruct os_event * ev)
+ * @fn rng_filter(dw1000_rng_instance_t * rng, twr_frame_t * frame, float * range)
  *
- * @brief JSON encoding of range
+ * @brief Feeds the range to the filter of the peer, weighted by the line of sight likelihood of the
+ * last frame received, and the carrier offset of the final frame as range-rate.
  *
  * input parameters
  * @param rng     Pointer of dw1000_rng_instance_t.
+ * @param frame   Final frame of the exchange.
  * output parameters
- * returns void
+ * @param range   Measured range, replaced by the filtered range.
+ * returns false if the range was rejected and is not to be reported
  */
-void
-rng_encode(dw1000_rng_instance_t * rng) {
+static bool
+rng_filter(dw1000_rng_instance_t * rng, twr_frame_t * frame, float * range){
 
-    uint16_t idx = (rng->idx)%rng->nframes;
-    twr_frame_t * frame = rng->frames[idx];
+    dw1000_dev_instance_t * inst = rng->parent;
+    uint16_t peer = (frame->src_address == inst->my_short_address) ? frame->dst_address : frame->src_address;
+    float los = (inst->config.rxdiag_enable) ? dw1000_estimate_los(dw1000_get_rssi(inst), dw1000_get_fppl(inst)) : 1.0f;
+    rng_filter_result_t result;
 
-    if (frame->code == DWT_SS_TWR_FINAL) {
-        float time_of_flight = (float) dw1000_rng_twr_to_tof(rng, idx);
-        float range = dw1000_rng_tof_to_meters(time_of_flight);
-        printf("{\"utime\": %lu,\"tof\": %lu,\"range\": %lu,\"res_req\": \"%lX\","
+    if (rng_filter_update(peer, *range, los, &result) != OS_OK || result.rejected)
+        return false;
+    if (frame->carrier_integrator){
+        float ratio = dw1000_calc_clock_offset_ratio(inst, frame->carrier_integrator);
+        // The oscillator offset is seeded from the clock model when there is one, else from the peer's carrier
+        float osc = ratio;
+#if MYNEWT_VAL(WCS_ENABLED)
+        if (inst->ccp->wcs->status.valid)
+            osc = -inst->ccp->wcs->skew;
+#endif
+        rng_filter_update_rate(peer, ratio, osc, &result);
+    }
+    *range = result.range;
+    return true;
+}
+#endif
+
+static void
+rng_output(dw1000_rng_instance_t * rng, twr_frame_t * frame, float time_of_flight, float range, bool azimuth){
+
+#if MYNEWT_VAL(RNG_FILTER_ENABLED)
+    if (!rng_filter(rng, frame, &range))
+        return;
+#endif
+#if MYNEWT_VAL(TELEMETRY_ENABLED)
+    rng_telemetry(frame, time_of_flight, range, azimuth);
+#else
+    if (azimuth)
+        printf("{\"utime\": %lu,\"tof\": %lu,\"range\": %lu,\"azimuth\": %lu,\"res_req\":\"%lX\","
                 " \"rec_tra\": \"%lX\"}\n",
                 os_cputime_ticks_to_usecs(os_cputime_get32()),
                 *(uint32_t *)(&time_of_flight),
                 *(uint32_t *)(&range),
+                *(uint32_t *)(&frame->spherical.azimuth),
                 (frame->response_timestamp - frame->request_timestamp),
                 (frame->transmission_timestamp - frame->reception_timestamp)
         );
-        frame->code = DWT_SS_TWR_END;
-    }
-    else if (frame->code == DWT_DS_TWR_FINAL) {
-        float time_of_flight = dw1000_rng_twr_to_tof(rng, idx);
-        float range = dw1000_rng_tof_to_meters(time_of_flight);
-        printf("{\"utime\": %lu,\"tof\": %lu,\"range\": %lu,\"azimuth\": %lu,\"res_req\":\"%lX\","
+    else
+        printf("{\"utime\": %lu,\"tof\": %lu,\"range\": %lu,\"res_req\": \"%lX\","
                 " \"rec_tra\": \"%lX\"}\n",
                 os_cputime_ticks_to_usecs(os_cputime_get32()),
                 *(uint32_t *)(&time_of_flight),
                 *(uint32_t *)(&range),
-                *(uint32_t *)(&frame->spherical.azimuth),
                 (frame->response_timestamp - frame->request_timestamp),
                 (frame->transmission_timestamp - frame->reception_timestamp)
         );
+#endif
+}
+
+/*!
+ * @fn rng_encodestruct os_event * ev)
+ *
+ * @brief JSON encoding of range
+ *
+ * input parameters
+ * @param rng     Pointer of dw1000_rng_instance_t.
+ * output parameters
+ * returns void
+ */
+void
+rng_encode(dw1000_rng_instance_t * rng) {
+
+    uint16_t idx = (rng->idx)%rng->nframes;
+    twr_frame_t * frame = rng->frames[idx];
+
+    if (frame->code == DWT_SS_TWR_FINAL) {
+        float time_of_flight = (float) dw1000_rng_twr_to_tof(rng, idx);
+        rng_output(rng, frame, time_of_flight, dw1000_rng_tof_to_meters(time_of_flight), false);
+        frame->code = DWT_SS_TWR_END;
+    }
+    else if (frame->code == DWT_SS_TWR_WCS_T1 || frame->code == DWT_SS_TWR_WCS_RESULT) {
+        float time_of_flight = (float) dw1000_rng_twr_to_tof(rng, idx);
+        rng_output(rng, frame, time_of_flight, dw1000_rng_tof_to_meters(time_of_flight), false);
+        frame->code = DWT_SS_TWR_WCS_END;
+    }
+    else if (frame->code == DWT_DS_TWR_FINAL) {
+        float time_of_flight = dw1000_rng_twr_to_tof(rng, idx);
+        rng_output(rng, frame, time_of_flight, dw1000_rng_tof_to_meters(time_of_flight), true);
         frame->code = DWT_DS_TWR_END;
     }
     else if (frame->code == DWT_DS_TWR_EXT_FINAL) {
         float time_of_flight = dw1000_rng_twr_to_tof(rng, idx);
-        printf("{\"utime\": %lu,\"tof\": %lu,\"range\": %lu,\"azimuth\": %lu,\"res_req\":\"%lX\","
-                " \"rec_tra\": \"%lX\"}\n",
-                os_cputime_ticks_to_usecs(os_cputime_get32()),
-                *(uint32_t *)(&time_of_flight),
-                *(uint32_t *)(&frame->spherical.range),
-                *(uint32_t *)(&frame->spherical.azimuth),
-                (frame->response_timestamp - frame->request_timestamp),
-                (frame->transmission_timestamp - frame->reception_timestamp)
-        );
+        rng_output(rng, frame, time_of_flight, frame->spherical.range, true);
         frame->code = DWT_DS_TWR_END;
     }
 }
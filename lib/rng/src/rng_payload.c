@@ -0,0 +1,190 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file rng_payload.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Piggybacked application payload
+ *
+ * @details An optional TLV area appended to the fixed part of ranging frames. Each entry is a type byte,
+ * a length byte and length bytes of value. The producer fills the area at TX time and the consumer is
+ * called for each entry on RX, so sensor data shares the preamble of the ranging exchange.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <os/os.h>
+
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_hal.h>
+#include <dw1000/dw1000_mac.h>
+#include <dw1000/dw1000_phy.h>
+#include <rng/rng.h>
+
+/**
+ * @fn dw1000_rng_set_payload(dw1000_dev_instance_t * inst, dw1000_rng_payload_producer_t * producer,
+ * dw1000_rng_payload_consumer_t * consumer, uint16_t budget)
+ * @brief API to register the payload callbacks. The TLV area is sized to the largest length, up to
+ * RNG_PAYLOAD_MAX, whose additional airtime fits within budget. Both ends of an exchange pass the same budget,
+ * a consumer-only node uses it to size its rx timeouts and length checks for the peer's area.
+ *
+ * @param inst      Pointer to dw1000_dev_instance_t.
+ * @param producer  Called at TX time, NULL to send no payload.
+ * @param consumer  Called for each received entry, NULL to ignore payloads.
+ * @param budget    Airtime per frame available to the payload, in usec.
+ *
+ * @return void
+ */
+void
+dw1000_rng_set_payload(dw1000_dev_instance_t * inst, dw1000_rng_payload_producer_t * producer,
+                        dw1000_rng_payload_consumer_t * consumer, uint16_t budget){
+
+    dw1000_rng_payload_t * payload = &inst->rng->payload;
+    uint16_t base = dw1000_phy_frame_duration(&inst->attrib, 0);
+
+    payload->len = 0;
+    payload->usecs = 0;
+    if (producer || consumer){
+        for (uint16_t len = MYNEWT_VAL(RNG_PAYLOAD_MAX); len > 0; len--){
+            uint16_t usecs = dw1000_phy_frame_duration(&inst->attrib, len) - base;
+            if (usecs <= budget){
+                payload->len = len;
+                payload->usecs = usecs;
+                break;
+            }
+        }
+    }
+    payload->consumer = consumer;
+    payload->producer = producer;
+}
+
+/**
+ * @fn dw1000_rng_payload_rx_usecs(dw1000_dev_instance_t * inst)
+ * @brief API to size rx timeouts for a frame that may carry a payload, 0 when none is configured.
+ *
+ * @param inst      Pointer to dw1000_dev_instance_t.
+ *
+ * @return additional airtime in usec
+ */
+uint16_t
+dw1000_rng_payload_rx_usecs(dw1000_dev_instance_t * inst){
+
+    return inst->rng->payload.usecs;
+}
+
+/**
+ * @fn dw1000_rng_payload_fits(dw1000_dev_instance_t * inst, uint16_t offset)
+ * @brief API to check the length of a received frame that may carry a payload, the fixed part followed by at
+ * most the configured TLV area. Without a payload configured only the fixed part is accepted.
+ *
+ * @param inst      Pointer to dw1000_dev_instance_t.
+ * @param offset    Length of the fixed part of the frame.
+ *
+ * @return true if the length is valid
+ */
+bool
+dw1000_rng_payload_fits(dw1000_dev_instance_t * inst, uint16_t offset){
+
+    return inst->frame_len >= offset && inst->frame_len <= offset + inst->rng->payload.len;
+}
+
+/**
+ * @fn dw1000_rng_payload_write(dw1000_dev_instance_t * inst, uint16_t code, uint16_t offset)
+ * @brief API to append the producer's TLV area to the TX buffer after the fixed part of a frame.
+ *
+ * @param inst      Pointer to dw1000_dev_instance_t.
+ * @param code      Code of the frame being sent.
+ * @param offset    Length of the fixed part of the frame.
+ *
+ * @return number of payload bytes written, to be added to the frame length passed to dw1000_write_tx_fctrl
+ */
+uint16_t
+dw1000_rng_payload_write(dw1000_dev_instance_t * inst, uint16_t code, uint16_t offset){
+
+    dw1000_rng_payload_t * payload = &inst->rng->payload;
+    if (payload->producer == NULL || payload->len == 0)
+        return 0;
+
+    uint8_t buf[MYNEWT_VAL(RNG_PAYLOAD_MAX)];
+    uint16_t len = payload->producer(inst, code, buf, payload->len);
+    if (len > payload->len)
+        len = payload->len;
+    if (len)
+        dw1000_write_tx(inst, buf, offset, len);
+    return len;
+}
+
+/**
+ * @fn dw1000_rng_payload_read(dw1000_dev_instance_t * inst, uint16_t offset)
+ * @brief API to pass the TLV entries following the fixed part of the received frame to the consumer.
+ * Truncated entries are dropped.
+ *
+ * @param inst      Pointer to dw1000_dev_instance_t.
+ * @param offset    Length of the fixed part of the frame.
+ *
+ * @return void
+ */
+void
+dw1000_rng_payload_read(dw1000_dev_instance_t * inst, uint16_t offset){
+
+    dw1000_rng_payload_t * payload = &inst->rng->payload;
+    if (payload->consumer == NULL || inst->frame_len <= offset)
+        return;
+
+    uint16_t src_address = ((ieee_rng_request_frame_t *) inst->rxbuf)->src_address;
+    while (offset + 2 <= inst->frame_len){
+        uint8_t type = inst->rxbuf[offset];
+        uint8_t len = inst->rxbuf[offset + 1];
+        if (offset + 2 + len > inst->frame_len)
+            break;
+        payload->consumer(inst, src_address, type, &inst->rxbuf[offset + 2], len);
+        offset += 2 + len;
+    }
+}
+
+/**
+ * @fn dw1000_rng_tlv_put(uint8_t * buf, uint16_t len, uint16_t * offset, uint8_t type, const void * value, uint8_t vlen)
+ * @brief Helper for producers, appends a TLV entry to buf.
+ *
+ * @param buf       TLV area.
+ * @param len       Size of buf.
+ * @param offset    Write position, advanced on success.
+ * @param type      Application defined entry type.
+ * @param value     Entry value.
+ * @param vlen      Entry value length.
+ *
+ * @return OS_OK on success, OS_ENOMEM if the entry does not fit
+ */
+int
+dw1000_rng_tlv_put(uint8_t * buf, uint16_t len, uint16_t * offset, uint8_t type, const void * value, uint8_t vlen){
+
+    if (*offset + 2 + vlen > len)
+        return OS_ENOMEM;
+
+    buf[*offset] = type;
+    buf[*offset + 1] = vlen;
+    memcpy(&buf[*offset + 2], value, vlen);
+    *offset += 2 + vlen;
+    return OS_OK;
+}
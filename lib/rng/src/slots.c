@@ -44,34 +44,23 @@
  */
 uint32_t
 NumberOfBits(uint32_t n) {
-    uint32_t count = 0;
-    while (n) {
-        n &= (n-1);
-        count++;
-    }
-    return count;
+    return __builtin_popcount(n);
 }
 
 /**
  * Help function to calculate the position of slots within a bitmask
  *
- * @param n bitfield to count bits within
+ * @param n bitfield with a single bit set
  *
- * @return number of set bits
+ * @return one based position of the bit
  */
 uint32_t BitPosition(uint32_t n) {
-    uint32_t count = 0;
     assert(n && (! (n & (n-1)) )); // single bit set
-
-    while (n){
-        n = n >> 1;
-        ++count; // position of bit within bitfield
-    }
-    return count;
+    return __builtin_ctz(n) + 1;
 }
 
 /**
- * @fn BitIndex(uint32_t nslots_mask, uint32_t n, uint8_t mode)
+ * @fn BitIndex(uint32_t nslots_mask, uint32_t n, slot_mode_t mode)
  * @brief Help function to calculate the numerical ordering of a bit within a bitmask
  *
  * @param nslots_mask     number of slots mask parameter
@@ -81,17 +70,219 @@ uint32_t BitPosition(uint32_t n) {
  * @return numerical ordering of a bit witin bitmask.
  */
 uint32_t
-BitIndex(uint32_t nslots_mask, uint32_t n, uint8_t mode) {
+BitIndex(uint32_t nslots_mask, uint32_t n, slot_mode_t mode) {
 
     assert(n && (! (n & (n-1)) ));  // single bit set
     assert(n & nslots_mask);        // bit set is within ROI
-    
-    uint32_t idx = BitPosition(n);
-    uint32_t slot_mask =  (((uint32_t)~0UL >> (sizeof(uint32_t) * 8 - idx)));
-    uint32_t remaining_mask = ((uint32_t)~0UL << idx);
 
     if (mode == SLOT_POSITION)
-        return NumberOfBits(nslots_mask & slot_mask) - 1; // slot position
+        return __builtin_popcount(nslots_mask & (n - 1)); // slot position
     else
-        return NumberOfBits(nslots_mask & remaining_mask) - 1; // no. of slots remaining
+        return __builtin_popcount(nslots_mask & ~(n | (n - 1))) - 1; // no. of slots remaining
+}
+
+/**
+ * @fn slot_map_count(const uint32_t map[], uint16_t nwords)
+ * @brief Number of slots set within a multi-word slot map
+ *
+ * @param map       slot map, bit n of word n/32 marks slot n
+ * @param nwords    number of words in map
+ *
+ * @return number of set slots
+ */
+uint16_t
+slot_map_count(const uint32_t map[], uint16_t nwords){
+    uint16_t count = 0;
+    for (uint16_t i = 0; i < nwords; i++)
+        count += __builtin_popcount(map[i]);
+    return count;
+}
+
+/**
+ * @fn slot_map_rank(const uint32_t map[], uint16_t slot)
+ * @brief Number of slots set below slot, i.e. the position of slot within the response schedule
+ *
+ * @param map       slot map
+ * @param slot      slot id
+ *
+ * @return number of set slots preceding slot
+ */
+uint16_t
+slot_map_rank(const uint32_t map[], uint16_t slot){
+    uint16_t rank = 0;
+    for (uint16_t i = 0; i < (slot >> 5); i++)
+        rank += __builtin_popcount(map[i]);
+    return rank + __builtin_popcount(map[slot >> 5] & ((1UL << (slot & 31)) - 1));
+}
+
+/**
+ * @fn slot_map_rank_table(const uint32_t map[], uint16_t nwords, uint16_t table[])
+ * @brief Precompute the number of slots set below each word, so that slot_map_rank_cached() costs a
+ * single popcount. slot_map_select() still scans the table for the word holding the rank, then clears at
+ * most 31 bits within it. Recompute whenever the map changes.
+ *
+ * @param map       slot map
+ * @param nwords    number of words in map
+ * @param table     nwords entries
+ *
+ * @return number of set slots
+ */
+uint16_t
+slot_map_rank_table(const uint32_t map[], uint16_t nwords, uint16_t table[]){
+    uint16_t rank = 0;
+    for (uint16_t i = 0; i < nwords; i++) {
+        table[i] = rank;
+        rank += __builtin_popcount(map[i]);
+    }
+    return rank;
+}
+
+/**
+ * @fn slot_map_select(const uint32_t map[], const uint16_t table[], uint16_t nwords, uint16_t rank)
+ * @brief Slot at a given position within the response schedule, the inverse of slot_map_rank(). Linear
+ * in nwords for the table scan plus up to 31 iterations within the word.
+ *
+ * @param map       slot map
+ * @param table     rank table of map, see slot_map_rank_table()
+ * @param nwords    number of words in map
+ * @param rank      position within the schedule
+ *
+ * @return slot id, -1 if fewer than rank + 1 slots are set
+ */
+int32_t
+slot_map_select(const uint32_t map[], const uint16_t table[], uint16_t nwords, uint16_t rank){
+    uint16_t i = 0;
+    while (i + 1 < nwords && table[i + 1] <= rank)
+        i++;
+    uint32_t word = map[i];
+    if (__builtin_popcount(word) <= rank - table[i])
+        return -1;
+    for (uint16_t k = rank - table[i]; k; k--)
+        word &= word - 1;   // drop the lowest set slots preceding rank
+    return (i << 5) + __builtin_ctz(word);
+}
+
+/**
+ * @fn slot_map_next(const uint32_t map[], uint16_t nwords, uint16_t from)
+ * @brief Next slot set within a slot map
+ *
+ * @param map       slot map
+ * @param nwords    number of words in map
+ * @param from      first slot to consider
+ *
+ * @return slot id, -1 if no further slots are set
+ */
+int32_t
+slot_map_next(const uint32_t map[], uint16_t nwords, uint16_t from){
+    uint16_t i = from >> 5;
+    if (i >= nwords)
+        return -1;
+    uint32_t word = map[i] & ((uint32_t)~0UL << (from & 31));
+    while (word == 0) {
+        if (++i == nwords)
+            return -1;
+        word = map[i];
+    }
+    return (i << 5) + __builtin_ctz(word);
+}
+
+/**
+ * @fn slot_map_encode(const uint32_t map[], uint16_t nwords, uint8_t buf[], uint16_t size, bool * rle)
+ * @brief Compact over-the-air encoding of a slot map. Contiguous allocations are sent as a list of runs
+ * {start, length - 1}, sparse allocations as the little-endian bitmap truncated after the last set slot,
+ * whichever is shorter. Runs limit slot ids to 255.
+ *
+ * @param map       slot map
+ * @param nwords    number of words in map
+ * @param buf       output buffer, 4 * nwords bytes always suffice
+ * @param size      size of buf
+ * @param rle       set when buf holds runs
+ *
+ * @return encoded length in bytes
+ */
+uint16_t
+slot_map_encode(const uint32_t map[], uint16_t nwords, uint8_t buf[], uint16_t size, bool * rle){
+
+    uint16_t raw = 0;
+    for (uint16_t i = 0; i < 4 * nwords; i++)
+        if ((map[i >> 2] >> (8 * (i & 3))) & 0xff)
+            raw = i + 1;
+    assert(raw <= size);
+
+    uint16_t len = 0;
+    int32_t slot = slot_map_next(map, nwords, 0);
+    while (slot >= 0 && slot <= UINT8_MAX && len + 2 < raw) {
+        uint16_t end = slot;
+        while (end - slot < UINT8_MAX && end + 1 < 32 * nwords && slot_map_test(map, end + 1))
+            end++;
+        buf[len++] = slot;
+        buf[len++] = end - slot;
+        slot = slot_map_next(map, nwords, end + 1);
+    }
+    if (slot < 0 && len < raw) {
+        *rle = true;
+        return len;
+    }
+    for (uint16_t i = 0; i < raw; i++)
+        buf[i] = map[i >> 2] >> (8 * (i & 3));
+    *rle = false;
+    return raw;
+}
+
+/**
+ * @fn slot_map_decode(const uint8_t buf[], uint16_t len, bool rle, uint32_t map[], uint16_t nwords)
+ * @brief Expand an encoded slot map, slots beyond the map are ignored
+ *
+ * @param buf       encoded slot map
+ * @param len       encoded length
+ * @param rle       buf holds runs
+ * @param map       output slot map
+ * @param nwords    number of words in map
+ *
+ * @return number of set slots
+ */
+uint16_t
+slot_map_decode(const uint8_t buf[], uint16_t len, bool rle, uint32_t map[], uint16_t nwords){
+
+    memset(map, 0, nwords * sizeof(uint32_t));
+    if (rle) {
+        for (uint16_t i = 0; i + 1 < len; i += 2)
+            for (uint16_t slot = buf[i]; slot <= buf[i] + buf[i + 1] && slot < 32 * nwords; slot++)
+                slot_map_set(map, slot);
+    } else {
+        for (uint16_t i = 0; i < len && i < 4 * nwords; i++)
+            map[i >> 2] |= (uint32_t)buf[i] << (8 * (i & 3));
+    }
+    return slot_map_count(map, nwords);
+}
+
+/**
+ * @fn slot_map_position(const uint8_t buf[], uint16_t len, bool rle, uint16_t slot)
+ * @brief Position of slot within the response schedule, evaluated on the encoded map so responders
+ * need not expand it.
+ *
+ * @param buf       encoded slot map
+ * @param len       encoded length
+ * @param rle       buf holds runs
+ * @param slot      slot id
+ *
+ * @return number of set slots preceding slot, -1 if slot is not set
+ */
+int32_t
+slot_map_position(const uint8_t buf[], uint16_t len, bool rle, uint16_t slot){
+
+    uint16_t position = 0;
+    if (rle) {
+        for (uint16_t i = 0; i + 1 < len; i += 2) {
+            if (slot >= buf[i] && slot <= buf[i] + buf[i + 1])
+                return position + slot - buf[i];
+            position += buf[i + 1] + 1;
+        }
+        return -1;
+    }
+    if ((slot >> 3) >= len || !((buf[slot >> 3] >> (slot & 7)) & 1))
+        return -1;
+    for (uint16_t i = 0; i < (slot >> 3); i++)
+        position += __builtin_popcount(buf[i]);
+    return position + __builtin_popcount(buf[slot >> 3] & ((1U << (slot & 7)) - 1));
 }
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sysinit/sysinit.h"
+#include "syscfg/syscfg.h"
+#include "os/os.h"
+#include "testutil/testutil.h"
+
+#include "rng_test.h"
+
+os_stack_t test_stack[OS_STACK_ALIGN(TEST_STACK_SIZE)];
+struct os_task test_task;
+
+TEST_CASE_DECL(rng_slots_tests)
+TEST_CASE_DECL(rng_exchange_tests)
+
+TEST_SUITE(rng_test_all)
+{
+    // Runs before the exchanges, which restart the test once they are done
+    rng_slots_tests();
+    rng_exchange_tests();
+}
+
+#if MYNEWT_VAL(SELFTEST)
+int
+main(int argc, char **argv)
+{
+    // sysinit() runs from the test task, the dw1000 driver needs the os started
+    rng_test_all();
+
+    return 0;
+}
+#endif
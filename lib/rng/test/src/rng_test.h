@@ -0,0 +1,47 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef _RNG_TEST_H
+#define _RNG_TEST_H
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sysinit/sysinit.h"
+#include "syscfg/syscfg.h"
+#include "os/os.h"
+#include "testutil/testutil.h"
+
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_hal.h>
+#include <dw1000/dw1000_sim.h>
+#include <rng/rng.h>
+
+#define TEST_STACK_SIZE 4096
+#define TEST_PRIO 22
+extern os_stack_t test_stack[];
+extern struct os_task test_task;
+
+void rng_test_handler(void *arg);
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+void rng_test_pcode_model(dw1000_dev_instance_t * inst);
+#endif
+
+#endif /* _RNG_TEST_H */
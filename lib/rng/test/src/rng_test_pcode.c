@@ -0,0 +1,171 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file rng_test_pcode.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Throughput against response loss of nrng preamble code groups
+ *
+ * @details The two device simulator cannot put several responders on the air at once, the cost and benefit of code
+ * groups are evaluated on a timing model of the exchange instead. Frame durations, holdoff and guard come from the
+ * twr_ss_nrng configuration of device 0. Each cell is one initiator and RNG_TEST_PCODE_NODES responders answering in
+ * turn, with a turnaround jitter of RNG_TEST_PCODE_JITTER. A second cell runs at a random phase of the same period.
+ * A response is lost when another frame on the same code overlaps it, or when the initiator's receiver is not back
+ * yet: it needs RNG_TEST_PCODE_REARM after the previous response it took, and after the rx timeout that moves it to
+ * the code of a new group, which fires half a guard before that group's first preamble. Distinct codes are taken as
+ * orthogonal. With code groups each cell takes its own share of the NRNG_PCODE_NCODES codes. The guard is swept from
+ * zero to the configured tx_guard_delay, each row reports the responses delivered per ms of air by all cells and the
+ * fraction lost.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "rng_test.h"
+#include <nrng/nrng.h>
+
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+
+#define NCELLS 2
+#define NNODES MYNEWT_VAL(RNG_TEST_PCODE_NODES)
+#define NSTEPS 8
+
+//! Response on the air
+typedef struct _rng_test_response_t{
+    double start;                   //!< Preamble start (usec)
+    double nominal;                 //!< Scheduled preamble start (usec)
+    uint8_t code;                   //!< Preamble code, 0 for the channel code
+}rng_test_response_t;
+
+//! Timing of the exchange
+typedef struct _rng_test_timing_t{
+    double frame;                   //!< Response duration (usec)
+    double holdoff;                 //!< Request to first response (usec)
+    double guard;                   //!< Guard between responses (usec)
+    double period;                  //!< Request to request (usec)
+}rng_test_timing_t;
+
+static uint32_t g_seed = 0x9E3779B9;
+
+static double
+uniform(void){
+    g_seed ^= g_seed << 13;
+    g_seed ^= g_seed >> 17;
+    g_seed ^= g_seed << 5;
+    return g_seed / 4294967296.0;
+}
+
+/**
+ * Code of slot idx of cell, the groups of a cell take turns on its share of the codes.
+ */
+static uint8_t
+rng_test_pcode(uint8_t cell, uint8_t ncells, uint8_t group, uint16_t idx){
+    if (group == 0)
+        return 0;
+    uint8_t ncodes = MYNEWT_VAL(NRNG_PCODE_NCODES) / ncells;
+    return 1 + cell * ncodes + (idx / group) % ncodes;
+}
+
+static bool
+rng_test_overlap(const rng_test_response_t * a, const rng_test_response_t * b, double offset, double frame){
+    return a->code == b->code && b->start + offset < a->start + frame && a->start < b->start + offset + frame;
+}
+
+/**
+ * Runs RNG_TEST_PCODE_TRIALS exchanges of every cell.
+ *
+ * @return responses lost
+ */
+static uint32_t
+rng_test_pcode_trials(const rng_test_timing_t * timing, uint8_t ncells, uint8_t group){
+    static rng_test_response_t responses[NCELLS][NNODES];
+    double slot = timing->guard + timing->frame;
+    double jitter = MYNEWT_VAL(RNG_TEST_PCODE_JITTER);
+    double rearm = MYNEWT_VAL(RNG_TEST_PCODE_REARM);
+    uint32_t lost = 0;
+
+    for (uint16_t trial = 0; trial < MYNEWT_VAL(RNG_TEST_PCODE_TRIALS); trial++){
+        for (uint8_t c = 0; c < ncells; c++){
+            double offset = (c == 0) ? 0 : uniform() * timing->period;
+            for (uint16_t i = 0; i < NNODES; i++){
+                rng_test_response_t * r = &responses[c][i];
+                r->nominal = offset + timing->holdoff + i * slot;
+                r->start = r->nominal + (2 * uniform() - 1) * jitter;
+                r->code = rng_test_pcode(c, ncells, group, i);
+            }
+        }
+        for (uint8_t c = 0; c < ncells; c++){
+            double ready = 0;   // The receiver is on from the end of the request
+            for (uint16_t i = 0; i < NNODES; i++){
+                rng_test_response_t * r = &responses[c][i];
+                // A new group needs the rx timeout then a rearm on its code, from half a guard before its preamble
+                if (group && i && i % group == 0 && r->nominal - timing->guard / 2 + rearm > ready)
+                    ready = r->nominal - timing->guard / 2 + rearm;
+                bool ok = r->start >= ready;
+                // Other cells repeat with the period, the exchanges either side count as well
+                for (uint8_t k = 0; k < ncells && ok; k++)
+                    for (uint16_t j = 0; j < NNODES && ok; j++)
+                        for (int8_t n = -1; n <= 1 && ok; n++)
+                            if (!(k == c && j == i && n == 0))
+                                ok = !rng_test_overlap(r, &responses[k][j], n * timing->period, timing->frame);
+                if (ok)
+                    ready = r->start + timing->frame + rearm;
+                else
+                    lost++;
+            }
+        }
+    }
+    return lost;
+}
+
+void
+rng_test_pcode_model(dw1000_dev_instance_t * inst){
+    dw1000_rng_config_t * config = dw1000_nrng_get_config(inst, DWT_SS_TWR_NRNG);
+    rng_test_timing_t timing;
+    timing.frame = dw1000_phy_frame_duration(&inst->attrib, sizeof(nrng_response_frame_t));
+    timing.holdoff = dw1000_dwt_usecs_to_usecs(config->tx_holdoff_delay);
+    double guard = dw1000_dwt_usecs_to_usecs(config->tx_guard_delay);
+    double request = dw1000_phy_frame_duration(&inst->attrib, sizeof(nrng_request_frame_t));
+    uint32_t total = MYNEWT_VAL(RNG_TEST_PCODE_TRIALS) * NNODES;
+    float error[NCELLS][2];
+    float throughput[NCELLS][2];
+
+    for (uint8_t step = 0; step <= NSTEPS; step++){
+        timing.guard = guard * step / NSTEPS;
+        timing.period = request + timing.holdoff + NNODES * (timing.guard + timing.frame) + dw1000_dwt_usecs_to_usecs(config->rx_timeout_delay);
+        for (uint8_t ncells = 1; ncells <= NCELLS; ncells++)
+            for (uint8_t p = 0; p < 2; p++){
+                uint8_t group = p ? MYNEWT_VAL(RNG_TEST_PCODE_GROUP) : 0;
+                uint32_t lost = rng_test_pcode_trials(&timing, ncells, group);
+                error[ncells - 1][p] = (float) lost / (total * ncells);
+                throughput[ncells - 1][p] = (total * ncells - lost) / (MYNEWT_VAL(RNG_TEST_PCODE_TRIALS) * timing.period / 1000);
+                printf("{\"test\": \"nrng_pcode\", \"cells\": %d, \"pcode_group\": %d, \"guard_usecs\": %d, \"responses_per_ms\": %.2f, \"error_rate\": %.4f}\n",
+                    ncells, group, (int) timing.guard, throughput[ncells - 1][p], error[ncells - 1][p]);
+            }
+    }
+    // At the configured guard one cell loses nothing either way, two cells sharing the channel code collide and
+    // code groups keep them apart
+    TEST_ASSERT(error[0][0] < 0.01f && error[0][1] < 0.01f);
+    TEST_ASSERT(error[1][1] < error[1][0]);
+    TEST_ASSERT(throughput[1][1] > throughput[1][0]);
+}
+#endif
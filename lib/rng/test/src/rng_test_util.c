@@ -0,0 +1,477 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file rng_test_util.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Ranging exchanges against a simulated DW1000
+ *
+ * @details Runs twr_ss, twr_ds, twr_ds_ext and twr_ss_nrng between the two simulated devices and reports, per profile,
+ * the exchange duration, the host cpu time and bus time of each phase of the exchange and the range error. The bounds
+ * are derived from the configuration of each service: every turnaround must fit its tx_holdoff_delay without a late
+ * start, an exchange must complete within one holdoff per frame plus the airtime of its frames and the initiator of
+ * a lost request must time out once the turnaround, guard, response and rx_timeout_delay have passed. rtdoa needs ccp and wcs, which
+ * switch twr to the wcs timebase, and is exercised on its own in lib/rtdoa/test. Each profile is run once more with
+ * a payload at both ends, which must reach the other end on every frame that carries one. With NRNG_PCODE_ENABLED
+ * twr_ss_nrng also runs over preamble code groups, see rng_test_pcode.c for their throughput against response loss.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "rng_test.h"
+#include <nrng/nrng.h>
+
+//! Profile under test
+typedef struct _rng_test_profile_t{
+    dw1000_rng_modes_t code;        //!< Ranging mode
+    const char * name;              //!< Profile name, as in the README
+    dw1000_dev_status_t (* listen)(dw1000_dev_instance_t * inst, dw1000_dev_modes_t mode);
+    dw1000_dev_status_t (* request)(dw1000_dev_instance_t * inst, dw1000_dev_instance_t * responder, dw1000_rng_modes_t code);
+    float (* range)(dw1000_dev_instance_t * inst);              //!< Range of the last exchange (m), NAN if none
+    dw1000_rng_config_t * (* config)(dw1000_dev_instance_t * inst, dw1000_rng_modes_t code);
+    uint8_t timeout_completes:1;    //!< The exchange ends on a rx timeout, as nrng requests do
+    uint8_t payloads[2];            //!< Frames carrying a payload the initiator and the responder receive
+}rng_test_profile_t;
+
+static dw1000_dev_status_t
+rng_request(dw1000_dev_instance_t * inst, dw1000_dev_instance_t * responder, dw1000_rng_modes_t code){
+    return dw1000_rng_request(inst, responder->my_short_address, code);
+}
+
+static float
+rng_range(dw1000_dev_instance_t * inst){
+    dw1000_rng_instance_t * rng = inst->rng;
+    return dw1000_rng_tof_to_meters(dw1000_rng_twr_to_tof(rng, rng->idx));
+}
+
+static dw1000_dev_status_t
+nrng_request(dw1000_dev_instance_t * inst, dw1000_dev_instance_t * responder, dw1000_rng_modes_t code){
+    return dw1000_nrng_request(inst, BROADCAST_ADDRESS, code, 1UL << responder->slot_id, responder->cell_id);
+}
+
+static float
+nrng_range(dw1000_dev_instance_t * inst){
+    float ranges[32];
+    if (dw1000_nrng_get_ranges(inst, ranges, sizeof(ranges)/sizeof(ranges[0]), inst->nrng->idx) == 0)
+        return NAN;
+    return ranges[0];
+}
+
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+//! Requests one slot per code group, the responder answers in its own slot
+static dw1000_dev_status_t
+nrng_pcode_request(dw1000_dev_instance_t * inst, dw1000_dev_instance_t * responder, dw1000_rng_modes_t code){
+    return dw1000_nrng_request(inst, BROADCAST_ADDRESS, code, (1UL << MYNEWT_VAL(NRNG_PCODE_NCODES)) - 1, responder->cell_id);
+}
+#endif
+
+static const rng_test_profile_t g_profiles[] = {
+    {DWT_SS_TWR,      "twr_ss",      dw1000_rng_listen,  rng_request,  rng_range,  dw1000_rng_get_config,  0, {1, 2}},
+    {DWT_DS_TWR,      "twr_ds",      dw1000_rng_listen,  rng_request,  rng_range,  dw1000_rng_get_config,  0, {2, 2}},
+    {DWT_DS_TWR_EXT,  "twr_ds_ext",  dw1000_rng_listen,  rng_request,  rng_range,  dw1000_rng_get_config,  0, {1, 1}},
+    {DWT_SS_TWR_NRNG, "twr_ss_nrng", dw1000_nrng_listen, nrng_request, nrng_range, dw1000_nrng_get_config, 1, {0, 1}},
+};
+
+//! Trace entry, one per radio event of an exchange
+typedef struct _rng_test_trace_t{
+    uint8_t node;                   //!< Device index
+    dw1000_sim_event_t event;       //!< Radio event
+    uint64_t nsecs;                 //!< Simulated time of the event
+    uint64_t cpu_nsecs;             //!< Host cpu time of the process at the event
+    uint64_t spi_nsecs[2];          //!< Bus time of both devices at the event
+}rng_test_trace_t;
+
+static const char * g_events[] = {"tx_start", "tx_done", "rx_done", "rx_timeout", "rx_lost", "start_late"};
+static rng_test_trace_t g_trace[32];
+static uint16_t g_ntrace;
+static bool g_tracing;
+static dw1000_dev_instance_t * g_inst[2];
+
+/**
+ * Host cpu time of the process. Both devices, the ranging services and the radio model share the process, the time
+ * between two radio events is what the host spent on that phase of the exchange.
+ */
+static uint64_t
+rng_test_cpu_nsecs(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+rng_test_trace(dw1000_dev_instance_t * inst, dw1000_sim_event_t event, uint64_t nsecs){
+    if (!g_tracing || g_ntrace == sizeof(g_trace)/sizeof(g_trace[0]))
+        return;
+    rng_test_trace_t * trace = &g_trace[g_ntrace++];
+    trace->node = (inst == g_inst[0]) ? 0 : 1;
+    trace->event = event;
+    trace->nsecs = nsecs;
+    trace->cpu_nsecs = rng_test_cpu_nsecs();
+    for (uint8_t i = 0; i < 2; i++)
+        trace->spi_nsecs[i] = dw1000_sim_get_stats(g_inst[i])->spi_nsecs;
+}
+
+//! Totals of one exchange
+typedef struct _rng_test_exchange_t{
+    dw1000_dev_status_t status;     //!< Status returned by the request
+    uint64_t start;                 //!< Simulated time of the request
+    uint64_t nsecs;                 //!< Request to completion
+    uint64_t cpu_start;             //!< Host cpu time at the request
+    uint64_t cpu_nsecs;             //!< Host cpu time during the exchange
+    uint64_t spi_start[2];          //!< Bus time of both devices at the request
+    uint64_t spi_nsecs[2];          //!< Bus time of both devices during the exchange
+    float range;                    //!< Range reported by the initiator (m)
+}rng_test_exchange_t;
+
+static rng_test_exchange_t
+rng_test_exchange(const rng_test_profile_t * profile){
+    rng_test_exchange_t exchange;
+    dw1000_dev_instance_t * initiator = g_inst[0];
+    dw1000_dev_instance_t * responder = g_inst[1];
+
+    profile->listen(responder, DWT_NONBLOCKING);
+
+    g_ntrace = 0;
+    g_tracing = true;
+    for (uint8_t i = 0; i < 2; i++)
+        exchange.spi_start[i] = dw1000_sim_get_stats(g_inst[i])->spi_nsecs;
+    exchange.start = dw1000_sim_nsecs();
+    exchange.cpu_start = rng_test_cpu_nsecs();
+
+    exchange.status = profile->request(initiator, responder, profile->code);
+
+    exchange.cpu_nsecs = rng_test_cpu_nsecs() - exchange.cpu_start;
+    exchange.nsecs = dw1000_sim_nsecs() - exchange.start;
+    for (uint8_t i = 0; i < 2; i++)
+        exchange.spi_nsecs[i] = dw1000_sim_get_stats(g_inst[i])->spi_nsecs - exchange.spi_start[i];
+    g_tracing = false;
+
+    exchange.range = profile->range(initiator);
+
+    // Let the responder settle before the next request
+    os_time_delay(1);
+    return exchange;
+}
+
+static void
+rng_test_phases(const rng_test_profile_t * profile, rng_test_exchange_t * exchange){
+    uint64_t nsecs = exchange->start;
+    uint64_t cpu_nsecs = exchange->cpu_start;
+    uint64_t spi_nsecs[2] = {exchange->spi_start[0], exchange->spi_start[1]};
+
+    for (uint16_t i = 0; i < g_ntrace; i++){
+        rng_test_trace_t * trace = &g_trace[i];
+        printf("{\"profile\": \"%s\", \"phase\": %d, \"node\": %d, \"event\": \"%s\", \"usecs\": %lu, \"cpu_usecs\": %lu, \"spi_usecs\": [%lu, %lu]}\n",
+            profile->name, i, trace->node, g_events[trace->event],
+            (uint32_t)((trace->nsecs - nsecs) / 1000),
+            (uint32_t)((trace->cpu_nsecs - cpu_nsecs) / 1000),
+            (uint32_t)((trace->spi_nsecs[0] - spi_nsecs[0]) / 1000),
+            (uint32_t)((trace->spi_nsecs[1] - spi_nsecs[1]) / 1000)
+        );
+        nsecs = trace->nsecs;
+        cpu_nsecs = trace->cpu_nsecs;
+        spi_nsecs[0] = trace->spi_nsecs[0];
+        spi_nsecs[1] = trace->spi_nsecs[1];
+    }
+    printf("{\"profile\": \"%s\", \"phase\": %d, \"node\": 0, \"event\": \"complete\", \"usecs\": %lu, \"cpu_usecs\": %lu, \"spi_usecs\": [%lu, %lu]}\n",
+        profile->name, g_ntrace, (uint32_t)((exchange->start + exchange->nsecs - nsecs) / 1000),
+        (uint32_t)((exchange->cpu_start + exchange->cpu_nsecs - cpu_nsecs) / 1000),
+        (uint32_t)((exchange->spi_start[0] + exchange->spi_nsecs[0] - spi_nsecs[0]) / 1000),
+        (uint32_t)((exchange->spi_start[1] + exchange->spi_nsecs[1] - spi_nsecs[1]) / 1000)
+    );
+}
+
+/**
+ * Longest airtime of the frames a device sent during the traced exchange.
+ */
+static uint64_t
+rng_test_airtime(uint8_t node){
+    uint64_t airtime = 0;
+    for (uint16_t i = 0; i < g_ntrace; i++){
+        if (g_trace[i].node != node || g_trace[i].event != DW1000_SIM_TX_START)
+            continue;
+        for (uint16_t j = i + 1; j < g_ntrace; j++)
+            if (g_trace[j].node == node && g_trace[j].event == DW1000_SIM_TX_DONE){
+                uint64_t nsecs = g_trace[j].nsecs - g_trace[i].nsecs;
+                airtime = (nsecs > airtime) ? nsecs : airtime;
+                break;
+            }
+    }
+    return airtime;
+}
+
+/**
+ * Checks the traced exchange against the configuration of the service: no late start, every response leaves within
+ * tx_holdoff_delay of the frame it answers, and the exchange completes within one holdoff per frame sent, plus one for
+ * the initial request, on top of the airtime of its frames.
+ *
+ * @return the bound on the exchange duration (nsecs)
+ */
+static uint64_t
+rng_test_bounds(const rng_test_profile_t * profile, rng_test_exchange_t * exchange){
+    dw1000_rng_config_t * config = profile->config(g_inst[0], profile->code);
+    uint64_t holdoff = dw1000_dwt_usecs_to_usecs(config->tx_holdoff_delay) * 1000;
+    uint64_t bound = holdoff;
+
+    for (uint16_t i = 0; i < g_ntrace; i++){
+        rng_test_trace_t * trace = &g_trace[i];
+        TEST_ASSERT(trace->event != DW1000_SIM_START_LATE);
+        if (trace->event == DW1000_SIM_TX_DONE){
+            for (int16_t j = i - 1; j >= 0; j--)
+                if (g_trace[j].node == trace->node && g_trace[j].event == DW1000_SIM_TX_START){
+                    bound += holdoff + trace->nsecs - g_trace[j].nsecs;
+                    break;
+                }
+        }
+        if (trace->event != DW1000_SIM_TX_START)
+            continue;
+        for (int16_t j = i - 1; j >= 0; j--)
+            if (g_trace[j].node == trace->node && g_trace[j].event == DW1000_SIM_RX_DONE){
+                TEST_ASSERT(trace->nsecs - g_trace[j].nsecs <= holdoff);
+                break;
+            }
+    }
+    TEST_ASSERT(exchange->nsecs <= bound);
+    return bound;
+}
+
+static void
+rng_test_profile(const rng_test_profile_t * profile){
+    float distance = dw1000_sim_distance(g_inst[0], g_inst[1]);
+    uint64_t nsecs = 0, max_nsecs = 0, cpu_nsecs = 0, bound = 0;
+    uint64_t spi_nsecs[2] = {0, 0};
+    float error = 0, max_error = 0;
+    uint16_t n = MYNEWT_VAL(RNG_TEST_EXCHANGES);
+
+    // The single sided skew correction uses the carrier integrator of the previous exchange, the first one is discarded
+    rng_test_exchange(profile);
+
+    for (uint16_t i = 0; i < n; i++){
+        rng_test_exchange_t exchange = rng_test_exchange(profile);
+        TEST_ASSERT(exchange.status.rx_error == 0);
+        TEST_ASSERT(exchange.status.rx_timeout_error == 0 || profile->timeout_completes);
+        TEST_ASSERT(exchange.status.start_tx_error == 0);
+        TEST_ASSERT(exchange.status.start_rx_error == 0);
+
+        if (i == n - 1)
+            rng_test_phases(profile, &exchange);
+        uint64_t b = rng_test_bounds(profile, &exchange);
+        bound = (b > bound) ? b : bound;
+
+        nsecs += exchange.nsecs;
+        max_nsecs = (exchange.nsecs > max_nsecs) ? exchange.nsecs : max_nsecs;
+        cpu_nsecs += exchange.cpu_nsecs;
+        for (uint8_t j = 0; j < 2; j++)
+            spi_nsecs[j] += exchange.spi_nsecs[j];
+        float e = fabsf(exchange.range - distance);
+        TEST_ASSERT(!isnan(e));
+        error += e;
+        max_error = (e > max_error) ? e : max_error;
+    }
+    nsecs /= n;
+    cpu_nsecs /= n;
+    spi_nsecs[0] /= n;
+    spi_nsecs[1] /= n;
+    error /= n;
+
+    printf("{\"profile\": \"%s\", \"usecs\": %lu, \"max_usecs\": %lu, \"bound_usecs\": %lu, \"cpu_usecs\": %lu, \"spi_usecs\": [%lu, %lu], \"error_mm\": %d, \"max_error_mm\": %d}\n",
+        profile->name, (uint32_t)(nsecs / 1000), (uint32_t)(max_nsecs / 1000), (uint32_t)(bound / 1000),
+        (uint32_t)(cpu_nsecs / 1000), (uint32_t)(spi_nsecs[0] / 1000), (uint32_t)(spi_nsecs[1] / 1000),
+        (int)(error * 1000), (int)(max_error * 1000)
+    );
+
+    TEST_ASSERT(error < MYNEWT_VAL(RNG_TEST_RANGE_ERROR));
+}
+
+static void
+rng_test_lost(const rng_test_profile_t * profile){
+    float distance = dw1000_sim_distance(g_inst[0], g_inst[1]);
+    dw1000_rng_config_t * config = profile->config(g_inst[0], profile->code);
+
+    // Longest response of a complete exchange
+    rng_test_exchange(profile);
+    uint64_t response = rng_test_airtime(1);
+
+    // Nothing reaches the responder, the initiator has to give up once the response is overdue: after the request,
+    // the turnaround, the response with its configured payload and the rx_timeout_delay allowance
+    dw1000_sim_set_loss(g_inst[1], 1.0f);
+    rng_test_exchange_t exchange = rng_test_exchange(profile);
+    TEST_ASSERT(exchange.status.rx_timeout_error == 1);
+    // The rx timeout counts in uwb microseconds, frame durations are rounded up to the next one and nrng slots
+    // take the guard in microseconds
+    uint64_t bound = rng_test_airtime(0) + (uint64_t)(1000 * dw1000_dwt_usecs_to_usecs(response / 1000.0 + 1
+                + config->tx_holdoff_delay + dw1000_dwt_usecs_to_usecs(config->tx_guard_delay) + config->rx_timeout_delay
+                + dw1000_rng_payload_rx_usecs(g_inst[0])));
+    uint64_t nsecs = UINT64_MAX;
+    for (uint16_t i = 0, start = g_ntrace; i < g_ntrace; i++){
+        if (g_trace[i].node != 0)
+            continue;
+        if (g_trace[i].event == DW1000_SIM_TX_START && start == g_ntrace)
+            start = i;
+        if (g_trace[i].event == DW1000_SIM_RX_TIMEOUT && start < g_ntrace){
+            nsecs = g_trace[i].nsecs - g_trace[start].nsecs;
+            break;
+        }
+    }
+    printf("{\"profile\": \"%s\", \"lost_usecs\": %lu, \"timeout_usecs\": %lu, \"bound_usecs\": %lu}\n",
+        profile->name, (uint32_t)(exchange.nsecs / 1000), (uint32_t)(nsecs / 1000), (uint32_t)(bound / 1000));
+    TEST_ASSERT(nsecs <= bound);
+    dw1000_sim_set_loss(g_inst[1], 0.0f);
+
+    // and both sides recover
+    rng_test_exchange(profile);
+    exchange = rng_test_exchange(profile);
+    TEST_ASSERT(exchange.status.rx_timeout_error == 0 || profile->timeout_completes);
+    TEST_ASSERT(fabsf(exchange.range - distance) < 4 * MYNEWT_VAL(RNG_TEST_RANGE_ERROR));
+}
+
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+static const rng_test_profile_t g_pcode_profile =
+    {DWT_SS_TWR_NRNG, "twr_ss_nrng_pcode", dw1000_nrng_listen, nrng_pcode_request, nrng_range, dw1000_nrng_get_config, 1, {0, 1}};
+
+/**
+ * One responder per code group, in each group in turn. The initiator moves to the code of the next group on the rx
+ * timeout that closes a group, with the receiver idle, and must range the responder whichever group it answers in
+ * without a late start. Both sides end on their channel codes.
+ */
+static void
+rng_test_pcode_groups(void){
+    static const uint8_t pcodes[MYNEWT_VAL(NRNG_PCODE_NCODES)] = {9, 10, 11, 12};
+    dw1000_dev_instance_t * initiator = g_inst[0];
+    dw1000_dev_instance_t * responder = g_inst[1];
+    float distance = dw1000_sim_distance(initiator, responder);
+    uint8_t slot_id = responder->slot_id;
+    dw1000_nrng_device_type_t device_type = initiator->nrng->device_type;
+
+    // Code groups are walked by the initiator, NRNG_DEVICE_TYPE makes both devices responders
+    initiator->nrng->device_type = DWT_NRNG_INITIATOR;
+    dw1000_nrng_set_pcodes(initiator, 1, pcodes);
+    dw1000_rng_config_t * config = dw1000_nrng_get_config(initiator, DWT_SS_TWR_NRNG);
+    uint64_t bound = 1000 * (uint64_t)(dw1000_phy_frame_duration(&initiator->attrib, sizeof(nrng_request_frame_t))
+                + dw1000_dwt_usecs_to_usecs(config->tx_holdoff_delay + config->rx_timeout_delay
+                + MYNEWT_VAL(NRNG_PCODE_NCODES) * (config->tx_guard_delay
+                + dw1000_usecs_to_dwt_usecs(dw1000_phy_frame_duration(&initiator->attrib, sizeof(nrng_response_frame_t))))));
+    for (uint8_t slot = 0; slot < MYNEWT_VAL(NRNG_PCODE_NCODES); slot++){
+        responder->slot_id = slot;
+        rng_test_exchange_t exchange = rng_test_exchange(&g_pcode_profile);
+        // Request start to the timeout that closes the last group
+        uint16_t timeouts = 0;
+        uint64_t start = 0, nsecs = 0;
+        for (uint16_t i = 0; i < g_ntrace; i++){
+            TEST_ASSERT(g_trace[i].event != DW1000_SIM_START_LATE);
+            if (g_trace[i].node != 0)
+                continue;
+            if (g_trace[i].event == DW1000_SIM_TX_START && timeouts == 0)
+                start = g_trace[i].nsecs;
+            if (g_trace[i].event == DW1000_SIM_RX_TIMEOUT){
+                nsecs = g_trace[i].nsecs - start;
+                timeouts++;
+            }
+        }
+        printf("{\"profile\": \"%s\", \"slot\": %d, \"usecs\": %lu, \"listen_usecs\": %lu, \"bound_usecs\": %lu, \"rx_timeouts\": %d, \"error_mm\": %d}\n",
+            g_pcode_profile.name, slot, (uint32_t)(exchange.nsecs / 1000), (uint32_t)(nsecs / 1000), (uint32_t)(bound / 1000), timeouts, (int)(fabsf(exchange.range - distance) * 1000));
+        TEST_ASSERT(exchange.status.rx_error == 0 && exchange.status.start_rx_error == 0);
+        TEST_ASSERT(exchange.status.start_tx_error == 0);
+        // The last group closes once every slot has passed
+        TEST_ASSERT(nsecs <= bound);
+        // One timeout closes each group
+        TEST_ASSERT(timeouts == MYNEWT_VAL(NRNG_PCODE_NCODES));
+        TEST_ASSERT(fabsf(exchange.range - distance) < 4 * MYNEWT_VAL(RNG_TEST_RANGE_ERROR));
+        for (uint8_t i = 0; i < 2; i++){
+            uint32_t chan_ctrl = dw1000_read_reg(g_inst[i], CHAN_CTRL_ID, 0, sizeof(uint32_t));
+            TEST_ASSERT(((chan_ctrl & CHAN_CTRL_TX_PCOD_MASK) >> CHAN_CTRL_TX_PCOD_SHIFT) == g_inst[i]->config.tx.preambleCodeIndex);
+            TEST_ASSERT(((chan_ctrl & CHAN_CTRL_RX_PCOD_MASK) >> CHAN_CTRL_RX_PCOD_SHIFT) == g_inst[i]->config.rx.preambleCodeIndex);
+        }
+    }
+    dw1000_nrng_set_pcodes(initiator, 0, pcodes);
+    initiator->nrng->device_type = device_type;
+    responder->slot_id = slot_id;
+}
+#endif
+
+static uint8_t g_payloads[2];
+
+static uint16_t
+rng_test_producer(dw1000_dev_instance_t * inst, uint16_t code, uint8_t * buf, uint16_t len){
+    uint16_t offset = 0;
+    dw1000_rng_tlv_put(buf, len, &offset, 1, &code, sizeof(code));
+    return offset;
+}
+
+static void
+rng_test_consumer(dw1000_dev_instance_t * inst, uint16_t src_address, uint8_t type, uint8_t * value, uint8_t len){
+    uint8_t node = (inst == g_inst[0]) ? 0 : 1;
+    if (type == 1 && len == sizeof(uint16_t) && src_address == g_inst[!node]->my_short_address)
+        g_payloads[node]++;
+}
+
+static void
+rng_test_payload(const rng_test_profile_t * profile){
+    float distance = dw1000_sim_distance(g_inst[0], g_inst[1]);
+
+    // Both ends carry a payload, every frame that takes one delivers it and the range is unaffected
+    for (uint8_t i = 0; i < 2; i++)
+        dw1000_rng_set_payload(g_inst[i], rng_test_producer, rng_test_consumer, UINT16_MAX);
+    memset(g_payloads, 0, sizeof(g_payloads));
+    rng_test_exchange_t exchange = rng_test_exchange(profile);
+    printf("{\"profile\": \"%s\", \"payload_usecs\": %lu, \"payloads\": [%d, %d]}\n",
+        profile->name, (uint32_t)(exchange.nsecs / 1000), g_payloads[0], g_payloads[1]);
+    TEST_ASSERT(exchange.status.rx_timeout_error == 0 || profile->timeout_completes);
+    TEST_ASSERT(g_payloads[0] == profile->payloads[0] && g_payloads[1] == profile->payloads[1]);
+    TEST_ASSERT(fabsf(exchange.range - distance) < 4 * MYNEWT_VAL(RNG_TEST_RANGE_ERROR));
+
+    for (uint8_t i = 0; i < 2; i++)
+        dw1000_rng_set_payload(g_inst[i], NULL, NULL, 0);
+}
+
+void
+rng_test_handler(void *arg)
+{
+    sysinit();
+
+    g_inst[0] = hal_dw1000_inst(0);
+    g_inst[1] = hal_dw1000_inst(1);
+    g_inst[0]->slot_id = 0;
+    g_inst[1]->slot_id = 1;
+    dw1000_sim_set_position(g_inst[1], MYNEWT_VAL(RNG_TEST_DISTANCE), 0, 0);
+    dw1000_sim_set_drift(g_inst[0], MYNEWT_VAL(RNG_TEST_DRIFT));
+    dw1000_sim_set_drift(g_inst[1], -MYNEWT_VAL(RNG_TEST_DRIFT));
+    dw1000_sim_set_trace(rng_test_trace);
+
+    for (uint16_t i = 0; i < sizeof(g_profiles)/sizeof(g_profiles[0]); i++)
+        rng_test_profile(&g_profiles[i]);
+    for (uint16_t i = 0; i < sizeof(g_profiles)/sizeof(g_profiles[0]); i++)
+        rng_test_lost(&g_profiles[i]);
+    for (uint16_t i = 0; i < sizeof(g_profiles)/sizeof(g_profiles[0]); i++)
+        rng_test_payload(&g_profiles[i]);
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+    rng_test_pcode_groups();
+    rng_test_pcode_model(g_inst[0]);
+#endif
+
+    dw1000_sim_set_trace(NULL);
+    tu_restart();
+}
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Slot index helpers against the loop implementations they replaced. Every helper must agree with its reference
+ * on random masks, then one request's worth of lookups, each slot of the mask ranked once as the nrng responders
+ * and encoders do, is timed with host cpu time for both.
+ */
+#include <time.h>
+#include "rng_test.h"
+#include <rng/slots.h>
+
+static uint32_t
+ref_NumberOfBits(uint32_t n){
+    uint32_t count = 0;
+    while (n) {
+        n &= (n-1);
+        count++;
+    }
+    return count;
+}
+
+static uint32_t
+ref_BitPosition(uint32_t n){
+    uint32_t count = 0;
+    while (n){
+        n = n >> 1;
+        ++count;
+    }
+    return count;
+}
+
+static uint32_t
+ref_BitIndex(uint32_t nslots_mask, uint32_t n, slot_mode_t mode){
+    uint32_t idx = ref_BitPosition(n);
+    uint32_t slot_mask =  (((uint32_t)~0UL >> (sizeof(uint32_t) * 8 - idx)));
+    // Shifting by 32 is undefined, Cortex-M yields 0 and so does BitIndex
+    uint32_t remaining_mask = (idx < 32) ? ((uint32_t)~0UL << idx) : 0;
+
+    if (mode == SLOT_POSITION)
+        return ref_NumberOfBits(nslots_mask & slot_mask) - 1;
+    else
+        return ref_NumberOfBits(nslots_mask & remaining_mask) - 1;
+}
+
+//! Rank of slot by testing each slot below it
+static uint16_t
+ref_rank(const uint32_t map[], uint16_t slot){
+    uint16_t rank = 0;
+    for (uint16_t i = 0; i < slot; i++)
+        rank += ref_NumberOfBits(map[i >> 5] & 1UL << (i & 31));
+    return rank;
+}
+
+static uint32_t g_seed = 0x2545F491;
+
+static uint32_t
+xorshift32(void){
+    g_seed ^= g_seed << 13;
+    g_seed ^= g_seed >> 17;
+    g_seed ^= g_seed << 5;
+    return g_seed;
+}
+
+static uint64_t
+cpu_nsecs(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#define NWORDS SLOT_MAP_WORDS(MYNEWT_VAL(RNG_TEST_SLOTS))
+
+static void
+rng_slots_equivalence(void){
+
+    for (uint16_t i = 0; i < MYNEWT_VAL(RNG_TEST_SLOTS_MASKS); i++){
+        uint32_t mask = xorshift32() & xorshift32();
+        TEST_ASSERT(NumberOfBits(mask) == ref_NumberOfBits(mask));
+        for (uint16_t slot = 0; slot < 32; slot++){
+            if (!(mask & 1UL << slot))
+                continue;
+            TEST_ASSERT(BitPosition(1UL << slot) == ref_BitPosition(1UL << slot));
+            TEST_ASSERT(BitIndex(mask, 1UL << slot, SLOT_POSITION) == ref_BitIndex(mask, 1UL << slot, SLOT_POSITION));
+            TEST_ASSERT(BitIndex(mask, 1UL << slot, SLOT_REMAINING) == ref_BitIndex(mask, 1UL << slot, SLOT_REMAINING));
+        }
+    }
+
+    uint32_t map[NWORDS];
+    uint16_t table[NWORDS];
+    for (uint16_t i = 0; i < MYNEWT_VAL(RNG_TEST_SLOTS_MASKS); i++){
+        for (uint16_t w = 0; w < NWORDS; w++)
+            map[w] = xorshift32() & xorshift32();
+        uint16_t n = slot_map_rank_table(map, NWORDS, table);
+        TEST_ASSERT(n == slot_map_count(map, NWORDS));
+        uint16_t rank = 0;
+        SLOT_MAP_FOREACH(map, NWORDS, slot){
+            TEST_ASSERT(slot_map_rank_cached(map, table, slot) == ref_rank(map, slot));
+            TEST_ASSERT(slot_map_rank(map, slot) == rank);
+            TEST_ASSERT(slot_map_select(map, table, NWORDS, rank) == slot);
+            rank++;
+        }
+        TEST_ASSERT(rank == n);
+    }
+}
+
+static void
+rng_slots_benchmark(void){
+
+    volatile uint32_t sink = 0;
+    uint32_t masks[16];
+    for (uint16_t i = 0; i < sizeof(masks)/sizeof(masks[0]); i++)
+        masks[i] = xorshift32() | xorshift32();
+
+    // A 32 slot request, each slot of the mask located once
+    uint64_t start = cpu_nsecs();
+    for (uint32_t i = 0; i < MYNEWT_VAL(RNG_TEST_SLOTS_ITERATIONS); i++){
+        uint32_t mask = masks[i % 16];
+        for (uint16_t slot = 0; slot < 32; slot++)
+            if (mask & 1UL << slot)
+                sink += ref_BitIndex(mask, 1UL << slot, SLOT_POSITION);
+    }
+    uint64_t ref_nsecs = cpu_nsecs() - start;
+    start = cpu_nsecs();
+    for (uint32_t i = 0; i < MYNEWT_VAL(RNG_TEST_SLOTS_ITERATIONS); i++){
+        uint32_t mask = masks[i % 16];
+        for (uint16_t slot = 0; slot < 32; slot++)
+            if (mask & 1UL << slot)
+                sink += BitIndex(mask, 1UL << slot, SLOT_POSITION);
+    }
+    uint64_t nsecs = cpu_nsecs() - start;
+    printf("{\"test\": \"slot_index\", \"nslots\": 32, \"ref_nsecs\": %lu, \"nsecs\": %lu}\n",
+        (unsigned long)(ref_nsecs / MYNEWT_VAL(RNG_TEST_SLOTS_ITERATIONS)),
+        (unsigned long)(nsecs / MYNEWT_VAL(RNG_TEST_SLOTS_ITERATIONS)));
+
+    // A RNG_TEST_SLOTS slot map, the rank table built once per request then each set slot ranked
+    uint32_t map[NWORDS];
+    uint16_t table[NWORDS];
+    for (uint16_t w = 0; w < NWORDS; w++)
+        map[w] = xorshift32() | xorshift32();
+    uint32_t iterations = MYNEWT_VAL(RNG_TEST_SLOTS_ITERATIONS) / NWORDS + 1;
+    start = cpu_nsecs();
+    for (uint32_t i = 0; i < iterations; i++)
+        SLOT_MAP_FOREACH(map, NWORDS, slot)
+            sink += ref_rank(map, slot);
+    ref_nsecs = cpu_nsecs() - start;
+    start = cpu_nsecs();
+    for (uint32_t i = 0; i < iterations; i++){
+        slot_map_rank_table(map, NWORDS, table);
+        SLOT_MAP_FOREACH(map, NWORDS, slot)
+            sink += slot_map_rank_cached(map, table, slot);
+    }
+    nsecs = cpu_nsecs() - start;
+    printf("{\"test\": \"slot_map_rank\", \"nslots\": %d, \"ref_nsecs\": %lu, \"nsecs\": %lu}\n",
+        MYNEWT_VAL(RNG_TEST_SLOTS), (unsigned long)(ref_nsecs / iterations), (unsigned long)(nsecs / iterations));
+    (void) sink;
+}
+
+TEST_CASE(rng_slots_tests)
+{
+    rng_slots_equivalence();
+    rng_slots_benchmark();
+}
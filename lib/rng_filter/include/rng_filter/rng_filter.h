@@ -0,0 +1,110 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file rng_filter.h
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Per-peer range filter bank
+ *
+ * @details Fixed capacity table of range filters keyed by peer short address. The least recently
+ * updated peer is evicted when the table is full. No dynamic memory is used. The kalman filters
+ * additionally fuse the carrier frequency offset of each received frame as a Doppler range-rate
+ * measurement, see rng_filter_update_rate().
+ */
+
+#ifndef _RNG_FILTER_H_
+#define _RNG_FILTER_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <os/os.h>
+#include <stats/stats.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if MYNEWT_VAL(RNG_FILTER_STATS)
+STATS_SECT_START(rng_filter_stat_section)
+    STATS_SECT_ENTRY(update)
+    STATS_SECT_ENTRY(reject)
+    STATS_SECT_ENTRY(reinit)
+    STATS_SECT_ENTRY(evict)
+    STATS_SECT_ENTRY(rate_update)
+STATS_SECT_END
+#endif
+
+typedef enum _rng_filter_type_t{
+    RNG_FILTER_KALMAN = 0,          //!< Constant-velocity kalman filter
+    RNG_FILTER_MEDIAN,              //!< Median of last RNG_FILTER_MEDIAN_N ranges
+    RNG_FILTER_NIS                  //!< Constant-velocity kalman filter with NIS outlier gate
+}rng_filter_type_t;
+
+typedef struct _rng_filter_config_t{
+    rng_filter_type_t type;         //!< Filter applied to new peers
+    float qvar;                     //!< Process noise, acceleration variance (m^2/s^4)
+    float rvar;                     //!< Measurement variance of a LOS range (m^2)
+    float nlos_gain;                //!< Measurement variance multiplier for a NLOS range
+    float nis_gate;                 //!< Normalized innovation squared rejection threshold
+    uint16_t max_rejects;           //!< Consecutive rejects before reinitialization
+    float dvar;                     //!< Measurement variance of a Doppler range-rate (m^2/s^2)
+    float bias_gain;                //!< Gain of the per-peer oscillator offset tracking, 0 disables tracking
+}rng_filter_config_t;
+
+typedef struct _rng_filter_result_t{
+    float range;                    //!< Filtered range (m)
+    float rate;                     //!< Range-rate (m/s)
+    float variance;                 //!< Range variance (m^2)
+    float rate_variance;            //!< Range-rate variance (m^2/s^2)
+    float nis;                      //!< Normalized innovation squared of last update
+    uint16_t rejected:1;            //!< Last range was rejected as an outlier
+}rng_filter_result_t;
+
+typedef struct _rng_filter_node_t{
+    uint16_t addr;                  //!< Peer short address, 0 marks a free entry
+    uint8_t type;                   //!< rng_filter_type_t
+    uint8_t widx;                   //!< Median window write index
+    uint16_t rejects;               //!< Consecutive rejects
+    uint32_t num;                   //!< Accepted ranges
+    uint32_t last_updated;          //!< os_cputime of last update
+    float x[2];                     //!< State: range, range-rate
+    float P[3];                     //!< Covariance: P00, P01, P11
+    float bias;                     //!< Oscillator offset ratio between peer and local clock
+    uint32_t nbias;                 //!< Oscillator offset updates, the seed included
+    uint32_t nrate;                 //!< Doppler measurements fused
+    float window[MYNEWT_VAL(RNG_FILTER_MEDIAN_N)];
+    rng_filter_result_t result;
+}rng_filter_node_t;
+
+int rng_filter_update(uint16_t addr, float range, float los, rng_filter_result_t * result);
+int rng_filter_update_rate(uint16_t addr, float ratio, float osc, rng_filter_result_t * result);
+int rng_filter_get(uint16_t addr, rng_filter_result_t * result);
+int rng_filter_reset(uint16_t addr);
+void rng_filter_set_config(rng_filter_config_t * config);
+rng_filter_config_t * rng_filter_get_config(void);
+rng_filter_node_t * rng_filter_get_nodes(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RNG_FILTER_H_ */
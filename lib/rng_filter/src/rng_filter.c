@@ -0,0 +1,470 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file rng_filter.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Per-peer range filter bank
+ *
+ * @details Each peer is tracked by a constant-velocity kalman filter, a median-of-N window or a kalman
+ * filter with a normalized innovation squared (NIS) outlier gate. Range measurements are weighted by
+ * their line of sight likelihood, see dw1000_estimate_los() and dw1000_rng_is_los().
+ *
+ * The carrier frequency offset measured on a received frame is the sum of the oscillator offset between
+ * the two nodes and the Doppler shift, -v/c. The oscillator part is tracked per peer by low-passing the
+ * offset left after removing the range-rate of the differential range. What remains is fused into the
+ * kalman range-rate state.
+ *
+ * With RNG_FILTER_ENABLED rng_encode() and nrng_encode() pass every range through the bank, report the
+ * filtered range and drop the ranges flagged as rejected.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <os/os.h>
+#include <os/os_cputime.h>
+#include <stats/stats.h>
+#include <rng_filter/rng_filter.h>
+
+#if MYNEWT_VAL(RNG_FILTER_STATS)
+STATS_NAME_START(rng_filter_stat_section)
+    STATS_NAME(rng_filter_stat_section, update)
+    STATS_NAME(rng_filter_stat_section, reject)
+    STATS_NAME(rng_filter_stat_section, reinit)
+    STATS_NAME(rng_filter_stat_section, evict)
+    STATS_NAME(rng_filter_stat_section, rate_update)
+STATS_NAME_END(rng_filter_stat_section)
+
+static STATS_SECT_DECL(rng_filter_stat_section) g_stat;
+#define RNG_FILTER_STATS_INC(__X) STATS_INC(g_stat, __X)
+#else
+#define RNG_FILTER_STATS_INC(__X) {}
+#endif
+
+#define RNG_FILTER_P11_INIT (4.0f)  // Initial range-rate variance (m^2/s^2)
+#define RNG_FILTER_C (299792458.0f/1.000293f)   // Speed of light in air (m/s)
+
+static rng_filter_config_t g_config = {
+    .type = MYNEWT_VAL(RNG_FILTER_TYPE),
+    .qvar = MYNEWT_VAL(RNG_FILTER_QVAR),
+    .rvar = MYNEWT_VAL(RNG_FILTER_RVAR),
+    .nlos_gain = MYNEWT_VAL(RNG_FILTER_NLOS_GAIN),
+    .nis_gate = MYNEWT_VAL(RNG_FILTER_NIS_GATE),
+    .max_rejects = MYNEWT_VAL(RNG_FILTER_MAX_REJECTS),
+    .dvar = MYNEWT_VAL(RNG_FILTER_DVAR),
+    .bias_gain = MYNEWT_VAL(RNG_FILTER_BIAS_GAIN)
+};
+
+static rng_filter_node_t nodes[MYNEWT_VAL(RNG_FILTER_NNODES)];
+
+/**
+ * API to access the filter table.
+ *
+ * @return Pointer to the first of RNG_FILTER_NNODES entries.
+ */
+rng_filter_node_t *
+rng_filter_get_nodes(void)
+{
+    return nodes;
+}
+
+/**
+ * API to access the current filter configuration.
+ *
+ * @return Pointer to rng_filter_config_t.
+ */
+rng_filter_config_t *
+rng_filter_get_config(void)
+{
+    return &g_config;
+}
+
+/**
+ * API to replace the filter configuration. The filter type applies to peers added after the call.
+ *
+ * @param config  Pointer to rng_filter_config_t.
+ * @return void
+ */
+void
+rng_filter_set_config(rng_filter_config_t * config)
+{
+    assert(config);
+    memcpy(&g_config, config, sizeof(rng_filter_config_t));
+}
+
+/**
+ * Find the entry for addr. When not found a free entry is claimed, or failing that
+ * the least recently updated entry is evicted.
+ *
+ * @param addr  Peer short address.
+ * @param now   os_cputime of the lookup.
+ * @return rng_filter_node_t
+ */
+static rng_filter_node_t *
+node_lookup(uint16_t addr, uint32_t now)
+{
+    rng_filter_node_t * free = NULL;
+    rng_filter_node_t * lru = &nodes[0];
+
+    for (uint16_t i = 0; i < MYNEWT_VAL(RNG_FILTER_NNODES); i++) {
+        if (nodes[i].addr == addr)
+            return &nodes[i];
+        if (nodes[i].addr == 0) {
+            if (free == NULL)
+                free = &nodes[i];
+        } else if ((int32_t)(now - nodes[i].last_updated) > (int32_t)(now - lru->last_updated)) {
+            lru = &nodes[i];
+        }
+    }
+    if (free == NULL) {
+        RNG_FILTER_STATS_INC(evict);
+        free = lru;
+    }
+    memset(free, 0, sizeof(rng_filter_node_t));
+    free->addr = addr;
+    free->type = g_config.type;
+    return free;
+}
+
+/**
+ * Measurement variance scaled by line of sight likelihood, los = 1.0 gives rvar and
+ * los = 0.0 gives rvar * nlos_gain.
+ */
+static float
+measurement_variance(float los)
+{
+    if (!(los >= 0.0f)) los = 0.0f;     // also catches NaN
+    if (los > 1.0f) los = 1.0f;
+    return g_config.rvar * (1.0f + (g_config.nlos_gain - 1.0f) * (1.0f - los));
+}
+
+static void
+kalman_reinit(rng_filter_node_t * node, float range, float R)
+{
+    node->x[0] = range;
+    node->x[1] = 0.0f;
+    node->P[0] = R;
+    node->P[1] = 0.0f;
+    node->P[2] = RNG_FILTER_P11_INIT;
+    node->rejects = 0;
+}
+
+static void
+kalman_predict(rng_filter_node_t * node, float dt)
+{
+    float * x = node->x;
+    float * P = node->P;
+
+    // White acceleration noise model
+    float dt2 = dt * dt;
+    float q = g_config.qvar;
+    x[0] += x[1] * dt;
+    P[0] += 2.0f * dt * P[1] + dt2 * P[2] + q * dt2 * dt2 / 4.0f;
+    P[1] += dt * P[2] + q * dt2 * dt / 2.0f;
+    P[2] += q * dt2;
+}
+
+static void
+kalman_update(rng_filter_node_t * node, float range, float R, float dt, bool gated)
+{
+    float * x = node->x;
+    float * P = node->P;
+    rng_filter_result_t * result = &node->result;
+
+    if (node->num == 0) {
+        kalman_reinit(node, range, R);
+        result->nis = 0.0f;
+        result->rejected = 0;
+        node->num++;
+        return;
+    }
+
+    kalman_predict(node, dt);
+
+    float y = range - x[0];
+    float S = P[0] + R;
+    result->nis = y * y / S;
+
+    if (gated && result->nis > g_config.nis_gate) {
+        RNG_FILTER_STATS_INC(reject);
+        result->rejected = 1;
+        if (++node->rejects >= g_config.max_rejects) {
+            // Persistent disagreement, the track is more likely wrong than the measurements
+            RNG_FILTER_STATS_INC(reinit);
+            kalman_reinit(node, range, R);
+            result->rejected = 0;
+        }
+        return;
+    }
+
+    float K0 = P[0] / S;
+    float K1 = P[1] / S;
+    x[0] += K0 * y;
+    x[1] += K1 * y;
+    P[2] -= K1 * P[1];
+    P[1] -= K0 * P[1];
+    P[0] -= K0 * P[0];
+
+    node->rejects = 0;
+    result->rejected = 0;
+    node->num++;
+}
+
+static float
+median(float * buf, uint16_t n)
+{
+    for (uint16_t i = 1; i < n; i++) {
+        float v = buf[i];
+        int16_t j = i - 1;
+        for (; j >= 0 && buf[j] > v; j--)
+            buf[j + 1] = buf[j];
+        buf[j + 1] = v;
+    }
+    return (n & 1) ? buf[n / 2] : (buf[n / 2 - 1] + buf[n / 2]) / 2.0f;
+}
+
+static void
+median_update(rng_filter_node_t * node, float range, float R, float dt)
+{
+    float tmp[MYNEWT_VAL(RNG_FILTER_MEDIAN_N)];
+    float last = node->x[0];
+
+    node->window[node->widx] = range;
+    node->widx = (node->widx + 1) % MYNEWT_VAL(RNG_FILTER_MEDIAN_N);
+    node->num++;
+
+    uint16_t n = (node->num < MYNEWT_VAL(RNG_FILTER_MEDIAN_N)) ? node->num : MYNEWT_VAL(RNG_FILTER_MEDIAN_N);
+    memcpy(tmp, node->window, n * sizeof(float));
+    node->x[0] = median(tmp, n);
+
+    // Median absolute deviation, 1.4826 * MAD is a consistent estimator of sigma
+    for (uint16_t i = 0; i < n; i++)
+        tmp[i] = fabsf(node->window[i] - node->x[0]);
+    float sigma = 1.4826f * median(tmp, n);
+
+    float P0 = (n > 2) ? sigma * sigma + R / n : R;
+    node->result.nis = (P0 > 0.0f) ? (range - node->x[0]) * (range - node->x[0]) / P0 : 0.0f;
+    // The spread of fewer than three ranges says nothing about outliers
+    node->result.rejected = (n > 2 && node->result.nis > g_config.nis_gate);
+    if (node->result.rejected) {
+        // Kept in the window so a real step is followed once it holds the majority, the output stays put
+        RNG_FILTER_STATS_INC(reject);
+        node->x[0] = last;
+        return;
+    }
+    node->x[1] = (node->num > 1 && dt > 0.0f) ? (node->x[0] - last) / dt : 0.0f;
+    node->P[0] = P0;
+}
+
+/**
+ * API to feed a new range measurement to the filter of a peer. The peer is added to the table
+ * on first use, evicting the least recently updated peer when the table is full.
+ *
+ * @param addr    Peer short address, 0 is reserved.
+ * @param range   Measured range (m).
+ * @param los     Line of sight likelihood in [0, 1], see dw1000_estimate_los().
+ * @param result  Optional pointer to rng_filter_result_t receiving the filter output.
+ * @return OS_OK on success, OS_EINVAL on invalid arguments.
+ */
+int
+rng_filter_update(uint16_t addr, float range, float los, rng_filter_result_t * result)
+{
+    if (addr == 0 || !isfinite(range))
+        return OS_EINVAL;
+
+    uint32_t now = os_cputime_get32();
+    rng_filter_node_t * node = node_lookup(addr, now);
+    float dt = (node->num) ? os_cputime_ticks_to_usecs(now - node->last_updated) * 1e-6f : 0.0f;
+    float R = measurement_variance(los);
+
+    RNG_FILTER_STATS_INC(update);
+    switch (node->type) {
+        case RNG_FILTER_MEDIAN:
+            median_update(node, range, R, dt);
+            break;
+        case RNG_FILTER_NIS:
+            kalman_update(node, range, R, dt, true);
+            break;
+        case RNG_FILTER_KALMAN:
+        default:
+            kalman_update(node, range, R, dt, false);
+            break;
+    }
+    node->last_updated = now;
+    node->result.range = node->x[0];
+    node->result.rate = node->x[1];
+    node->result.variance = node->P[0];
+    node->result.rate_variance = node->P[2];
+
+    if (result)
+        memcpy(result, &node->result, sizeof(rng_filter_result_t));
+    return OS_OK;
+}
+
+/**
+ * API to fuse the carrier frequency offset of a frame received from a tracked peer as a range-rate
+ * measurement, normally called right after rng_filter_update() for the same exchange. The oscillator
+ * offset is seeded with osc and then learnt from the differential range-rate, the range-rate is left alone
+ * until it has settled.
+ *
+ * @param addr    Peer short address.
+ * @param ratio   Clock offset ratio of the frame, dw1000_calc_clock_offset_ratio(inst, inst->carrier_integrator).
+ * @param osc     Expected oscillator offset ratio to the peer, e.g. -wcs->skew when the peer is the
+ *                clock master or the first ratio measured from the peer, only used on the first call.
+ * @param result  Optional pointer to rng_filter_result_t receiving the filter output.
+ * @return OS_OK on success, OS_ENOENT if the peer has no range yet, OS_EINVAL on invalid arguments.
+ */
+int
+rng_filter_update_rate(uint16_t addr, float ratio, float osc, rng_filter_result_t * result)
+{
+    if (addr == 0 || !isfinite(ratio) || !isfinite(osc))
+        return OS_EINVAL;
+
+    rng_filter_node_t * node = NULL;
+    for (uint16_t i = 0; i < MYNEWT_VAL(RNG_FILTER_NNODES) && node == NULL; i++)
+        if (nodes[i].addr == addr)
+            node = &nodes[i];
+    if (node == NULL || node->num == 0)
+        return OS_ENOENT;
+
+    uint32_t now = os_cputime_get32();
+    float dt = os_cputime_ticks_to_usecs(now - node->last_updated) * 1e-6f;
+    float * x = node->x;
+    float * P = node->P;
+
+    if (node->nbias == 0) {
+        node->bias = osc;
+        node->nbias++;
+    } else if (node->num > 2) {
+        // Offset not explained by the differential range-rate is attributed to the oscillators
+        node->bias += g_config.bias_gain * ((ratio + x[1] / RNG_FILTER_C) - node->bias);
+        node->nbias++;
+    }
+    // 1 ppm of bias error reads as 300 m/s, the offset is only fused once the bias has settled for
+    // RNG_FILTER_BIAS_SETTLE time constants of bias_gain
+    if (g_config.bias_gain > 0.0f && node->nbias * g_config.bias_gain < MYNEWT_VAL(RNG_FILTER_BIAS_SETTLE)) {
+        if (result)
+            memcpy(result, &node->result, sizeof(rng_filter_result_t));
+        return OS_OK;
+    }
+    node->nrate++;
+
+    float rate = -RNG_FILTER_C * (ratio - node->bias);
+    RNG_FILTER_STATS_INC(rate_update);
+
+    switch (node->type) {
+        case RNG_FILTER_MEDIAN:
+            x[1] = rate;
+            P[2] = g_config.dvar;
+            break;
+        case RNG_FILTER_NIS:
+        case RNG_FILTER_KALMAN:
+        default:{
+            kalman_predict(node, dt);
+            float y = rate - x[1];
+            float S = P[2] + g_config.dvar;
+            float K0 = P[1] / S;
+            float K1 = P[2] / S;
+            x[0] += K0 * y;
+            x[1] += K1 * y;
+            P[0] -= K0 * P[1];
+            P[1] -= K0 * P[2];
+            P[2] -= K1 * P[2];
+            break;
+        }
+    }
+    node->last_updated = now;
+    node->result.range = x[0];
+    node->result.rate = x[1];
+    node->result.variance = P[0];
+    node->result.rate_variance = P[2];
+
+    if (result)
+        memcpy(result, &node->result, sizeof(rng_filter_result_t));
+    return OS_OK;
+}
+
+/**
+ * API to read the latest filter output of a peer.
+ *
+ * @param addr    Peer short address.
+ * @param result  Pointer to rng_filter_result_t.
+ * @return OS_OK on success, OS_ENOENT if the peer is not tracked.
+ */
+int
+rng_filter_get(uint16_t addr, rng_filter_result_t * result)
+{
+    if (addr == 0 || result == NULL)
+        return OS_EINVAL;
+
+    for (uint16_t i = 0; i < MYNEWT_VAL(RNG_FILTER_NNODES); i++) {
+        if (nodes[i].addr == addr) {
+            memcpy(result, &nodes[i].result, sizeof(rng_filter_result_t));
+            return OS_OK;
+        }
+    }
+    return OS_ENOENT;
+}
+
+/**
+ * API to drop the filter state of a peer, addr = 0xffff clears the whole table.
+ *
+ * @param addr  Peer short address.
+ * @return OS_OK on success, OS_ENOENT if the peer is not tracked.
+ */
+int
+rng_filter_reset(uint16_t addr)
+{
+    if (addr == 0xffff) {
+        memset(nodes, 0, sizeof(nodes));
+        return OS_OK;
+    }
+    for (uint16_t i = 0; i < MYNEWT_VAL(RNG_FILTER_NNODES); i++) {
+        if (addr && nodes[i].addr == addr) {
+            memset(&nodes[i], 0, sizeof(rng_filter_node_t));
+            return OS_OK;
+        }
+    }
+    return OS_ENOENT;
+}
+
+/**
+ * Function for initializing the range filter bank.
+ *
+ * @return void
+ */
+void
+rng_filter_pkg_init(void)
+{
+    memset(nodes, 0, sizeof(nodes));
+#if MYNEWT_VAL(RNG_FILTER_STATS)
+    int rc = stats_init(
+                STATS_HDR(g_stat),
+                STATS_SIZE_INIT_PARMS(g_stat, STATS_SIZE_32),
+                STATS_NAME_INIT_PARMS(rng_filter_stat_section)
+            );
+    rc |= stats_register("rngf", STATS_HDR(g_stat));
+    assert(rc == 0);
+#endif
+}
@@ -0,0 +1,349 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file rtdoa_test_util.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief RTDoA exchanges against a simulated DW1000
+ *
+ * @details Device 0 is an rtdoa node that sends a request and its own response, device 1 a tag that times both.
+ * Both frames come from the same node, the tdoa between them is zero and what the tag reports is the error. No ccp
+ * runs: the node is its own master and the tag's clock model is set to the skew ccp would converge to. Reports the
+ * exchange duration, the host cpu time and bus time of each phase and the tdoa error. The response must leave at the
+ * slot rtdoa_usecs_to_response() schedules from the request, without a late start, and the tag must time out once
+ * the response is overdue. A payload on the request must reach the tag without moving the response.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "rtdoa_test.h"
+#include <ccp/ccp.h>
+#include <wcs/wcs.h>
+#include <rtdoa_node/rtdoa_node.h>
+#include <rtdoa_tag/rtdoa_tag.h>
+
+//! Trace entry, one per radio event of an exchange
+typedef struct _rtdoa_test_trace_t{
+    uint8_t node;                   //!< Device index
+    dw1000_sim_event_t event;       //!< Radio event
+    uint64_t nsecs;                 //!< Simulated time of the event
+    uint64_t cpu_nsecs;             //!< Host cpu time of the process at the event
+    uint64_t spi_nsecs[2];          //!< Bus time of both devices at the event
+}rtdoa_test_trace_t;
+
+static const char * g_events[] = {"tx_start", "tx_done", "rx_done", "rx_timeout", "rx_lost", "start_late"};
+static rtdoa_test_trace_t g_trace[32];
+static uint16_t g_ntrace;
+static bool g_tracing;
+static dw1000_dev_instance_t * g_inst[2];
+
+/**
+ * Host cpu time of the process, see rng_test_util.c.
+ */
+static uint64_t
+rtdoa_test_cpu_nsecs(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+rtdoa_test_trace(dw1000_dev_instance_t * inst, dw1000_sim_event_t event, uint64_t nsecs){
+    if (!g_tracing || g_ntrace == sizeof(g_trace)/sizeof(g_trace[0]))
+        return;
+    rtdoa_test_trace_t * trace = &g_trace[g_ntrace++];
+    trace->node = (inst == g_inst[0]) ? 0 : 1;
+    trace->event = event;
+    trace->nsecs = nsecs;
+    trace->cpu_nsecs = rtdoa_test_cpu_nsecs();
+    for (uint8_t i = 0; i < 2; i++)
+        trace->spi_nsecs[i] = dw1000_sim_get_stats(g_inst[i])->spi_nsecs;
+}
+
+/**
+ * Slot of the node's response, counted from the request.
+ */
+static uint32_t
+rtdoa_test_schedule(dw1000_dev_instance_t * inst){
+    rtdoa_request_frame_t req = {
+        .rpt_count = 0,
+        .rpt_max = MYNEWT_VAL(RTDOA_MAX_CASCADE_RPTS)
+    };
+    return rtdoa_usecs_to_response(inst, &req, g_inst[0]->slot_id % MYNEWT_VAL(RTDOA_NNODES) + 1,
+        &inst->rtdoa->config, dw1000_phy_frame_duration(&inst->attrib, sizeof(rtdoa_response_frame_t)));
+}
+
+/**
+ * Tag listen timeout, from one holdoff before the request to the end of the node's response and the
+ * rx_timeout_delay allowance.
+ */
+static uint16_t
+rtdoa_test_timeout(dw1000_dev_instance_t * tag){
+    dw1000_rng_config_t * config = &tag->rtdoa->config;
+    return 2 * config->tx_holdoff_delay
+        + dw1000_phy_frame_duration(&tag->attrib, sizeof(rtdoa_request_frame_t))
+        + rtdoa_test_schedule(tag)
+        + dw1000_phy_frame_duration(&tag->attrib, sizeof(rtdoa_response_frame_t))
+        + config->rx_timeout_delay;
+}
+
+//! Totals of one exchange
+typedef struct _rtdoa_test_exchange_t{
+    dw1000_dev_status_t status;     //!< Status of the tag once it stopped listening
+    uint64_t start;                 //!< Simulated time of the request
+    uint64_t nsecs;                 //!< Request to the end of the tag's listen
+    uint64_t cpu_start;             //!< Host cpu time at the request
+    uint64_t cpu_nsecs;             //!< Host cpu time during the exchange
+    uint64_t spi_start[2];          //!< Bus time of both devices at the request
+    uint64_t spi_nsecs[2];          //!< Bus time of both devices during the exchange
+    float tdoa;                     //!< Tdoa between the request and the response at the tag (m), NAN if not heard
+}rtdoa_test_exchange_t;
+
+static rtdoa_test_exchange_t
+rtdoa_test_exchange(void){
+    rtdoa_test_exchange_t exchange;
+    dw1000_dev_instance_t * node = g_inst[0];
+    dw1000_dev_instance_t * tag = g_inst[1];
+    uint64_t holdoff = (uint64_t)tag->rtdoa->config.tx_holdoff_delay << 16;
+
+    // The tag listens from one holdoff on, the node sends its request a holdoff later
+    dw1000_rtdoa_listen(tag, DWT_NONBLOCKING, (dw1000_read_systime(tag) + holdoff) & 0xFFFFFFFE00ULL, rtdoa_test_timeout(tag));
+
+    g_ntrace = 0;
+    g_tracing = true;
+    for (uint8_t i = 0; i < 2; i++)
+        exchange.spi_start[i] = dw1000_sim_get_stats(g_inst[i])->spi_nsecs;
+    exchange.start = dw1000_sim_nsecs();
+    exchange.cpu_start = rtdoa_test_cpu_nsecs();
+
+    dw1000_rtdoa_request(node, (dw1000_read_systime(node) + 2 * holdoff) & 0xFFFFFFFE00ULL);
+
+    // The tag is done with the exchange on its timeout
+    os_error_t err = os_sem_pend(&tag->rtdoa->sem, OS_TIMEOUT_NEVER);
+    assert(err == OS_OK);
+    err = os_sem_release(&tag->rtdoa->sem);
+    assert(err == OS_OK);
+    exchange.status = tag->status;
+
+    exchange.cpu_nsecs = rtdoa_test_cpu_nsecs() - exchange.cpu_start;
+    exchange.nsecs = dw1000_sim_nsecs() - exchange.start;
+    for (uint8_t i = 0; i < 2; i++)
+        exchange.spi_nsecs[i] = dw1000_sim_get_stats(g_inst[i])->spi_nsecs - exchange.spi_start[i];
+    g_tracing = false;
+
+    dw1000_rtdoa_instance_t * rtdoa = tag->rtdoa;
+    rtdoa_frame_t * frame = rtdoa->frames[rtdoa->idx%rtdoa->nframes];
+    exchange.tdoa = (rtdoa->req_frame && frame != rtdoa->req_frame) ? rtdoa_tdoa_between_frames(tag, rtdoa->req_frame, frame) : NAN;
+
+    os_time_delay(1);
+    return exchange;
+}
+
+static void
+rtdoa_test_phases(rtdoa_test_exchange_t * exchange){
+    uint64_t nsecs = exchange->start;
+    uint64_t cpu_nsecs = exchange->cpu_start;
+    uint64_t spi_nsecs[2] = {exchange->spi_start[0], exchange->spi_start[1]};
+
+    for (uint16_t i = 0; i < g_ntrace; i++){
+        rtdoa_test_trace_t * trace = &g_trace[i];
+        printf("{\"profile\": \"rtdoa\", \"phase\": %d, \"node\": %d, \"event\": \"%s\", \"usecs\": %lu, \"cpu_usecs\": %lu, \"spi_usecs\": [%lu, %lu]}\n",
+            i, trace->node, g_events[trace->event],
+            (uint32_t)((trace->nsecs - nsecs) / 1000),
+            (uint32_t)((trace->cpu_nsecs - cpu_nsecs) / 1000),
+            (uint32_t)((trace->spi_nsecs[0] - spi_nsecs[0]) / 1000),
+            (uint32_t)((trace->spi_nsecs[1] - spi_nsecs[1]) / 1000)
+        );
+        nsecs = trace->nsecs;
+        cpu_nsecs = trace->cpu_nsecs;
+        spi_nsecs[0] = trace->spi_nsecs[0];
+        spi_nsecs[1] = trace->spi_nsecs[1];
+    }
+    printf("{\"profile\": \"rtdoa\", \"phase\": %d, \"node\": 1, \"event\": \"complete\", \"usecs\": %lu, \"cpu_usecs\": %lu, \"spi_usecs\": [%lu, %lu]}\n",
+        g_ntrace, (uint32_t)((exchange->start + exchange->nsecs - nsecs) / 1000),
+        (uint32_t)((exchange->cpu_start + exchange->cpu_nsecs - cpu_nsecs) / 1000),
+        (uint32_t)((exchange->spi_start[0] + exchange->spi_nsecs[0] - spi_nsecs[0]) / 1000),
+        (uint32_t)((exchange->spi_start[1] + exchange->spi_nsecs[1] - spi_nsecs[1]) / 1000)
+    );
+}
+
+/**
+ * Time between the first two frames the node sent, the request and its response (nsecs), UINT64_MAX if fewer.
+ */
+static uint64_t
+rtdoa_test_response(void){
+    uint64_t request = UINT64_MAX;
+    for (uint16_t i = 0; i < g_ntrace; i++){
+        if (g_trace[i].node != 0 || g_trace[i].event != DW1000_SIM_TX_START)
+            continue;
+        if (request != UINT64_MAX)
+            return g_trace[i].nsecs - request;
+        request = g_trace[i].nsecs;
+    }
+    return UINT64_MAX;
+}
+
+/**
+ * Time from the last frame the tag heard, or from start if none, to the tag's timeout (nsecs), UINT64_MAX if none.
+ * The receiver restarts its timeout each time it is re-enabled for the next frame.
+ */
+static uint64_t
+rtdoa_test_timed_out(uint64_t start){
+    for (uint16_t i = 0; i < g_ntrace; i++){
+        if (g_trace[i].node != 1)
+            continue;
+        if (g_trace[i].event == DW1000_SIM_RX_DONE)
+            start = g_trace[i].nsecs;
+        if (g_trace[i].event == DW1000_SIM_RX_TIMEOUT)
+            return g_trace[i].nsecs - start;
+    }
+    return UINT64_MAX;
+}
+
+static void
+rtdoa_test_run(void){
+    // Both frames leave at the rmarker the schedule sets, the rx timeout and the schedule count in uwb microseconds
+    uint64_t schedule = 1000 * dw1000_dwt_usecs_to_usecs(rtdoa_test_schedule(g_inst[0]));
+    // The tag gives up at most one listen window after the last frame it heard
+    uint64_t timeout = 1000 * dw1000_dwt_usecs_to_usecs(rtdoa_test_timeout(g_inst[1]) + 1);
+    uint64_t nsecs = 0, max_nsecs = 0, cpu_nsecs = 0;
+    uint64_t spi_nsecs[2] = {0, 0};
+    float error = 0, max_error = 0;
+    uint16_t n = MYNEWT_VAL(RTDOA_TEST_EXCHANGES);
+
+    for (uint16_t i = 0; i < n; i++){
+        rtdoa_test_exchange_t exchange = rtdoa_test_exchange();
+        TEST_ASSERT(exchange.status.start_tx_error == 0);
+        TEST_ASSERT(exchange.status.start_rx_error == 0);
+        TEST_ASSERT(exchange.status.rx_error == 0);
+        for (uint16_t j = 0; j < g_ntrace; j++)
+            TEST_ASSERT(g_trace[j].event != DW1000_SIM_START_LATE);
+        uint64_t response = rtdoa_test_response();
+        TEST_ASSERT(response != UINT64_MAX && llabs((int64_t)(response - schedule)) <= 1000);
+        TEST_ASSERT(rtdoa_test_timed_out(exchange.start) <= timeout);
+
+        if (i == n - 1)
+            rtdoa_test_phases(&exchange);
+
+        nsecs += exchange.nsecs;
+        max_nsecs = (exchange.nsecs > max_nsecs) ? exchange.nsecs : max_nsecs;
+        cpu_nsecs += exchange.cpu_nsecs;
+        for (uint8_t j = 0; j < 2; j++)
+            spi_nsecs[j] += exchange.spi_nsecs[j];
+        float e = fabsf(exchange.tdoa);
+        TEST_ASSERT(!isnan(e));
+        error += e;
+        max_error = (e > max_error) ? e : max_error;
+    }
+    nsecs /= n;
+    cpu_nsecs /= n;
+    spi_nsecs[0] /= n;
+    spi_nsecs[1] /= n;
+    error /= n;
+
+    printf("{\"profile\": \"rtdoa\", \"usecs\": %lu, \"max_usecs\": %lu, \"response_usecs\": %lu, \"timeout_usecs\": %lu, \"cpu_usecs\": %lu, \"spi_usecs\": [%lu, %lu], \"error_mm\": %d, \"max_error_mm\": %d}\n",
+        (uint32_t)(nsecs / 1000), (uint32_t)(max_nsecs / 1000), (uint32_t)(schedule / 1000), (uint32_t)(timeout / 1000),
+        (uint32_t)(cpu_nsecs / 1000), (uint32_t)(spi_nsecs[0] / 1000), (uint32_t)(spi_nsecs[1] / 1000),
+        (int)(error * 1000), (int)(max_error * 1000)
+    );
+    TEST_ASSERT(error < MYNEWT_VAL(RTDOA_TEST_TDOA_ERROR));
+}
+
+static void
+rtdoa_test_lost(void){
+    // The tag hears nothing and gives up on its own timeout, the node is not held up
+    dw1000_sim_set_loss(g_inst[1], 1.0f);
+    rtdoa_test_exchange_t exchange = rtdoa_test_exchange();
+    TEST_ASSERT(exchange.status.rx_timeout_error == 1);
+    TEST_ASSERT(isnan(exchange.tdoa));
+    // The listen opened one holdoff after the exchange started
+    dw1000_rng_config_t * config = &g_inst[1]->rtdoa->config;
+    TEST_ASSERT(rtdoa_test_timed_out(exchange.start)
+        <= 1000 * dw1000_dwt_usecs_to_usecs(config->tx_holdoff_delay + rtdoa_test_timeout(g_inst[1]) + 1));
+    dw1000_sim_set_loss(g_inst[1], 0.0f);
+
+    // and the next exchange is whole again
+    exchange = rtdoa_test_exchange();
+    TEST_ASSERT(fabsf(exchange.tdoa) < 4 * MYNEWT_VAL(RTDOA_TEST_TDOA_ERROR));
+}
+
+static uint8_t g_payloads;
+
+static uint16_t
+rtdoa_test_producer(dw1000_dev_instance_t * inst, uint16_t code, uint8_t * buf, uint16_t len){
+    uint16_t offset = 0;
+    dw1000_rng_tlv_put(buf, len, &offset, 1, &code, sizeof(code));
+    return offset;
+}
+
+static void
+rtdoa_test_consumer(dw1000_dev_instance_t * inst, uint16_t src_address, uint8_t type, uint8_t * value, uint8_t len){
+    if (type == 1 && len == sizeof(uint16_t) && src_address == g_inst[0]->my_short_address)
+        g_payloads++;
+}
+
+static void
+rtdoa_test_payload(void){
+    // The request carries the payload to the tag, the responses keep their slots
+    dw1000_rng_set_payload(g_inst[0], rtdoa_test_producer, NULL, UINT16_MAX);
+    dw1000_rng_set_payload(g_inst[1], NULL, rtdoa_test_consumer, UINT16_MAX);
+    g_payloads = 0;
+    rtdoa_test_exchange_t exchange = rtdoa_test_exchange();
+    TEST_ASSERT(g_payloads == 1);
+    uint64_t schedule = 1000 * dw1000_dwt_usecs_to_usecs(rtdoa_test_schedule(g_inst[0]));
+    uint64_t response = rtdoa_test_response();
+    TEST_ASSERT(response != UINT64_MAX && llabs((int64_t)(response - schedule)) <= 1000);
+    TEST_ASSERT(fabsf(exchange.tdoa) < 4 * MYNEWT_VAL(RTDOA_TEST_TDOA_ERROR));
+    dw1000_rng_set_payload(g_inst[0], NULL, NULL, 0);
+    dw1000_rng_set_payload(g_inst[1], NULL, NULL, 0);
+}
+
+void
+rtdoa_test_handler(void *arg)
+{
+    sysinit();
+
+    g_inst[0] = hal_dw1000_inst(0);
+    g_inst[1] = hal_dw1000_inst(1);
+    // rtdoa_node and rtdoa_tag bind to every device under the same id and the node comes first, removing it from
+    // device 1 leaves the tag there
+    rtdoa_node_free(g_inst[1]);
+
+    dw1000_sim_set_position(g_inst[1], MYNEWT_VAL(RTDOA_TEST_DISTANCE), 0, 0);
+    dw1000_sim_set_drift(g_inst[0], MYNEWT_VAL(RTDOA_TEST_DRIFT));
+    dw1000_sim_set_drift(g_inst[1], -MYNEWT_VAL(RTDOA_TEST_DRIFT));
+    wcs_instance_t * wcs = g_inst[1]->ccp->wcs;
+    wcs->skew = 1.0 - (1.0 + MYNEWT_VAL(RTDOA_TEST_DRIFT) * 1e-6) / (1.0 - MYNEWT_VAL(RTDOA_TEST_DRIFT) * 1e-6);
+    wcs->status.valid = 1;
+    dw1000_sim_set_trace(rtdoa_test_trace);
+
+    rtdoa_test_run();
+    rtdoa_test_lost();
+    rtdoa_test_payload();
+
+    dw1000_sim_set_trace(NULL);
+    tu_restart();
+}
@@ -54,13 +54,35 @@ static bool rx_timeout_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t *
 static bool rx_error_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t *);
 static bool reset_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
 
-static dw1000_mac_interface_t g_cbs = {
-    .id = DW1000_RTDOA,
-    .tx_complete_cb = tx_complete_cb,
-    .rx_complete_cb = rx_complete_cb,
-    .rx_timeout_cb = rx_timeout_cb,
-    .rx_error_cb = rx_error_cb,
-    .reset_cb = reset_cb
+static dw1000_mac_interface_t g_cbs[] = {
+        [0] = {
+            .id = DW1000_RTDOA,
+            .tx_complete_cb = tx_complete_cb,
+            .rx_complete_cb = rx_complete_cb,
+            .rx_timeout_cb = rx_timeout_cb,
+            .rx_error_cb = rx_error_cb,
+            .reset_cb = reset_cb
+        },
+#if MYNEWT_VAL(DW1000_DEVICE_1)
+        [1] = {
+            .id = DW1000_RTDOA,
+            .tx_complete_cb = tx_complete_cb,
+            .rx_complete_cb = rx_complete_cb,
+            .rx_timeout_cb = rx_timeout_cb,
+            .rx_error_cb = rx_error_cb,
+            .reset_cb = reset_cb
+        },
+#endif
+#if MYNEWT_VAL(DW1000_DEVICE_2)
+        [2] = {
+            .id = DW1000_RTDOA,
+            .tx_complete_cb = tx_complete_cb,
+            .rx_complete_cb = rx_complete_cb,
+            .rx_timeout_cb = rx_timeout_cb,
+            .rx_error_cb = rx_error_cb,
+            .reset_cb = reset_cb
+        }
+#endif
 };
 
 /**
@@ -73,7 +95,15 @@ void rtdoa_node_pkg_init(void){
 #if MYNEWT_VAL(DW1000_PKG_INIT_LOG)
     printf("{\"utime\": %lu,\"msg\": \"rtdoa_node_pkg_init\"}\n", os_cputime_ticks_to_usecs(os_cputime_get32()));
 #endif
-    dw1000_mac_append_interface(hal_dw1000_inst(0), &g_cbs);
+#if MYNEWT_VAL(DW1000_DEVICE_0)
+    dw1000_mac_append_interface(hal_dw1000_inst(0), &g_cbs[0]);
+#endif
+#if MYNEWT_VAL(DW1000_DEVICE_1)
+    dw1000_mac_append_interface(hal_dw1000_inst(1), &g_cbs[1]);
+#endif
+#if MYNEWT_VAL(DW1000_DEVICE_2)
+    dw1000_mac_append_interface(hal_dw1000_inst(2), &g_cbs[2]);
+#endif
 }
 
 
@@ -121,8 +151,11 @@ dw1000_rtdoa_request(dw1000_dev_instance_t * inst, uint64_t delay)
     /* Also set the local rx_timestamp to allow us to also transmit in the next part */
     rtdoa->req_frame->rx_timestamp = frame->tx_timestamp;
 
-    dw1000_write_tx(inst, frame->array, 0, sizeof(rtdoa_request_frame_t));
-    dw1000_write_tx_fctrl(inst, sizeof(rtdoa_request_frame_t), 0);
+    /* Responses are slotted by their fixed length, only the request carries a payload */
+    uint16_t len = sizeof(rtdoa_request_frame_t);
+    dw1000_write_tx(inst, frame->array, 0, len);
+    len += dw1000_rng_payload_write(inst, frame->code, len);
+    dw1000_write_tx_fctrl(inst, len, 0);
     dw1000_set_wait4resp(inst, false);
 
     if (dw1000_start_tx(inst).start_tx_error) {
@@ -371,7 +404,8 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
                     /* Queue up response message directly if not relaying request */
                     tx_rtdoa_response(inst);
                 }
-
+                /* Relays carry the fixed part only, the payload comes with the original request */
+                dw1000_rng_payload_read(inst, sizeof(rtdoa_request_frame_t));
                 break; 
             }
         default:
@@ -53,12 +53,32 @@ static bool rx_timeout_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t *
 static bool rx_error_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t *);
 static bool reset_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
 
-static dw1000_mac_interface_t g_cbs = {
-    .id = DW1000_RTDOA,
-    .rx_complete_cb = rx_complete_cb,
-    .rx_timeout_cb = rx_timeout_cb,
-    .rx_error_cb = rx_error_cb,
-    .reset_cb = reset_cb
+static dw1000_mac_interface_t g_cbs[] = {
+        [0] = {
+            .id = DW1000_RTDOA,
+            .rx_complete_cb = rx_complete_cb,
+            .rx_timeout_cb = rx_timeout_cb,
+            .rx_error_cb = rx_error_cb,
+            .reset_cb = reset_cb
+        },
+#if MYNEWT_VAL(DW1000_DEVICE_1)
+        [1] = {
+            .id = DW1000_RTDOA,
+            .rx_complete_cb = rx_complete_cb,
+            .rx_timeout_cb = rx_timeout_cb,
+            .rx_error_cb = rx_error_cb,
+            .reset_cb = reset_cb
+        },
+#endif
+#if MYNEWT_VAL(DW1000_DEVICE_2)
+        [2] = {
+            .id = DW1000_RTDOA,
+            .rx_complete_cb = rx_complete_cb,
+            .rx_timeout_cb = rx_timeout_cb,
+            .rx_error_cb = rx_error_cb,
+            .reset_cb = reset_cb
+        }
+#endif
 };
 
 /**
@@ -73,7 +93,15 @@ rtdoa_tag_pkg_init(void)
 #if MYNEWT_VAL(DW1000_PKG_INIT_LOG)
     printf("{\"utime\": %lu,\"msg\": \"rtdoa_tag_pkg_init\"}\n", os_cputime_ticks_to_usecs(os_cputime_get32()));
 #endif
-    dw1000_mac_append_interface(hal_dw1000_inst(0), &g_cbs);
+#if MYNEWT_VAL(DW1000_DEVICE_0)
+    dw1000_mac_append_interface(hal_dw1000_inst(0), &g_cbs[0]);
+#endif
+#if MYNEWT_VAL(DW1000_DEVICE_1)
+    dw1000_mac_append_interface(hal_dw1000_inst(1), &g_cbs[1]);
+#endif
+#if MYNEWT_VAL(DW1000_DEVICE_2)
+    dw1000_mac_append_interface(hal_dw1000_inst(2), &g_cbs[2]);
+#endif
 }
 
 
@@ -224,11 +252,16 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
             /* Subtract the preamble time */
             dx_time -= dw1000_phy_SHR_duration(&inst->attrib);
             dw1000_set_delay_start(inst, dx_time);
+            /* The receiver times out from when it turns on, keep the end of the listen where it was */
+            new_timeout = (int64_t)rtdoa->timeout - (int64_t)(dx_time & 0xFFFFFFFE00UL);
+            if (new_timeout < 0) new_timeout = 1;
+            dw1000_set_rx_timeout(inst, (uint16_t)(new_timeout>>16));
             if(dw1000_start_rx(inst).start_rx_error){
                 os_sem_release(&rtdoa->sem);
                 RTDOA_STATS_INC(start_rx_error);
             }
-            goto adj_to_return;
+            /* Receiver is rescheduled, the payload is now off the critical path */
+            dw1000_rng_payload_read(inst, sizeof(rtdoa_request_frame_t));
             break;
         }
         case DWT_RTDOA_RESP:
@@ -249,11 +282,5 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
             break;
         }
     return true;
-
-adj_to_return:
-    new_timeout = (int64_t)inst->rtdoa->timeout - (int64_t)inst->rxtimestamp;
-    if (new_timeout < 0) new_timeout = 1;
-    dw1000_set_rx_timeout(inst, (uint16_t)(new_timeout>>16));
-    return true;
 }
 
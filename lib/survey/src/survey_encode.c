@@ -27,6 +27,9 @@
 #include <dw1000/dw1000_mac.h>
 #include <nrng/nrng_encode.h>
 #include <survey/survey_encode.h>
+#if MYNEWT_VAL(TELEMETRY_ENABLED)
+#include <telemetry/telemetry.h>
+#endif
 
 #if MYNEWT_VAL(SURVEY_VERBOSE)
 
@@ -88,7 +91,36 @@ survey_encode(survey_instance_t * survey, uint16_t seq, uint16_t idx){
     survey->status.empty = NumberOfBits(mask) == 0;
     if (survey->status.empty)
        return;
-       
+
+#if MYNEWT_VAL(TELEMETRY_ENABLED)
+    // Node entries are variable length, a record takes as many whole entries as fit
+    uint8_t entries[UINT8_MAX - sizeof(telemetry_survey_t)];
+    uint8_t used = 0;
+    telemetry_survey_t record = {.seq_num = seq, .n = 0, .flags = 0};
+    const void * payload[] = {&record, entries};
+
+    for (uint16_t i=0; i < survey->nnodes; i++){
+        if (nrngs->nrng[i]->mask == 0)
+            continue;
+        telemetry_survey_node_t node = {.node = i, .mask = nrngs->nrng[i]->mask};
+        uint16_t n = NumberOfBits(nrngs->nrng[i]->mask) * sizeof(float);
+        if (used + sizeof(node) + n > sizeof(entries)) {
+            const uint8_t len[] = {sizeof(record), used};
+            record.flags = TELEMETRY_MORE;
+            telemetry_writev(TELEMETRY_SURVEY, payload, len, 2);
+            record.n = used = 0;
+        }
+        memcpy(&entries[used], &node, sizeof(node));
+        memcpy(&entries[used + sizeof(node)], nrngs->nrng[i]->rng, n);
+        used += sizeof(node) + n;
+        record.n++;
+    }
+    const uint8_t len[] = {sizeof(record), used};
+    record.flags = 0;
+    telemetry_writev(TELEMETRY_SURVEY, payload, len, 2);
+    return;
+#endif
+
     /* reset the state of the internal test */
     memset(&encoder, 0, sizeof(encoder));
     encoder.je_write = json_write;
@@ -115,7 +147,8 @@ survey_encode(survey_instance_t * survey, uint16_t seq, uint16_t idx){
             rc |= json_encode_object_entry(&encoder, "mask", &value);
             rc |= json_encode_array_name(&encoder, "nrng");
             rc |= json_encode_array_start(&encoder);
-            for (uint16_t j=0; j < NumberOfBits(nrngs->nrng[i]->mask); j++){
+            uint16_t n = NumberOfBits(nrngs->nrng[i]->mask);
+            for (uint16_t j=0; j < n; j++){
                 JSON_VALUE_UINT(&value, *(uint32_t *)&nrngs->nrng[i]->rng[j]);
                 rc |= json_encode_array_value(&encoder, &value); 
             }
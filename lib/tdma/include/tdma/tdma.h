@@ -51,6 +51,9 @@ STATS_SECT_START(tdma_stat_section)
     STATS_SECT_ENTRY(superframe_cnt)
     STATS_SECT_ENTRY(rx_complete)
     STATS_SECT_ENTRY(tx_complete)
+    STATS_SECT_ENTRY(holdover)
+    STATS_SECT_ENTRY(prepare_cnt)
+    STATS_SECT_ENTRY(stage_miss)
 STATS_SECT_END
 #endif
 
@@ -59,17 +62,46 @@ typedef struct _tdma_status_t{
     uint16_t selfmalloc:1;            //!< Internal flag for memory garbage collection
     uint16_t initialized:1;           //!< Instance allocated
     uint16_t awaiting_superframe:1;   //!< Superframe of tdma
+    uint16_t reschedule:1;            //!< Slots were assigned or released since the schedule was built
 }tdma_status_t;
 
 //! Structure of tdma_slot
 typedef struct _tdma_slot_t{
     struct _tdma_instance_t * parent;  //!< Pointer to _tdma_instance_ti
-    struct hal_timer timer;            //!< Timer
     struct os_callout event_cb;        //!< Sturcture of event_cb
     uint16_t idx;                      //!< Slot number
     void * arg;                        //!< Optional argument
+    uint16_t period;                   //!< Slot recurs every period superframes, 0 or 1 for every superframe
+    uint16_t phase;                    //!< Superframe, ccp seq_num modulo period, the slot runs in
+#if MYNEWT_VAL(TDMA_PROFILE_ENABLED)
+    os_event_fn * callout;             //!< Application callout, run by the profiler
+#endif
+#if MYNEWT_VAL(TDMA_STAGE_ENABLED)
+    os_event_fn * prepare;             //!< Prepare callout, run in the preceding slot, NULL for none
+    struct os_callout prepare_cb;      //!< Structure of prepare_cb
+#endif
 }tdma_slot_t; 
 
+//! Entry of the slot schedule walked by the slot timer
+typedef struct _tdma_schedule_t{
+    uint16_t idx;                      //!< Slot number
+    uint16_t prepare;                  //!< Entry runs the prepare callout of slot idx rather than its callout
+    uint32_t offset;                   //!< Entry start from the epoch (os_cputime ticks)
+}tdma_schedule_t;
+
+#if MYNEWT_VAL(TDMA_STAGE_ENABLED)
+//! Frame staged in one of the tx buffer regions above MYNEWT_VAL(TDMA_STAGE_TX_OFFSET)
+typedef struct _tdma_stage_t{
+    uint64_t dx_time;                  //!< Delayed start of the staged frame
+    uint16_t offset;                   //!< Tx buffer offset of the region
+    uint16_t idx;                      //!< Slot the frame is staged for
+    uint16_t len;                      //!< Frame length
+    uint16_t fctrl;                    //!< Frame control of the staged frame
+    uint16_t valid:1;                  //!< A frame is staged and not yet started
+    uint16_t started:1;                //!< The frame was started and may still be on air
+}tdma_stage_t;
+#endif
+
 //! Structure of tdma instance
 typedef struct _tdma_instance_t{
     struct _dw1000_dev_instance_t * parent;  //!< Pointer to _dw1000_dev_instance_t
@@ -79,10 +111,28 @@ typedef struct _tdma_instance_t{
     tdma_status_t status;                    //!< Status of tdma 
     dw1000_mac_interface_t cbs;              //!< MAC Layer Callbacks
     struct os_mutex mutex;                   //!< Structure of os_mutex
-    uint16_t idx;                            //!< Slot number
+    uint16_t idx;                            //!< Slot number, last slot posted
     uint16_t nslots;                         //!< Number of slots 
     uint32_t os_epoch;                          //!< Epoch timestamp
+    uint8_t seq_num;                         //!< ccp seq_num of the epoch, selects the hyperframe phase
     struct os_callout event_cb;              //!< Sturcture of event_cb
+    struct hal_timer timer;                  //!< Slot timer, re-armed for each scheduled slot in turn
+    tdma_schedule_t * schedule;              //!< Assigned slots in start order, and their prepare callouts
+    uint16_t nscheduled;                     //!< Entries in schedule
+    uint16_t cursor;                         //!< Next schedule entry due
+    uint32_t schedule_epoch;                 //!< os_epoch of the superframe being walked
+    uint32_t schedule_lead;                  //!< Slot events lead the slot start by (os_cputime ticks)
+    uint32_t schedule_period;                //!< ccp period the offsets were computed for
+#if MYNEWT_VAL(TDMA_ALLOC_ENABLED)
+    struct _tdma_alloc_instance_t * alloc;   //!< Dynamic slot allocation
+#endif
+#if MYNEWT_VAL(TDMA_PROFILE_ENABLED)
+    struct _tdma_profile_t * profile;        //!< Slot execution profiler
+#endif
+#if MYNEWT_VAL(TDMA_STAGE_ENABLED)
+    tdma_stage_t stage[2];                   //!< Staged tx frames, the regions are used in turn
+    uint8_t stage_next;                      //!< Region the next frame is staged in
+#endif
 #ifdef TDMA_TASKS_ENABLE
     struct os_eventq eventq;                 //!< Structure of os events
     struct os_task task_str;                 //!< Structure of os tasks
@@ -100,10 +150,18 @@ struct _tdma_instance_t * tdma_init(struct _dw1000_dev_instance_t * inst, uint16
 void tdma_free(struct _tdma_instance_t * inst);
 void tdma_assign_slot(struct _tdma_instance_t * inst, void (* callout )(struct os_event *), uint16_t idx, void * arg);
 void tdma_release_slot(struct _tdma_instance_t * inst, uint16_t idx);
+void tdma_set_slot_rate(struct _tdma_instance_t * inst, uint16_t idx, uint16_t period, uint16_t phase);
+bool tdma_slot_active(struct _tdma_instance_t * inst, uint16_t idx);
+#if MYNEWT_VAL(TDMA_STAGE_ENABLED)
+void tdma_set_slot_prepare(struct _tdma_instance_t * inst, uint16_t idx, void (* prepare )(struct os_event *));
+struct _dw1000_dev_status_t tdma_stage_tx(struct _dw1000_dev_instance_t * inst, uint16_t idx, uint8_t * frame, uint16_t len, uint64_t dx_time);
+struct _dw1000_dev_status_t tdma_start_staged_tx(struct _dw1000_dev_instance_t * inst, uint16_t idx);
+#endif
 void tdma_stop(struct _tdma_instance_t * tdma);
 
 uint64_t tdma_tx_slot_start(struct _dw1000_dev_instance_t * inst, float idx);
 uint64_t tdma_rx_slot_start(struct _dw1000_dev_instance_t * inst, float idx);
+uint16_t tdma_rx_slot_guard(struct _dw1000_dev_instance_t * inst);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file tdma_alloc.h
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief TDMA dynamic slot allocation
+ *
+ * @details Slots from MYNEWT_VAL(TDMA_ALLOC_FIRST_SLOT) up form a pool owned by a coordinator. Nodes ask
+ * for the number of pool slots they want with a TDMA_ALLOC_REQ sent in a randomly chosen contention slot,
+ * backing off exponentially while unanswered. The coordinator grants or trims slots and broadcasts the
+ * owners in the map slot every superframe, changed entries first and the rest of the pool in rotation.
+ * Nodes assign and release the pool slots named in the map with the callout set by tdma_alloc_set_callout().
+ * A node hands back slots it has not transmitted in for TDMA_ALLOC_IDLE_EPOCHS superframes and asks for
+ * its full request again once the trimmed count has held for a while, the hold doubling with each trim up
+ * to TDMA_ALLOC_LEASE_EPOCHS. The coordinator reclaims grants that have not been renewed within
+ * TDMA_ALLOC_LEASE_EPOCHS.
+ */
+
+#ifndef _TDMA_ALLOC_H_
+#define _TDMA_ALLOC_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stats/stats.h>
+#include <dw1000/dw1000_ftypes.h>
+#include <dw1000/dw1000_dev.h>
+
+#if MYNEWT_VAL(TDMA_STATS)
+STATS_SECT_START(tdma_alloc_stat_section)
+    STATS_SECT_ENTRY(req_tx)
+    STATS_SECT_ENTRY(req_rx)
+    STATS_SECT_ENTRY(map_tx)
+    STATS_SECT_ENTRY(map_rx)
+    STATS_SECT_ENTRY(grant)
+    STATS_SECT_ENTRY(reclaim)
+    STATS_SECT_ENTRY(idle)
+    STATS_SECT_ENTRY(regrow)
+    STATS_SECT_ENTRY(pool_full)
+STATS_SECT_END
+#endif
+
+//! Allocation frame codes
+typedef enum _tdma_alloc_code_t{
+    TDMA_ALLOC_INVALID = 0,
+    TDMA_ALLOC_REQ,                     //!< Node asks for nslots pool slots in total, also renews its grants
+    TDMA_ALLOC_MAP                      //!< Coordinator broadcast of pool slot owners
+}tdma_alloc_code_t;
+
+//! Slot map entry
+typedef struct _tdma_alloc_entry_t{
+    uint16_t slot;                      //!< Slot number
+    uint16_t owner;                     //!< Owner short address, 0 for a free slot
+}__attribute__((__packed__, aligned(1))) tdma_alloc_entry_t;
+
+//! Allocation frame
+typedef union {
+    struct _tdma_alloc_frame_t{
+        struct _ieee_std_frame_t;
+        uint8_t n;                      //!< REQ: pool slots wanted, MAP: entries that follow
+        tdma_alloc_entry_t entry[MYNEWT_VAL(TDMA_ALLOC_MAP_ENTRIES)];
+    }__attribute__((__packed__, aligned(1)));
+    uint8_t array[sizeof(struct _tdma_alloc_frame_t)];
+}tdma_alloc_frame_t;
+
+//! Pool slot state
+typedef struct _tdma_alloc_slot_t{
+    uint16_t owner;                     //!< Coordinator: grantee, node: own address when assigned, 0 when free
+    uint16_t count;                     //!< Coordinator: lease remaining, node: superframes since last transmission
+    uint16_t changed:1;                 //!< Coordinator: owner changed since last broadcast
+}tdma_alloc_slot_t;
+
+//! Allocation status
+typedef struct _tdma_alloc_status_t{
+    uint16_t coordinator:1;             //!< Owns the pool and broadcasts the map
+    uint16_t rx:1;                      //!< A frame was received in the last listen
+    uint16_t start_tx_error:1;          //!< Start transmit error
+    uint16_t start_rx_error:1;          //!< Start receive error
+}tdma_alloc_status_t;
+
+//! Allocation instance
+typedef struct _tdma_alloc_instance_t{
+    struct _tdma_instance_t * tdma;     //!< Pointer to _tdma_instance_t
+#if MYNEWT_VAL(TDMA_STATS)
+    STATS_SECT_DECL(tdma_alloc_stat_section) stat; //!< Stats instance
+#endif
+    dw1000_mac_interface_t cbs;         //!< MAC Layer Callbacks
+    struct os_sem sem;                  //!< Held for the duration of a slot transaction
+    tdma_alloc_status_t status;         //!< Status
+    os_event_fn * callout;              //!< Node: callout of granted pool slots
+    void * arg;                         //!< Node: argument of granted pool slots
+    uint8_t request;                    //!< Node: pool slots asked for with tdma_alloc_request()
+    uint8_t want;                       //!< Node: pool slots wanted, the request less slots found idle
+    uint8_t held;                       //!< Node: pool slots assigned
+    uint8_t attempts;                   //!< Node: unanswered requests
+    uint16_t backoff;                   //!< Node: superframes before the next request
+    uint16_t renew;                     //!< Node: superframes before the grants must be renewed
+    uint16_t hold;                      //!< Node: superframes before a trimmed want is raised to the request
+    uint16_t probe;                     //!< Node: hold after the next idle trim
+    uint16_t tx_idx;                    //!< Node: pool slot whose callout is running, 0 for none
+    uint16_t tx_slot;                   //!< Node: contention slot to request in this superframe, 0 for none
+    uint16_t cursor;                    //!< Coordinator: next pool slot in the map rotation
+    uint32_t seed;                      //!< Contention slot and backoff generator
+    uint8_t seq_num;                    //!< Frame sequence number
+    tdma_alloc_frame_t frame;           //!< Last frame sent or received
+    tdma_alloc_slot_t slots[];          //!< Pool slots, nslots - TDMA_ALLOC_FIRST_SLOT entries
+}tdma_alloc_instance_t;
+
+struct _tdma_alloc_instance_t * tdma_alloc_init(struct _tdma_instance_t * tdma, bool coordinator);
+void tdma_alloc_free(struct _tdma_alloc_instance_t * alloc);
+void tdma_alloc_set_callout(struct _tdma_alloc_instance_t * alloc, os_event_fn * callout, void * arg);
+void tdma_alloc_request(struct _tdma_alloc_instance_t * alloc, uint8_t nslots);
+uint16_t tdma_alloc_held(struct _tdma_alloc_instance_t * alloc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TDMA_ALLOC_H_ */
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file tdma_hyperframe.h
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief TDMA hyperframe packing
+ *
+ * @details A hyperframe spans MYNEWT_VAL(TDMA_HYPERFRAME_MAX) superframes. A member of rate class period
+ * needs one slot in every period-th superframe, i.e. a (slot, phase) pair applied with tdma_set_slot_rate().
+ * Members of slower classes share a slot in different phases, so a slot carries one member of period 1,
+ * two of period 2, and so on. The packer keeps the superframes taken in each slot of a range as a bitmap
+ * and places members first fit. Packing all members from the fastest class to the slowest fills the range
+ * without gaps: as all periods are powers of two, the free superframes of a slot always remain whole phases
+ * of the next class. Every set of members whose load, the sum of 1/period, fits the number of slots is
+ * therefore placed.
+ */
+
+#ifndef _TDMA_HYPERFRAME_H_
+#define _TDMA_HYPERFRAME_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TDMA_HYPERFRAME_NONE 0xFFFF     //!< Slot of a member that was not placed
+
+//! Member of a rate class
+typedef struct _tdma_hyperframe_entry_t{
+    uint16_t period;                    //!< Superframes between slots, power of two up to TDMA_HYPERFRAME_MAX
+    uint16_t slot;                      //!< Placed slot, TDMA_HYPERFRAME_NONE if not placed
+    uint16_t phase;                     //!< Placed phase, less than period
+}tdma_hyperframe_entry_t;
+
+//! Hyperframe packer
+typedef struct _tdma_hyperframe_t{
+    uint16_t selfmalloc:1;              //!< Internal flag for memory garbage collection
+    uint16_t first;                     //!< First slot of the range
+    uint16_t nslots;                    //!< Slots in the range
+    uint32_t occupancy[];               //!< Per slot, bit n set when superframe n of the hyperframe is taken
+}tdma_hyperframe_t;
+
+struct _tdma_hyperframe_t * tdma_hyperframe_init(struct _tdma_hyperframe_t * hf, uint16_t first, uint16_t nslots);
+void tdma_hyperframe_free(struct _tdma_hyperframe_t * hf);
+void tdma_hyperframe_clear(struct _tdma_hyperframe_t * hf);
+int tdma_hyperframe_place(struct _tdma_hyperframe_t * hf, tdma_hyperframe_entry_t * entry);
+void tdma_hyperframe_remove(struct _tdma_hyperframe_t * hf, tdma_hyperframe_entry_t * entry);
+uint16_t tdma_hyperframe_pack(struct _tdma_hyperframe_t * hf, tdma_hyperframe_entry_t entries[], uint16_t n);
+uint16_t tdma_hyperframe_capacity(struct _tdma_hyperframe_t * hf, uint16_t period);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TDMA_HYPERFRAME_H_ */
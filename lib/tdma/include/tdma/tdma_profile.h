@@ -0,0 +1,106 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file tdma_profile.h
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief TDMA slot execution profiler
+ *
+ * @details Each slot callout is timed against the slot grid the slot timer runs on. Per run the profiler
+ * records the latency from the slot timer posting the callout to the callout starting, the margin left
+ * from the callout starting to the dx_time it programs for its delayed start, whether the callout
+ * returned after the next slot started (overrun), the start error status left by the callout and the
+ * airtime of the frames sent and received while it ran. Totals are kept per slot, the distributions in
+ * log2 histograms of TDMA_PROFILE_BINS bins starting at MYNEWT_VAL(TDMA_PROFILE_BIN_USECS). All memory
+ * is allocated once in tdma_profile_init().
+ */
+
+#ifndef _TDMA_PROFILE_H_
+#define _TDMA_PROFILE_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stats/stats.h>
+#include <os/os.h>
+
+#define TDMA_PROFILE_BINS 8             //!< Histogram bins
+#define TDMA_PROFILE_IDLE 0xFFFF        //!< No slot callout running
+
+#if MYNEWT_VAL(TDMA_STATS)
+STATS_SECT_START(tdma_profile_stat_section)
+    STATS_SECT_ENTRY(runs)
+    STATS_SECT_ENTRY(late)
+    STATS_SECT_ENTRY(start_error)
+    STATS_SECT_ENTRY(overrun)
+    STATS_SECT_ENTRY(frames)
+    STATS_SECT_ENTRY(unattributed)
+STATS_SECT_END
+#endif
+
+//! Per slot totals
+typedef struct _tdma_profile_slot_t{
+    uint32_t runs;                      //!< Callouts timed
+    uint16_t late;                      //!< Callout started after the dx_time it programmed
+    uint16_t start_error;               //!< Callout left start_tx_error or start_rx_error set
+    uint16_t overrun;                   //!< Callout returned after the next slot started
+    uint16_t latency_max;               //!< Largest slot timer to callout latency (usecs)
+    int32_t margin_min;                 //!< Smallest callout start to programmed dx_time margin (usecs)
+    uint32_t busy;                      //!< Callout execution time (usecs)
+    uint32_t airtime;                   //!< Frames sent and received (usecs)
+    uint32_t posted;                    //!< os_cputime the slot timer posted the callout
+    uint32_t epoch;                     //!< Superframe epoch the callout was posted in
+    uint16_t pending:1;                 //!< Posted by the slot timer and not yet run
+}tdma_profile_slot_t;
+
+//! Profiler instance
+typedef struct _tdma_profile_t{
+    struct _tdma_instance_t * tdma;     //!< Pointer to _tdma_instance_t
+#if MYNEWT_VAL(TDMA_STATS)
+    STATS_SECT_DECL(tdma_profile_stat_section) stat; //!< Stats instance
+#endif
+    volatile uint16_t current;          //!< Slot whose callout is running, TDMA_PROFILE_IDLE if none
+    volatile uint32_t run_airtime;      //!< Airtime of the running callout (usecs)
+    uint32_t latency[TDMA_PROFILE_BINS];     //!< Slot timer to callout start (usecs, log2 bins)
+    uint32_t margin[TDMA_PROFILE_BINS];      //!< Callout start to programmed dx_time, late runs excluded (usecs, log2 bins)
+    uint32_t utilization[TDMA_PROFILE_BINS]; //!< Airtime per run as a fraction of the slot (linear bins)
+    tdma_profile_slot_t slots[];        //!< Per slot totals, nslots entries
+}tdma_profile_t;
+
+struct _tdma_profile_t * tdma_profile_init(struct _tdma_instance_t * tdma);
+void tdma_profile_free(struct _tdma_profile_t * profile);
+void tdma_profile_clear(struct _tdma_profile_t * profile);
+void tdma_profile_posted(struct _tdma_profile_t * profile, uint16_t idx, uint32_t now);
+void tdma_profile_slot_cb(struct os_event * ev);
+void tdma_profile_frame(struct _tdma_profile_t * profile, bool tx);
+uint32_t tdma_profile_bin_edge(uint16_t bin);
+int tdma_cli_register(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TDMA_PROFILE_H_ */
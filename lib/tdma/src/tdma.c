@@ -45,6 +45,7 @@
 
 #include <dw1000/dw1000_dev.h>
 #include <dw1000/dw1000_hal.h>
+#include <dw1000/dw1000_mac.h>
 #include <tdma/tdma.h>
 
 #if MYNEWT_VAL(CCP_ENABLED)
@@ -55,14 +56,37 @@
 #include <wcs/wcs.h>
 #endif
 
+#if MYNEWT_VAL(TDMA_PROFILE_ENABLED)
+#include <tdma/tdma_profile.h>
+#endif
+
 #include <stats/stats.h>
 
+#if MYNEWT_VAL(TDMA_HYPERFRAME_MAX) & (MYNEWT_VAL(TDMA_HYPERFRAME_MAX) - 1) || MYNEWT_VAL(TDMA_HYPERFRAME_MAX) > 32
+#error "TDMA_HYPERFRAME_MAX must be a power of two no larger than 32"
+#endif
+
+#if MYNEWT_VAL(TDMA_STAGE_ENABLED)
+/* Two staging regions above TDMA_STAGE_TX_OFFSET */
+#define STAGE_REGION_LEN ((TX_BUFFER_LEN - MYNEWT_VAL(TDMA_STAGE_TX_OFFSET)) / 2)
+#if MYNEWT_VAL(TDMA_STAGE_TX_OFFSET) + 2 * 127 > TX_BUFFER_LEN
+#error "TDMA_STAGE_TX_OFFSET leaves no room for two staged frames"
+#endif
+/* Each slot may add a prepare entry to the schedule */
+#define SCHEDULE_LEN(nslots) (2 * (nslots))
+#else
+#define SCHEDULE_LEN(nslots) (nslots)
+#endif
+
 #if MYNEWT_VAL(TDMA_STATS)
 STATS_NAME_START(tdma_stat_section)
     STATS_NAME(tdma_stat_section, slot_timer_cnt)
     STATS_NAME(tdma_stat_section, superframe_cnt)
     STATS_NAME(tdma_stat_section, rx_complete)
     STATS_NAME(tdma_stat_section, tx_complete)
+    STATS_NAME(tdma_stat_section, holdover)
+    STATS_NAME(tdma_stat_section, prepare_cnt)
+    STATS_NAME(tdma_stat_section, stage_miss)
 STATS_NAME_END(tdma_stat_section)
 
 #define TDMA_STATS_INC(__X) STATS_INC(inst->tdma->stat, __X)
@@ -79,6 +103,10 @@ static void tdma_superframe_event_cb(struct os_event * ev);
 static void slot_timer_cb(void * arg);
 static bool rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t *);
 static bool tx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t *);
+#if MYNEWT_VAL(CCP_HOLDOVER_EPOCHS)
+static void holdover_cb(struct _dw1000_dev_instance_t * inst);
+#endif
+static uint16_t epoch_guard(dw1000_ccp_instance_t * ccp);
 
 #ifdef TDMA_TASKS_ENABLE
 static void tdma_tasks_init(struct _tdma_instance_t * inst);
@@ -116,6 +144,11 @@ tdma_init(struct _dw1000_dev_instance_t * inst, uint16_t nslots){
     }else{
         tdma = inst->tdma;
     }
+    /* A freed instance gave its schedule back, a caller provided one may not be zeroed */
+    if (!tdma->status.initialized || tdma->schedule == NULL) {
+        tdma->schedule = (tdma_schedule_t *) malloc(SCHEDULE_LEN(tdma->nslots) * sizeof(tdma_schedule_t));
+        assert(tdma->schedule);
+    }
 
     inst->tdma->cbs = (dw1000_mac_interface_t){
         .id = DW1000_TDMA,
@@ -123,6 +156,9 @@ tdma_init(struct _dw1000_dev_instance_t * inst, uint16_t nslots){
         .rx_complete_cb = rx_complete_cb
     };
     dw1000_mac_append_interface(inst, &inst->tdma->cbs);
+#if MYNEWT_VAL(CCP_HOLDOVER_EPOCHS)
+    dw1000_ccp_set_holdover_cb(inst->ccp, holdover_cb);
+#endif
     
 #if MYNEWT_VAL(TDMA_STATS)
     int rc = stats_init(
@@ -149,6 +185,20 @@ tdma_init(struct _dw1000_dev_instance_t * inst, uint16_t nslots){
     os_callout_init(&tdma->event_cb, &inst->eventq, tdma_superframe_event_cb, (void *) tdma);
 #endif
 
+#if MYNEWT_VAL(TDMA_PROFILE_ENABLED)
+    tdma_profile_init(tdma);
+#endif
+
+#if MYNEWT_VAL(TDMA_STAGE_ENABLED)
+    for (uint16_t i = 0; i < 2; i++)
+        tdma->stage[i] = (tdma_stage_t){.offset = MYNEWT_VAL(TDMA_STAGE_TX_OFFSET) + i * STAGE_REGION_LEN};
+    tdma->stage_next = 0;
+#endif
+
+    os_cputime_timer_init(&tdma->timer, slot_timer_cb, (void *) tdma);
+    tdma->nscheduled = 0;
+    tdma->cursor = 0;
+    tdma->status.reschedule = true;
     tdma->status.initialized = true;
     tdma->os_epoch = os_cputime_get32();
 
@@ -169,6 +219,14 @@ tdma_init(struct _dw1000_dev_instance_t * inst, uint16_t nslots){
 void
 tdma_free(tdma_instance_t * inst){
     assert(inst);
+    os_cputime_timer_stop(&inst->timer);
+#if MYNEWT_VAL(TDMA_PROFILE_ENABLED)
+    if (inst->profile)
+        tdma_profile_free(inst->profile);
+#endif
+    free(inst->schedule);
+    inst->schedule = NULL;
+    inst->nscheduled = 0;
     if (inst->status.selfmalloc)
         free(inst);
     else
@@ -196,6 +254,9 @@ void tdma_pkg_init(void){
 #if MYNEWT_VAL(DW1000_DEVICE_2)
         tdma_init(hal_dw1000_inst(2), MYNEWT_VAL(TDMA_NSLOTS));
 #endif
+#if MYNEWT_VAL(TDMA_PROFILE_CLI)
+    tdma_cli_register();
+#endif
 
 }
 
@@ -285,11 +346,16 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
 
     tdma_instance_t * tdma = inst->tdma;
 
+#if MYNEWT_VAL(TDMA_PROFILE_ENABLED)
+    if (tdma != NULL && tdma->profile)
+        tdma_profile_frame(tdma->profile, false);
+#endif
     if (inst->ccp->status.valid && inst->fctrl_array[0] == FCNTL_IEEE_BLINK_CCP_64){
         TDMA_STATS_INC(rx_complete);
         DIAGMSG("{\"utime\": %lu,\"msg\": \"tdma:rx_complete_cb\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
         if (inst->tdma != NULL && inst->tdma->status.initialized){
             tdma->os_epoch = inst->ccp->os_epoch;
+            tdma->seq_num = inst->ccp->seq_num;
 #ifdef TDMA_TASKS_ENABLE
             os_eventq_put(&inst->tdma->eventq, &inst->tdma->event_cb.c_ev);
 #else
@@ -315,11 +381,16 @@ tx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
 
    tdma_instance_t * tdma = inst->tdma;
 
+#if MYNEWT_VAL(TDMA_PROFILE_ENABLED)
+    if (tdma != NULL && tdma->profile)
+        tdma_profile_frame(tdma->profile, true);
+#endif
     if (inst->fctrl_array[0] == FCNTL_IEEE_BLINK_CCP_64 && inst->ccp->config.role == CCP_ROLE_MASTER){
         TDMA_STATS_INC(tx_complete);
         DIAGMSG("{\"utime\": %lu,\"msg\": \"tdma:tx_complete_cb\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
         if (inst->tdma != NULL && inst->tdma->status.initialized){
             tdma->os_epoch = inst->ccp->os_epoch;
+            tdma->seq_num = inst->ccp->seq_num;
 #ifdef TDMA_TASKS_ENABLE
             os_eventq_put(&inst->tdma->eventq, &inst->tdma->event_cb.c_ev);
 #else
@@ -331,6 +402,33 @@ tx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
     return false;
 }
 
+#if MYNEWT_VAL(CCP_HOLDOVER_EPOCHS)
+/**
+ * @fn holdover_cb(struct _dw1000_dev_instance_t * inst)
+ * @brief ccp holdover callback, the extrapolated epoch starts the superframe in place of the missed ccp frame.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ *
+ * @return void
+ */
+static void
+holdover_cb(struct _dw1000_dev_instance_t * inst){
+
+    tdma_instance_t * tdma = inst->tdma;
+
+    if (tdma != NULL && tdma->status.initialized){
+        TDMA_STATS_INC(holdover);
+        tdma->os_epoch = inst->ccp->os_epoch;
+        tdma->seq_num = inst->ccp->seq_num;
+#ifdef TDMA_TASKS_ENABLE
+        os_eventq_put(&tdma->eventq, &tdma->event_cb.c_ev);
+#else
+        os_eventq_put(&inst->eventq, &tdma->event_cb.c_ev);
+#endif
+    }
+}
+#endif
+
 /**
  * @fn tdma_assign_slot(struct _tdma_instance_t * inst, void (* callout )(struct os_event *), uint16_t idx, void * arg)
  * @brief API to intialise slot instance for the slot.Also initialise a timer and assigns callback for each slot.
@@ -360,8 +458,13 @@ tdma_assign_slot(struct _tdma_instance_t * inst, void (* callout )(struct os_eve
     inst->slot[idx]->idx = idx;
     inst->slot[idx]->parent = inst;
     inst->slot[idx]->arg = arg;
+    inst->status.reschedule = true;
 
-    os_cputime_timer_init(&inst->slot[idx]->timer, slot_timer_cb, (void *) inst->slot[idx]);
+#if MYNEWT_VAL(TDMA_PROFILE_ENABLED)
+    /* The profiler runs the callout, timing it */
+    inst->slot[idx]->callout = callout;
+    callout = tdma_profile_slot_cb;
+#endif
 #ifdef TDMA_TASKS_ENABLE
     os_callout_init(&inst->slot[idx]->event_cb, &inst->eventq, callout, (void *) inst->slot[idx]);
 #else
@@ -382,16 +485,223 @@ void
 tdma_release_slot(struct _tdma_instance_t * inst, uint16_t idx){
     assert(idx < inst->nslots);
     if (inst->slot[idx]) {
-        os_cputime_timer_stop(&inst->slot[idx]->timer);
-        free(inst->slot[idx]);
-        inst->slot[idx] =  NULL;
+        // The slot timer may be walking the schedule, unlink before freeing
+        os_sr_t sr;
+        OS_ENTER_CRITICAL(sr);
+        tdma_slot_t * slot = inst->slot[idx];
+        inst->slot[idx] = NULL;
+        inst->status.reschedule = true;
+        OS_EXIT_CRITICAL(sr);
+        free(slot);
+    }
+}
+
+/**
+ * @fn tdma_set_slot_rate(struct _tdma_instance_t * inst, uint16_t idx, uint16_t period, uint16_t phase)
+ * @brief API to run an assigned slot only every period-th superframe, in the superframes whose ccp seq_num
+ * modulo period equals phase. All nodes follow the same ccp sequence, so they agree on the phase without
+ * further signalling. The period is a power of two so that it divides the 8 bit sequence. tdma_assign_slot()
+ * resets the slot to every superframe.
+ *
+ * @param inst      Pointer to _tdma_instance_t.
+ * @param idx       Slot number.
+ * @param period    Superframes between runs, power of two up to MYNEWT_VAL(TDMA_HYPERFRAME_MAX), 0 or 1 for every superframe.
+ * @param phase     Superframe of the hyperframe the slot runs in, less than period.
+ *
+ * @return void
+ */
+void
+tdma_set_slot_rate(struct _tdma_instance_t * inst, uint16_t idx, uint16_t period, uint16_t phase){
+    assert(idx < inst->nslots);
+    assert(inst->slot[idx]);
+    assert((period & (period - 1)) == 0 && period <= MYNEWT_VAL(TDMA_HYPERFRAME_MAX));
+    assert(period > 1 ? phase < period : phase == 0);
+
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    inst->slot[idx]->period = period;
+    inst->slot[idx]->phase = phase;
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * @fn tdma_slot_active(struct _tdma_instance_t * inst, uint16_t idx)
+ * @brief API to test whether an assigned slot runs in the current superframe, see tdma_set_slot_rate().
+ *
+ * @param inst      Pointer to _tdma_instance_t.
+ * @param idx       Slot number.
+ *
+ * @return true if the slot is assigned and its phase matches the current superframe
+ */
+bool
+tdma_slot_active(struct _tdma_instance_t * inst, uint16_t idx){
+    assert(idx < inst->nslots);
+    tdma_slot_t * slot = inst->slot[idx];
+    if (slot == NULL)
+        return false;
+    return slot->period <= 1 || ((uint8_t)(inst->seq_num - slot->phase) & (slot->period - 1)) == 0;
+}
+
+#if MYNEWT_VAL(TDMA_STAGE_ENABLED)
+/**
+ * @fn tdma_set_slot_prepare(struct _tdma_instance_t * inst, uint16_t idx, void (* prepare )(struct os_event *))
+ * @brief API to register the prepare callout of an assigned slot. It is posted at the start of the preceding
+ * slot, behind that slot's callout, and always runs before the callout of slot idx. It is meant to build the
+ * frame and stage it with tdma_stage_tx(). Follows the hyperframe phase of slot idx. tdma_assign_slot() clears it.
+ *
+ * @param inst       Pointer to _tdma_instance_t.
+ * @param idx        Slot number, not 0.
+ * @param prepare    Prepare callout, ev_arg is the tdma_slot_t of slot idx. NULL removes it.
+ *
+ * @return void
+ */
+void
+tdma_set_slot_prepare(struct _tdma_instance_t * inst, uint16_t idx, void (* prepare )(struct os_event *)){
+    assert(idx > 0 && idx < inst->nslots);
+    assert(inst->slot[idx]);
+
+    tdma_slot_t * slot = inst->slot[idx];
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    slot->prepare = NULL;
+    OS_EXIT_CRITICAL(sr);
+    if (prepare){
+#ifdef TDMA_TASKS_ENABLE
+        os_callout_init(&slot->prepare_cb, &inst->eventq, prepare, (void *) slot);
+#else
+        os_callout_init(&slot->prepare_cb, &inst->parent->eventq, prepare, (void *) slot);
+#endif
+    }
+    OS_ENTER_CRITICAL(sr);
+    slot->prepare = prepare;
+    inst->status.reschedule = true;
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * @fn tdma_stage_tx(struct _dw1000_dev_instance_t * inst, uint16_t idx, uint8_t * frame, uint16_t len, uint64_t dx_time)
+ * @brief API to stage the frame of slot idx, called from its prepare callout. Frames are written above
+ * MYNEWT_VAL(TDMA_STAGE_TX_OFFSET), clear of frames other services write at offset 0, alternating between two
+ * regions. The preceding slot's frame, staged or not, may therefore still be waiting for its delayed start. Should
+ * the region about to be reused hold a frame that was started, staging waits for the transmission in progress
+ * to complete. TX_FCTRL and DX_TIME are shared and left to tdma_start_staged_tx().
+ *
+ * @param inst       Pointer to _dw1000_dev_instance_t.
+ * @param idx        Slot number.
+ * @param frame      Frame, starting with the frame control.
+ * @param len        Frame length, as for dw1000_write_tx().
+ * @param dx_time    Delayed start, e.g. tdma_tx_slot_start().
+ *
+ * @return dw1000_dev_status_t, tx_frame_error if the frame does not fit
+ */
+struct _dw1000_dev_status_t
+tdma_stage_tx(struct _dw1000_dev_instance_t * inst, uint16_t idx, uint8_t * frame, uint16_t len, uint64_t dx_time){
+
+    tdma_instance_t * tdma = inst->tdma;
+
+    if (len > STAGE_REGION_LEN){
+        inst->status.tx_frame_error = 1;
+        return inst->status;
+    }
+    tdma_stage_t * stage = &tdma->stage[tdma->stage_next];
+    tdma->stage_next ^= 1;
+
+    if (stage->started){
+        /* Released on tx complete, or at once when no transmission is pending */
+        os_error_t err = os_sem_pend(&inst->tx_sem, OS_TIMEOUT_NEVER);
+        assert(err == OS_OK);
+        err = os_sem_release(&inst->tx_sem);
+        assert(err == OS_OK);
     }
+    stage->valid = 0;
+    stage->started = 0;
+    dw1000_write_tx(inst, frame, stage->offset, len);
+    if (inst->status.tx_frame_error)
+        return inst->status;
+
+    stage->dx_time = dx_time;
+    stage->idx = idx;
+    stage->len = len;
+    stage->fctrl = frame[0] | (uint16_t)frame[1] << 8;
+    stage->valid = 1;
+    return inst->status;
+}
+
+/**
+ * @fn tdma_start_staged_tx(struct _dw1000_dev_instance_t * inst, uint16_t idx)
+ * @brief API to start the frame staged for slot idx, called from the slot callout. Leaves only the frame control,
+ * delayed start and start command to the slot. wait4resp and the other control flags are set by the caller beforehand
+ * as for dw1000_start_tx(). With nothing staged for the slot start_tx_error is reported and nothing is sent.
+ *
+ * @param inst       Pointer to _dw1000_dev_instance_t.
+ * @param idx        Slot number.
+ *
+ * @return dw1000_dev_status_t
+ */
+struct _dw1000_dev_status_t
+tdma_start_staged_tx(struct _dw1000_dev_instance_t * inst, uint16_t idx){
+
+    tdma_stage_t * stage = NULL;
+
+    for (uint16_t i = 0; i < 2 && stage == NULL; i++)
+        if (inst->tdma->stage[i].valid && inst->tdma->stage[i].idx == idx)
+            stage = &inst->tdma->stage[i];
+    if (stage == NULL){
+        TDMA_STATS_INC(stage_miss);
+        inst->status.start_tx_error = 1;
+        return inst->status;
+    }
+    stage->valid = 0;
+    stage->started = 1;
+    /* dw1000_write_tx() only records the frame control of frames at offset 0, the mac callbacks expect it */
+    inst->fctrl = stage->fctrl;
+    dw1000_write_tx_fctrl(inst, stage->len, stage->offset);
+    dw1000_set_delay_start(inst, stage->dx_time);
+    return dw1000_start_tx(inst);
+}
+#endif
+
+/**
+ * @fn tdma_schedule_build(tdma_instance_t * tdma)
+ * @brief Collects the assigned slots in start order with their offset from the epoch. Slot i starts at
+ * i * period / nslots, the same grid tdma_tx_slot_start() uses. A prepare callout of slot i + 1 follows
+ * the entry of slot i at the same offset. Called from the superframe event with the slot timer stopped,
+ * only when slots or the ccp period changed.
+ *
+ * @param tdma  Pointer to tdma_instance_t.
+ *
+ * @return void
+ */
+static void
+tdma_schedule_build(tdma_instance_t * tdma){
+
+    dw1000_ccp_instance_t * ccp = tdma->parent->ccp;
+    double slot_usecs = dw1000_dwt_usecs_to_usecs(ccp->period) / tdma->nslots;
+    uint16_t n = 0;
+
+    tdma->status.reschedule = false;
+    for (uint16_t i = 0; i < tdma->nslots; i++) {
+        uint32_t offset = os_cputime_usecs_to_ticks((uint32_t)(i * slot_usecs));
+        if (tdma->slot[i]){
+            tdma->schedule[n] = (tdma_schedule_t){.idx = i, .prepare = 0, .offset = offset};
+            n++;
+        }
+#if MYNEWT_VAL(TDMA_STAGE_ENABLED)
+        if (i + 1 < tdma->nslots && tdma->slot[i + 1] && tdma->slot[i + 1]->prepare){
+            tdma->schedule[n] = (tdma_schedule_t){.idx = i + 1, .prepare = 1, .offset = offset};
+            n++;
+        }
+#endif
+    }
+    tdma->nscheduled = n;
+    tdma->schedule_period = ccp->period;
 }
 
 /**
  * @fn tdma_superframe_event_cb(struct os_event * ev)
  * @brief This event is generated by ccp/clkcal complete event. This event defines the start of an superframe epoch.
- * The event also schedules a tdma_superframe_timer_cb which turns on the receiver in advance of the next superframe epoch.
+ * A single slot timer walks the precomputed schedule of assigned slots, so the work done here does not grow
+ * with the number of slots.
  *
  * @param ev   Pointer to os_event.
  *
@@ -409,29 +719,26 @@ tdma_superframe_event_cb(struct os_event * ev){
     
     TDMA_STATS_INC(superframe_cnt);
 
-    for (uint16_t i = 0; i < tdma->nslots; i++) {
-        if (tdma->slot[i]){
-            os_cputime_timer_stop(&tdma->slot[i]->timer);
-        }
-    }
-    for (uint16_t i = 0; i < tdma->nslots; i++) {
-        if (tdma->slot[i]){
-            hal_timer_start_at(&tdma->slot[i]->timer, tdma->os_epoch
-                + os_cputime_usecs_to_ticks(
-                    (uint32_t) (i * dw1000_dwt_usecs_to_usecs(ccp->period/tdma->nslots))
-                    - (uint32_t)ceilf(dw1000_phy_SHR_duration(&tdma->parent->attrib)) 
-                    - MYNEWT_VAL(OS_LATENCY))
-            );
-        }
-    }
+    uint32_t guard = (uint32_t)dw1000_dwt_usecs_to_usecs(epoch_guard(ccp));
+    os_cputime_timer_stop(&tdma->timer);
+    if (tdma->status.reschedule || tdma->schedule_period != ccp->period)
+        tdma_schedule_build(tdma);
+
+    tdma->cursor = 0;
+    tdma->schedule_epoch = tdma->os_epoch;
+    tdma->schedule_lead = os_cputime_usecs_to_ticks(
+                    (uint32_t)ceilf(dw1000_phy_SHR_duration(&tdma->parent->attrib))
+                    + MYNEWT_VAL(OS_LATENCY) + guard);
+    if (tdma->nscheduled)
+        hal_timer_start_at(&tdma->timer, tdma->schedule_epoch + tdma->schedule[0].offset - tdma->schedule_lead);
 }
 
 /**
  * @fn slot_timer_cb(void * arg)
- * @brief API for each slot. This function then puts
- * the callback provided by the user in the tdma event queue.
+ * @brief Slot timer callback. Puts the callback of every slot that is due in the tdma event queue
+ * and re-arms the timer for the next scheduled slot.
  *
- * @param arg    A void type argument.
+ * @param arg    Pointer to tdma_instance_t.
  *
  * @return void
  */
@@ -440,23 +747,52 @@ slot_timer_cb(void * arg){
 
     assert(arg);
 
-    tdma_slot_t * slot = (tdma_slot_t *) arg;
-    /* No point in continuing if this slot is NULL */
-    if (slot == NULL) {
-        return;
-    }
-    tdma_instance_t * tdma = slot->parent;
+    tdma_instance_t * tdma = (tdma_instance_t *) arg;
     struct _dw1000_dev_instance_t * inst = tdma->parent;
+    uint32_t now = os_cputime_get32();
 
     DIAGMSG("{\"utime\": %lu,\"msg\": \"slot_timer_cb\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
 
-    TDMA_STATS_INC(slot_timer_cnt);
-
+    while (tdma->cursor < tdma->nscheduled) {
+        tdma_schedule_t * entry = &tdma->schedule[tdma->cursor];
+        /* Released since the schedule was built, or off phase in this superframe, skip without waking for it */
+        if (!tdma_slot_active(tdma, entry->idx)){
+            tdma->cursor++;
+            continue;
+        }
+        uint32_t start = tdma->schedule_epoch + entry->offset - tdma->schedule_lead;
+        if ((int32_t)(start - now) > 0){
+            hal_timer_start_at(&tdma->timer, start);
+            return;
+        }
+        tdma->cursor++;
+
+        tdma_slot_t * slot = tdma->slot[entry->idx];
+#if MYNEWT_VAL(TDMA_STAGE_ENABLED)
+        if (entry->prepare){
+            /* Prepare callout removed since the schedule was built */
+            if (slot->prepare == NULL)
+                continue;
+            TDMA_STATS_INC(prepare_cnt);
 #ifdef TDMA_TASKS_ENABLE
-    os_eventq_put(&tdma->eventq, &slot->event_cb.c_ev);
+            os_eventq_put(&tdma->eventq, &slot->prepare_cb.c_ev);
 #else
-    os_eventq_put(&tdma->parent->eventq, &slot->event_cb.c_ev);
+            os_eventq_put(&tdma->parent->eventq, &slot->prepare_cb.c_ev);
 #endif
+            continue;
+        }
+#endif
+        TDMA_STATS_INC(slot_timer_cnt);
+        tdma->idx = entry->idx;
+#if MYNEWT_VAL(TDMA_PROFILE_ENABLED)
+        tdma_profile_posted(tdma->profile, entry->idx, now);
+#endif
+#ifdef TDMA_TASKS_ENABLE
+        os_eventq_put(&tdma->eventq, &slot->event_cb.c_ev);
+#else
+        os_eventq_put(&tdma->parent->eventq, &slot->event_cb.c_ev);
+#endif
+    }
 }
 
 /**
@@ -469,11 +805,10 @@ slot_timer_cb(void * arg){
  */
 void
 tdma_stop(struct _tdma_instance_t * tdma){
+    os_cputime_timer_stop(&tdma->timer);
     for (uint16_t i = 0; i < tdma->nslots; i++) {
-        if (tdma->slot[i]){
-            os_cputime_timer_stop(&tdma->slot[i]->timer);
+        if (tdma->slot[i])
             tdma_release_slot(tdma, i);
-        }
     }
 }
 
@@ -495,7 +830,7 @@ tdma_tx_slot_start(struct _dw1000_dev_instance_t * inst, float idx)
 
 #if MYNEWT_VAL(WCS_ENABLED)
     wcs_instance_t * wcs = ccp->wcs;
-    uint64_t dx_time = (ccp->local_epoch + (uint64_t) wcs_dtu_time_adjust(wcs, ((idx * ((uint64_t)ccp->period << 16))/tdma->nslots)));
+    uint64_t dx_time = (ccp->local_epoch + (uint64_t) wcs_dtu_interval_to_local(wcs, ((idx * ((uint64_t)ccp->period << 16))/tdma->nslots)));
     // uint64_t dx_time = (ccp->local_epoch + (uint64_t) roundf((1.0l + wcs->skew) * (double)((idx * (uint64_t)inst->ccp->period * 65536)/tdma->nslots)));
 #else
     uint64_t dx_time = (ccp->local_epoch + (uint64_t) ((idx * ((uint64_t)ccp->period << 16)/tdma->nslots)));
@@ -518,5 +853,48 @@ tdma_rx_slot_start(struct _dw1000_dev_instance_t * inst, float idx)
 {
     uint64_t dx_time = tdma_tx_slot_start(inst, idx);
     dx_time = (dx_time - ((uint64_t)ceilf(dw1000_usecs_to_dwt_usecs(dw1000_phy_SHR_duration(&inst->attrib))) << 16));
+    /* Open early by the epoch uncertainty, callers widen their timeout with tdma_rx_slot_guard() */
+    dx_time = (dx_time - ((uint64_t)epoch_guard(inst->ccp) << 16));
     return dx_time;
 }
+
+/**
+ * Function for the extra rx timeout a slot needs to cover the epoch uncertainty, see epoch_guard().
+ * The rx window opened at tdma_rx_slot_start() is already early by half of it.
+ *
+ * @param inst       Pointer to struct _dw1000_dev_instance_t
+ *
+ * @return guard     Extra rx timeout in dwt usecs
+ */
+uint16_t
+tdma_rx_slot_guard(struct _dw1000_dev_instance_t * inst)
+{
+    return 2 * epoch_guard(inst->ccp);
+}
+
+/**
+ * Uncertainty of the epoch the slots are timed from. In holdover it is the ccp holdover guard. Otherwise, with
+ * WCS_QUALITY_ENABLED, it is MYNEWT_VAL(TDMA_GUARD_SIGMAS) times the time error wcs_quality_time_error()
+ * predicts one epoch out, which bounds the error of the clock model over the whole superframe. Zero without
+ * either.
+ *
+ * @param ccp        Pointer to dw1000_ccp_instance_t
+ *
+ * @return guard     Guard in dwt usecs
+ */
+static uint16_t
+epoch_guard(dw1000_ccp_instance_t * ccp)
+{
+    uint16_t guard = 0;
+#if MYNEWT_VAL(CCP_HOLDOVER_EPOCHS)
+    guard = dw1000_ccp_holdover_guard(ccp);
+#endif
+#if MYNEWT_VAL(WCS_ENABLED) && MYNEWT_VAL(WCS_QUALITY_ENABLED)
+    wcs_quality_t * quality = &ccp->wcs->quality;
+    if (guard == 0 && quality->tau0){
+        float error = ceilf(MYNEWT_VAL(TDMA_GUARD_SIGMAS) * wcs_quality_time_error(quality, 1) / 65536.0f);
+        guard = (error > UINT16_MAX/4) ? UINT16_MAX/4 : (uint16_t) error;
+    }
+#endif
+    return guard;
+}
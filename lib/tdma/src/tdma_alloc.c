@@ -0,0 +1,626 @@
+/*
+ * Copyright (C) 2017-2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file tdma_alloc.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief TDMA dynamic slot allocation
+ *
+ * @details The map and contention slot callouts run on the tdma eventq and block on the instance
+ * semaphore for the duration of their one frame transaction, frames are only copied in interrupt
+ * context. Slots are assigned and released from the map slot callout, never from the interrupt.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include "os/os.h"
+
+#if MYNEWT_VAL(TDMA_ALLOC_ENABLED)
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_mac.h>
+#include <dw1000/dw1000_phy.h>
+#include <tdma/tdma.h>
+#include <tdma/tdma_alloc.h>
+#include <ccp/ccp.h>
+
+#if MYNEWT_VAL(TDMA_ALLOC_MAP_SLOT) >= MYNEWT_VAL(TDMA_ALLOC_CONTENTION_SLOT)
+#error "TDMA_ALLOC_MAP_SLOT must precede the contention slots"
+#endif
+#if MYNEWT_VAL(TDMA_ALLOC_CONTENTION_SLOT) + MYNEWT_VAL(TDMA_ALLOC_CONTENTION_SLOTS) > MYNEWT_VAL(TDMA_ALLOC_FIRST_SLOT)
+#error "TDMA_ALLOC contention slots overlap the dynamic pool"
+#endif
+
+#define POOL_FIRST MYNEWT_VAL(TDMA_ALLOC_FIRST_SLOT)
+#define FRAME_LEN(n) (sizeof(struct _ieee_std_frame_t) + sizeof(uint8_t) + (n) * sizeof(tdma_alloc_entry_t))
+
+#if MYNEWT_VAL(TDMA_STATS)
+STATS_NAME_START(tdma_alloc_stat_section)
+    STATS_NAME(tdma_alloc_stat_section, req_tx)
+    STATS_NAME(tdma_alloc_stat_section, req_rx)
+    STATS_NAME(tdma_alloc_stat_section, map_tx)
+    STATS_NAME(tdma_alloc_stat_section, map_rx)
+    STATS_NAME(tdma_alloc_stat_section, grant)
+    STATS_NAME(tdma_alloc_stat_section, reclaim)
+    STATS_NAME(tdma_alloc_stat_section, idle)
+    STATS_NAME(tdma_alloc_stat_section, regrow)
+    STATS_NAME(tdma_alloc_stat_section, pool_full)
+STATS_NAME_END(tdma_alloc_stat_section)
+
+#define ALLOC_STATS_INC(__X) STATS_INC(alloc->stat, __X)
+#else
+#define ALLOC_STATS_INC(__X) {}
+#endif
+
+static bool rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
+static bool tx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
+static bool rx_timeout_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
+static bool reset_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
+static void map_slot_cb(struct os_event * ev);
+static void contention_slot_cb(struct os_event * ev);
+static void pool_slot_cb(struct os_event * ev);
+
+static inline uint16_t
+pool_size(tdma_alloc_instance_t * alloc){
+    return alloc->tdma->nslots - POOL_FIRST;
+}
+
+static uint32_t
+alloc_rand(tdma_alloc_instance_t * alloc){
+    alloc->seed = alloc->seed * 1664525UL + 1013904223UL;
+    return alloc->seed >> 16;
+}
+
+/**
+ * @fn tdma_alloc_init(struct _tdma_instance_t * tdma, bool coordinator)
+ * @brief API to initialise dynamic slot allocation. Assigns the map and contention slots, the pool
+ * slots are assigned as the map grants them.
+ *
+ * @param tdma         Pointer to _tdma_instance_t.
+ * @param coordinator  Owns the pool and broadcasts the map, normally the clock master.
+ *
+ * @return tdma_alloc_instance_t *
+ */
+tdma_alloc_instance_t *
+tdma_alloc_init(struct _tdma_instance_t * tdma, bool coordinator){
+    assert(tdma);
+    assert(tdma->nslots > POOL_FIRST);
+    dw1000_dev_instance_t * inst = tdma->parent;
+    tdma_alloc_instance_t * alloc = tdma->alloc;
+
+    if (alloc == NULL){
+        uint16_t npool = tdma->nslots - POOL_FIRST;
+        alloc = (tdma_alloc_instance_t *) malloc(sizeof(tdma_alloc_instance_t) + npool * sizeof(tdma_alloc_slot_t));
+        assert(alloc);
+        memset(alloc, 0, sizeof(tdma_alloc_instance_t) + npool * sizeof(tdma_alloc_slot_t));
+        alloc->tdma = tdma;
+        os_error_t err = os_sem_init(&alloc->sem, 0x1);
+        assert(err == OS_OK);
+
+        alloc->cbs = (dw1000_mac_interface_t){
+            .id = DW1000_TDMA_ALLOC,
+            .rx_complete_cb = rx_complete_cb,
+            .tx_complete_cb = tx_complete_cb,
+            .rx_timeout_cb = rx_timeout_cb,
+            .rx_error_cb = rx_timeout_cb,
+            .reset_cb = reset_cb
+        };
+        dw1000_mac_append_interface(inst, &alloc->cbs);
+
+#if MYNEWT_VAL(TDMA_STATS)
+        int rc = stats_init(
+                    STATS_HDR(alloc->stat),
+                    STATS_SIZE_INIT_PARMS(alloc->stat, STATS_SIZE_32),
+                    STATS_NAME_INIT_PARMS(tdma_alloc_stat_section)
+                );
+        assert(rc == 0);
+#if  MYNEWT_VAL(DW1000_DEVICE_0) && !MYNEWT_VAL(DW1000_DEVICE_1)
+        rc = stats_register("tdma_alloc", STATS_HDR(alloc->stat));
+#elif  MYNEWT_VAL(DW1000_DEVICE_0) && MYNEWT_VAL(DW1000_DEVICE_1)
+        if (inst->idx == 0)
+            rc |= stats_register("tdma_alloc0", STATS_HDR(alloc->stat));
+        else
+            rc |= stats_register("tdma_alloc1", STATS_HDR(alloc->stat));
+#endif
+        assert(rc == 0);
+#endif
+        tdma->alloc = alloc;
+    }
+    alloc->status.coordinator = coordinator;
+    alloc->seed = (uint32_t)inst->euid ^ (uint32_t)(inst->euid >> 32) ^ inst->my_short_address;
+
+    tdma_assign_slot(tdma, map_slot_cb, MYNEWT_VAL(TDMA_ALLOC_MAP_SLOT), alloc);
+    for (uint16_t i = 0; i < MYNEWT_VAL(TDMA_ALLOC_CONTENTION_SLOTS); i++)
+        tdma_assign_slot(tdma, contention_slot_cb, MYNEWT_VAL(TDMA_ALLOC_CONTENTION_SLOT) + i, alloc);
+    return alloc;
+}
+
+/**
+ * @fn tdma_alloc_free(struct _tdma_alloc_instance_t * alloc)
+ * @brief API to stop dynamic slot allocation and release the map, contention and held pool slots.
+ *
+ * @param alloc  Pointer to _tdma_alloc_instance_t.
+ *
+ * @return void
+ */
+void
+tdma_alloc_free(struct _tdma_alloc_instance_t * alloc){
+    assert(alloc);
+    tdma_instance_t * tdma = alloc->tdma;
+
+    tdma_release_slot(tdma, MYNEWT_VAL(TDMA_ALLOC_MAP_SLOT));
+    for (uint16_t i = 0; i < MYNEWT_VAL(TDMA_ALLOC_CONTENTION_SLOTS); i++)
+        tdma_release_slot(tdma, MYNEWT_VAL(TDMA_ALLOC_CONTENTION_SLOT) + i);
+    if (!alloc->status.coordinator){
+        for (uint16_t i = 0; i < pool_size(alloc); i++)
+            if (alloc->slots[i].owner)
+                tdma_release_slot(tdma, POOL_FIRST + i);
+    }
+    dw1000_mac_remove_interface(tdma->parent, alloc->cbs.id);
+    tdma->alloc = NULL;
+    free(alloc);
+}
+
+/**
+ * @fn tdma_alloc_set_callout(struct _tdma_alloc_instance_t * alloc, os_event_fn * callout, void * arg)
+ * @brief API to set the callout of the pool slots granted to this node, as for tdma_assign_slot(). A frame
+ * the callout sends marks its slot in use when it completes before the callout returns, as with DWT_BLOCKING.
+ *
+ * @param alloc    Pointer to _tdma_alloc_instance_t.
+ * @param callout  Slot callout.
+ * @param arg      Argument of the slot.
+ *
+ * @return void
+ */
+void
+tdma_alloc_set_callout(struct _tdma_alloc_instance_t * alloc, os_event_fn * callout, void * arg){
+    assert(alloc);
+    alloc->callout = callout;
+    alloc->arg = arg;
+}
+
+/**
+ * @fn tdma_alloc_request(struct _tdma_alloc_instance_t * alloc, uint8_t nslots)
+ * @brief API to set the number of pool slots this node wants. The request is sent in the next free
+ * contention slot, 0 hands all slots back.
+ *
+ * @param alloc   Pointer to _tdma_alloc_instance_t.
+ * @param nslots  Pool slots wanted in total.
+ *
+ * @return void
+ */
+void
+tdma_alloc_request(struct _tdma_alloc_instance_t * alloc, uint8_t nslots){
+    assert(alloc && !alloc->status.coordinator);
+    assert(alloc->callout || nslots == 0);
+    alloc->request = nslots;
+    alloc->want = nslots;
+    alloc->attempts = 0;
+    alloc->backoff = 0;
+    alloc->hold = 0;
+    alloc->probe = MYNEWT_VAL(TDMA_ALLOC_IDLE_EPOCHS);
+}
+
+/**
+ * @fn tdma_alloc_held(struct _tdma_alloc_instance_t * alloc)
+ * @brief API for the number of pool slots assigned to this node.
+ *
+ * @param alloc  Pointer to _tdma_alloc_instance_t.
+ *
+ * @return uint16_t
+ */
+uint16_t
+tdma_alloc_held(struct _tdma_alloc_instance_t * alloc){
+    return alloc->held;
+}
+
+static void
+alloc_send(tdma_alloc_instance_t * alloc, uint64_t dx_time, uint16_t len){
+    dw1000_dev_instance_t * inst = alloc->tdma->parent;
+
+    os_error_t err = os_sem_pend(&alloc->sem, OS_TIMEOUT_NEVER);
+    assert(err == OS_OK);
+
+    alloc->frame.fctrl = FCNTL_IEEE_TDMA_16;
+    alloc->frame.seq_num = alloc->seq_num++;
+    alloc->frame.PANID = inst->PANID;
+    alloc->frame.src_address = inst->my_short_address;
+    dw1000_write_tx(inst, alloc->frame.array, 0, len);
+    dw1000_write_tx_fctrl(inst, len, 0);
+    dw1000_set_delay_start(inst, dx_time);
+
+    alloc->status.start_tx_error = dw1000_start_tx(inst).start_tx_error;
+    if (alloc->status.start_tx_error){
+        err = os_sem_release(&alloc->sem);
+        assert(err == OS_OK);
+    }else{
+        err = os_sem_pend(&alloc->sem, OS_TIMEOUT_NEVER); // Wait for completion of transactions
+        assert(err == OS_OK);
+        err = os_sem_release(&alloc->sem);
+        assert(err == OS_OK);
+    }
+}
+
+static bool
+alloc_listen(tdma_alloc_instance_t * alloc, uint64_t dx_time, uint16_t len){
+    dw1000_dev_instance_t * inst = alloc->tdma->parent;
+
+    os_error_t err = os_sem_pend(&alloc->sem, OS_TIMEOUT_NEVER);
+    assert(err == OS_OK);
+
+    alloc->status.rx = 0;
+    uint16_t timeout = dw1000_phy_frame_duration(&inst->attrib, len) + dw1000_phy_SHR_duration(&inst->attrib)
+                        + tdma_rx_slot_guard(inst) + MYNEWT_VAL(XTALT_GUARD);
+    dw1000_set_delay_start(inst, dx_time);
+    dw1000_set_rx_timeout(inst, timeout);
+
+    alloc->status.start_rx_error = dw1000_start_rx(inst).start_rx_error;
+    if (alloc->status.start_rx_error){
+        err = os_sem_release(&alloc->sem);
+        assert(err == OS_OK);
+    }else{
+        err = os_sem_pend(&alloc->sem, OS_TIMEOUT_NEVER); // Wait for completion of transactions
+        assert(err == OS_OK);
+        err = os_sem_release(&alloc->sem);
+        assert(err == OS_OK);
+    }
+    return alloc->status.rx;
+}
+
+/* Coordinator: grant or trim the pool slots of a node to the number it wants and renew its lease */
+static void
+coordinator_request(tdma_alloc_instance_t * alloc, uint16_t addr, uint8_t want){
+    uint16_t npool = pool_size(alloc);
+    uint16_t held = 0;
+
+    for (uint16_t i = 0; i < npool; i++){
+        if (alloc->slots[i].owner == addr){
+            alloc->slots[i].count = MYNEWT_VAL(TDMA_ALLOC_LEASE_EPOCHS);
+            held++;
+        }
+    }
+    // A slot freed but not yet broadcast may still be used by its previous owner
+    for (uint16_t i = 0; i < npool && held < want; i++){
+        tdma_alloc_slot_t * slot = &alloc->slots[i];
+        if (slot->owner == 0 && !slot->changed){
+            slot->owner = addr;
+            slot->count = MYNEWT_VAL(TDMA_ALLOC_LEASE_EPOCHS);
+            slot->changed = 1;
+            held++;
+            ALLOC_STATS_INC(grant);
+        }
+    }
+    if (held < want)
+        ALLOC_STATS_INC(pool_full);
+    for (uint16_t i = npool; i > 0 && held > want; i--){
+        tdma_alloc_slot_t * slot = &alloc->slots[i - 1];
+        if (slot->owner == addr){
+            slot->owner = 0;
+            slot->changed = 1;
+            held--;
+        }
+    }
+}
+
+/* Coordinator: expire leases, then fill the map with changed entries and the rest of the pool in rotation */
+static uint8_t
+coordinator_map(tdma_alloc_instance_t * alloc){
+    uint16_t npool = pool_size(alloc);
+    uint8_t n = 0;
+
+    for (uint16_t i = 0; i < npool; i++){
+        tdma_alloc_slot_t * slot = &alloc->slots[i];
+        if (slot->owner && --slot->count == 0){
+            slot->owner = 0;
+            slot->changed = 1;
+            ALLOC_STATS_INC(reclaim);
+        }
+    }
+    for (uint16_t i = 0; i < npool && n < MYNEWT_VAL(TDMA_ALLOC_MAP_ENTRIES); i++){
+        if (alloc->slots[i].changed){
+            alloc->slots[i].changed = 0;
+            alloc->frame.entry[n++] = (tdma_alloc_entry_t){.slot = POOL_FIRST + i, .owner = alloc->slots[i].owner};
+        }
+    }
+    uint8_t nchanged = n;
+    for (uint16_t k = 0; k < npool && n < MYNEWT_VAL(TDMA_ALLOC_MAP_ENTRIES); k++){
+        uint16_t i = alloc->cursor;
+        alloc->cursor = (alloc->cursor + 1) % npool;
+        uint8_t j;
+        for (j = 0; j < nchanged && alloc->frame.entry[j].slot != POOL_FIRST + i; j++);
+        if (j == nchanged)
+            alloc->frame.entry[n++] = (tdma_alloc_entry_t){.slot = POOL_FIRST + i, .owner = alloc->slots[i].owner};
+    }
+    return n;
+}
+
+/* Node: follow the map */
+static void
+node_map(tdma_alloc_instance_t * alloc){
+    tdma_instance_t * tdma = alloc->tdma;
+    uint16_t addr = tdma->parent->my_short_address;
+    uint8_t n = alloc->frame.n;
+
+    if (n > MYNEWT_VAL(TDMA_ALLOC_MAP_ENTRIES))
+        n = MYNEWT_VAL(TDMA_ALLOC_MAP_ENTRIES);
+    for (uint8_t j = 0; j < n; j++){
+        tdma_alloc_entry_t * entry = &alloc->frame.entry[j];
+        if (entry->slot < POOL_FIRST || entry->slot >= tdma->nslots)
+            continue;
+        tdma_alloc_slot_t * slot = &alloc->slots[entry->slot - POOL_FIRST];
+        if (entry->owner == addr && slot->owner == 0 && alloc->callout){
+            tdma_assign_slot(tdma, pool_slot_cb, entry->slot, alloc->arg);
+            slot->owner = addr;
+            slot->count = 0;
+            alloc->held++;
+        }else if (entry->owner != addr && slot->owner == addr){
+            tdma_release_slot(tdma, entry->slot);
+            slot->owner = 0;
+            alloc->held--;
+        }
+    }
+}
+
+/* Node: hand back idle slots, raise a trimmed want back to the request once its hold expires and decide
+ * whether and where to send a request this superframe */
+static void
+node_superframe(tdma_alloc_instance_t * alloc){
+    uint8_t nidle = 0;
+
+    for (uint16_t i = 0; i < pool_size(alloc); i++){
+        tdma_alloc_slot_t * slot = &alloc->slots[i];
+        if (slot->owner && ++slot->count >= MYNEWT_VAL(TDMA_ALLOC_IDLE_EPOCHS))
+            nidle++;
+    }
+    if (nidle && alloc->want > alloc->held - nidle){
+        alloc->want = alloc->held - nidle;
+        // Restart the observation, the coordinator chooses which slots to take back
+        for (uint16_t i = 0; i < pool_size(alloc); i++)
+            alloc->slots[i].count = 0;
+        // The load may come back, try the request again later, later still if the slots go idle again
+        alloc->hold = alloc->probe;
+        alloc->probe = (2 * alloc->probe < MYNEWT_VAL(TDMA_ALLOC_LEASE_EPOCHS)) ? 2 * alloc->probe : MYNEWT_VAL(TDMA_ALLOC_LEASE_EPOCHS);
+        ALLOC_STATS_INC(idle);
+    }else if (alloc->want < alloc->request){
+        if (alloc->hold)
+            alloc->hold--;
+        else{
+            alloc->want = alloc->request;
+            ALLOC_STATS_INC(regrow);
+        }
+    }
+
+    if (alloc->held && alloc->renew)
+        alloc->renew--;
+    alloc->tx_slot = 0;
+    if (alloc->want == alloc->held && !(alloc->held && alloc->renew == 0)){
+        alloc->attempts = 0;
+        alloc->backoff = 0;
+        return;
+    }
+    if (alloc->backoff){
+        alloc->backoff--;
+        return;
+    }
+    alloc->tx_slot = MYNEWT_VAL(TDMA_ALLOC_CONTENTION_SLOT) + alloc_rand(alloc) % MYNEWT_VAL(TDMA_ALLOC_CONTENTION_SLOTS);
+    alloc->backoff = alloc_rand(alloc) % (1U << alloc->attempts);
+    if (alloc->attempts < MYNEWT_VAL(TDMA_ALLOC_MAX_BACKOFF))
+        alloc->attempts++;
+}
+
+/**
+ * @fn map_slot_cb(struct os_event * ev)
+ * @brief Map slot callout, the coordinator broadcasts the map and nodes follow it.
+ *
+ * @param ev  Pointer to os_event.
+ *
+ * @return void
+ */
+static void
+map_slot_cb(struct os_event * ev){
+    assert(ev);
+    assert(ev->ev_arg);
+
+    tdma_slot_t * slot = (tdma_slot_t *) ev->ev_arg;
+    tdma_alloc_instance_t * alloc = (tdma_alloc_instance_t *) slot->arg;
+    dw1000_dev_instance_t * inst = alloc->tdma->parent;
+
+    if (alloc->status.coordinator){
+        uint8_t n = coordinator_map(alloc);
+        alloc->frame.dst_address = BROADCAST_ADDRESS;
+        alloc->frame.code = TDMA_ALLOC_MAP;
+        alloc->frame.n = n;
+        alloc_send(alloc, tdma_tx_slot_start(inst, slot->idx) & 0xFFFFFFFE00UL, FRAME_LEN(n));
+        ALLOC_STATS_INC(map_tx);
+        return;
+    }
+    if (alloc_listen(alloc, tdma_rx_slot_start(inst, slot->idx) & 0xFFFFFFFE00UL, FRAME_LEN(MYNEWT_VAL(TDMA_ALLOC_MAP_ENTRIES)))
+        && alloc->frame.code == TDMA_ALLOC_MAP){
+        ALLOC_STATS_INC(map_rx);
+        node_map(alloc);
+    }
+    node_superframe(alloc);
+}
+
+/**
+ * @fn contention_slot_cb(struct os_event * ev)
+ * @brief Contention slot callout, the coordinator listens for requests and a node with a pending request
+ * sends it in the slot it drew.
+ *
+ * @param ev  Pointer to os_event.
+ *
+ * @return void
+ */
+static void
+contention_slot_cb(struct os_event * ev){
+    assert(ev);
+    assert(ev->ev_arg);
+
+    tdma_slot_t * slot = (tdma_slot_t *) ev->ev_arg;
+    tdma_alloc_instance_t * alloc = (tdma_alloc_instance_t *) slot->arg;
+    dw1000_dev_instance_t * inst = alloc->tdma->parent;
+
+    if (alloc->status.coordinator){
+        if (alloc_listen(alloc, tdma_rx_slot_start(inst, slot->idx) & 0xFFFFFFFE00UL, FRAME_LEN(0))
+            && alloc->frame.code == TDMA_ALLOC_REQ){
+            ALLOC_STATS_INC(req_rx);
+            coordinator_request(alloc, alloc->frame.src_address, alloc->frame.n);
+        }
+        return;
+    }
+    if (alloc->tx_slot != slot->idx)
+        return;
+    alloc->tx_slot = 0;
+    alloc->frame.dst_address = BROADCAST_ADDRESS;
+    alloc->frame.code = TDMA_ALLOC_REQ;
+    alloc->frame.n = alloc->want;
+    alloc_send(alloc, tdma_tx_slot_start(inst, slot->idx) & 0xFFFFFFFE00UL, FRAME_LEN(0));
+    alloc->renew = MYNEWT_VAL(TDMA_ALLOC_LEASE_EPOCHS) / 4 + 1;
+    ALLOC_STATS_INC(req_tx);
+}
+
+/**
+ * @fn pool_slot_cb(struct os_event * ev)
+ * @brief Callout of the pool slots held by a node, runs the callout set by tdma_alloc_set_callout(). A frame
+ * completed in the meantime is credited to this slot by tx_complete_cb.
+ *
+ * @param ev  Pointer to os_event.
+ *
+ * @return void
+ */
+static void
+pool_slot_cb(struct os_event * ev){
+    assert(ev);
+    assert(ev->ev_arg);
+
+    tdma_slot_t * slot = (tdma_slot_t *) ev->ev_arg;
+    tdma_alloc_instance_t * alloc = slot->parent->alloc;
+
+    if (alloc->callout == NULL)
+        return;
+    alloc->tx_idx = slot->idx;
+    alloc->callout(ev);
+    alloc->tx_idx = 0;
+}
+
+/**
+ * @fn rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
+ * @brief Interrupt context rx_complete callback, copies an allocation frame received while listening.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ * @param cbs   Pointer to dw1000_mac_interface_t.
+ *
+ * @return bool
+ */
+static bool
+rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs){
+
+    if (inst->fctrl != FCNTL_IEEE_TDMA_16)
+        return false;
+
+    tdma_alloc_instance_t * alloc = inst->tdma->alloc;
+    if (os_sem_get_count(&alloc->sem) == 1)
+        return true;    // Unsolicited, not listening
+
+    uint16_t len = inst->frame_len < sizeof(tdma_alloc_frame_t) ? inst->frame_len : sizeof(tdma_alloc_frame_t);
+    if (len >= FRAME_LEN(0)){
+        dw1000_read_rx(inst, alloc->frame.array, 0, len);
+        alloc->status.rx = 1;
+    }
+    os_error_t err = os_sem_release(&alloc->sem);
+    assert(err == OS_OK);
+    return true;
+}
+
+/**
+ * @fn tx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
+ * @brief Interrupt context tx_complete callback. Completes an allocation frame, any other frame completed
+ * while the callout of a held pool slot runs marks that slot as in use.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ * @param cbs   Pointer to dw1000_mac_interface_t.
+ *
+ * @return bool
+ */
+static bool
+tx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs){
+
+    tdma_alloc_instance_t * alloc = inst->tdma->alloc;
+
+    if (inst->fctrl == FCNTL_IEEE_TDMA_16){
+        if (os_sem_get_count(&alloc->sem) == 0){
+            os_error_t err = os_sem_release(&alloc->sem);
+            assert(err == OS_OK);
+        }
+        return true;
+    }
+    // Not the last slot the tdma timer posted, that leads the slot start and may be a later one
+    uint16_t idx = alloc->tx_idx;
+    if (idx >= POOL_FIRST && idx < inst->tdma->nslots)
+        alloc->slots[idx - POOL_FIRST].count = 0;
+    return false;
+}
+
+/**
+ * @fn rx_timeout_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
+ * @brief Interrupt context rx_timeout and rx_error callback, ends a listen without a frame.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ * @param cbs   Pointer to dw1000_mac_interface_t.
+ *
+ * @return bool
+ */
+static bool
+rx_timeout_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs){
+
+    tdma_alloc_instance_t * alloc = inst->tdma->alloc;
+    if (os_sem_get_count(&alloc->sem) == 1)
+        return false;
+
+    alloc->status.rx = 0;
+    os_error_t err = os_sem_release(&alloc->sem);
+    assert(err == OS_OK);
+    return true;
+}
+
+/**
+ * @fn reset_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
+ * @brief Releases a transaction in progress when the MAC is reset.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ * @param cbs   Pointer to dw1000_mac_interface_t.
+ *
+ * @return bool
+ */
+static bool
+reset_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs){
+
+    tdma_alloc_instance_t * alloc = inst->tdma->alloc;
+    if (os_sem_get_count(&alloc->sem) == 0){
+        os_error_t err = os_sem_release(&alloc->sem);
+        assert(err == OS_OK);
+        return true;
+    }
+    return false;
+}
+#endif
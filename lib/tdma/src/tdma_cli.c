@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2017-2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file tdma_cli.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief TDMA command line interface
+ *
+ * @details tdma prof [instance] prints the slot profiler totals and histograms, tdma clear [instance]
+ * resets them, see tdma_profile.h.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include "os/os.h"
+
+#if MYNEWT_VAL(TDMA_PROFILE_CLI)
+#include <shell/shell.h>
+#include <console/console.h>
+#include <dw1000/dw1000_hal.h>
+#include <dw1000/dw1000_dev.h>
+#include <tdma/tdma.h>
+#include <tdma/tdma_profile.h>
+#include <ccp/ccp.h>
+
+static int tdma_cli_cmd(int argc, char **argv);
+
+#if MYNEWT_VAL(SHELL_CMD_HELP)
+const struct shell_param cmd_tdma_param[] = {
+    {"prof", "[instance] slot profiler totals and histograms"},
+    {"clear", "[instance] reset the slot profiler"},
+    {NULL,NULL},
+};
+
+const struct shell_cmd_help cmd_tdma_help = {
+	"tdma", "<cmd>", cmd_tdma_param
+};
+#endif
+
+static struct shell_cmd shell_tdma_cmd = {
+    .sc_cmd = "tdma",
+    .sc_cmd_func = tdma_cli_cmd,
+#if MYNEWT_VAL(SHELL_CMD_HELP)
+    .help = &cmd_tdma_help
+#endif
+};
+
+static void
+print_histogram(const char * name, const uint32_t * bins)
+{
+    console_printf("%-6s", name);
+    for (uint16_t i = 0; i < TDMA_PROFILE_BINS; i++)
+        console_printf(" %8lu", (unsigned long)bins[i]);
+    console_printf("\n");
+}
+
+static void
+tdma_cli_prof(struct _tdma_instance_t * tdma)
+{
+    tdma_profile_t * profile = tdma->profile;
+    uint32_t slot_usecs = (uint32_t)(dw1000_dwt_usecs_to_usecs(tdma->parent->ccp->period) / tdma->nslots);
+
+    console_printf("#slot,    runs, late,  err,  ovr, lat_max(us), margin_min(us), busy(us/run), air(%%)\n");
+    for (uint16_t i = 0; i < tdma->nslots; i++){
+        tdma_profile_slot_t * rec = &profile->slots[i];
+        if (rec->runs == 0)
+            continue;
+        uint32_t air = (uint32_t)((uint64_t)rec->airtime * 1000 / ((uint64_t)rec->runs * slot_usecs));
+        console_printf("%5u, %7lu, %4u, %4u, %4u, %11u, %14ld, %12lu, %3lu.%lu\n",
+            i, (unsigned long)rec->runs, rec->late, rec->start_error, rec->overrun, rec->latency_max,
+            (long)rec->margin_min, (unsigned long)(rec->busy / rec->runs),
+            (unsigned long)(air / 10), (unsigned long)(air % 10));
+    }
+
+    console_printf("#bin(us)");
+    for (uint16_t i = 0; i < TDMA_PROFILE_BINS; i++)
+        console_printf(" %8lu", (unsigned long)tdma_profile_bin_edge(i));
+    console_printf("\n");
+    print_histogram("lat", profile->latency);
+    print_histogram("margin", profile->margin);
+    console_printf("#bin(%%)");
+    for (uint16_t i = 0; i < TDMA_PROFILE_BINS; i++)
+        console_printf(" %8u", i * 100 / TDMA_PROFILE_BINS);
+    console_printf("\n");
+    print_histogram("util", profile->utilization);
+}
+
+static int
+tdma_cli_cmd(int argc, char **argv)
+{
+    struct _dw1000_dev_instance_t * inst;
+    uint16_t inst_n = 0;
+
+    if (argc < 2) {
+        console_printf("Too few args\n");
+        return 0;
+    }
+    if (argc > 2)
+        inst_n = strtol(argv[2], NULL, 0);
+    inst = hal_dw1000_inst(inst_n);
+    if (inst->tdma == NULL || inst->tdma->profile == NULL) {
+        console_printf("No tdma profiler\n");
+        return 0;
+    }
+
+    if (!strcmp(argv[1], "prof")) {
+        tdma_cli_prof(inst->tdma);
+    } else if (!strcmp(argv[1], "clear")) {
+        tdma_profile_clear(inst->tdma->profile);
+    } else {
+        console_printf("Unknown cmd\n");
+    }
+    return 0;
+}
+
+#endif
+
+int
+tdma_cli_register(void)
+{
+#if MYNEWT_VAL(TDMA_PROFILE_CLI)
+    return shell_cmd_register(&shell_tdma_cmd);
+#else
+    return 0;
+#endif
+}
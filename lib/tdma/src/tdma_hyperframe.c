@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2017-2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file tdma_hyperframe.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief TDMA hyperframe packing
+ *
+ * @details Bookkeeping only, the packer does not touch the tdma instance. The application distributes the
+ * placements, e.g. in its slot map, and each node applies its own with tdma_assign_slot() followed by
+ * tdma_set_slot_rate().
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "os/os.h"
+
+#include <tdma/tdma_hyperframe.h>
+
+#define HYPERFRAME MYNEWT_VAL(TDMA_HYPERFRAME_MAX)
+
+/**
+ * @fn tdma_hyperframe_init(struct _tdma_hyperframe_t * hf, uint16_t first, uint16_t nslots)
+ * @brief API to initialise an empty packer for the slots first to first + nslots - 1.
+ *
+ * @param hf       Pointer to tdma_hyperframe_t, allocated here if NULL.
+ * @param first    First slot of the range.
+ * @param nslots   Slots in the range.
+ *
+ * @return tdma_hyperframe_t *
+ */
+tdma_hyperframe_t *
+tdma_hyperframe_init(struct _tdma_hyperframe_t * hf, uint16_t first, uint16_t nslots){
+
+    if (hf == NULL){
+        hf = (tdma_hyperframe_t *) malloc(sizeof(tdma_hyperframe_t) + nslots * sizeof(uint32_t));
+        assert(hf);
+        memset(hf, 0, sizeof(tdma_hyperframe_t) + nslots * sizeof(uint32_t));
+        hf->selfmalloc = 1;
+    }
+    hf->first = first;
+    hf->nslots = nslots;
+    tdma_hyperframe_clear(hf);
+    return hf;
+}
+
+/**
+ * @fn tdma_hyperframe_free(struct _tdma_hyperframe_t * hf)
+ * @brief API to free the packer.
+ *
+ * @param hf    Pointer to tdma_hyperframe_t.
+ *
+ * @return void
+ */
+void
+tdma_hyperframe_free(struct _tdma_hyperframe_t * hf){
+    assert(hf);
+    if (hf->selfmalloc)
+        free(hf);
+}
+
+/**
+ * @fn tdma_hyperframe_clear(struct _tdma_hyperframe_t * hf)
+ * @brief API to remove all placements.
+ *
+ * @param hf    Pointer to tdma_hyperframe_t.
+ *
+ * @return void
+ */
+void
+tdma_hyperframe_clear(struct _tdma_hyperframe_t * hf){
+    assert(hf);
+    memset(hf->occupancy, 0, hf->nslots * sizeof(uint32_t));
+}
+
+/**
+ * @fn period_mask(uint16_t period)
+ * @brief Superframes of the hyperframe taken by phase 0 of a rate class.
+ *
+ * @param period   Superframes between slots, 0 is taken as 1.
+ *
+ * @return bitmap
+ */
+static uint32_t
+period_mask(uint16_t period){
+    assert((period & (period - 1)) == 0 && period <= HYPERFRAME);
+    if (period == 0)
+        period = 1;
+    uint32_t mask = 0;
+    for (uint16_t k = 0; k < HYPERFRAME; k += period)
+        mask |= 1UL << k;
+    return mask;
+}
+
+/**
+ * @fn tdma_hyperframe_place(struct _tdma_hyperframe_t * hf, tdma_hyperframe_entry_t * entry)
+ * @brief API to place one member, first fit. Slots already shared are tried before empty ones so that
+ * members added one at a time leave whole slots for faster classes.
+ *
+ * @param hf       Pointer to tdma_hyperframe_t.
+ * @param entry    Member, period in, slot and phase out.
+ *
+ * @return OS_OK, OS_ENOMEM if no slot has room for the class
+ */
+int
+tdma_hyperframe_place(struct _tdma_hyperframe_t * hf, tdma_hyperframe_entry_t * entry){
+
+    uint32_t mask = period_mask(entry->period);
+    uint16_t period = entry->period ? entry->period : 1;
+
+    entry->slot = TDMA_HYPERFRAME_NONE;
+    for (uint16_t pass = 0; pass < 2; pass++){
+        for (uint16_t i = 0; i < hf->nslots; i++){
+            if ((hf->occupancy[i] == 0) == (pass == 0))
+                continue;
+            for (uint16_t phase = 0; phase < period; phase++){
+                if ((hf->occupancy[i] & (mask << phase)) == 0){
+                    hf->occupancy[i] |= mask << phase;
+                    entry->slot = hf->first + i;
+                    entry->phase = phase;
+                    return OS_OK;
+                }
+            }
+        }
+    }
+    return OS_ENOMEM;
+}
+
+/**
+ * @fn tdma_hyperframe_remove(struct _tdma_hyperframe_t * hf, tdma_hyperframe_entry_t * entry)
+ * @brief API to release the placement of a member.
+ *
+ * @param hf       Pointer to tdma_hyperframe_t.
+ * @param entry    Member placed by tdma_hyperframe_place() or tdma_hyperframe_pack().
+ *
+ * @return void
+ */
+void
+tdma_hyperframe_remove(struct _tdma_hyperframe_t * hf, tdma_hyperframe_entry_t * entry){
+
+    if (entry->slot == TDMA_HYPERFRAME_NONE)
+        return;
+    assert(entry->slot >= hf->first && entry->slot < hf->first + hf->nslots);
+    hf->occupancy[entry->slot - hf->first] &= ~(period_mask(entry->period) << entry->phase);
+    entry->slot = TDMA_HYPERFRAME_NONE;
+}
+
+/**
+ * @fn tdma_hyperframe_pack(struct _tdma_hyperframe_t * hf, tdma_hyperframe_entry_t entries[], uint16_t n)
+ * @brief API to repack all members from scratch, fastest class first. Members that do not fit are left
+ * with slot TDMA_HYPERFRAME_NONE, they are always members of the slowest classes.
+ *
+ * @param hf        Pointer to tdma_hyperframe_t.
+ * @param entries   Members, period in, slot and phase out.
+ * @param n         Number of members.
+ *
+ * @return Number of members placed
+ */
+uint16_t
+tdma_hyperframe_pack(struct _tdma_hyperframe_t * hf, tdma_hyperframe_entry_t entries[], uint16_t n){
+
+    uint16_t placed = 0;
+
+    tdma_hyperframe_clear(hf);
+    for (uint16_t i = 0; i < n; i++)
+        entries[i].slot = TDMA_HYPERFRAME_NONE;
+
+    for (uint16_t period = 1; period <= HYPERFRAME; period <<= 1){
+        for (uint16_t i = 0; i < n; i++){
+            if ((entries[i].period ? entries[i].period : 1) != period)
+                continue;
+            if (tdma_hyperframe_place(hf, &entries[i]) == OS_OK)
+                placed++;
+        }
+    }
+    return placed;
+}
+
+/**
+ * @fn tdma_hyperframe_capacity(struct _tdma_hyperframe_t * hf, uint16_t period)
+ * @brief API for the number of further members of a rate class that fit without repacking.
+ *
+ * @param hf       Pointer to tdma_hyperframe_t.
+ * @param period   Superframes between slots.
+ *
+ * @return Number of free (slot, phase) pairs of the class
+ */
+uint16_t
+tdma_hyperframe_capacity(struct _tdma_hyperframe_t * hf, uint16_t period){
+
+    uint32_t mask = period_mask(period);
+    uint16_t free = 0;
+
+    if (period == 0)
+        period = 1;
+    for (uint16_t i = 0; i < hf->nslots; i++)
+        for (uint16_t phase = 0; phase < period; phase++)
+            if ((hf->occupancy[i] & (mask << phase)) == 0)
+                free++;
+    return free;
+}
@@ -0,0 +1,306 @@
+/*
+ * Copyright (C) 2017-2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file tdma_profile.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief TDMA slot execution profiler
+ *
+ * @details With TDMA_PROFILE_ENABLED tdma_assign_slot() installs tdma_profile_slot_cb() as the slot
+ * callout, which times the application callout it wraps. The slot timer and the tdma mac callbacks feed
+ * tdma_profile_posted() and tdma_profile_frame() from interrupt context, everything else runs on the tdma
+ * eventq. The slot grid is the os_cputime one of the slot timer. The margin of a run is taken against the
+ * dx_time the callout programs with dw1000_set_delay_start(), mapped to os_cputime through the ccp epoch,
+ * runs that program none are not counted in it.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+#include "os/os.h"
+
+#if MYNEWT_VAL(TDMA_PROFILE_ENABLED)
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_phy.h>
+#include <tdma/tdma.h>
+#include <tdma/tdma_profile.h>
+#include <ccp/ccp.h>
+
+#if MYNEWT_VAL(TDMA_STATS)
+STATS_NAME_START(tdma_profile_stat_section)
+    STATS_NAME(tdma_profile_stat_section, runs)
+    STATS_NAME(tdma_profile_stat_section, late)
+    STATS_NAME(tdma_profile_stat_section, start_error)
+    STATS_NAME(tdma_profile_stat_section, overrun)
+    STATS_NAME(tdma_profile_stat_section, frames)
+    STATS_NAME(tdma_profile_stat_section, unattributed)
+STATS_NAME_END(tdma_profile_stat_section)
+
+#define PROFILE_STATS_INC(__X) STATS_INC(profile->stat, __X)
+#else
+#define PROFILE_STATS_INC(__X) {}
+#endif
+
+/**
+ * @fn tdma_profile_init(struct _tdma_instance_t * tdma)
+ * @brief API to allocate the profiler of a tdma instance, called from tdma_init().
+ *
+ * @param tdma  Pointer to _tdma_instance_t.
+ *
+ * @return tdma_profile_t *
+ */
+tdma_profile_t *
+tdma_profile_init(struct _tdma_instance_t * tdma){
+    assert(tdma);
+    tdma_profile_t * profile = tdma->profile;
+
+    if (profile == NULL){
+        profile = (tdma_profile_t *) malloc(sizeof(tdma_profile_t) + tdma->nslots * sizeof(tdma_profile_slot_t));
+        assert(profile);
+        memset(profile, 0, sizeof(tdma_profile_t) + tdma->nslots * sizeof(tdma_profile_slot_t));
+        profile->tdma = tdma;
+
+#if MYNEWT_VAL(TDMA_STATS)
+        int rc = stats_init(
+                    STATS_HDR(profile->stat),
+                    STATS_SIZE_INIT_PARMS(profile->stat, STATS_SIZE_32),
+                    STATS_NAME_INIT_PARMS(tdma_profile_stat_section)
+                );
+        assert(rc == 0);
+#if  MYNEWT_VAL(DW1000_DEVICE_0) && !MYNEWT_VAL(DW1000_DEVICE_1)
+        rc = stats_register("tdma_prof", STATS_HDR(profile->stat));
+#elif  MYNEWT_VAL(DW1000_DEVICE_0) && MYNEWT_VAL(DW1000_DEVICE_1)
+        if (tdma->parent->idx == 0)
+            rc |= stats_register("tdma_prof0", STATS_HDR(profile->stat));
+        else
+            rc |= stats_register("tdma_prof1", STATS_HDR(profile->stat));
+#endif
+        assert(rc == 0);
+#endif
+        tdma->profile = profile;
+    }
+    tdma_profile_clear(profile);
+    return profile;
+}
+
+/**
+ * @fn tdma_profile_free(struct _tdma_profile_t * profile)
+ * @brief API to free the profiler.
+ *
+ * @param profile  Pointer to tdma_profile_t.
+ *
+ * @return void
+ */
+void
+tdma_profile_free(struct _tdma_profile_t * profile){
+    assert(profile);
+    profile->tdma->profile = NULL;
+    free(profile);
+}
+
+/**
+ * @fn tdma_profile_clear(struct _tdma_profile_t * profile)
+ * @brief API to reset the totals and histograms, the stats counters are left running.
+ *
+ * @param profile  Pointer to tdma_profile_t.
+ *
+ * @return void
+ */
+void
+tdma_profile_clear(struct _tdma_profile_t * profile){
+    assert(profile);
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    memset(profile->latency, 0, sizeof(profile->latency));
+    memset(profile->margin, 0, sizeof(profile->margin));
+    memset(profile->utilization, 0, sizeof(profile->utilization));
+    for (uint16_t i = 0; i < profile->tdma->nslots; i++){
+        tdma_profile_slot_t * rec = &profile->slots[i];
+        uint16_t pending = rec->pending;
+        uint32_t posted = rec->posted;
+        uint32_t epoch = rec->epoch;
+        memset(rec, 0, sizeof(tdma_profile_slot_t));
+        rec->margin_min = INT32_MAX;
+        rec->pending = pending;
+        rec->posted = posted;
+        rec->epoch = epoch;
+    }
+    profile->current = TDMA_PROFILE_IDLE;
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * @fn tdma_profile_bin_edge(uint16_t bin)
+ * @brief API for the lower edge of a log2 histogram bin, bin 0 starts at zero.
+ *
+ * @param bin  Bin number.
+ *
+ * @return usecs
+ */
+uint32_t
+tdma_profile_bin_edge(uint16_t bin){
+    return bin ? (uint32_t)MYNEWT_VAL(TDMA_PROFILE_BIN_USECS) << (bin - 1) : 0;
+}
+
+static uint16_t
+log2_bin(uint32_t usecs){
+    uint16_t bin = 0;
+    while (bin < TDMA_PROFILE_BINS - 1 && usecs >= tdma_profile_bin_edge(bin + 1))
+        bin++;
+    return bin;
+}
+
+/**
+ * @fn tdma_profile_posted(struct _tdma_profile_t * profile, uint16_t idx, uint32_t now)
+ * @brief Interrupt context, the slot timer posted the callout of slot idx.
+ *
+ * @param profile  Pointer to tdma_profile_t.
+ * @param idx      Slot number.
+ * @param now      os_cputime of the post.
+ *
+ * @return void
+ */
+void
+tdma_profile_posted(struct _tdma_profile_t * profile, uint16_t idx, uint32_t now){
+    tdma_profile_slot_t * rec = &profile->slots[idx];
+    rec->posted = now;
+    rec->epoch = profile->tdma->schedule_epoch;
+    rec->pending = 1;
+}
+
+/**
+ * @fn tdma_profile_frame(struct _tdma_profile_t * profile, bool tx)
+ * @brief Interrupt context, a frame was sent or received. Its airtime is charged to the running slot callout.
+ *
+ * @param profile  Pointer to tdma_profile_t.
+ * @param tx       Transmit complete, else receive complete.
+ *
+ * @return void
+ */
+void
+tdma_profile_frame(struct _tdma_profile_t * profile, bool tx){
+
+    struct _dw1000_dev_instance_t * inst = profile->tdma->parent;
+
+    if (profile->current == TDMA_PROFILE_IDLE){
+        PROFILE_STATS_INC(unattributed);
+        return;
+    }
+    PROFILE_STATS_INC(frames);
+    uint16_t len = tx ? inst->tx_frame_len : inst->frame_len;
+    profile->run_airtime += dw1000_phy_frame_duration(&inst->attrib, len);
+}
+
+/**
+ * @fn tdma_profile_slot_cb(struct os_event * ev)
+ * @brief Slot callout installed by tdma_assign_slot(), runs and times the application callout of the slot.
+ * Callouts not posted by the slot timer, e.g. put on the eventq by the application, run untimed.
+ *
+ * @param ev  Pointer to os_event, ev_arg is the tdma_slot_t.
+ *
+ * @return void
+ */
+void
+tdma_profile_slot_cb(struct os_event * ev){
+    assert(ev != NULL);
+    assert(ev->ev_arg != NULL);
+
+    tdma_slot_t * slot = (tdma_slot_t *) ev->ev_arg;
+    tdma_instance_t * tdma = slot->parent;
+    tdma_profile_t * profile = tdma->profile;
+    struct _dw1000_dev_instance_t * inst = tdma->parent;
+    uint16_t idx = slot->idx;
+    tdma_profile_slot_t * rec = &profile->slots[idx];
+
+    if (!rec->pending){
+        slot->callout(ev);
+        return;
+    }
+
+    double slot_usecs = dw1000_dwt_usecs_to_usecs(inst->ccp->period) / tdma->nslots;
+    uint32_t end = rec->epoch + os_cputime_usecs_to_ticks((uint32_t)((idx + 1) * slot_usecs));
+
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    rec->pending = 0;
+    profile->current = idx;
+    profile->run_airtime = 0;
+    uint64_t local_epoch = inst->ccp->local_epoch;
+    uint32_t os_epoch = inst->ccp->os_epoch;
+    uint64_t dx_time = inst->dx_time;
+    // Errors left by an earlier start are not this callout's
+    inst->status.start_tx_error = 0;
+    inst->status.start_rx_error = 0;
+    OS_EXIT_CRITICAL(sr);
+
+    uint32_t t0 = os_cputime_get32();
+    slot->callout(ev);  // may release the slot, it is not touched past here
+    uint32_t t1 = os_cputime_get32();
+
+    OS_ENTER_CRITICAL(sr);
+    profile->current = TDMA_PROFILE_IDLE;
+    uint32_t airtime = profile->run_airtime;
+    bool programmed = inst->dx_time != dx_time;
+    dx_time = inst->dx_time;
+    bool start_error = inst->status.start_tx_error || inst->status.start_rx_error;
+    OS_EXIT_CRITICAL(sr);
+
+    uint32_t latency = os_cputime_ticks_to_usecs(t0 - rec->posted);
+
+    PROFILE_STATS_INC(runs);
+    rec->runs++;
+    rec->busy += os_cputime_ticks_to_usecs(t1 - t0);
+    rec->airtime += airtime;
+    if (latency > rec->latency_max)
+        rec->latency_max = (latency > UINT16_MAX) ? UINT16_MAX : latency;
+    profile->latency[log2_bin(latency)]++;
+
+    if (programmed){
+        // dx_time and t0 both from the ccp epoch, the 40 bit dx_time offset sign extended
+        int64_t dx_offset = ((int64_t)(((dx_time - local_epoch) & 0xFFFFFFFFFFULL) << 24)) >> 24;
+        int32_t since = (int32_t)(t0 - os_epoch) >= 0 ? (int32_t)os_cputime_ticks_to_usecs(t0 - os_epoch)
+                                                      : -(int32_t)os_cputime_ticks_to_usecs(os_epoch - t0);
+        int32_t margin = (int32_t)dw1000_dwt_usecs_to_usecs(dx_offset / 65536.0) - since;
+
+        if (margin < rec->margin_min)
+            rec->margin_min = margin;
+        if (margin < 0){
+            PROFILE_STATS_INC(late);
+            rec->late++;
+        }else
+            profile->margin[log2_bin(margin)]++;
+    }
+
+    if ((int32_t)(t1 - end) > 0){
+        PROFILE_STATS_INC(overrun);
+        rec->overrun++;
+    }
+    if (start_error){
+        PROFILE_STATS_INC(start_error);
+        rec->start_error++;
+    }
+
+    uint32_t bin = (uint32_t)(airtime * TDMA_PROFILE_BINS / slot_usecs);
+    profile->utilization[bin < TDMA_PROFILE_BINS ? bin : TDMA_PROFILE_BINS - 1]++;
+}
+
+#endif
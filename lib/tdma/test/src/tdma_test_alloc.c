@@ -0,0 +1,226 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file tdma_test_alloc.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Dynamic slot allocation between two simulated devices
+ *
+ * @details Device 0 is the coordinator, device 1 a node asking for two pool slots. No ccp runs, both devices take
+ * the same epoch, read from their clocks at one instant, and the test walks the superframe itself: the events of
+ * the slots assigned on either device are posted in slot order, each followed by a marker that tells the test the
+ * callout is done. The node sends a frame only in the lowest pool slot it holds. It must hand the other back once
+ * idle, keeping the one it uses, ask for it again once the hold expires, and release both when it asks for none.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tdma_test.h"
+
+#if MYNEWT_VAL(TDMA_ALLOC_ENABLED)
+#include <tdma/tdma_alloc.h>
+
+#define POOL_FIRST MYNEWT_VAL(TDMA_ALLOC_FIRST_SLOT)
+
+static tdma_instance_t * g_tdma[2];
+static struct os_sem g_done;
+static struct os_sem g_tx_sem;
+static struct os_event g_marker[2];
+static dw1000_mac_interface_t g_cbs;
+static uint32_t g_sent;             //!< Frames the node sent in its pool slots
+
+static void
+tdma_test_marker_cb(struct os_event * ev){
+    os_error_t err = os_sem_release(&g_done);
+    assert(err == OS_OK);
+}
+
+static bool
+tdma_test_tx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs){
+    if (inst->fctrl != FCNTL_IEEE_RANGE_16 || os_sem_get_count(&g_tx_sem) == 1)
+        return false;
+    os_error_t err = os_sem_release(&g_tx_sem);
+    assert(err == OS_OK);
+    return true;
+}
+
+//! Lowest pool slot the node holds, 0 for none
+static uint16_t
+tdma_test_lowest(tdma_alloc_instance_t * alloc){
+    for (uint16_t i = 0; i < alloc->tdma->nslots - POOL_FIRST; i++)
+        if (alloc->slots[i].owner)
+            return POOL_FIRST + i;
+    return 0;
+}
+
+/**
+ * Pool slot callout of the node, sends a frame in the lowest slot it holds and waits for it to complete.
+ */
+static void
+tdma_test_pool_cb(struct os_event * ev){
+    tdma_slot_t * slot = (tdma_slot_t *) ev->ev_arg;
+    dw1000_dev_instance_t * inst = slot->parent->parent;
+    ieee_std_frame_t frame = {
+        .fctrl = FCNTL_IEEE_RANGE_16,
+        .PANID = inst->PANID,
+        .dst_address = BROADCAST_ADDRESS,
+        .src_address = inst->my_short_address
+    };
+
+    if (slot->idx != tdma_test_lowest(slot->parent->alloc))
+        return;
+    os_error_t err = os_sem_pend(&g_tx_sem, OS_TIMEOUT_NEVER);
+    assert(err == OS_OK);
+    dw1000_write_tx(inst, frame.array, 0, sizeof(frame));
+    dw1000_write_tx_fctrl(inst, sizeof(frame), 0);
+    dw1000_set_delay_start(inst, tdma_tx_slot_start(inst, slot->idx) & 0xFFFFFFFE00UL);
+    if (dw1000_start_tx(inst).start_tx_error){
+        err = os_sem_release(&g_tx_sem);
+        assert(err == OS_OK);
+        return;
+    }
+    err = os_sem_pend(&g_tx_sem, OS_TIMEOUT_NEVER);
+    assert(err == OS_OK);
+    err = os_sem_release(&g_tx_sem);
+    assert(err == OS_OK);
+    g_sent++;
+}
+
+/**
+ * Runs one superframe on both devices. The epoch is set MYNEWT_VAL(TDMA_TEST_ALLOC_LEAD) ahead, the clock offset
+ * of device 1 is taken between two reads of device 0 so the spi time cancels.
+ */
+static void
+tdma_test_superframe(uint8_t seq_num){
+    dw1000_dev_instance_t * inst[2] = {g_tdma[0]->parent, g_tdma[1]->parent};
+    uint64_t t0 = dw1000_read_systime(inst[0]);
+    uint64_t t1 = dw1000_read_systime(inst[1]);
+    uint64_t t2 = dw1000_read_systime(inst[0]);
+    uint64_t offset = t1 - (t0 + (((t2 - t0) & 0xFFFFFFFFFFULL) >> 1));
+    uint64_t epoch = t2 + ((uint64_t)MYNEWT_VAL(TDMA_TEST_ALLOC_LEAD) << 16);
+
+    for (uint8_t d = 0; d < 2; d++){
+        inst[d]->ccp->local_epoch = (epoch + d * offset) & 0xFFFFFFFFFFULL;
+        inst[d]->ccp->seq_num = seq_num;
+        g_tdma[d]->seq_num = seq_num;
+    }
+    for (uint16_t i = 0; i < g_tdma[0]->nslots; i++){
+        uint8_t posted = 0;
+        for (uint8_t d = 0; d < 2; d++){
+            if (!tdma_slot_active(g_tdma[d], i))
+                continue;
+            os_eventq_put(&g_tdma[d]->eventq, &g_tdma[d]->slot[i]->event_cb.c_ev);
+            os_eventq_put(&g_tdma[d]->eventq, &g_marker[d]);
+            posted++;
+        }
+        while (posted--){
+            os_error_t err = os_sem_pend(&g_done, OS_TIMEOUT_NEVER);
+            assert(err == OS_OK);
+        }
+    }
+}
+
+/**
+ * Runs superframes until the node holds nslots, at most TDMA_TEST_ALLOC_SUPERFRAMES.
+ *
+ * @return superframes run
+ */
+static uint16_t
+tdma_test_until(tdma_alloc_instance_t * alloc, uint8_t * seq_num, uint16_t nslots){
+    uint16_t n;
+    for (n = 0; n < MYNEWT_VAL(TDMA_TEST_ALLOC_SUPERFRAMES) && tdma_alloc_held(alloc) != nslots; n++)
+        tdma_test_superframe((*seq_num)++);
+    return n;
+}
+
+void
+tdma_alloc_test(void){
+    uint8_t seq_num = 0;
+
+    for (uint8_t d = 0; d < 2; d++){
+        g_tdma[d] = hal_dw1000_inst(d)->tdma;
+        g_tdma[d]->parent->my_short_address = 0x1000 + d;
+        g_marker[d].ev_cb = tdma_test_marker_cb;
+        tdma_stop(g_tdma[d]);
+    }
+    os_error_t err = os_sem_init(&g_done, 0);
+    assert(err == OS_OK);
+    err = os_sem_init(&g_tx_sem, 0x1);
+    assert(err == OS_OK);
+
+    tdma_alloc_instance_t * coordinator = tdma_alloc_init(g_tdma[0], true);
+    tdma_alloc_instance_t * node = tdma_alloc_init(g_tdma[1], false);
+    // After the allocation callbacks, which see the frame complete first
+    g_cbs = (dw1000_mac_interface_t){
+        .id = DW1000_APP0,
+        .tx_complete_cb = tdma_test_tx_complete_cb
+    };
+    dw1000_mac_append_interface(g_tdma[1]->parent, &g_cbs);
+    tdma_alloc_set_callout(node, tdma_test_pool_cb, NULL);
+    tdma_alloc_request(node, 2);
+
+    // Granted, in the lowest pool slots
+    uint16_t n = tdma_test_until(node, &seq_num, 2);
+    uint16_t busy = tdma_test_lowest(node);
+    printf("{\"test\": \"tdma_alloc\", \"phase\": \"grant\", \"superframes\": %d, \"held\": %d, \"slot\": %d}\n",
+        n, tdma_alloc_held(node), busy);
+    TEST_ASSERT(tdma_alloc_held(node) == 2);
+    TEST_ASSERT(busy == POOL_FIRST);
+    TEST_ASSERT(coordinator->slots[0].owner == 0x1001 && coordinator->slots[1].owner == 0x1001);
+    TEST_ASSERT(g_tdma[1]->slot[POOL_FIRST] && g_tdma[1]->slot[POOL_FIRST + 1]);
+
+    // Only the slot sent in is credited, the other goes idle and is handed back
+    uint32_t sent = g_sent;
+    n = tdma_test_until(node, &seq_num, 1);
+    printf("{\"test\": \"tdma_alloc\", \"phase\": \"idle\", \"superframes\": %d, \"held\": %d, \"sent\": %lu}\n",
+        n, tdma_alloc_held(node), (unsigned long)(g_sent - sent));
+    TEST_ASSERT(tdma_alloc_held(node) == 1);
+    TEST_ASSERT(n >= MYNEWT_VAL(TDMA_ALLOC_IDLE_EPOCHS));
+    TEST_ASSERT(g_sent - sent == n);
+    TEST_ASSERT(node->slots[0].owner && node->slots[0].count <= 1);
+    TEST_ASSERT(g_tdma[1]->slot[POOL_FIRST + 1] == NULL);
+    TEST_ASSERT(node->want == 1 && node->request == 2);
+
+    // The request comes back once the hold expires
+    n = tdma_test_until(node, &seq_num, 2);
+    printf("{\"test\": \"tdma_alloc\", \"phase\": \"regrow\", \"superframes\": %d, \"held\": %d, \"probe\": %d}\n",
+        n, tdma_alloc_held(node), node->probe);
+    TEST_ASSERT(tdma_alloc_held(node) == 2);
+    TEST_ASSERT(n > MYNEWT_VAL(TDMA_ALLOC_IDLE_EPOCHS));
+    TEST_ASSERT(node->probe == 2 * MYNEWT_VAL(TDMA_ALLOC_IDLE_EPOCHS));
+
+    // Everything handed back
+    tdma_alloc_request(node, 0);
+    n = tdma_test_until(node, &seq_num, 0);
+    printf("{\"test\": \"tdma_alloc\", \"phase\": \"release\", \"superframes\": %d, \"held\": %d}\n",
+        n, tdma_alloc_held(node));
+    TEST_ASSERT(tdma_alloc_held(node) == 0);
+    for (uint16_t i = POOL_FIRST; i < g_tdma[1]->nslots; i++)
+        TEST_ASSERT(g_tdma[1]->slot[i] == NULL);
+    for (uint16_t i = 0; i < g_tdma[0]->nslots - POOL_FIRST; i++)
+        TEST_ASSERT(coordinator->slots[i].owner == 0);
+
+    tdma_alloc_free(node);
+    tdma_alloc_free(coordinator);
+    dw1000_mac_remove_interface(g_tdma[1]->parent, DW1000_APP0);
+}
+#endif
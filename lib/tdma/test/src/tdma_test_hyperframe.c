@@ -0,0 +1,216 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file tdma_test_hyperframe.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Hyperframe packing and the seq_num phase of slots
+ *
+ * @details Random mixes of rate classes are packed into TDMA_TEST_HYPERFRAME_SLOTS slots. A mix whose load, the sum of
+ * 1/period, fits the slots must be placed in full, a larger one must fill the slots and leave out only members of the
+ * slowest classes. Placements are checked against a superframe by superframe occupancy built here. The placements
+ * of one mix are then applied to a slot of device 0 with tdma_set_slot_rate() one member at a time and
+ * tdma_slot_active() is walked over the ccp seq_num, across its wrap: every member must run in exactly the
+ * superframes of its phase and no two members of a slot in the same superframe.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tdma_test.h"
+#include <tdma/tdma_hyperframe.h>
+
+#define HYPERFRAME MYNEWT_VAL(TDMA_HYPERFRAME_MAX)
+#define NSLOTS MYNEWT_VAL(TDMA_TEST_HYPERFRAME_SLOTS)
+#define NMEMBERS (NSLOTS * HYPERFRAME)
+#define FIRST 16
+
+static uint32_t g_seed = 0x2545F491;
+static tdma_hyperframe_entry_t g_entries[NMEMBERS + 1];
+
+static uint32_t
+tdma_test_rand(void){
+    g_seed ^= g_seed << 13;
+    g_seed ^= g_seed >> 17;
+    g_seed ^= g_seed << 5;
+    return g_seed;
+}
+
+static void
+tdma_test_slot_cb(struct os_event * ev){
+}
+
+/**
+ * Draws members of random classes until their load, in slots, reaches load.
+ *
+ * @return members drawn
+ */
+static uint16_t
+tdma_test_mix(float load){
+    uint16_t n = 0;
+    float sum = 0;
+    uint8_t nclasses = 0;
+    while ((HYPERFRAME >> nclasses) > 1)
+        nclasses++;
+
+    while (n < NMEMBERS){
+        uint16_t period = 1 << (tdma_test_rand() % (nclasses + 1));
+        if (sum + 1.0f / period > load)
+            break;
+        g_entries[n++].period = period;
+        sum += 1.0f / period;
+    }
+    // Top up with the slowest class
+    while (n < NMEMBERS && sum + 1.0f / HYPERFRAME <= load){
+        g_entries[n++].period = HYPERFRAME;
+        sum += 1.0f / HYPERFRAME;
+    }
+    return n;
+}
+
+/**
+ * Checks the placements of n members: in range, whole phases of their class, no two in the same slot and
+ * superframe.
+ *
+ * @return superframes taken over all slots
+ */
+static uint32_t
+tdma_test_check(tdma_hyperframe_entry_t entries[], uint16_t n){
+    static uint32_t occupancy[NSLOTS];
+    uint32_t taken = 0;
+
+    memset(occupancy, 0, sizeof(occupancy));
+    for (uint16_t i = 0; i < n; i++){
+        tdma_hyperframe_entry_t * e = &entries[i];
+        if (e->slot == TDMA_HYPERFRAME_NONE)
+            continue;
+        TEST_ASSERT_FATAL(e->slot >= FIRST && e->slot < FIRST + NSLOTS);
+        TEST_ASSERT(e->phase < e->period);
+        for (uint16_t k = e->phase; k < HYPERFRAME; k += e->period){
+            TEST_ASSERT((occupancy[e->slot - FIRST] & (1UL << k)) == 0);
+            occupancy[e->slot - FIRST] |= 1UL << k;
+            taken++;
+        }
+    }
+    return taken;
+}
+
+/*!
+ * Packs random mixes at and over the capacity of the slots.
+ */
+static void
+tdma_hyperframe_pack_test(tdma_hyperframe_t * hf){
+
+    for (uint16_t trial = 0; trial < MYNEWT_VAL(TDMA_TEST_HYPERFRAME_TRIALS); trial++){
+        // A full mix is placed in full and fills every superframe of every slot
+        uint16_t n = tdma_test_mix(NSLOTS);
+        TEST_ASSERT(tdma_hyperframe_pack(hf, g_entries, n) == n);
+        TEST_ASSERT(tdma_test_check(g_entries, n) == NSLOTS * HYPERFRAME);
+        for (uint16_t period = 1; period <= HYPERFRAME; period <<= 1)
+            TEST_ASSERT(tdma_hyperframe_capacity(hf, period) == 0);
+
+        // Half a mix leaves room for exactly the capacity it reports
+        n = tdma_test_mix(NSLOTS / 2.0f);
+        TEST_ASSERT(tdma_hyperframe_pack(hf, g_entries, n) == n);
+        uint32_t taken = tdma_test_check(g_entries, n);
+        uint16_t period = 1 << (tdma_test_rand() % 3);
+        uint16_t capacity = tdma_hyperframe_capacity(hf, period);
+        TEST_ASSERT(capacity > 0 && capacity * (HYPERFRAME / period) <= NSLOTS * HYPERFRAME - taken);
+        uint16_t m;
+        for (m = n; m < NMEMBERS; m++){
+            g_entries[m].period = period;
+            if (tdma_hyperframe_place(hf, &g_entries[m]) != OS_OK)
+                break;
+        }
+        TEST_ASSERT(m - n == capacity);
+        TEST_ASSERT(g_entries[m].slot == TDMA_HYPERFRAME_NONE);
+        tdma_test_check(g_entries, m);
+
+        // Removing a member makes its phase available again
+        tdma_hyperframe_entry_t removed = g_entries[n];
+        tdma_hyperframe_remove(hf, &g_entries[n]);
+        TEST_ASSERT(g_entries[n].slot == TDMA_HYPERFRAME_NONE);
+        TEST_ASSERT(tdma_hyperframe_capacity(hf, period) == 1);
+        TEST_ASSERT(tdma_hyperframe_place(hf, &g_entries[n]) == OS_OK);
+        TEST_ASSERT(g_entries[n].slot == removed.slot && g_entries[n].phase == removed.phase);
+
+        // Overload, only members of the slowest classes are left out and the slots are filled
+        n = tdma_test_mix(NSLOTS * 1.5f);
+        uint16_t placed = tdma_hyperframe_pack(hf, g_entries, n);
+        TEST_ASSERT(placed < n);
+        TEST_ASSERT(tdma_test_check(g_entries, n) == NSLOTS * HYPERFRAME);
+        uint16_t fastest_left = HYPERFRAME;
+        uint16_t slowest_placed = 1;
+        for (uint16_t i = 0; i < n; i++){
+            if (g_entries[i].slot == TDMA_HYPERFRAME_NONE && g_entries[i].period < fastest_left)
+                fastest_left = g_entries[i].period;
+            if (g_entries[i].slot != TDMA_HYPERFRAME_NONE && g_entries[i].period > slowest_placed)
+                slowest_placed = g_entries[i].period;
+        }
+        TEST_ASSERT(fastest_left >= slowest_placed);
+    }
+}
+
+/*!
+ * Applies the placements of a full mix to device 0 and walks the seq_num twice over its range.
+ */
+static void
+tdma_hyperframe_phase_test(tdma_instance_t * tdma, tdma_hyperframe_t * hf){
+    static uint16_t owner[NSLOTS][2 * 256];
+    uint16_t n = tdma_test_mix(NSLOTS);
+
+    TEST_ASSERT_FATAL(tdma_hyperframe_pack(hf, g_entries, n) == n);
+    memset(owner, 0xFF, sizeof(owner));
+    tdma_stop(tdma);
+    for (uint16_t i = 0; i < n; i++){
+        tdma_hyperframe_entry_t * e = &g_entries[i];
+        uint16_t runs = 0;
+        tdma_assign_slot(tdma, tdma_test_slot_cb, e->slot, NULL);
+        tdma_set_slot_rate(tdma, e->slot, e->period, e->phase);
+        for (uint16_t s = 0; s < 2 * 256; s++){
+            tdma->seq_num = (uint8_t) s;
+            if (!tdma_slot_active(tdma, e->slot))
+                continue;
+            TEST_ASSERT(((uint8_t)(tdma->seq_num - e->phase) % e->period) == 0);
+            TEST_ASSERT(owner[e->slot - FIRST][s] == 0xFFFF);
+            owner[e->slot - FIRST][s] = i;
+            runs++;
+        }
+        TEST_ASSERT(runs == 2 * 256 / e->period);
+        tdma_release_slot(tdma, e->slot);
+    }
+    // Every superframe of every slot has its member
+    for (uint16_t j = 0; j < NSLOTS; j++)
+        for (uint16_t s = 0; s < 2 * 256; s++)
+            TEST_ASSERT(owner[j][s] != 0xFFFF);
+    printf("{\"test\": \"tdma_hyperframe\", \"slots\": %d, \"members\": %d, \"hyperframe\": %d}\n", NSLOTS, n, HYPERFRAME);
+}
+
+void
+tdma_hyperframe_test(void){
+    tdma_instance_t * tdma = hal_dw1000_inst(0)->tdma;
+    tdma_hyperframe_t * hf = tdma_hyperframe_init(NULL, FIRST, NSLOTS);
+
+    TEST_ASSERT_FATAL(FIRST + NSLOTS <= tdma->nslots);
+    tdma_hyperframe_pack_test(hf);
+    tdma_hyperframe_phase_test(tdma, hf);
+    tdma_hyperframe_free(hf);
+}
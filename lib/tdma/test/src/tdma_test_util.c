@@ -0,0 +1,154 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file tdma_test_util.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Epoch processing cost of tdma against the number of slots
+ *
+ * @details The superframe event of the tdma instance of the simulated device is run back to back on epochs a
+ * period ahead, so the slot timer it arms never fires, and timed with os_cputime. The slot timer callback is
+ * then run on an epoch a period back, every slot is due and posted in one walk.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tdma_test.h"
+
+static uint32_t g_slot_count;
+
+static void
+tdma_test_slot_cb(struct os_event * ev){
+    g_slot_count++;
+}
+
+//! Period of the ccp instance (os_cputime ticks)
+static uint32_t
+tdma_test_period(tdma_instance_t * tdma){
+    return os_cputime_usecs_to_ticks((uint32_t) dw1000_dwt_usecs_to_usecs(tdma->parent->ccp->period));
+}
+
+/**
+ * API to time the superframe event, the fastest of TDMA_TEST_BATCHES batches of TDMA_TEST_EPOCHS epochs.
+ *
+ * @param tdma      Pointer to tdma_instance_t.
+ * @param rebuild   Flag the schedule for a rebuild on every epoch, as an assignment in each superframe would.
+ * @return nsecs per epoch
+ */
+static uint32_t
+tdma_test_epochs(tdma_instance_t * tdma, bool rebuild){
+    struct os_event * ev = &tdma->event_cb.c_ev;
+    uint32_t best = UINT32_MAX;
+
+    for (uint16_t b = 0; b < MYNEWT_VAL(TDMA_TEST_BATCHES); b++){
+        uint32_t start = os_cputime_get32();
+        tdma->os_epoch = start + tdma_test_period(tdma);
+        for (uint16_t k = 0; k < MYNEWT_VAL(TDMA_TEST_EPOCHS); k++){
+            tdma->status.reschedule |= rebuild;
+            ev->ev_cb(ev);
+        }
+        uint32_t ticks = os_cputime_get32() - start;
+        os_cputime_timer_stop(&tdma->timer);
+        best = (ticks < best) ? ticks : best;
+    }
+    return (uint32_t)((uint64_t) os_cputime_ticks_to_usecs(best) * 1000 / MYNEWT_VAL(TDMA_TEST_EPOCHS));
+}
+
+/**
+ * API to time one walk of the slot timer over a superframe with every slot due, the fastest of TDMA_TEST_BATCHES
+ * batches of TDMA_TEST_EPOCHS walks. The slot callouts run in the tdma task as they are posted.
+ *
+ * @param tdma      Pointer to tdma_instance_t.
+ * @return nsecs per walk
+ */
+static uint32_t
+tdma_test_walk(tdma_instance_t * tdma){
+    uint32_t best = UINT32_MAX;
+
+    for (uint16_t b = 0; b < MYNEWT_VAL(TDMA_TEST_BATCHES); b++){
+        uint32_t start = os_cputime_get32();
+        for (uint16_t k = 0; k < MYNEWT_VAL(TDMA_TEST_EPOCHS); k++){
+            tdma->cursor = 0;
+            tdma->schedule_epoch = start - tdma_test_period(tdma);
+            tdma->timer.cb_func(tdma->timer.cb_arg);
+        }
+        uint32_t ticks = os_cputime_get32() - start;
+        best = (ticks < best) ? ticks : best;
+    }
+    return (uint32_t)((uint64_t) os_cputime_ticks_to_usecs(best) * 1000 / MYNEWT_VAL(TDMA_TEST_EPOCHS));
+}
+
+/*!
+ * Epoch processing against the number of assigned slots, spread evenly over the superframe. The superframe event
+ * only arms the timer for the first slot, its cost must not grow with the slots. Rebuilding the schedule and
+ * walking it are linear, they are reported for reference.
+ */
+static void
+tdma_epoch_test(void){
+    tdma_instance_t * tdma = hal_dw1000_inst(0)->tdma;
+    uint32_t epoch_nsecs[5];
+    uint16_t last = 0;
+
+    for (uint16_t n = 16, j = 0; n <= tdma->nslots && j < 5; n *= 2, j++){
+        uint16_t stride = tdma->nslots / n;
+        tdma_stop(tdma);
+        for (uint16_t i = 0; i < n; i++)
+            tdma_assign_slot(tdma, tdma_test_slot_cb, i * stride, NULL);
+
+        epoch_nsecs[j] = tdma_test_epochs(tdma, false);
+        uint32_t rebuild_nsecs = tdma_test_epochs(tdma, true);
+
+        // Schedule in start order, one entry per slot
+        TEST_ASSERT(tdma->nscheduled == n);
+        for (uint16_t i = 1; i < tdma->nscheduled; i++)
+            TEST_ASSERT(tdma->schedule[i].offset > tdma->schedule[i - 1].offset);
+
+        g_slot_count = 0;
+        uint32_t walk_nsecs = tdma_test_walk(tdma);
+        TEST_ASSERT(g_slot_count == (uint32_t) n * MYNEWT_VAL(TDMA_TEST_EPOCHS) * MYNEWT_VAL(TDMA_TEST_BATCHES));
+
+        printf("{\"test\": \"tdma_epoch\", \"nslots\": %d, \"assigned\": %d, \"epoch_nsecs\": %d, \"rebuild_nsecs\": %d, \"slot_nsecs\": %d}\n",
+            tdma->nslots, n, (int) epoch_nsecs[j], (int) rebuild_nsecs, (int)(walk_nsecs / n)
+        );
+        last = j;
+    }
+    tdma_stop(tdma);
+
+    TEST_ASSERT(last > 0);
+    TEST_ASSERT(epoch_nsecs[last] <= MYNEWT_VAL(TDMA_TEST_GROWTH) * epoch_nsecs[0] + MYNEWT_VAL(TDMA_TEST_SLACK));
+}
+
+void
+tdma_test_handler(void *arg)
+{
+    sysinit();
+
+    tdma_epoch_test();
+    tdma_hyperframe_test();
+#if MYNEWT_VAL(TDMA_ALLOC_ENABLED)
+    tdma_alloc_test();
+#endif
+
+    tu_restart();
+}
@@ -0,0 +1,163 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file telemetry.h
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Binary telemetry records
+ *
+ * @details Fixed layout, little-endian records replacing the *_VERBOSE json streams. Each record is a
+ * 4 byte header followed by len bytes of payload. Header byte 0 is TELEMETRY_HDR_VT(version, type), built
+ * with shifts rather than bitfields so the wire layout does not depend on the compiler. The header time
+ * is the low 16 bits of the os_cputime in usecs when the record was reserved; a TELEMETRY_UTIME record
+ * carrying all 32 bits is emitted first and whenever 16 bits would wrap between two records. Records
+ * that do not fit 255 bytes, nrng, survey and cir, are split and flag the continuation. With
+ * TELEMETRY_CBOR each record is additionally wrapped in a CBOR byte string.
+ */
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <os/os.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TELEMETRY_VERSION 3
+
+typedef enum _telemetry_type_t{
+    TELEMETRY_UTIME = 0,        //!< telemetry_utime_t
+    TELEMETRY_RNG,              //!< telemetry_rng_t
+    TELEMETRY_NRNG,             //!< telemetry_nrng_t, followed by n telemetry_nrng_slot_t
+    TELEMETRY_CCP,              //!< telemetry_ccp_t
+    TELEMETRY_WCS,              //!< telemetry_wcs_t
+    TELEMETRY_WCS_QUALITY,      //!< telemetry_wcs_quality_t
+    TELEMETRY_SURVEY,           //!< telemetry_survey_t, followed by n telemetry_survey_node_t each with its ranges
+    TELEMETRY_CIR               //!< telemetry_cir_t, followed by n telemetry_cir_sample_t
+}telemetry_type_t;
+
+#define TELEMETRY_HDR_VT(version, type) ((uint8_t)((((version) & 0x0f) << 4) | ((type) & 0x0f)))
+#define TELEMETRY_HDR_VERSION(vt) (((vt) >> 4) & 0x0f)
+#define TELEMETRY_HDR_TYPE(vt) ((vt) & 0x0f)
+
+typedef struct _telemetry_hdr_t{
+    uint8_t vt;                 //!< TELEMETRY_HDR_VT(TELEMETRY_VERSION, telemetry_type_t)
+    uint8_t len;                //!< Payload length
+    uint16_t utime;             //!< Low 16 bits of the usecs timestamp
+}__attribute__((__packed__)) telemetry_hdr_t;
+
+typedef struct _telemetry_utime_t{
+    uint32_t utime;
+}__attribute__((__packed__)) telemetry_utime_t;
+
+#define TELEMETRY_RNG_AZIMUTH 0x01  //!< Exchange measured the azimuth, reported alongside the range
+
+typedef struct _telemetry_rng_t{
+    uint8_t code;               //!< Final frame code, DWT_SS_TWR_FINAL, DWT_DS_TWR_FINAL ...
+    uint8_t flags;              //!< TELEMETRY_RNG_AZIMUTH
+    float tof;
+    float range;
+    float azimuth;
+    uint32_t res_req;           //!< response_timestamp - request_timestamp
+    uint32_t rec_tra;           //!< transmission_timestamp - reception_timestamp
+}__attribute__((__packed__)) telemetry_rng_t;
+
+#define TELEMETRY_MORE 0x01     //!< Further records of the same exchange follow
+#define TELEMETRY_NRNG_MM 0x02  //!< Reported ranges as mm (NRNG_HUMAN_READABLE_RANGES)
+#define TELEMETRY_CIR_FP 0x02   //!< First path index and power are valid, a cir rather than a pmem read
+
+typedef struct _telemetry_nrng_t{
+    uint8_t seq_num;
+    uint8_t n;                  //!< Number of slots in this record
+    uint8_t flags;              //!< TELEMETRY_MORE, TELEMETRY_NRNG_MM
+    uint8_t mask_words;         //!< NRNG_SLOT_WORDS, the width of the valid slot mask
+}__attribute__((__packed__)) telemetry_nrng_t;
+
+typedef struct _telemetry_nrng_slot_t{
+    uint8_t slot;               //!< Responder slot id
+    float range;
+    int32_t tdoa;               //!< Reception time relative to the first requested slot
+}__attribute__((__packed__)) telemetry_nrng_slot_t;
+
+typedef struct _telemetry_ccp_t{
+    uint64_t transmission_timestamp;
+    uint64_t delta;
+    float clock_offset;
+    uint8_t seq_num;
+}__attribute__((__packed__)) telemetry_ccp_t;
+
+typedef struct _telemetry_wcs_t{
+    uint64_t master_epoch;
+    uint64_t local_master;      //!< wcs_local_to_master(local_epoch)
+    uint64_t local_epoch;
+    uint64_t time;              //!< timescale state
+    double skew;
+}__attribute__((__packed__)) telemetry_wcs_t;
+
+typedef struct _telemetry_wcs_quality_t{
+    uint64_t tau0;              //!< ccp epoch spacing (dtu)
+    float adev[4];              //!< Overlapping Allan deviation at tau0, 2 tau0, 4 tau0, 8 tau0
+    float innovation_mean;      //!< Master epoch less model prediction (dtu)
+    float innovation_rms;       //!< (dtu)
+    float sync_error;           //!< Predicted rms sync error at the next epoch (dtu)
+}__attribute__((__packed__)) telemetry_wcs_quality_t;
+
+typedef struct _telemetry_survey_t{
+    uint16_t seq_num;
+    uint8_t n;                  //!< Number of nodes in this record
+    uint8_t flags;              //!< TELEMETRY_MORE
+}__attribute__((__packed__)) telemetry_survey_t;
+
+typedef struct _telemetry_survey_node_t{
+    uint8_t node;               //!< Surveying node, bit position in the survey mask
+    uint16_t mask;              //!< Slots it ranged with, followed by one float range per set bit
+}__attribute__((__packed__)) telemetry_survey_node_t;
+
+typedef struct _telemetry_cir_t{
+    char name[6];               //!< "cir", "cir0", "pmem1" ..., NUL padded
+    uint8_t flags;              //!< TELEMETRY_MORE, TELEMETRY_CIR_FP
+    uint8_t n;                  //!< Number of samples in this record
+    uint16_t offset;            //!< Index of the first sample
+    float fp_idx;
+    float fp_power;
+}__attribute__((__packed__)) telemetry_cir_t;
+
+typedef struct _telemetry_cir_sample_t{
+    int16_t real;
+    int16_t imag;
+}__attribute__((__packed__)) telemetry_cir_sample_t;
+
+typedef int (telemetry_sink_fn)(void * arg, const uint8_t * buf, uint16_t len);
+
+int telemetry_write(telemetry_type_t type, const void * payload, uint8_t len);
+int telemetry_writev(telemetry_type_t type, const void * payload[], const uint8_t len[], uint8_t n);
+void telemetry_set_sink(telemetry_sink_fn * sink, void * arg);
+void telemetry_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TELEMETRY_H_ */
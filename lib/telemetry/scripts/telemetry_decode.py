@@ -0,0 +1,388 @@
+#!/usr/bin/env python3
+#
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#  http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+#
+
+"""Decode the lib/telemetry record stream into the json lines the *_VERBOSE
+printers produced, byte for byte, so existing tools keep working.
+
+The stream is read from a file, stdin or, with pyserial installed, a serial
+port. Bytes that do not start a valid record, console text sharing the link
+for instance, are skipped. Record layouts follow telemetry.h; records split
+over several frames, nrng, survey and cir, are merged before printing.
+
+    telemetry_decode.py /dev/ttyACM0 -b 115200
+    JLinkRTTClient | telemetry_decode.py
+    telemetry_decode.py --cbor capture.bin
+"""
+
+import argparse
+import struct
+import sys
+
+TELEMETRY_VERSION = 3
+HDR = struct.Struct('<BBH')
+
+UTIME, RNG, NRNG, CCP, WCS, WCS_QUALITY, SURVEY, CIR = range(8)
+
+MORE = 0x01
+RNG_AZIMUTH = 0x01
+NRNG_MM = 0x02
+CIR_FP = 0x02
+
+# Floats are unpacked as their bit patterns, the printers output them that way
+UTIME_REC = struct.Struct('<I')
+RNG_REC = struct.Struct('<BBIIIII')
+CCP_REC = struct.Struct('<QQIB')
+WCS_REC = struct.Struct('<QQQQQ')
+WCS_QUALITY_REC = struct.Struct('<Q4IIII')
+NRNG_HDR = struct.Struct('<BBBB')
+NRNG_SLOT = struct.Struct('<BIi')
+SURVEY_HDR = struct.Struct('<HBB')
+SURVEY_NODE = struct.Struct('<BH')
+CIR_HDR = struct.Struct('<6sBBHII')
+CIR_SAMPLE = struct.Struct('<hh')
+
+FIXED = {UTIME: UTIME_REC, RNG: RNG_REC, CCP: CCP_REC, WCS: WCS_REC, WCS_QUALITY: WCS_QUALITY_REC}
+VARIABLE = {NRNG: (NRNG_HDR, NRNG_SLOT.size), CIR: (CIR_HDR, CIR_SAMPLE.size)}
+
+
+def payload_len_ok(rtype, payload):
+    if rtype in FIXED:
+        return len(payload) == FIXED[rtype].size
+    if rtype in VARIABLE:
+        hdr, size = VARIABLE[rtype]
+        if len(payload) < hdr.size:
+            return False
+        n = payload[1] if rtype == NRNG else payload[7]
+        return len(payload) == hdr.size + n * size
+    if rtype == SURVEY:
+        if len(payload) < SURVEY_HDR.size:
+            return False
+        _, n, _ = SURVEY_HDR.unpack_from(payload)
+        offset = SURVEY_HDR.size
+        for _ in range(n):
+            if len(payload) < offset + SURVEY_NODE.size:
+                return False
+            _, mask = SURVEY_NODE.unpack_from(payload, offset)
+            offset += SURVEY_NODE.size + 4 * bin(mask).count('1')
+        return len(payload) == offset
+    return False
+
+
+def bits_to_float(bits):
+    return struct.unpack('<f', struct.pack('<I', bits))[0]
+
+
+def float_mm(bits):
+    """(uint32_t)(range*1000) as the target computes it, in single precision"""
+    return int(struct.unpack('<f', struct.pack('<f', bits_to_float(bits) * 1000))[0]) & 0xffffffff
+
+
+class JsonEncoder:
+    """Output of apache-mynewt-core encoding/json, json_encode.c"""
+
+    def __init__(self):
+        self.out = []
+        self.commas = False
+
+    def _comma(self):
+        if self.commas:
+            self.out.append(',')
+            self.commas = False
+
+    def object_start(self):
+        self._comma()
+        self.out.append('{')
+        self.commas = False
+
+    def key(self, key):
+        self._comma()
+        self.out.append('"%s": ' % key)
+
+    def entry(self, key, value):
+        self.key(key)
+        self.out.append(str(value))
+        self.commas = True
+
+    def object_finish(self):
+        self.out.append('}')
+        self.commas = True
+
+    def array_start(self):
+        self.out.append('[')
+        self.commas = False
+
+    def value(self, value):
+        self._comma()
+        self.out.append(str(value))
+        self.commas = True
+
+    def array_finish(self):
+        self.commas = True
+        self.out.append(']')
+
+    def array(self, key, values):
+        self.key(key)
+        self.array_start()
+        for v in values:
+            self.value(v)
+        self.array_finish()
+
+    def __str__(self):
+        return ''.join(self.out)
+
+
+def format_rng(utime, payload):
+    _, flags, tof, rng, azimuth, res_req, rec_tra = RNG_REC.unpack(payload)
+    if flags & RNG_AZIMUTH:
+        return ('{"utime": %d,"tof": %d,"range": %d,"azimuth": %d,"res_req":"%X", "rec_tra": "%X"}'
+                % (utime, tof, rng, azimuth, res_req, rec_tra))
+    return ('{"utime": %d,"tof": %d,"range": %d,"res_req": "%X", "rec_tra": "%X"}'
+            % (utime, tof, rng, res_req, rec_tra))
+
+
+def format_ccp(utime, payload):
+    tx, delta, clock_offset, seq_num = CCP_REC.unpack(payload)
+    return ('{"utime": %d,"ccp":["%X","%X"],"clock_offset": %d,"seq_num" :%d}'
+            % (utime, tx, delta, clock_offset, seq_num))
+
+
+def format_wcs(utime, payload):
+    return '{"utime": %d,"wcs": [%d,%d,%d,%d],"skew": %d}' % ((utime,) + WCS_REC.unpack(payload))
+
+
+def format_wcs_quality(utime, payload):
+    values = WCS_QUALITY_REC.unpack(payload)
+    return ('{"utime": %d,"wcs_quality": [%d,%d,%d,%d],"sync_error": %d}'
+            % ((utime,) + values[1:5] + values[7:8]))
+
+
+def format_nrng(utime, parts):
+    _, _, flags, words = NRNG_HDR.unpack_from(parts[0])
+    seq_num = parts[0][0]
+    slots = []
+    for payload in parts:
+        n = payload[1]
+        for i in range(n):
+            slots.append(NRNG_SLOT.unpack_from(payload, NRNG_HDR.size + i * NRNG_SLOT.size))
+    mask = [0] * words
+    for slot, _, _ in slots:
+        mask[slot // 32] |= 1 << (slot % 32)
+
+    e = JsonEncoder()
+    e.object_start()
+    e.entry('utime', utime)
+    e.key('nrng')
+    e.object_start()
+    e.entry('seq', seq_num)
+    if words == 1:
+        e.entry('mask', mask[0])
+    else:
+        e.array('mask', mask)
+    e.array('rng', [float_mm(r) if flags & NRNG_MM else r for _, r, _ in slots])
+    e.array('tdoa', [tdoa for _, _, tdoa in slots])
+    e.object_finish()
+    e.object_finish()
+    return str(e)
+
+
+def format_survey(utime, parts):
+    seq_num = SURVEY_HDR.unpack_from(parts[0])[0]
+    nodes = []
+    for payload in parts:
+        _, n, _ = SURVEY_HDR.unpack_from(payload)
+        offset = SURVEY_HDR.size
+        for _ in range(n):
+            node, mask = SURVEY_NODE.unpack_from(payload, offset)
+            offset += SURVEY_NODE.size
+            count = bin(mask).count('1')
+            nodes.append((node, mask, struct.unpack_from('<%dI' % count, payload, offset)))
+            offset += 4 * count
+
+    e = JsonEncoder()
+    e.object_start()
+    e.entry('utime', utime)
+    e.key('survey')
+    e.object_start()
+    e.entry('seq', seq_num)
+    e.entry('mask', sum(1 << node for node, _, _ in nodes))
+    e.key('nrngs')
+    e.array_start()
+    for _, mask, ranges in nodes:
+        e.object_start()
+        e.entry('mask', mask)
+        e.array('nrng', ranges)
+        e.object_finish()
+    e.array_finish()
+    e.object_finish()
+    e.object_finish()
+    return str(e)
+
+
+def format_cir(utime, parts):
+    name, flags, _, _, fp_idx, fp_power = CIR_HDR.unpack_from(parts[0])
+    samples = []
+    for payload in parts:
+        n = payload[7]
+        samples.extend(CIR_SAMPLE.unpack_from(payload, CIR_HDR.size + i * CIR_SAMPLE.size) for i in range(n))
+
+    e = JsonEncoder()
+    e.object_start()
+    e.entry('utime', utime)
+    e.key(name.rstrip(b'\0').decode('ascii', 'replace'))
+    e.object_start()
+    if flags & CIR_FP:
+        e.entry('idx', fp_idx)
+        e.entry('power', fp_power)
+    e.array('real', [real for real, _ in samples])
+    e.array('imag', [imag for _, imag in samples])
+    e.object_finish()
+    e.object_finish()
+    return str(e)
+
+
+FORMAT = {RNG: format_rng, CCP: format_ccp, WCS: format_wcs, WCS_QUALITY: format_wcs_quality}
+MERGED = {NRNG: format_nrng, SURVEY: format_survey, CIR: format_cir}
+FLAGS_OFFSET = {NRNG: 2, SURVEY: 3, CIR: 6}
+
+
+class Decoder:
+    """Incremental decoder, feed() bytes and collect the json lines it returns."""
+
+    def __init__(self, cbor=False):
+        self.cbor = cbor
+        self.buf = bytearray()
+        self.utime = None
+        self.parts = {}
+        self.skipped = 0
+
+    def _cbor_prefix(self):
+        """Returns (prefix length, byte string length), None if incomplete, or (0, 0) if not a prefix."""
+        b = self.buf
+        if not b:
+            return None
+        if 0x40 <= b[0] < 0x40 + 24:
+            return 1, b[0] & 0x1f
+        if b[0] == 0x58:
+            return (2, b[1]) if len(b) >= 2 else None
+        if b[0] == 0x59:
+            return (3, b[1] << 8 | b[2]) if len(b) >= 3 else None
+        return 0, 0
+
+    def _record(self, rtype, utime16, payload):
+        """Returns the json line of a record, or None while waiting for the rest of a split record."""
+        if rtype == UTIME:
+            self.utime = UTIME_REC.unpack(payload)[0]
+            return None
+        if self.utime is None:
+            return None
+        self.utime = (self.utime + ((utime16 - self.utime) & 0xffff)) & 0xffffffff
+        if rtype in FORMAT:
+            return FORMAT[rtype](self.utime, payload)
+
+        # Continuation records carry their own time, the line reports the first like the printers did
+        utime, parts = self.parts.pop(rtype, (self.utime, []))
+        parts.append(payload)
+        flags = payload[FLAGS_OFFSET[rtype]]
+        if flags & MORE:
+            self.parts[rtype] = (utime, parts)
+            return None
+        return MERGED[rtype](utime, parts)
+
+    def _next(self):
+        """Returns a json line, None if more bytes are needed, True after a record with no output
+        or False after skipping a byte."""
+        start = 0
+        if self.cbor:
+            prefix = self._cbor_prefix()
+            if prefix is None:
+                return None
+            start, size = prefix
+            if start == 0 or size < HDR.size:
+                return False
+        if len(self.buf) < start + HDR.size:
+            return None
+        vt, length, utime16 = HDR.unpack_from(self.buf, start)
+        version, rtype = vt >> 4, vt & 0x0f
+        if version != TELEMETRY_VERSION or rtype > CIR:
+            return False
+        if self.cbor and size != HDR.size + length:
+            return False
+        end = start + HDR.size + length
+        if len(self.buf) < end:
+            return None
+        payload = bytes(self.buf[start + HDR.size:end])
+        if not payload_len_ok(rtype, payload):
+            return False
+        del self.buf[:end]
+        line = self._record(rtype, utime16, payload)
+        return True if line is None else line
+
+    def feed(self, data):
+        self.buf.extend(data)
+        lines = []
+        while True:
+            line = self._next()
+            if line is None:
+                break
+            if line is False:
+                del self.buf[:1]
+                self.skipped += 1
+                continue
+            if line is not True:
+                lines.append(line)
+        return lines
+
+
+def open_input(args):
+    if args.input == '-':
+        return sys.stdin.buffer
+    if args.baudrate:
+        import serial
+        return serial.Serial(args.input, args.baudrate, timeout=0.1)
+    return open(args.input, 'rb')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode lib/telemetry records to the *_VERBOSE json lines')
+    parser.add_argument('input', nargs='?', default='-', help='capture file, serial port or - for stdin')
+    parser.add_argument('-b', '--baudrate', type=int, help='open input as a serial port at this rate')
+    parser.add_argument('--cbor', action='store_true', help='records are framed as CBOR byte strings (TELEMETRY_CBOR)')
+    args = parser.parse_args()
+
+    decoder = Decoder(cbor=args.cbor)
+    stream = open_input(args)
+    try:
+        while True:
+            # read1() returns what is available rather than waiting for a full block
+            data = stream.read1(256) if hasattr(stream, 'read1') else stream.read(256)
+            if not data:
+                if args.baudrate:
+                    continue
+                break
+            for line in decoder.feed(data):
+                print(line, flush=True)
+    except KeyboardInterrupt:
+        pass
+    if decoder.skipped:
+        print('skipped %d bytes' % decoder.skipped, file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
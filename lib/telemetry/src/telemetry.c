@@ -0,0 +1,316 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file telemetry.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Binary telemetry records
+ *
+ * @details The ring is lock free for any number of producers, tasks or interrupts. A producer reserves
+ * space by advancing g_reserve with a compare and swap, copies its record in, then adds its size to
+ * g_written. The consumer only drains once g_written has caught up with g_reserve, so a record is never
+ * read half written; a producer preempted between reserving and committing delays the drain until it
+ * commits and posts the drain event itself. The timestamp is read inside the reservation loop, times are
+ * therefore monotonic in stream order.
+ *
+ * The consumer runs on its own low priority task, the default sink writes the device under the console,
+ * RTT channel 0 or the MYNEWT_VAL(TELEMETRY_UART_PORT) uart, raw since console_write() expands LF to CRLF.
+ * The blocking uart writes then only consume time no other task wants; point TELEMETRY_UART_PORT at a
+ * spare uart to keep console text off the stream, scripts/telemetry_decode.py skips what is not a record.
+ * The sink can be replaced with telemetry_set_sink(), e.g. newtmgr or UDP.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <os/os.h>
+#include <os/os_cputime.h>
+#include <stats/stats.h>
+#include <telemetry/telemetry.h>
+#if MYNEWT_VAL(CONSOLE_RTT)
+#include <rtt/SEGGER_RTT.h>
+#else
+#include <hal/hal_uart.h>
+#endif
+
+#define TELEMETRY_RING_MASK (MYNEWT_VAL(TELEMETRY_RING_SIZE) - 1)
+#if (MYNEWT_VAL(TELEMETRY_RING_SIZE) & TELEMETRY_RING_MASK)
+#error "TELEMETRY_RING_SIZE must be a power of two"
+#endif
+#if defined(__ARM_ARCH_6M__)
+#error "The telemetry ring needs ldrex/strex, not available on armv6-m"
+#endif
+
+#if MYNEWT_VAL(TELEMETRY_STATS)
+STATS_SECT_START(telemetry_stat_section)
+    STATS_SECT_ENTRY(records)
+    STATS_SECT_ENTRY(bytes)
+    STATS_SECT_ENTRY(dropped)
+    STATS_SECT_ENTRY(sink_error)
+STATS_SECT_END
+
+STATS_NAME_START(telemetry_stat_section)
+    STATS_NAME(telemetry_stat_section, records)
+    STATS_NAME(telemetry_stat_section, bytes)
+    STATS_NAME(telemetry_stat_section, dropped)
+    STATS_NAME(telemetry_stat_section, sink_error)
+STATS_NAME_END(telemetry_stat_section)
+
+static STATS_SECT_DECL(telemetry_stat_section) g_stat;
+#define TELEMETRY_STATS_INC(__X) STATS_INC(g_stat, __X)
+#define TELEMETRY_STATS_INCN(__X, __N) STATS_INCN(g_stat, __X, __N)
+#else
+#define TELEMETRY_STATS_INC(__X) {}
+#define TELEMETRY_STATS_INCN(__X, __N) {}
+#endif
+
+static uint8_t g_ring[MYNEWT_VAL(TELEMETRY_RING_SIZE)];
+static uint32_t g_reserve;                  // Advanced by producers when reserving
+static uint32_t g_written;                  // Advanced by producers once the record is copied in
+static uint32_t g_tail;                     // Advanced by the consumer only
+static uint32_t g_last_utime;               // Time of a recent reservation, only ever behind
+static bool g_utime_valid;
+static struct os_event g_drain_ev;
+static struct os_eventq g_eventq;
+static struct os_task g_task;
+static os_stack_t g_task_stack[MYNEWT_VAL(TELEMETRY_TASK_STACK_SZ)]
+    __attribute__((aligned(OS_STACK_ALIGNMENT)));
+static telemetry_sink_fn * g_sink;
+static void * g_sink_arg;
+
+static int
+raw_sink(void * arg, const uint8_t * buf, uint16_t len){
+#if MYNEWT_VAL(CONSOLE_RTT)
+    // Returns 0 when the up buffer is full, the rest is retried on the next record
+    return SEGGER_RTT_Write(0, buf, len);
+#else
+    for (uint16_t i = 0; i < len; i++)
+        hal_uart_blocking_tx(MYNEWT_VAL(TELEMETRY_UART_PORT), buf[i]);
+    return len;
+#endif
+}
+
+/**
+ * API to replace the record sink. The sink is called from the telemetry task with contiguous
+ * chunks of the stream and returns the number of bytes consumed, or a negative value on error.
+ *
+ * @param sink  Pointer to telemetry_sink_fn.
+ * @param arg   Argument passed to the sink.
+ * @return void
+ */
+void
+telemetry_set_sink(telemetry_sink_fn * sink, void * arg){
+    assert(sink);
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    g_sink = sink;
+    g_sink_arg = arg;
+    OS_EXIT_CRITICAL(sr);
+}
+
+static uint32_t
+ring_put(uint32_t pos, const void * data, uint16_t len){
+    const uint8_t * p = (const uint8_t *) data;
+    for (uint16_t i = 0; i < len; i++)
+        g_ring[(pos + i) & TELEMETRY_RING_MASK] = p[i];
+    return pos + len;
+}
+
+#if MYNEWT_VAL(TELEMETRY_CBOR)
+static uint8_t
+cbor_prefix(uint8_t * buf, uint16_t len){
+    if (len < 24) {
+        buf[0] = 0x40 | len;
+        return 1;
+    } else if (len < 256) {
+        buf[0] = 0x58;
+        buf[1] = len;
+        return 2;
+    }
+    buf[0] = 0x59;
+    buf[1] = len >> 8;
+    buf[2] = len & 0xff;
+    return 3;
+}
+#endif
+
+static uint16_t
+record_size(uint16_t len){
+#if MYNEWT_VAL(TELEMETRY_CBOR)
+    uint8_t prefix[3];
+    return cbor_prefix(prefix, sizeof(telemetry_hdr_t) + len) + sizeof(telemetry_hdr_t) + len;
+#else
+    return sizeof(telemetry_hdr_t) + len;
+#endif
+}
+
+static uint32_t
+record_put(uint32_t pos, telemetry_type_t type, uint32_t utime, const void * payload[], const uint8_t len[], uint8_t n, uint16_t total){
+    telemetry_hdr_t hdr = {
+        .vt = TELEMETRY_HDR_VT(TELEMETRY_VERSION, type),
+        .len = total,
+        .utime = utime & 0xffff
+    };
+#if MYNEWT_VAL(TELEMETRY_CBOR)
+    uint8_t prefix[3];
+    pos = ring_put(pos, prefix, cbor_prefix(prefix, sizeof(telemetry_hdr_t) + total));
+#endif
+    pos = ring_put(pos, &hdr, sizeof(telemetry_hdr_t));
+    for (uint8_t i = 0; i < n; i++)
+        pos = ring_put(pos, payload[i], len[i]);
+    return pos;
+}
+
+/**
+ * API to queue a record assembled from several payload fragments, callable from any context.
+ *
+ * @param type     telemetry_type_t.
+ * @param payload  Array of n payload fragments.
+ * @param len      Array of n fragment lengths.
+ * @param n        Number of fragments.
+ * @return OS_OK on success, OS_EINVAL if the payload exceeds 255 bytes, OS_ENOMEM if the ring is full.
+ */
+int
+telemetry_writev(telemetry_type_t type, const void * payload[], const uint8_t len[], uint8_t n){
+
+    uint16_t total = 0;
+    for (uint8_t i = 0; i < n; i++)
+        total += len[i];
+    if (total > UINT8_MAX)
+        return OS_EINVAL;
+
+    uint32_t pos, utime;
+    bool resync;
+    uint16_t size;
+    do {
+        pos = __atomic_load_n(&g_reserve, __ATOMIC_ACQUIRE);
+        utime = os_cputime_ticks_to_usecs(os_cputime_get32());
+        // A stale g_last_utime only overstates the gap, at worst an extra resync
+        resync = !__atomic_load_n(&g_utime_valid, __ATOMIC_RELAXED)
+                || utime - __atomic_load_n(&g_last_utime, __ATOMIC_RELAXED) > UINT16_MAX;
+        size = record_size(total) + (resync ? record_size(sizeof(telemetry_utime_t)) : 0);
+        if (pos + size - __atomic_load_n(&g_tail, __ATOMIC_ACQUIRE) > MYNEWT_VAL(TELEMETRY_RING_SIZE)) {
+            TELEMETRY_STATS_INC(dropped);
+            return OS_ENOMEM;
+        }
+    } while (!__atomic_compare_exchange_n(&g_reserve, &pos, pos + size, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    __atomic_store_n(&g_last_utime, utime, __ATOMIC_RELAXED);
+    if (resync) {
+        telemetry_utime_t record = {.utime = utime};
+        const void * p[] = {&record};
+        const uint8_t l[] = {sizeof(record)};
+        pos = record_put(pos, TELEMETRY_UTIME, utime, p, l, 1, sizeof(record));
+        __atomic_store_n(&g_utime_valid, true, __ATOMIC_RELAXED);
+    }
+    record_put(pos, type, utime, payload, len, n, total);
+    __atomic_fetch_add(&g_written, size, __ATOMIC_RELEASE);
+
+    TELEMETRY_STATS_INC(records);
+    os_eventq_put(&g_eventq, &g_drain_ev);
+    return OS_OK;
+}
+
+/**
+ * API to queue a single record.
+ *
+ * @param type     telemetry_type_t.
+ * @param payload  Pointer to the packed record payload.
+ * @param len      Payload length.
+ * @return OS_OK on success, OS_ENOMEM if the ring is full.
+ */
+int
+telemetry_write(telemetry_type_t type, const void * payload, uint8_t len){
+    const void * p[] = {payload};
+    const uint8_t l[] = {len};
+    return telemetry_writev(type, p, l, 1);
+}
+
+/**
+ * API to drain the committed records to the sink, called from the telemetry task.
+ *
+ * @return void
+ */
+void
+telemetry_flush(void){
+    uint32_t head = __atomic_load_n(&g_written, __ATOMIC_ACQUIRE);
+    if (head != __atomic_load_n(&g_reserve, __ATOMIC_ACQUIRE))
+        return;     // A record is being copied in, its producer posts the drain event once committed
+
+    while (g_tail != head) {
+        uint32_t offset = g_tail & TELEMETRY_RING_MASK;
+        uint32_t len = head - g_tail;
+        if (offset + len > MYNEWT_VAL(TELEMETRY_RING_SIZE))
+            len = MYNEWT_VAL(TELEMETRY_RING_SIZE) - offset;
+
+        int rc = g_sink(g_sink_arg, &g_ring[offset], len);
+        if (rc <= 0) {
+            // Sink is busy or broken, retry on the next record
+            TELEMETRY_STATS_INC(sink_error);
+            return;
+        }
+        TELEMETRY_STATS_INCN(bytes, rc);
+        __atomic_store_n(&g_tail, g_tail + rc, __ATOMIC_RELEASE);
+    }
+}
+
+static void
+drain_ev_cb(struct os_event * ev){
+    telemetry_flush();
+}
+
+static void
+telemetry_task(void * arg){
+    while (1) {
+        os_eventq_run(&g_eventq);
+    }
+}
+
+/**
+ * Function for initializing the telemetry ring and its task.
+ *
+ * @return void
+ */
+void
+telemetry_pkg_init(void)
+{
+    g_reserve = g_written = g_tail = 0;
+    g_utime_valid = false;
+    g_sink = raw_sink;
+    g_sink_arg = NULL;
+    g_drain_ev.ev_cb = drain_ev_cb;
+    g_drain_ev.ev_arg = NULL;
+
+    os_eventq_init(&g_eventq);
+    os_task_init(&g_task, "telemetry", telemetry_task, NULL, MYNEWT_VAL(TELEMETRY_TASK_PRIO), OS_WAIT_FOREVER,
+        g_task_stack, MYNEWT_VAL(TELEMETRY_TASK_STACK_SZ));
+
+#if MYNEWT_VAL(TELEMETRY_STATS)
+    int rc = stats_init(
+                STATS_HDR(g_stat),
+                STATS_SIZE_INIT_PARMS(g_stat, STATS_SIZE_32),
+                STATS_NAME_INIT_PARMS(telemetry_stat_section)
+            );
+    rc |= stats_register("telemetry", STATS_HDR(g_stat));
+    assert(rc == 0);
+#endif
+}
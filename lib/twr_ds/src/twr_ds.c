@@ -46,6 +46,9 @@
 #include <dw1000/dw1000_phy.h>
 #include <dw1000/dw1000_ftypes.h>
 #include <rng/rng.h>
+#if MYNEWT_VAL(RNG_CALIB_ENABLED)
+#include <rng/rng_calib.h>
+#endif
 #include <dsp/polyval.h>
 #if MYNEWT_VAL(WCS_ENABLED)
 #include <wcs/wcs.h>
@@ -106,6 +109,20 @@ static dw1000_rng_config_t g_config = {
     .rx_timeout_delay = MYNEWT_VAL(TWR_DS_RX_TIMEOUT)       // Receive response timeout in usec
 };
 
+#if MYNEWT_VAL(RNG_CALIB_ENABLED)
+// The remote holdoff is not ours to tune, time out on the worst case
+#define REMOTE_HOLDOFF (g_calib.max_holdoff)
+#else
+#define REMOTE_HOLDOFF (g_config.tx_holdoff_delay)
+#endif
+
+#if MYNEWT_VAL(RNG_CALIB_ENABLED)
+static dw1000_rng_calib_t g_calib = {
+    .name = "twr_ds",
+    .config = &g_config
+};
+#endif
+
 
 /**
  * API to initialise the rng_ss package.
@@ -136,6 +153,9 @@ void twr_ds_pkg_init(void){
     
     rc = stats_register("twr_ds", STATS_HDR(g_stat));
     assert(rc == 0);
+#if MYNEWT_VAL(RNG_CALIB_ENABLED)
+    dw1000_rng_calib_register(&g_calib);
+#endif
   
 }
 
@@ -177,6 +197,9 @@ twr_ds_config(dw1000_dev_instance_t * inst){
 static bool 
 start_tx_error_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs){
     STATS_INC(g_stat, start_tx_error);
+#if MYNEWT_VAL(RNG_CALIB_ENABLED)
+    dw1000_rng_calib_tx_error(&g_calib);
+#endif
     return true;
 }
 
@@ -227,7 +250,7 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
                 dw1000_rng_instance_t * rng = inst->rng; 
                 twr_frame_t * frame = rng->frames[(rng->idx)%rng->nframes];  // Frame already read within loader layers.
                 
-                if (inst->frame_len != sizeof(ieee_rng_request_frame_t)) 
+                if (!dw1000_rng_payload_fits(inst, sizeof(ieee_rng_request_frame_t))) 
                     break;
    
                 uint64_t request_timestamp = inst->rxtimestamp;
@@ -246,21 +269,30 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
 #endif
                 frame->code = DWT_DS_TWR_T1;
 
-                dw1000_write_tx(inst, frame->array, 0, sizeof(ieee_rng_response_frame_t));
-                dw1000_write_tx_fctrl(inst, sizeof(ieee_rng_response_frame_t), 0);
+                uint16_t len = sizeof(ieee_rng_response_frame_t);
+                dw1000_write_tx(inst, frame->array, 0, len);
+                len += dw1000_rng_payload_write(inst, frame->code, len);
+                dw1000_write_tx_fctrl(inst, len, 0);
                 dw1000_set_wait4resp(inst, true);   
 
                 dw1000_set_delay_start(inst, response_tx_delay);
                 uint16_t timeout = dw1000_phy_frame_duration(&inst->attrib, sizeof(ieee_rng_response_frame_t))
+                                    + dw1000_rng_payload_rx_usecs(inst)
                                     + g_config.rx_timeout_delay
-                                    + g_config.tx_holdoff_delay;         // Remote side turn arroud time.
+                                    + REMOTE_HOLDOFF;         // Remote side turn arroud time.
                 dw1000_set_rx_timeout(inst, timeout);
-
-                if (dw1000_start_tx(inst).start_tx_error){
+                bool start_tx_error = dw1000_start_tx(inst).start_tx_error;
+                if (start_tx_error){
                     os_sem_release(&rng->sem);  
                     if (cbs!=NULL && cbs->start_tx_error_cb) 
                         cbs->start_tx_error_cb(inst, cbs);
-                }            
+                }
+#if MYNEWT_VAL(RNG_CALIB_ENABLED)
+                // The response is armed, reading the latency no longer delays it
+                if (!start_tx_error)
+                    dw1000_rng_calib_sample(inst, &g_calib);
+#endif
+                dw1000_rng_payload_read(inst, sizeof(ieee_rng_request_frame_t));
                 break;
             }
         case DWT_DS_TWR_T1:
@@ -270,7 +302,7 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
  
                 if(inst->status.lde_error)
                     break;
-                if (inst->frame_len != sizeof(ieee_rng_response_frame_t)) 
+                if (!dw1000_rng_payload_fits(inst, sizeof(ieee_rng_response_frame_t))) 
                     break;
 
                 dw1000_rng_instance_t * rng = inst->rng; 
@@ -305,20 +337,29 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
                 frame->reception_timestamp =  (uint32_t) (request_timestamp & 0xFFFFFFFFUL);
                 frame->transmission_timestamp =  (uint32_t) (response_timestamp & 0xFFFFFFFFUL);
 
-                dw1000_write_tx(inst, frame->array, 0, sizeof(twr_frame_final_t));                
-                dw1000_write_tx_fctrl(inst, sizeof(twr_frame_final_t), 0);
+                uint16_t len = sizeof(twr_frame_final_t);
+                dw1000_write_tx(inst, frame->array, 0, len);                
+                len += dw1000_rng_payload_write(inst, frame->code, len);
+                dw1000_write_tx_fctrl(inst, len, 0);
                 dw1000_set_wait4resp(inst, true);
                 dw1000_set_delay_start(inst, response_tx_delay);
                 uint16_t timeout = dw1000_phy_frame_duration(&inst->attrib, sizeof(twr_frame_final_t))
+                                + dw1000_rng_payload_rx_usecs(inst)
                                 + g_config.rx_timeout_delay
-                                + g_config.tx_holdoff_delay;         // Remote side turn around time.
+                                + REMOTE_HOLDOFF;         // Remote side turn around time.
                 dw1000_set_rx_timeout(inst, timeout);
-                     
-                if (dw1000_start_tx(inst).start_tx_error){
+                bool start_tx_error = dw1000_start_tx(inst).start_tx_error;
+                if (start_tx_error){
                     os_sem_release(&rng->sem);  
                     if (cbs!=NULL && cbs->start_tx_error_cb) 
                         cbs->start_tx_error_cb(inst, cbs);
                 }
+#if MYNEWT_VAL(RNG_CALIB_ENABLED)
+                // The response is armed, reading the latency no longer delays it
+                if (!start_tx_error)
+                    dw1000_rng_calib_sample(inst, &g_calib);
+#endif
+                dw1000_rng_payload_read(inst, sizeof(ieee_rng_response_frame_t));
                 break; 
             }
         case DWT_DS_TWR_T2:
@@ -326,11 +367,11 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
                 // This code executes on the device that responded to the original request, and is now preparing the final timestamps
                 if(inst->status.lde_error)
                     break;
-                if (inst->frame_len != sizeof(twr_frame_final_t))
+                if (!dw1000_rng_payload_fits(inst, sizeof(twr_frame_final_t)))
                     break;
 
                 dw1000_rng_instance_t * rng = inst->rng; 
-                twr_frame_t * previous_frame = rng->frames[(uint16_t)(rng->idx-1)%rng->nframes];
+                twr_frame_t * previous_frame = dw1000_rng_previous_frame(rng);
                 twr_frame_t * frame = rng->frames[(rng->idx)%rng->nframes];
  
                 previous_frame->request_timestamp = frame->request_timestamp;
@@ -350,10 +391,14 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
                 frame->code = DWT_DS_TWR_FINAL;
 
                 // Transmit timestamp final report
-                dw1000_write_tx(inst, frame->array, 0, sizeof(twr_frame_final_t));
-                dw1000_write_tx_fctrl(inst, sizeof(twr_frame_final_t), 0); 
+                uint16_t len = sizeof(twr_frame_final_t);
+                dw1000_write_tx(inst, frame->array, 0, len);
+                len += dw1000_rng_payload_write(inst, frame->code, len);
+                dw1000_write_tx_fctrl(inst, len, 0); 
         
-                if (dw1000_start_tx(inst).start_tx_error){
+                bool start_tx_error = dw1000_start_tx(inst).start_tx_error;
+                dw1000_rng_payload_read(inst, sizeof(twr_frame_final_t));
+                if (start_tx_error){
                     os_sem_release(&rng->sem);  
                     if (cbs!=NULL && cbs->start_tx_error_cb) 
                         cbs->start_tx_error_cb(inst, cbs);
@@ -379,6 +424,7 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
                     dw1000_stop_rx(inst); // Need to prevent timeout event 
 
                 dw1000_rng_instance_t * rng = inst->rng; 
+                dw1000_rng_payload_read(inst, sizeof(twr_frame_final_t));
                 STATS_INC(g_stat, complete);                   
                 os_sem_release(&rng->sem);
                 dw1000_mac_interface_t * cbs = NULL;
@@ -280,8 +280,11 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
 #endif
                 frame->code = DWT_DS_TWR_EXT_T1;
 
-                dw1000_write_tx(inst, frame->array, 0, sizeof(ieee_rng_response_frame_t));
-                dw1000_write_tx_fctrl(inst, sizeof(ieee_rng_response_frame_t), 0);
+                // The extended frames that follow carry twr_data, only the request and this response take a payload
+                uint16_t len = sizeof(ieee_rng_response_frame_t);
+                dw1000_write_tx(inst, frame->array, 0, len);
+                len += dw1000_rng_payload_write(inst, frame->code, len);
+                dw1000_write_tx_fctrl(inst, len, 0);
                 dw1000_set_wait4resp(inst, true);    
 
                 dw1000_set_delay_start(inst, response_tx_delay);   
@@ -295,6 +298,8 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
                     if (cbs!=NULL && cbs->start_tx_error_cb) 
                         cbs->start_tx_error_cb(inst, cbs);
                 }
+                // Response is scheduled, the payload is now off the critical path
+                dw1000_rng_payload_read(inst, sizeof(ieee_rng_request_frame_t));
                 break;
             }
         case DWT_DS_TWR_EXT_T1:
@@ -303,7 +308,7 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
                 // The 1st frame now contains a local copy of the initial first side of the double sided scheme. 
          
 
-                if (inst->frame_len != sizeof(ieee_rng_response_frame_t)) 
+                if (!dw1000_rng_payload_fits(inst, sizeof(ieee_rng_response_frame_t))) 
                     break;
 
                 dw1000_rng_instance_t * rng = inst->rng; 
@@ -352,7 +357,9 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
                                 + g_config.tx_holdoff_delay;         // Remote side turn arroud time.
                 dw1000_set_rx_timeout(inst, timeout);
                         
-                if (dw1000_start_tx(inst).start_tx_error){
+                bool start_tx_error = dw1000_start_tx(inst).start_tx_error;
+                dw1000_rng_payload_read(inst, sizeof(ieee_rng_response_frame_t));
+                if (start_tx_error){
                     os_sem_release(&rng->sem);  
                     if (cbs!=NULL && cbs->start_tx_error_cb) 
                         cbs->start_tx_error_cb(inst, cbs);
@@ -365,7 +372,7 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
                 // This code executes on the device that responded to the original request, and is now preparing the final timestamps
         
                 dw1000_rng_instance_t * rng = inst->rng; 
-                twr_frame_t * previous_frame = rng->frames[(uint16_t)(rng->idx-1)%rng->nframes];
+                twr_frame_t * previous_frame = dw1000_rng_previous_frame(rng);
                 twr_frame_t * frame = rng->frames[(rng->idx)%rng->nframes];
 
                 previous_frame->request_timestamp = frame->request_timestamp;
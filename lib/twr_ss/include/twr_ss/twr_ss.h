@@ -45,9 +45,27 @@ extern "C" {
 #include <dw1000/dw1000_ftypes.h>
 #include <rng/rng.h>
 
+#if MYNEWT_VAL(TWR_SS_WCS_ENABLED)
+//! Range entry of the result broadcast
+typedef struct _twr_ss_wcs_result_t{
+    uint16_t addr;                  //!< Responder short address
+    uint16_t tof;                   //!< Time of flight in dwt units, saturated
+}__attribute__((__packed__, aligned(1))) twr_ss_wcs_result_t;
+
+//! Result broadcast frame, replaces the per-pair finals of DWT_SS_TWR
+typedef struct _twr_ss_wcs_result_frame_t{
+    struct _ieee_rng_request_frame_t;
+    uint8_t n;                      //!< Number of entries
+    twr_ss_wcs_result_t results[MYNEWT_VAL(TWR_SS_WCS_NRESULTS)];
+}__attribute__((__packed__, aligned(1))) twr_ss_wcs_result_frame_t;
+#endif
+
 void twr_ss_pkg_init(void);
 void twr_ss_free(dw1000_dev_instance_t * inst);
 dw1000_rng_config_t * twr_ss_config(dw1000_dev_instance_t * inst);
+#if MYNEWT_VAL(TWR_SS_WCS_ENABLED)
+dw1000_dev_status_t twr_ss_wcs_result_broadcast(dw1000_dev_instance_t * inst);
+#endif
 
 #ifdef __cplusplus
 }
@@ -31,6 +31,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
 #include <assert.h>
 #include <math.h>
 #include <os/os.h>
@@ -46,6 +47,10 @@
 #include <dw1000/dw1000_phy.h>
 #include <dw1000/dw1000_ftypes.h>
 #include <rng/rng.h>
+#include <twr_ss/twr_ss.h>
+#if MYNEWT_VAL(RNG_CALIB_ENABLED)
+#include <rng/rng_calib.h>
+#endif
 #include <dsp/polyval.h>
 
 #if MYNEWT_VAL(WCS_ENABLED)
@@ -107,6 +112,96 @@ static dw1000_rng_config_t g_config = {
     .rx_timeout_delay = MYNEWT_VAL(TWR_SS_RX_TIMEOUT)       // Receive response timeout in usec
 };
 
+#if MYNEWT_VAL(RNG_CALIB_ENABLED)
+// The remote holdoff is not ours to tune, time out on the worst case
+#define REMOTE_HOLDOFF (g_calib.max_holdoff)
+#else
+#define REMOTE_HOLDOFF (g_config.tx_holdoff_delay)
+#endif
+
+#if MYNEWT_VAL(RNG_CALIB_ENABLED)
+static dw1000_rng_calib_t g_calib = {
+    .name = "twr_ss",
+    .config = &g_config
+};
+#endif
+
+#if MYNEWT_VAL(TWR_SS_WCS_ENABLED)
+_Static_assert(sizeof(twr_ss_wcs_result_frame_t) <= sizeof(twr_frame_t), "TWR_SS_WCS_NRESULTS does not fit a twr_frame_t");
+
+static twr_ss_wcs_result_t g_results[MYNEWT_VAL(TWR_SS_WCS_NRESULTS)];
+static uint8_t g_nresults;
+
+/**
+ * @fn result_update(uint16_t addr, twr_frame_t * frame)
+ * @brief Records the range of a completed two message exchange for the next result broadcast.
+ *
+ * @param addr   Responder short address.
+ * @param frame  Completed frame, all timestamps referenced to the master clock.
+ *
+ * @return void
+ */
+static void
+result_update(uint16_t addr, twr_frame_t * frame){
+
+    int32_t tof = ((int32_t)(frame->response_timestamp - frame->request_timestamp)
+                    - (int32_t)(frame->transmission_timestamp - frame->reception_timestamp))/2;
+    tof = (tof < 0) ? 0 : (tof > UINT16_MAX) ? UINT16_MAX : tof;
+
+    uint8_t i;
+    for (i = 0; i < g_nresults; i++)
+        if (g_results[i].addr == addr)
+            break;
+    if (i == MYNEWT_VAL(TWR_SS_WCS_NRESULTS))
+        return;
+    if (i == g_nresults)
+        g_nresults++;
+    g_results[i].addr = addr;
+    g_results[i].tof = (uint16_t) tof;
+}
+
+/**
+ * @fn twr_ss_wcs_result_broadcast(dw1000_dev_instance_t * inst)
+ * @brief API to broadcast the ranges of the DWT_SS_TWR_WCS exchanges completed since the last broadcast.
+ * Responders that are listening receive their own range through the complete callback, in place of
+ * one final frame per exchange.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ *
+ * @return dw1000_dev_status_t
+ */
+dw1000_dev_status_t
+twr_ss_wcs_result_broadcast(dw1000_dev_instance_t * inst){
+
+    dw1000_rng_instance_t * rng = inst->rng;
+    os_error_t err = os_sem_pend(&rng->sem, OS_TIMEOUT_NEVER);
+    assert(err == OS_OK);
+
+    twr_ss_wcs_result_frame_t frame = {
+        .fctrl = FCNTL_IEEE_RANGE_16,
+        .seq_num = ++rng->seq_num,
+        .PANID = 0xDECA,
+        .dst_address = BROADCAST_ADDRESS,
+        .src_address = inst->my_short_address,
+        .code = DWT_SS_TWR_WCS_RESULT,
+        .n = g_nresults
+    };
+    memcpy(frame.results, g_results, g_nresults * sizeof(twr_ss_wcs_result_t));
+    uint16_t len = sizeof(twr_ss_wcs_result_frame_t) - (MYNEWT_VAL(TWR_SS_WCS_NRESULTS) - g_nresults) * sizeof(twr_ss_wcs_result_t);
+
+    dw1000_write_tx(inst, (uint8_t *) &frame, 0, len);
+    dw1000_write_tx_fctrl(inst, len, 0);
+    dw1000_set_wait4resp(inst, false);
+    if (dw1000_start_tx(inst).start_tx_error)
+        STATS_INC(g_stat, tx_error);
+    else
+        g_nresults = 0;
+    os_sem_release(&rng->sem);
+
+    return inst->status;
+}
+#endif
+
 /**
  * @fn twr_ss_pkg_init(void)
  * @brief API to initialise the rng_ss package.
@@ -134,6 +229,9 @@ twr_ss_pkg_init(void){
     STATS_NAME_INIT_PARMS(twr_ss_stat_section));
     rc |= stats_register("twr_ss", STATS_HDR(g_stat));
     assert(rc == 0);
+#if MYNEWT_VAL(RNG_CALIB_ENABLED)
+    dw1000_rng_calib_register(&g_calib);
+#endif
 }
 
 /**
@@ -175,6 +273,9 @@ twr_ss_config(dw1000_dev_instance_t * inst){
 static bool
 start_tx_error_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs){
     STATS_INC(g_stat, tx_error);
+#if MYNEWT_VAL(RNG_CALIB_ENABLED)
+    dw1000_rng_calib_tx_error(&g_calib);
+#endif
     return true;
 }
 
@@ -248,28 +349,38 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
                 frame->carrier_integrator  = - inst->carrier_integrator;
 #endif
                // Write the second part of the response
-                dw1000_write_tx(inst, frame->array ,0 ,sizeof(ieee_rng_response_frame_t));
-                dw1000_write_tx_fctrl(inst, sizeof(ieee_rng_response_frame_t), 0);
+                uint16_t len = sizeof(ieee_rng_response_frame_t);
+                dw1000_write_tx(inst, frame->array ,0 ,len);
+                len += dw1000_rng_payload_write(inst, frame->code, len);
+                dw1000_write_tx_fctrl(inst, len, 0);
                 dw1000_set_wait4resp(inst, true);   
 
                 uint16_t timeout = dw1000_phy_frame_duration(&inst->attrib, sizeof(ieee_rng_response_frame_t))
+                                        + dw1000_rng_payload_rx_usecs(inst)
                                         + g_config.rx_timeout_delay
-                                        + g_config.tx_holdoff_delay;         // Remote side turn arroud time.
+                                        + REMOTE_HOLDOFF;         // Remote side turn arroud time.
 
                 dw1000_set_delay_start(inst, response_tx_delay);
                 dw1000_set_rx_timeout(inst, timeout);
-
-                if (dw1000_start_tx(inst).start_tx_error){
+                bool start_tx_error = dw1000_start_tx(inst).start_tx_error;
+                if (start_tx_error){
                     os_sem_release(&rng->sem);
                     if (cbs!=NULL && cbs->start_tx_error_cb)
                         cbs->start_tx_error_cb(inst, cbs);
                 }
+#if MYNEWT_VAL(RNG_CALIB_ENABLED)
+                // The response is armed, reading the latency no longer delays it
+                if (!start_tx_error)
+                    dw1000_rng_calib_sample(inst, &g_calib);
+#endif
+                // Response is scheduled, the payload is now off the critical path
+                dw1000_rng_payload_read(inst, sizeof(ieee_rng_request_frame_t));
                 break;
             }
         case DWT_SS_TWR_T1:
             {
                 // This code executes on the device that initiated a request, and is now preparing the final timestamps
-                if (inst->frame_len != sizeof(ieee_rng_response_frame_t))
+                if (!dw1000_rng_payload_fits(inst, sizeof(ieee_rng_response_frame_t)))
                     break;
 
                 if(inst->status.lde_error)
@@ -293,9 +404,13 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
                 frame->carrier_integrator  = inst->carrier_integrator;
 #endif
                 // Transmit timestamp final report
-                dw1000_write_tx(inst, frame->array, 0,  sizeof(twr_frame_final_t));
-                dw1000_write_tx_fctrl(inst, sizeof(twr_frame_final_t), 0);
-                if (dw1000_start_tx(inst).start_tx_error){
+                uint16_t len = sizeof(twr_frame_final_t);
+                dw1000_write_tx(inst, frame->array, 0, len);
+                len += dw1000_rng_payload_write(inst, frame->code, len);
+                dw1000_write_tx_fctrl(inst, len, 0);
+                bool start_tx_error = dw1000_start_tx(inst).start_tx_error;
+                dw1000_rng_payload_read(inst, sizeof(ieee_rng_response_frame_t));
+                if (start_tx_error){
                     os_sem_release(&rng->sem);
                     if (cbs!=NULL && cbs->start_tx_error_cb)
                         cbs->start_tx_error_cb(inst, cbs);
@@ -313,13 +428,116 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
                     }
                 break;
             }
+#if MYNEWT_VAL(TWR_SS_WCS_ENABLED)
+        case DWT_SS_TWR_WCS:
+            {
+                // This code executes on the device that is responding to a request, the response closes the exchange
+                wcs_instance_t * wcs = inst->ccp->wcs;
+                if (!wcs->status.valid){
+                    os_sem_release(&rng->sem);
+                    break;
+                }
+                uint64_t request_timestamp = inst->rxtimestamp;
+                uint64_t response_tx_delay = request_timestamp + ((uint64_t) g_config.tx_holdoff_delay << 16);
+                uint64_t response_timestamp = (response_tx_delay & 0xFFFFFFFE00UL) + inst->tx_antenna_delay;
+
+                frame->reception_timestamp = (uint32_t)(wcs_local_to_master(wcs, request_timestamp)) & 0xFFFFFFFFULL;
+                frame->transmission_timestamp = (uint32_t)(wcs_local_to_master(wcs, response_timestamp)) & 0xFFFFFFFFULL;
+                frame->dst_address = frame->src_address;
+                frame->src_address = inst->my_short_address;
+                frame->code = DWT_SS_TWR_WCS_T1;
+
+                uint16_t len = sizeof(ieee_rng_response_frame_t);
+                dw1000_write_tx(inst, frame->array ,0 ,len);
+                len += dw1000_rng_payload_write(inst, frame->code, len);
+                dw1000_write_tx_fctrl(inst, len, 0);
+                dw1000_set_wait4resp(inst, false);
+                dw1000_set_delay_start(inst, response_tx_delay);
+                bool start_tx_error = dw1000_start_tx(inst).start_tx_error;
+                if (start_tx_error){
+                    if (cbs!=NULL && cbs->start_tx_error_cb)
+                        cbs->start_tx_error_cb(inst, cbs);
+                }
+#if MYNEWT_VAL(RNG_CALIB_ENABLED)
+                // The response is armed, reading the latency no longer delays it
+                if (!start_tx_error)
+                    dw1000_rng_calib_sample(inst, &g_calib);
+#endif
+                os_sem_release(&rng->sem);
+                dw1000_rng_payload_read(inst, sizeof(ieee_rng_request_frame_t));
+                break;
+            }
+        case DWT_SS_TWR_WCS_T1:
+            {
+                // This code executes on the device that initiated a request, the response completes the range
+                if (!dw1000_rng_payload_fits(inst, sizeof(ieee_rng_response_frame_t)) || inst->status.lde_error){
+                    os_sem_release(&rng->sem);
+                    break;
+                }
+                wcs_instance_t * wcs = inst->ccp->wcs;
+                frame->request_timestamp = wcs_local_to_master(wcs, dw1000_read_txtime(inst)) & 0xFFFFFFFFULL;
+                frame->response_timestamp = wcs_local_to_master(wcs, inst->rxtimestamp) & 0xFFFFFFFFULL;
+                frame->carrier_integrator  = 0.0l;
+                dw1000_rng_payload_read(inst, sizeof(ieee_rng_response_frame_t));
+                result_update(frame->src_address, frame);
+
+                STATS_INC(g_stat, complete);
+                os_sem_release(&rng->sem);
+                dw1000_mac_interface_t * cbs = NULL;
+                if(!(SLIST_EMPTY(&inst->interface_cbs))){
+                    SLIST_FOREACH(cbs, &inst->interface_cbs, next){
+                    if (cbs!=NULL && cbs->complete_cb)
+                        if(cbs->complete_cb(inst, cbs)) continue;
+                    }
+                }
+                break;
+            }
+        case DWT_SS_TWR_WCS_RESULT:
+            {
+                // This code executes on a listening responder, the broadcast carries the range of its last exchange
+                twr_ss_wcs_result_frame_t * _frame = (twr_ss_wcs_result_frame_t *) inst->rxbuf;
+                uint16_t n = 0;
+                if (inst->frame_len > offsetof(twr_ss_wcs_result_frame_t, results))
+                    n = (inst->frame_len - offsetof(twr_ss_wcs_result_frame_t, results)) / sizeof(twr_ss_wcs_result_t);
+                n = (n < _frame->n) ? n : _frame->n;
+
+                twr_ss_wcs_result_t * result = NULL;
+                for (uint16_t i = 0; i < n && result == NULL; i++)
+                    if (_frame->results[i].addr == inst->my_short_address)
+                        result = &_frame->results[i];
+
+                /* A broadcast without an entry for this node leaves the listen running until its own timeout */
+                if (result == NULL)
+                    break;
+                os_sem_release(&rng->sem);
+
+                // Present the range as the equivalent timestamp set so dw1000_rng_twr_to_tof applies unchanged
+                frame->dst_address = inst->my_short_address;
+                frame->request_timestamp = 0;
+                frame->response_timestamp = 2 * (uint32_t) result->tof;
+                frame->reception_timestamp = 0;
+                frame->transmission_timestamp = 0;
+                frame->carrier_integrator  = 0.0l;
+
+                STATS_INC(g_stat, complete);
+                dw1000_mac_interface_t * cbs = NULL;
+                if(!(SLIST_EMPTY(&inst->interface_cbs))){
+                    SLIST_FOREACH(cbs, &inst->interface_cbs, next){
+                    if (cbs!=NULL && cbs->complete_cb)
+                        if(cbs->complete_cb(inst, cbs)) continue;
+                    }
+                }
+                break;
+            }
+#endif
         case  DWT_SS_TWR_FINAL:
             {
                 // This code executes on the device that responded to the original request, and has now receive the response final timestamp.
                 // This marks the completion of the single-size-two-way request. This final 4th message is perhaps optional in some applicaiton.
 
-                if (inst->frame_len != sizeof(twr_frame_final_t))
+                if (!dw1000_rng_payload_fits(inst, sizeof(twr_frame_final_t)))
                    break;
+                dw1000_rng_payload_read(inst, sizeof(twr_frame_final_t));
 
                 STATS_INC(g_stat, complete);
                 os_sem_release(&rng->sem);
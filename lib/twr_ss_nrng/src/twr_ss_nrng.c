@@ -50,6 +50,9 @@
 #endif
 #include <dsp/polyval.h>
 #include <rng/slots.h>
+#if MYNEWT_VAL(NRNG_GUARD_ENABLED)
+#include <nrng/nrng_guard.h>
+#endif
 
 #define WCS_DTU MYNEWT_VAL(WCS_DTU)
 
@@ -62,13 +65,45 @@ static bool rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t
 static bool rx_timeout_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
 static bool rx_error_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t *);
 static bool reset_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+static bool tx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
+#endif
 
-static dw1000_mac_interface_t g_cbs = {
-    .id = DW1000_NRNG_SS,
-    .rx_complete_cb = rx_complete_cb,
-    .rx_timeout_cb = rx_timeout_cb,
-    .rx_error_cb = rx_error_cb,
-    .reset_cb = reset_cb
+static dw1000_mac_interface_t g_cbs[] = {
+        [0] = {
+            .id = DW1000_NRNG_SS,
+            .rx_complete_cb = rx_complete_cb,
+            .rx_timeout_cb = rx_timeout_cb,
+            .rx_error_cb = rx_error_cb,
+            .reset_cb = reset_cb,
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+            .tx_complete_cb = tx_complete_cb,
+#endif
+        },
+#if MYNEWT_VAL(DW1000_DEVICE_1)
+        [1] = {
+            .id = DW1000_NRNG_SS,
+            .rx_complete_cb = rx_complete_cb,
+            .rx_timeout_cb = rx_timeout_cb,
+            .rx_error_cb = rx_error_cb,
+            .reset_cb = reset_cb,
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+            .tx_complete_cb = tx_complete_cb,
+#endif
+        },
+#endif
+#if MYNEWT_VAL(DW1000_DEVICE_2)
+        [2] = {
+            .id = DW1000_NRNG_SS,
+            .rx_complete_cb = rx_complete_cb,
+            .rx_timeout_cb = rx_timeout_cb,
+            .rx_error_cb = rx_error_cb,
+            .reset_cb = reset_cb,
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+            .tx_complete_cb = tx_complete_cb,
+#endif
+        }
+#endif
 };
 
 static dw1000_rng_config_t g_config = {
@@ -88,7 +123,27 @@ void twr_ss_nrng_pkg_init(void){
 #if MYNEWT_VAL(DW1000_PKG_INIT_LOG)
     printf("{\"utime\": %lu,\"msg\": \"ss_nrng_pkg_init\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
 #endif
-    dw1000_mac_append_interface(hal_dw1000_inst(0), &g_cbs);
+#if MYNEWT_VAL(DW1000_DEVICE_0)
+    dw1000_mac_append_interface(hal_dw1000_inst(0), &g_cbs[0]);
+#endif
+#if MYNEWT_VAL(DW1000_DEVICE_1)
+    dw1000_mac_append_interface(hal_dw1000_inst(1), &g_cbs[1]);
+#endif
+#if MYNEWT_VAL(DW1000_DEVICE_2)
+    dw1000_mac_append_interface(hal_dw1000_inst(2), &g_cbs[2]);
+#endif
+#if MYNEWT_VAL(NRNG_GUARD_ENABLED)
+    // Each initiator tunes its own guard, g_config is shared by all devices
+#if MYNEWT_VAL(DW1000_DEVICE_0)
+    dw1000_nrng_guard_init(&hal_dw1000_inst(0)->nrng->guard, &g_config);
+#endif
+#if MYNEWT_VAL(DW1000_DEVICE_1)
+    dw1000_nrng_guard_init(&hal_dw1000_inst(1)->nrng->guard, &g_config);
+#endif
+#if MYNEWT_VAL(DW1000_DEVICE_2)
+    dw1000_nrng_guard_init(&hal_dw1000_inst(2)->nrng->guard, &g_config);
+#endif
+#endif
 }
 
 
@@ -134,6 +189,14 @@ rx_error_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs){
     dw1000_nrng_instance_t * nrng = inst->nrng;
     if(os_sem_get_count(&nrng->sem) == 0){
         NRNG_STATS_INC(rx_error);
+#if MYNEWT_VAL(NRNG_GUARD_ENABLED)
+        if (nrng->device_type == DWT_NRNG_INITIATOR)
+            dw1000_nrng_guard_widen(&nrng->guard);
+#endif
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+        if (nrng->device_type == DWT_NRNG_INITIATOR)
+            dw1000_nrng_pcode_rx(inst, nrng->nnodes);
+#endif
         os_error_t err = os_sem_release(&nrng->sem);
         assert(err == OS_OK);
         return true;
@@ -157,7 +220,26 @@ rx_timeout_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
         return false;
 
     if(os_sem_get_count(&nrng->sem) == 0){
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+        if (nrng->device_type == DWT_NRNG_INITIATOR && nrng->pcode_next < nrng->nnodes){
+            // End of a code group, listen for the next group on its code
+            dw1000_rng_config_t * config = dw1000_nrng_get_config(inst, DWT_SS_TWR_NRNG);
+            dw1000_nrng_pcode_rx(inst, nrng->pcode_next);
+            dw1000_set_rx_timeout(inst, dw1000_nrng_pcode_timeout(inst, config));
+            if (dw1000_start_rx(inst).start_rx_error == 0)
+                return true;
+            NRNG_STATS_INC(start_rx_error);
+        }
+#endif
         NRNG_STATS_INC(rx_timeout);
+#if MYNEWT_VAL(NRNG_GUARD_ENABLED)
+        if (nrng->device_type == DWT_NRNG_INITIATOR)
+            dw1000_nrng_guard_update(&nrng->guard);
+#endif
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+        if (nrng->device_type == DWT_NRNG_INITIATOR)
+            dw1000_nrng_pcode_rx(inst, nrng->nnodes);
+#endif
         // In the case of a NRNG timeout is used to mark the end of the request 
         // and is used to call the completion callback  
         if(!(SLIST_EMPTY(&inst->interface_cbs))){
@@ -192,6 +274,25 @@ reset_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs){
         return false;
 }
 
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+/**
+ * API for tx_complete_cb of nrng interface, a responder returns to the channel code once its response is sent.
+ *
+ * @param inst   Pointer to dw1000_dev_instance_t.
+ * @return false, other interfaces still see the event
+ */
+static bool
+tx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs){
+
+    dw1000_nrng_instance_t * nrng = inst->nrng;
+    if (nrng->pcode_active) {
+        nrng->pcode_active = 0;
+        dw1000_set_preamble_code(inst, inst->config.tx.preambleCodeIndex, inst->config.rx.preambleCodeIndex);
+    }
+    return false;
+}
+#endif
+
 /**
  * API for receive complete callback.
  *
@@ -230,28 +331,48 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
                 if (inst->frame_len < sizeof(nrng_request_frame_t)) 
                     break;
                 uint16_t slot_idx;    
+                if (_frame->ptype == PTYPE_MAP) {
 #if MYNEWT_VAL(CELL_ENABLED)
-                if (_frame->ptype != PTYPE_CELL) 
-                    break;
-                if (_frame->cell_id != inst->cell_id)
-                    break; 
-                if (_frame->slot_mask & (1UL << inst->slot_id))
-                    slot_idx = BitIndex(_frame->slot_mask, 1UL << inst->slot_id, SLOT_POSITION);
-                else
-                    break;
+                    if (_frame->cell_id != inst->cell_id)
+                        break;
+#endif
+                    // Slot map follows the request, locate our slot without expanding it
+                    uint16_t len = inst->frame_len - sizeof(nrng_request_frame_t);
+                    int32_t position = slot_map_position(inst->rxbuf + sizeof(nrng_request_frame_t),
+                                            (_frame->map_len < len) ? _frame->map_len : len, _frame->map_rle, inst->slot_id);
+                    if (position < 0)
+                        break;
+                    slot_idx = position;
+                } else {
+#if MYNEWT_VAL(CELL_ENABLED)
+                    if (_frame->ptype != PTYPE_CELL) 
+                        break;
+                    if (_frame->cell_id != inst->cell_id)
+                        break; 
+                    if (_frame->slot_mask & (1UL << inst->slot_id))
+                        slot_idx = BitIndex(_frame->slot_mask, 1UL << inst->slot_id, SLOT_POSITION);
+                    else
+                        break;
 #else
-                if (_frame->bitfield & (1UL << inst->slot_id))
-                    slot_idx = BitIndex(_frame->bitfield, 1UL << inst->slot_id, SLOT_POSITION);
-                else
-                    break;
-#endif         
+                    if (_frame->bitfield & (1UL << inst->slot_id))
+                        slot_idx = BitIndex(_frame->bitfield, 1UL << inst->slot_id, SLOT_POSITION);
+                    else
+                        break;
+#endif
+                }
                 nrng_final_frame_t * frame = (nrng_final_frame_t *) nrng->frames[(++nrng->idx)%nrng->nframes];
                 memcpy(frame->array, inst->rxbuf, sizeof(nrng_request_frame_t));
 
+#if MYNEWT_VAL(NRNG_GUARD_ENABLED)
+                // Follow the guard advertised by the initiator
+                uint32_t guard_delay = _frame->guard_delay ? _frame->guard_delay : config->tx_guard_delay;
+#else
+                uint32_t guard_delay = config->tx_guard_delay;
+#endif
                 uint64_t request_timestamp = inst->rxtimestamp;
                 uint64_t response_tx_delay = request_timestamp 
                             + (((uint64_t)config->tx_holdoff_delay
-                            + (uint64_t)(slot_idx * ((uint64_t)config->tx_guard_delay
+                            + (uint64_t)(slot_idx * ((uint64_t)guard_delay
                             + (uint64_t)(dw1000_usecs_to_dwt_usecs(dw1000_phy_frame_duration(&inst->attrib, sizeof(nrng_response_frame_t)))))))<< 16);
                 uint64_t response_timestamp = (response_tx_delay & 0xFFFFFFFE00UL) + inst->tx_antenna_delay;
 
@@ -278,15 +399,28 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
                 dw1000_write_tx_fctrl(inst, sizeof(nrng_response_frame_t), 0);
                 dw1000_set_wait4resp(inst, false);
                 dw1000_set_delay_start(inst, response_tx_delay);
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+                // Answer on the code of our group
+                uint8_t code = dw1000_nrng_pcode(_frame->pcodes, _frame->pcode_group, slot_idx);
+                if (code) {
+                    dw1000_set_preamble_code(inst, code, inst->config.rx.preambleCodeIndex);
+                    nrng->pcode_active = 1;
+                }
+#endif
 
                 if (dw1000_start_tx(inst).start_tx_error){
                     os_sem_release(&nrng->sem);  
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+                    tx_complete_cb(inst, cbs);
+#endif
                     if (cbs!=NULL && cbs->start_tx_error_cb) {
                         cbs->start_tx_error_cb(inst, cbs);
                     }
                 }else{
                     os_sem_release(&nrng->sem);
                 }
+                // Response is scheduled, the payload follows the slot map
+                dw1000_rng_payload_read(inst, sizeof(nrng_request_frame_t) + ((_frame->ptype == PTYPE_MAP) ? _frame->map_len : 0));
             break;
             }
         case DWT_SS_TWR_NRNG_T1:
@@ -329,6 +463,9 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
                 if(inst->config.rxdiag_enable) {
                     memcpy(&frame->diag, &inst->rxdiag, sizeof(struct _dw1000_dev_rxdiag_t));
                 }
+#if MYNEWT_VAL(NRNG_GUARD_ENABLED)
+                dw1000_nrng_guard_sample(inst, &nrng->guard, idx);
+#endif
                 if(idx == nrng->nnodes-1){
                      dw1000_set_rx_timeout(inst, 1); // Triger timeout event
                 }else{
@@ -338,6 +475,12 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
                                 config,                            // Guard delay 
                                 dw1000_phy_frame_duration(&inst->attrib, sizeof(nrng_response_frame_t)) // frame duration in usec
                             ) + config->rx_timeout_delay;          // TOF allowance.
+#if MYNEWT_VAL(NRNG_PCODE_ENABLED)
+                    // Listen to the end of the code group, the receiver is idle once it times out and rx_timeout_cb
+                    // moves on to the code of the next group
+                    if (nrng->pcode_group)
+                        timeout = dw1000_nrng_pcode_timeout(inst, config);
+#endif
                     dw1000_set_rx_timeout(inst, timeout);
                 }
             break;
@@ -27,7 +27,12 @@
 #include <os/os.h>
 #include <dw1000/dw1000_dev.h>
 #include <ccp/ccp.h>
-#include <timescale/timescale.h>        
+#if !MYNEWT_VAL(WCS_FLOAT_ESTIMATOR)
+#include <timescale/timescale.h>
+#endif
+#if MYNEWT_VAL(WCS_QUALITY_ENABLED)
+#include <stats/stats.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -48,6 +53,62 @@ typedef struct _wcs_config_t{
     uint16_t postprocess:1;
 }wcs_config_t;
 
+#define WCS_FIXED_SHIFT 40   //!< Fractional bits of the fixed point slope
+
+//! Linear local to master mapping of the current CCP epoch
+typedef struct _wcs_fixed_t{
+    uint64_t local_epoch;       //!< Local 40 bit timestamp of the epoch
+    uint64_t master_hi;         //!< Master timestamp above 40 bits
+    int64_t offset;             //!< Master 40 bit time at the epoch (dtu), may exceed 40 bits
+    int64_t slope;              //!< Master over local rate less 1, in 2^-WCS_FIXED_SHIFT
+}wcs_fixed_t;
+
+//! Single precision two-state clock filter, see wcs_estimator.c
+typedef struct _wcs_estimator_t{
+    uint64_t time;              //!< Master 40 bit time at the local epoch (dtu)
+    float rate;                 //!< Master over local rate less 1
+    float u;                    //!< Covariance factor U = [1 u; 0 1] (dtu), P = U diag(d) U'
+    float d[2];                 //!< Covariance factor D: d0 (dtu^2), d1
+    uint16_t initialized:1;
+    uint16_t valid:1;
+    uint16_t rejects;           //!< Consecutive rejected epochs
+}wcs_estimator_t;
+
+#define WCS_QUALITY_NTAU 4   //!< Allan deviation at tau0 * 2^k, k < WCS_QUALITY_NTAU
+#define WCS_QUALITY_NPHASE ((2 << (WCS_QUALITY_NTAU - 1)) + 1)
+
+#if MYNEWT_VAL(WCS_QUALITY_ENABLED)
+STATS_SECT_START(wcs_quality_stat_section)
+    STATS_SECT_ENTRY(adev_tau0)         // 1e-12
+    STATS_SECT_ENTRY(adev_tau1)
+    STATS_SECT_ENTRY(adev_tau2)
+    STATS_SECT_ENTRY(adev_tau3)
+    STATS_SECT_ENTRY(innovation_rms)    // ps
+    STATS_SECT_ENTRY(sync_error)        // ps
+    STATS_SECT_ENTRY(gaps)
+STATS_SECT_END
+#endif
+
+//! Clock quality of the local clock against the master, see wcs_quality.c
+typedef struct _wcs_quality_t{
+#if MYNEWT_VAL(WCS_QUALITY_ENABLED)
+    STATS_SECT_DECL(wcs_quality_stat_section) stat;
+#endif
+    int64_t phase[WCS_QUALITY_NPHASE];  //!< Ring of local less master elapsed time (dtu)
+    uint16_t head;                      //!< Latest phase sample
+    uint16_t nphase;                    //!< Consecutive epochs in the ring
+    uint16_t model_valid:1;             //!< Previous epoch left a valid model to predict from
+    uint64_t prev_master;               //!< Master timestamp of the previous epoch
+    uint64_t tau0;                      //!< Master epoch spacing (dtu)
+    float avar[WCS_QUALITY_NTAU];       //!< Mean squared second difference of phase (dtu^2)
+    uint32_t navar[WCS_QUALITY_NTAU];
+    float innovation_mean;              //!< Master epoch less model prediction (dtu)
+    float innovation_var;               //!< (dtu^2)
+    uint32_t ninnovation;
+    float adev[WCS_QUALITY_NTAU];       //!< Overlapping Allan deviation at tau0 * 2^k
+    float sync_error;                   //!< Predicted rms sync error at the next epoch, less the epoch timestamp noise (dtu)
+}wcs_quality_t;
+
 typedef struct _wcs_instance_t{
     wcs_status_t status;
     wcs_control_t control;
@@ -56,9 +117,18 @@ typedef struct _wcs_instance_t{
     ccp_timestamp_t master_epoch;
     ccp_timestamp_t local_epoch;
     double skew;
+    wcs_fixed_t fixed;                      //!< Recomputed in wcs_update_cb(), see wcs_local_to_master64()
+#if MYNEWT_VAL(WCS_FLOAT_ESTIMATOR)
+    wcs_estimator_t estimator;
+#endif
+#if MYNEWT_VAL(WCS_QUALITY_ENABLED)
+    wcs_quality_t quality;
+#endif
     struct os_event postprocess_ev;
     struct _dw1000_ccp_instance_t * ccp;
+#if !MYNEWT_VAL(WCS_FLOAT_ESTIMATOR)
     struct _timescale_instance_t * timescale;
+#endif
 }wcs_instance_t; 
 
 wcs_instance_t * wcs_init(wcs_instance_t * inst, dw1000_ccp_instance_t * ccp);
@@ -79,8 +149,17 @@ uint32_t wcs_read_rxtime_lo_master(struct _dw1000_dev_instance_t * inst);
 uint64_t wcs_read_txtime_master(struct _dw1000_dev_instance_t * inst);
 uint32_t wcs_read_txtime_lo_master(struct _dw1000_dev_instance_t * inst);
 
+void wcs_estimator_init(wcs_estimator_t * est, uint64_t time, float rate);
+bool wcs_estimator_update(wcs_estimator_t * est, uint64_t interval, uint64_t master_lo40);
+
+void wcs_quality_init(struct _wcs_instance_t * wcs);
+void wcs_quality_reset(wcs_quality_t * quality);
+void wcs_quality_update(struct _wcs_instance_t * wcs);
+float wcs_quality_time_error(wcs_quality_t * quality, uint16_t epochs);
+
 double wcs_dtu_time_correction(struct _wcs_instance_t * wcs);
 uint64_t wcs_dtu_time_adjust(struct _wcs_instance_t * wcs, uint64_t dtu_time);
+uint64_t wcs_dtu_interval_to_local(struct _wcs_instance_t * wcs, uint64_t dtu_interval);
 uint64_t wcs_local_to_master64(struct _wcs_instance_t * wcs, uint64_t dtu_time);
 uint64_t wcs_local_to_master(struct _wcs_instance_t * wcs, uint64_t dtu_time);
 
@@ -22,6 +22,7 @@
 /**
  * @file wcs.c
  * @author Paul.Kettle@decawave.com
+ * @author agent <agent@local>
  * @date Oct 20 2018
  * @brief Wireless Clock Synchronization
  *
@@ -52,7 +53,12 @@
 #include <dw1000/dw1000_ftypes.h>
 #include <ccp/ccp.h>
 #include <wcs/wcs.h>
+#if !MYNEWT_VAL(WCS_FLOAT_ESTIMATOR)
 #include <timescale/timescale.h>
+#endif
+#if MYNEWT_VAL(TELEMETRY_ENABLED)
+#include <telemetry/telemetry.h>
+#endif
 
 #if MYNEWT_VAL(WCS_ENABLED)
 
@@ -67,9 +73,11 @@
 
 static void wcs_postprocess(struct os_event * ev);
 
+#if !MYNEWT_VAL(WCS_FLOAT_ESTIMATOR)
 static const double g_x0[TIMESCALE_N] = {0};
 static const double g_q[] = { MYNEWT_VAL(TIMESCALE_QVAR) * 1.0l, MYNEWT_VAL(TIMESCALE_QVAR) * 0.1l, MYNEWT_VAL(TIMESCALE_QVAR) * 0.01l};
 static const double g_T = 1e-6l * MYNEWT_VAL(CCP_PERIOD);  // peroid in sec
+#endif
 
 /*! 
  * @fn wcs_init(wcs_instance_t * inst,  dw1000_ccp_instance_t * ccp)
@@ -97,9 +105,16 @@ wcs_init(wcs_instance_t * inst, dw1000_ccp_instance_t * ccp){
     }
     inst->ccp = ccp;    
 
+#if MYNEWT_VAL(WCS_FLOAT_ESTIMATOR)
+    inst->estimator.initialized = 0;
+#else
     inst->timescale = timescale_init(NULL, g_x0, g_q, g_T);
     inst->timescale->status.initialized = 0; //Ignore X0 values, until we get first event
+#endif
     inst->status.initialized = 0;
+#if MYNEWT_VAL(WCS_QUALITY_ENABLED)
+    wcs_quality_init(inst);
+#endif
 
     wcs_set_postprocess(inst, &wcs_postprocess);      // Using default process
 
@@ -121,7 +136,9 @@ wcs_init(wcs_instance_t * inst, dw1000_ccp_instance_t * ccp){
 void 
 wcs_free(wcs_instance_t * inst){
     assert(inst);  
+#if !MYNEWT_VAL(WCS_FLOAT_ESTIMATOR)
     timescale_free(inst->timescale);
+#endif
     if (inst->status.selfmalloc)
         free(inst);
     else
@@ -129,6 +146,46 @@ wcs_free(wcs_instance_t * inst){
 }
 
 
+/*! 
+ * @fn wcs_fixed_update(wcs_instance_t * wcs)
+ *
+ * @brief Precompute the local to master mapping of the new epoch. The timescale model is sampled at the epoch and
+ * one CCP period later, and the chord through both points is kept as a fixed point offset and slope. Within the
+ * period the chord departs from the model by at most drift * T^2 / 8. The pair is swapped atomically as the
+ * conversions run from interrupt context.
+ *
+ * input parameters
+ * @param wcs - wcs_instance_t *
+ *
+ * returns none
+ */
+static void
+wcs_fixed_update(wcs_instance_t * wcs){
+    wcs_fixed_t fixed = {
+        .local_epoch = wcs->local_epoch.lo,
+        .master_hi = wcs->master_epoch.timestamp & 0xFFFFFF0000000000UL,
+        .offset = wcs->master_epoch.lo,
+        .slope = 0
+    };
+#if MYNEWT_VAL(WCS_FLOAT_ESTIMATOR)
+    if (wcs->status.valid) {
+        fixed.offset = wcs->estimator.time;
+        fixed.slope = (int64_t) roundf(wcs->estimator.rate * (float)(1ULL << WCS_FIXED_SHIFT));
+    }
+#else
+    if (wcs->status.valid) {
+        double offset = timescale_forward(wcs->timescale, 0);
+        double slope = (timescale_forward(wcs->timescale, g_T) - offset) / (g_T * WCS_DTU);
+        fixed.offset = (int64_t) round(offset);
+        fixed.slope = (int64_t) round((slope - 1.0l) * (double)(1ULL << WCS_FIXED_SHIFT));
+    }
+#endif
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    wcs->fixed = fixed;
+    OS_EXIT_CRITICAL(sr);
+}
+
 /*! 
  * @fn clkcal_update_cb(struct os_event * ev)
  *
@@ -147,8 +204,12 @@ void wcs_update_cb(struct os_event * ev){
     assert(ev->ev_arg != NULL);
     dw1000_ccp_instance_t * ccp = (dw1000_ccp_instance_t *)ev->ev_arg;
     wcs_instance_t * wcs = ccp->wcs;
+#if MYNEWT_VAL(WCS_FLOAT_ESTIMATOR)
+    wcs_estimator_t * estimator = &wcs->estimator;
+#else
     timescale_instance_t * timescale = wcs->timescale;
     timescale_states_t * states = (timescale_states_t *) (timescale->eke->x);
+#endif
 
     DIAGMSG("{\"utime\": %lu,\"msg\": \"wcs_update_cb\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
 
@@ -158,7 +219,23 @@ void wcs_update_cb(struct os_event * ev){
         wcs->observed_interval = (ccp->local_epoch - wcs->local_epoch.lo) & 0x0FFFFFFFFFFUL; // Observed ccp interval        
         wcs->master_epoch.timestamp = ccp->master_epoch.timestamp; 
         wcs->local_epoch.timestamp += wcs->observed_interval;
+#if MYNEWT_VAL(WCS_QUALITY_ENABLED)
+        if (wcs->status.initialized == 0)
+            wcs_quality_reset(&wcs->quality);
+#endif
+
+#if MYNEWT_VAL(WCS_FLOAT_ESTIMATOR)
+        if (wcs->status.initialized == 0){
+            wcs_estimator_init(estimator, wcs->master_epoch.lo, dw1000_calc_clock_offset_ratio(ccp->parent, frame->carrier_integrator));
+            wcs->status.valid = wcs->status.initialized = 1;
+        }else{
+            wcs->status.valid = wcs_estimator_update(estimator, wcs->observed_interval, wcs->master_epoch.lo);
+        }
 
+        // A restarted filter keeps its rate. Dropping the skew would shift the next relayed epoch by the
+        // repeat delay times the crystal offset, which the filter takes for a rate error and restarts again
+        wcs->skew = - estimator->rate;
+#else
         if (wcs->status.initialized == 0){
             timescale = timescale_init(timescale, g_x0, g_q, g_T);
             /* Update pointer in case realloc happens in timescale_init */
@@ -181,6 +258,11 @@ void wcs_update_cb(struct os_event * ev){
             wcs->skew = 1.0l - states->skew / WCS_DTU;
         else
             wcs->skew = 0.0l;
+#endif
+#if MYNEWT_VAL(WCS_QUALITY_ENABLED)
+        wcs_quality_update(wcs);
+#endif
+        wcs_fixed_update(wcs);
 
         if(wcs->config.postprocess == true)
             os_eventq_put(os_eventq_dflt_get(), &wcs->postprocess_ev);
@@ -191,7 +273,8 @@ void wcs_update_cb(struct os_event * ev){
 /*! 
  * @fn wcs_postprocess(struct os_event * ev)
  *
- * @brief This function serves as a placeholder for timescale processing and by default creates json string for the event
+ * @brief This function serves as a placeholder for timescale processing and by default creates json string for the event.
+ * With TELEMETRY_ENABLED the wcs and clock quality records are written whether or not WCS_VERBOSE is set.
  *
  * input parameters
  * @param inst - struct os_event *  
@@ -205,19 +288,55 @@ wcs_postprocess(struct os_event * ev){
     assert(ev != NULL);
     assert(ev->ev_arg != NULL);
 
-#if MYNEWT_VAL(WCS_VERBOSE)
+#if MYNEWT_VAL(WCS_VERBOSE) || MYNEWT_VAL(TELEMETRY_ENABLED)
     wcs_instance_t * wcs = (wcs_instance_t *) ev->ev_arg;
+#if MYNEWT_VAL(WCS_FLOAT_ESTIMATOR)
+    uint64_t time = wcs->estimator.time;
+#else
     timescale_instance_t * timescale = wcs->timescale; 
     timescale_states_t * x = (timescale_states_t *) (timescale->eke->x); 
+    uint64_t time = x->time;
+#endif
 
+#if MYNEWT_VAL(TELEMETRY_ENABLED)
+    telemetry_wcs_t record = {
+        .master_epoch = wcs->master_epoch.timestamp,
+        .local_master = wcs_local_to_master(wcs, wcs->local_epoch.lo),
+        .local_epoch = wcs->local_epoch.timestamp,
+        .time = time,
+        .skew = wcs->skew
+    };
+    telemetry_write(TELEMETRY_WCS, &record, sizeof(record));
+#if MYNEWT_VAL(WCS_QUALITY_ENABLED)
+    telemetry_wcs_quality_t quality = {
+        .tau0 = wcs->quality.tau0,
+        .adev = {wcs->quality.adev[0], wcs->quality.adev[1], wcs->quality.adev[2], wcs->quality.adev[3]},
+        .innovation_mean = wcs->quality.innovation_mean,
+        .innovation_rms = sqrtf(wcs->quality.innovation_var),
+        .sync_error = wcs->quality.sync_error
+    };
+    telemetry_write(TELEMETRY_WCS_QUALITY, &quality, sizeof(quality));
+#endif
+#elif MYNEWT_VAL(WCS_VERBOSE)
     printf("{\"utime\": %lu,\"wcs\": [%llu,%llu,%llu,%llu],\"skew\": %llu}\n",
         os_cputime_ticks_to_usecs(os_cputime_get32()),
         (uint64_t) wcs->master_epoch.timestamp,
         (uint64_t) wcs_local_to_master(wcs, wcs->local_epoch.lo),
         (uint64_t) wcs->local_epoch.timestamp,
-        (uint64_t) x->time,
+        time,
        *(uint64_t *)&(wcs->skew)
     );
+#if MYNEWT_VAL(WCS_QUALITY_ENABLED)
+    printf("{\"utime\": %lu,\"wcs_quality\": [%lu,%lu,%lu,%lu],\"sync_error\": %lu}\n",
+        os_cputime_ticks_to_usecs(os_cputime_get32()),
+        *(uint32_t *)&(wcs->quality.adev[0]),
+        *(uint32_t *)&(wcs->quality.adev[1]),
+        *(uint32_t *)&(wcs->quality.adev[2]),
+        *(uint32_t *)&(wcs->quality.adev[3]),
+        *(uint32_t *)&(wcs->quality.sync_error)
+    );
+#endif
+#endif
 #endif
 }
 
@@ -256,22 +375,44 @@ inline uint64_t wcs_dtu_time_adjust(struct _wcs_instance_t * wcs, uint64_t dtu_t
     return dtu_time & 0x00FFFFFFFFFFUL;
 }
 
+/**
+ * API to convert an interval of the master clock to the local clock, the inverse of wcs_dtu_time_adjust().
+ * Local schedules derived from the master period use this, so they follow the same clock model as the
+ * timestamps mapped to the master.
+ *
+ * @param wcs  Pointer to _wcs_instance_t.
+ * @param dtu_interval uint64_t master interval in decawave transeiver units of time (dtu)
+ *
+ * @return local interval
+ */
+inline uint64_t wcs_dtu_interval_to_local(struct _wcs_instance_t * wcs, uint64_t dtu_interval){
+
+    if (wcs->status.valid)
+       dtu_interval = (uint64_t) roundl(dtu_interval / wcs_dtu_time_correction(wcs));
+
+    return dtu_interval & 0x00FFFFFFFFFFUL;
+}
 
 inline double wcs_dtu_time_correction(struct _wcs_instance_t * wcs){
     assert(wcs);
 
-    timescale_states_t * x = (timescale_states_t *) (wcs->timescale->eke->x);
-
     double correction = 1.0l;
+#if MYNEWT_VAL(WCS_FLOAT_ESTIMATOR)
+    if (wcs->status.valid)
+       correction = 1.0l + wcs->estimator.rate;
+#else
+    timescale_states_t * x = (timescale_states_t *) (wcs->timescale->eke->x);
     if (wcs->status.valid)
        correction = (double) x->skew / WCS_DTU;
+#endif
 
     return correction;
 }
 
 
 /**
- * API compensate for clock skew and offset relative to master clock
+ * API compensate for clock skew and offset relative to master clock. Evaluates the mapping precomputed
+ * for the current epoch with a multiply-shift-add, see wcs_fixed_update().
  *
  * @param wcs pointer to wcs_instance_t
  * @param dtu_time local observed timestamp
@@ -279,19 +420,18 @@ inline double wcs_dtu_time_correction(struct _wcs_instance_t * wcs){
  * 
  */
 uint64_t wcs_local_to_master64(wcs_instance_t * wcs, uint64_t dtu_time){
-    timescale_instance_t * timescale = wcs->timescale; 
-
-    double delta = ((dtu_time & 0x0FFFFFFFFFFUL) - wcs->local_epoch.lo) & 0x0FFFFFFFFFFUL;
-    uint64_t master_lo40;
-    if (wcs->status.valid) {
-        /* No need to take special care of 40bit overflow as the timescale forward returns 
-         * a double value that can exceed the 40bit. */
-        master_lo40 = (uint64_t) round(timescale_forward(timescale, delta / WCS_DTU));
-    } else {
-        master_lo40 = wcs->master_epoch.lo + delta;
-    }
-
-    return (wcs->master_epoch.timestamp & 0xFFFFFF0000000000UL) + master_lo40;
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    wcs_fixed_t fixed = wcs->fixed;
+    OS_EXIT_CRITICAL(sr);
+
+    uint64_t delta = ((dtu_time & 0x0FFFFFFFFFFUL) - fixed.local_epoch) & 0x0FFFFFFFFFFUL;
+    /* Split delta so that neither product overflows 64 bits, the offset may exceed 40 bits
+     * without special care of the 40bit overflow. */
+    int64_t correction = (((int64_t)(delta >> 16) * fixed.slope) >> (WCS_FIXED_SHIFT - 16))
+                        + (((int64_t)(delta & 0xFFFF) * fixed.slope) >> WCS_FIXED_SHIFT);
+
+    return fixed.master_hi + (uint64_t)(fixed.offset + (int64_t)delta + correction);
 }
 
 /**
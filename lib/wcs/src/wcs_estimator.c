@@ -0,0 +1,139 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ * 
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file wcs_estimator.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Single precision clock estimator
+ *
+ * @details Alternative to the double precision timescale filter for targets without a double precision FPU.
+ * The filter tracks the master clock as an offset and a rate against the local clock. Absolute times never
+ * enter floating point: the master time is held as an integer and propagated exactly by the local interval,
+ * while floats carry only the rate deviation from 1, of order 1e-5, and the epoch residual, of order a few dtu.
+ * Over an epoch the rate uncertainty grows the offset variance to ~1e11 dtu^2 against a timestamp variance
+ * of ~1e2, beyond single precision, so the covariance is carried in U D U' factors: prediction and update
+ * (Thornton and Bierman for the 2x2 case) only ever add positive terms or scale them, and P never
+ * loses its rate information to cancellation.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <os/os.h>
+
+// Built with every wcs configuration so that lib/wcs/test can run it next to the timescale filter,
+// the linker drops it when WCS_FLOAT_ESTIMATOR is off
+#if MYNEWT_VAL(WCS_ENABLED)
+#include <wcs/wcs.h>
+
+#define WCS_DTU ((float)MYNEWT_VAL(WCS_DTU))
+
+/*!
+ * @fn wcs_estimator_init(wcs_estimator_t * est, uint64_t time, float rate)
+ *
+ * @brief Restart the filter at the first epoch.
+ *
+ * input parameters
+ * @param est - wcs_estimator_t *
+ * @param time - master 40 bit time of the epoch
+ * @param rate - initial master over local rate less 1, i.e. from the carrier integrator
+ *
+ * returns none
+ */
+void
+wcs_estimator_init(wcs_estimator_t * est, uint64_t time, float rate){
+    est->time = time;
+    est->rate = rate;
+    est->u = 0.0f;
+    est->d[0] = MYNEWT_VAL(WCS_FLOAT_RVAR);
+    est->d[1] = 1e-10f;     // (10ppm)^2
+    est->initialized = 1;
+    est->valid = 0;
+    est->rejects = 0;
+}
+
+/*!
+ * @fn wcs_estimator_update(wcs_estimator_t * est, uint64_t interval, uint64_t master_lo40)
+ *
+ * @brief Propagate the filter by the local interval to the new epoch and fuse its master timestamp.
+ * Epochs failing the innovation gate are bridged by the prediction, three in a row restart the filter.
+ *
+ * input parameters
+ * @param est - wcs_estimator_t *
+ * @param interval - local dtu elapsed since the previous epoch
+ * @param master_lo40 - master 40 bit time of the new epoch
+ *
+ * returns true once the estimate is valid
+ */
+bool
+wcs_estimator_update(wcs_estimator_t * est, uint64_t interval, uint64_t master_lo40){
+
+    // Predict, the integer part of the interval is propagated exactly
+    float dt = (float) interval;
+    float T = dt / WCS_DTU;
+    est->time += interval + (int64_t) roundf(dt * est->rate);
+
+    // Add the process noise, itself factored as u = dt/2, d0 = qtime T + q dt^2/12, d1 = q
+    float q = MYNEWT_VAL(WCS_FLOAT_QRATE) * T;
+    float uq = dt / 2.0f;
+    float u = est->u + dt;
+    float d1 = est->d[1] + q;
+    est->d[0] += MYNEWT_VAL(WCS_FLOAT_QTIME) * T + q * dt * dt / 12.0f
+              + (est->d[1] * q / d1) * (u - uq) * (u - uq);
+    est->u = (est->d[1] * u + q * uq) / d1;
+    est->d[1] = d1;
+
+    // Residual is small, 40 bit wrap is taken care of in integer arithmetic
+    int64_t residual = (int64_t)(((master_lo40 - est->time) & 0x0FFFFFFFFFFUL) << 24) >> 24;
+    float y = (float) residual;
+    float a0 = MYNEWT_VAL(WCS_FLOAT_RVAR) + est->d[0];
+    float S = a0 + est->u * est->u * est->d[1];
+
+    if (y * y > MYNEWT_VAL(WCS_FLOAT_GATE) * S) {
+        est->time &= 0x0FFFFFFFFFFUL;
+        if (++est->rejects >= 3)
+            wcs_estimator_init(est, master_lo40, est->rate);
+        return est->valid;
+    }
+    est->rejects = 0;
+
+    // K = [P00 P01] / S
+    float K0 = (est->d[0] + est->u * est->u * est->d[1]) / S;
+    float K1 = est->u * est->d[1] / S;
+    est->time = (est->time + (int64_t) roundf(K0 * y)) & 0x0FFFFFFFFFFUL;
+    est->rate += K1 * y;
+
+    // Bierman update for H = [1 0], every factor is scaled by a ratio of positive sums
+    est->d[0] *= MYNEWT_VAL(WCS_FLOAT_RVAR) / a0;
+    est->d[1] *= a0 / S;
+    est->u *= MYNEWT_VAL(WCS_FLOAT_RVAR) / a0;
+    if (est->d[0] < 1e-3f)
+        est->d[0] = 1e-3f;
+    if (est->d[1] < 1e-24f)
+        est->d[1] = 1e-24f;
+
+    est->valid = 1;
+    return est->valid;
+}
+
+#endif
@@ -0,0 +1,207 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ * 
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file wcs_quality.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Clock quality metrics
+ *
+ * @details Incremental, fixed memory clock quality estimates updated once per ccp epoch. The phase x, the local
+ * less the master elapsed time, is kept for the last 2 * 2^(WCS_QUALITY_NTAU-1) epochs. The overlapping Allan
+ * variance at tau = m * tau0 is the mean of (x[n] - 2x[n-m] + x[n-2m])^2 / (2 tau^2), where every new epoch
+ * contributes one overlapping term per tau. A missed epoch breaks the phase record, which then restarts while
+ * the averages carry on. The innovation is the master epoch less its prediction by the model of the previous
+ * epoch at the local timestamp of the epoch. Its variance is that of the model plus that of the timestamp,
+ * MYNEWT_VAL(WCS_QUALITY_RVAR). The predicted sync error of the next epoch is the rms innovation with the
+ * timestamp variance taken out. Averages are running means over the first WCS_QUALITY_WINDOW samples and
+ * exponential thereafter. The stats register as "wcsq", or "wcsq0" and "wcsq1" with two devices.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <os/os.h>
+
+#if MYNEWT_VAL(WCS_ENABLED) && MYNEWT_VAL(WCS_QUALITY_ENABLED)
+#include <stats/stats.h>
+#include <wcs/wcs.h>
+
+#define WCS_DTU_PS (1e12f / (float)MYNEWT_VAL(WCS_DTU_SI))
+
+STATS_NAME_START(wcs_quality_stat_section)
+    STATS_NAME(wcs_quality_stat_section, adev_tau0)
+    STATS_NAME(wcs_quality_stat_section, adev_tau1)
+    STATS_NAME(wcs_quality_stat_section, adev_tau2)
+    STATS_NAME(wcs_quality_stat_section, adev_tau3)
+    STATS_NAME(wcs_quality_stat_section, innovation_rms)
+    STATS_NAME(wcs_quality_stat_section, sync_error)
+    STATS_NAME(wcs_quality_stat_section, gaps)
+STATS_NAME_END(wcs_quality_stat_section)
+
+static uint32_t
+window(uint32_t * n){
+    if (*n < MYNEWT_VAL(WCS_QUALITY_WINDOW))
+        (*n)++;
+    return *n;
+}
+
+/*!
+ * @fn wcs_quality_reset(wcs_quality_t * quality)
+ *
+ * @brief Forget all history, i.e. on a change of master.
+ *
+ * input parameters
+ * @param quality - wcs_quality_t *
+ *
+ * returns none
+ */
+void
+wcs_quality_reset(wcs_quality_t * quality){
+    size_t offset = offsetof(wcs_quality_t, phase);
+    memset((uint8_t *) quality + offset, 0, sizeof(wcs_quality_t) - offset);
+}
+
+/*!
+ * @fn wcs_quality_init(wcs_instance_t * wcs)
+ *
+ * @brief Reset the estimates and register the wcs_quality stats.
+ *
+ * input parameters
+ * @param wcs - wcs_instance_t *
+ *
+ * returns none
+ */
+void
+wcs_quality_init(struct _wcs_instance_t * wcs){
+
+    wcs_quality_reset(&wcs->quality);
+
+    int rc = stats_init(
+                STATS_HDR(wcs->quality.stat),
+                STATS_SIZE_INIT_PARMS(wcs->quality.stat, STATS_SIZE_32),
+                STATS_NAME_INIT_PARMS(wcs_quality_stat_section)
+            );
+    assert(rc == 0);
+
+#if  MYNEWT_VAL(DW1000_DEVICE_0) && !MYNEWT_VAL(DW1000_DEVICE_1)
+    rc = stats_register("wcsq", STATS_HDR(wcs->quality.stat));
+#elif  MYNEWT_VAL(DW1000_DEVICE_0) && MYNEWT_VAL(DW1000_DEVICE_1)
+    if (wcs->ccp->parent->idx == 0)
+        rc |= stats_register("wcsq0", STATS_HDR(wcs->quality.stat));
+    else
+        rc |= stats_register("wcsq1", STATS_HDR(wcs->quality.stat));
+#endif
+    assert(rc == 0);
+}
+
+/*!
+ * @fn wcs_quality_update(wcs_instance_t * wcs)
+ *
+ * @brief Fold the current epoch into the estimates. Called from wcs_update_cb() once the new epoch is
+ * known and before the local to master model is recomputed, so the innovation is taken against the
+ * prediction of the previous epoch.
+ *
+ * input parameters
+ * @param wcs - wcs_instance_t *
+ *
+ * returns none
+ */
+void
+wcs_quality_update(struct _wcs_instance_t * wcs){
+
+    wcs_quality_t * q = &wcs->quality;
+    uint64_t master = wcs->master_epoch.timestamp;
+    uint64_t tau0 = master - q->prev_master;
+
+    // A missed epoch, or the first one, restarts the phase record
+    if (q->prev_master == 0 || (q->tau0 && (tau0 > q->tau0 + (q->tau0 >> 6) || tau0 + (q->tau0 >> 6) < q->tau0))) {
+        if (q->nphase)
+            STATS_INC(q->stat, gaps);
+        q->nphase = 0;
+    }
+    int64_t x = 0;
+    if (q->nphase)
+        x = q->phase[q->head] + (int64_t)(wcs->observed_interval - tau0);
+    q->tau0 = (q->prev_master) ? tau0 : 0;
+    q->prev_master = master;
+    q->head = (q->head + 1) % WCS_QUALITY_NPHASE;
+    q->phase[q->head] = x;
+    if (q->nphase < WCS_QUALITY_NPHASE)
+        q->nphase++;
+
+    for (uint16_t k = 0; k < WCS_QUALITY_NTAU; k++) {
+        uint16_t m = 1 << k;
+        if (q->nphase <= 2 * m)
+            break;
+        int64_t xm = q->phase[(q->head + WCS_QUALITY_NPHASE - m) % WCS_QUALITY_NPHASE];
+        int64_t x2m = q->phase[(q->head + WCS_QUALITY_NPHASE - 2 * m) % WCS_QUALITY_NPHASE];
+        float d = (float)(x - 2 * xm + x2m);
+        q->avar[k] += (d * d - q->avar[k]) / window(&q->navar[k]);
+        float tau = (float) m * (float) q->tau0;
+        q->adev[k] = sqrtf(q->avar[k] / 2.0f) / tau;
+    }
+
+    if (q->model_valid) {
+        uint64_t predicted = wcs_local_to_master64(wcs, wcs->local_epoch.lo);
+        int64_t innovation = (int64_t)(((master - predicted) & 0x0FFFFFFFFFFUL) << 24) >> 24;
+        float dy = (float) innovation - q->innovation_mean;
+        uint32_t n = window(&q->ninnovation);
+        q->innovation_mean += dy / n;
+        q->innovation_var += (dy * ((float) innovation - q->innovation_mean) - q->innovation_var) / n;
+        float var = q->innovation_var - MYNEWT_VAL(WCS_QUALITY_RVAR);
+        q->sync_error = sqrtf(q->innovation_mean * q->innovation_mean + ((var > 0) ? var : 0));
+    }
+    q->model_valid = wcs->status.valid;
+
+    STATS_SET(q->stat, adev_tau0, (uint32_t)(q->adev[0] * 1e12f));
+    STATS_SET(q->stat, adev_tau1, (uint32_t)(q->adev[1] * 1e12f));
+    STATS_SET(q->stat, adev_tau2, (uint32_t)(q->adev[2] * 1e12f));
+    STATS_SET(q->stat, adev_tau3, (uint32_t)(q->adev[3] * 1e12f));
+    STATS_SET(q->stat, innovation_rms, (uint32_t)(sqrtf(q->innovation_var) * WCS_DTU_PS));
+    STATS_SET(q->stat, sync_error, (uint32_t)(q->sync_error * WCS_DTU_PS));
+}
+
+/*!
+ * @fn wcs_quality_time_error(wcs_quality_t * quality, uint16_t epochs)
+ *
+ * @brief Predicted rms time error after free running for a number of epochs, i.e. to size guard times.
+ * Combines the sync error with tau * adev(tau) at the smallest tracked tau covering the interval.
+ *
+ * input parameters
+ * @param quality - wcs_quality_t *
+ * @param epochs - epochs since the last update, 1 for the next epoch
+ *
+ * returns time error (dtu)
+ */
+float
+wcs_quality_time_error(wcs_quality_t * quality, uint16_t epochs){
+
+    uint16_t k = 0;
+    while (k < WCS_QUALITY_NTAU - 1 && (1 << k) < epochs)
+        k++;
+    float drift = quality->adev[k] * (float) epochs * (float) quality->tau0;
+    return sqrtf(quality->sync_error * quality->sync_error + drift * drift);
+}
+
+#endif
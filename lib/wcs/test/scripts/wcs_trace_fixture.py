@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+#
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#  http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+#
+
+"""Turn a recorded CCP trace into the wcs_test_trace.c fixture replayed by
+lib/wcs/test.
+
+The input is the WCS_VERBOSE json lines of one slave, as printed on its
+console or as telemetry_decode.py reproduces them from a telemetry capture.
+Other lines are skipped. Each epoch keeps the master and local epoch
+timestamps, the first two of the four "wcs" fields.
+
+    telemetry_decode.py capture.bin | wcs_trace_fixture.py -n 512 > ../src/wcs_test_trace.c
+"""
+
+import argparse
+import json
+import sys
+import textwrap
+
+HEADER = '''/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file wcs_test_trace.c
+ * @brief Recorded CCP trace, generated by scripts/wcs_trace_fixture.py
+ *
+ * @details %s
+ *
+ */
+
+#include "wcs_test.h"
+
+const wcs_test_record_t g_wcs_test_trace[] = {
+'''
+
+
+def records(stream):
+    for line in stream:
+        line = line.strip()
+        if '"wcs": [' not in line:
+            continue
+        try:
+            wcs = json.loads(line)['wcs']
+        except ValueError:
+            continue
+        yield wcs[0], wcs[2]
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Convert WCS_VERBOSE json lines to the lib/wcs/test trace fixture')
+    parser.add_argument('input', nargs='?', default='-', help='json lines file or - for stdin')
+    parser.add_argument('-n', '--epochs', type=int, default=0, help='keep at most this many epochs')
+    parser.add_argument('-d', '--details', default='Recorded on a CCP slave.', help='@details text of the fixture')
+    args = parser.parse_args()
+
+    stream = sys.stdin if args.input == '-' else open(args.input)
+    trace = list(records(stream))
+    if args.epochs:
+        trace = trace[:args.epochs]
+
+    out = sys.stdout
+    out.write(HEADER % '\n * '.join(textwrap.wrap(args.details, 108)))
+    for master, local in trace:
+        out.write('    {0x%014X, 0x%014X},\n' % (master, local))
+    out.write('};\n\nconst uint16_t g_wcs_test_trace_len = sizeof(g_wcs_test_trace) / sizeof(g_wcs_test_trace[0]);\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef _WCS_TEST_H
+#define _WCS_TEST_H
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sysinit/sysinit.h"
+#include "syscfg/syscfg.h"
+#include "os/os.h"
+#include "testutil/testutil.h"
+
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_hal.h>
+#include <ccp/ccp.h>
+#include <wcs/wcs.h>
+
+#define TEST_STACK_SIZE 4096
+#define TEST_PRIO 22
+extern os_stack_t test_stack[];
+extern struct os_task test_task;
+
+//! Synthetic CCP trace, master and slave clocks of one slave
+typedef struct _wcs_test_clock_t{
+    double t;                       //!< Master time of the epoch (s)
+    uint64_t master;                //!< Master timestamp of the epoch (dtu)
+    double local;                   //!< Slave time of the epoch (dtu), unbounded
+    uint64_t stamp;                 //!< Slave timestamp of the epoch, with noise (dtu)
+    double ppm;                     //!< Slave crystal offset at t = 0 (ppm)
+    double ramp;                    //!< Slave crystal temperature ramp (ppm/s)
+    double noise;                   //!< Standard deviation of the slave epoch timestamps (dtu)
+    uint32_t seed;                  //!< Noise generator state
+}wcs_test_clock_t;
+
+//! Recorded CCP epoch, see wcs_test_trace.c
+typedef struct _wcs_test_record_t{
+    uint64_t master;                //!< Master timestamp of the epoch (dtu)
+    uint64_t local;                 //!< Slave timestamp of the epoch (dtu)
+}wcs_test_record_t;
+
+extern const wcs_test_record_t g_wcs_test_trace[];
+extern const uint16_t g_wcs_test_trace_len;
+
+void wcs_test_clock_init(wcs_test_clock_t * clock, double ppm, double ramp, double noise);
+void wcs_test_advance(dw1000_ccp_instance_t * ccp, wcs_test_clock_t * clock);
+void wcs_test_epoch(dw1000_ccp_instance_t * ccp, wcs_test_clock_t * clock);
+void wcs_test_handler(void *arg);
+
+#endif /* _WCS_TEST_H */
@@ -0,0 +1,547 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file wcs_test_trace.c
+ * @brief Recorded CCP trace, generated by scripts/wcs_trace_fixture.py
+ *
+ * @details Slave 63 of the lib/netsim grid, 64 nodes 10 m apart with a 25 m range, two relays from the master, 2% frame
+ * loss, 8 dtu of timestamp noise. Its crystal is 7.2 ppm off and ramps by 0.0087 ppm/s from 120 s to 360 s. A
+ * hardware capture, WCS_VERBOSE console output or a decoded telemetry stream, converts the same way.
+ *
+ */
+
+#include "wcs_test.h"
+
+const wcs_test_record_t g_wcs_test_trace[] = {
+    {0x00011124B6FA50, 0x000050528A08A5},
+    {0x00012124B73A50, 0x0000605291DE65},
+    {0x00013124B77A50, 0x0000705299AD6E},
+    {0x00014124B7BA50, 0x00008052A1831F},
+    {0x00015124B7FA50, 0x00009052A958CC},
+    {0x00016124B83A50, 0x0000A052B12E6D},
+    {0x00017124B87A50, 0x0000B052B903FB},
+    {0x00018124B8BA50, 0x0000C052C0D9AB},
+    {0x00019124B8FA50, 0x0000D052C8AF6C},
+    {0x0001A124B93A50, 0x0000E052D08503},
+    {0x0001B124B97A50, 0x0000F052D85AAB},
+    {0x0001C124B9BA50, 0x00010052E03068},
+    {0x0001D124B9FA50, 0x00011052E80601},
+    {0x0001E124BA3A50, 0x00012052EFDBA2},
+    {0x0001F124BA7A50, 0x00013052F7B149},
+    {0x00020124BABA50, 0x00014052FF86FB},
+    {0x00021124BAFA50, 0x00015053075CBC},
+    {0x00022124BB3A50, 0x000160530F324E},
+    {0x00023124BB7A50, 0x000170531707EE},
+    {0x00024124BBBA50, 0x000180531EDDAE},
+    {0x00025124BBFA50, 0x0001905326B35C},
+    {0x00026124BC3A50, 0x0001A0532E8906},
+    {0x00027124BC7A50, 0x0001B053365E8B},
+    {0x00028124BCBA50, 0x0001C0533E3450},
+    {0x00029124BCFA50, 0x0001D0534609DC},
+    {0x0002A124BD3A50, 0x0001E0534DDF88},
+    {0x0002B124BD7A50, 0x0001F05355B549},
+    {0x0002C124BDBA50, 0x000200535D8AF0},
+    {0x0002D124BDFA50, 0x00021053656096},
+    {0x0002E124BE3A50, 0x000220536D364D},
+    {0x0002F124BE7A50, 0x00023053750BEE},
+    {0x00030124BEBA50, 0x000240537CE18D},
+    {0x00031124BEFA50, 0x0002505384B726},
+    {0x00032124BF3A50, 0x000260538C8CE7},
+    {0x00033124BF7A50, 0x0002705394628B},
+    {0x00034124BFBA50, 0x000280539C3845},
+    {0x00035124BFFA50, 0x00029053A40DDA},
+    {0x00036124C03A50, 0x0002A053ABE37B},
+    {0x00037124C07A50, 0x0002B053B3B930},
+    {0x00038124C0BA50, 0x0002C053BB8EDF},
+    {0x00039124C0FA50, 0x0002D053C36499},
+    {0x0003A124C13A50, 0x0002E053CB3A3A},
+    {0x0003B124C17A50, 0x0002F053D30FD8},
+    {0x0003C124C1BA50, 0x00030053DAE57C},
+    {0x0003D124C1FA50, 0x00031053E2BB2F},
+    {0x0003E124C23A50, 0x00032053EA90D7},
+    {0x0003F124C27A50, 0x00033053F26687},
+    {0x00040124C2BA50, 0x00034053FA3C1E},
+    {0x00041124C2FA50, 0x000350540211DF},
+    {0x00042124C33A50, 0x0003605409E780},
+    {0x00043124C37A50, 0x0003705411BD35},
+    {0x00044124C3BA50, 0x000380541992D3},
+    {0x00045124C3FA50, 0x0003905421687F},
+    {0x00046124C43A50, 0x0003A054293E27},
+    {0x00047124C47A50, 0x0003B0543113CF},
+    {0x00048124C4BA50, 0x0003C05438E96A},
+    {0x00049124C4FA50, 0x0003D05440BF12},
+    {0x0004A124C53A50, 0x0003E0544894DC},
+    {0x0004B124C57A50, 0x0003F054506A73},
+    {0x0004C124C5BA50, 0x0004005458400F},
+    {0x0004D124C5FA50, 0x000410546015B2},
+    {0x0004E124C63A50, 0x0004205467EB85},
+    {0x0004F124C67A50, 0x000430546FC112},
+    {0x00050124C6BA50, 0x000440547796D8},
+    {0x00051124C6FA50, 0x000450547F6C68},
+    {0x00052124C73A50, 0x00046054874209},
+    {0x00053124C77A50, 0x000470548F17B4},
+    {0x00054124C7BA50, 0x0004805496ED73},
+    {0x00055124C7FA50, 0x000490549EC2FD},
+    {0x00056124C83A50, 0x0004A054A698CA},
+    {0x00057124C87A50, 0x0004B054AE6E5E},
+    {0x00058124C8BA50, 0x0004C054B64416},
+    {0x00059124C8FA50, 0x0004D054BE19B0},
+    {0x0005A124C93A50, 0x0004E054C5EF5F},
+    {0x0005B124C97A50, 0x0004F054CDC50D},
+    {0x0005C124C9BA50, 0x00050054D59ABC},
+    {0x0005D124C9FA50, 0x00051054DD705C},
+    {0x0005E124CA3A50, 0x00052054E5460F},
+    {0x0005F124CA7A50, 0x00053054ED1BB3},
+    {0x00060124CABA50, 0x00054054F4F164},
+    {0x00061124CAFA50, 0x00055054FCC700},
+    {0x00062124CB3A50, 0x00056055049CB7},
+    {0x00063124CB7A50, 0x000570550C7252},
+    {0x00064124CBBA50, 0x000580551447F2},
+    {0x00065124CBFA50, 0x000590551C1DA2},
+    {0x00066124CC3A50, 0x0005A05523F34C},
+    {0x00067124CC7A50, 0x0005B0552BC8F4},
+    {0x00068124CCBA50, 0x0005C055339EA3},
+    {0x00069124CCFA50, 0x0005D0553B743C},
+    {0x0006A124CD3A50, 0x0005E0554349F9},
+    {0x0006B124CD7A50, 0x0005F0554B1F9D},
+    {0x0006C124CDBA50, 0x0006005552F53F},
+    {0x0006D124CDFA50, 0x000610555ACAE1},
+    {0x0006E124CE3A50, 0x0006205562A0A0},
+    {0x0006F124CE7A50, 0x000630556A764C},
+    {0x00070124CEBA50, 0x00064055724BF7},
+    {0x00071124CEFA50, 0x000650557A219D},
+    {0x00072124CF3A50, 0x0006605581F741},
+    {0x00073124CF7A50, 0x0006705589CCFA},
+    {0x00074124CFBA50, 0x0006805591A29E},
+    {0x00075124CFFA50, 0x0006905599782F},
+    {0x00076124D03A50, 0x0006A055A14DFB},
+    {0x00077124D07A50, 0x0006B055A92394},
+    {0x00078124D0BA50, 0x0006C055B0F949},
+    {0x00079124D0FA50, 0x0006D055B8CECF},
+    {0x0007A124D13A50, 0x0006E055C0A494},
+    {0x0007B124D17A50, 0x0006F055C87A47},
+    {0x0007C124D1BA50, 0x00070055D04FED},
+    {0x0007D124D1FA50, 0x00071055D8257E},
+    {0x0007E124D23A50, 0x00072055DFFB5F},
+    {0x0007F124D27A50, 0x00073055E7D349},
+    {0x00080124D2BA50, 0x00074055EFADE3},
+    {0x00081124D2FA50, 0x00075055F78AF1},
+    {0x00082124D33A50, 0x00076055FF6A61},
+    {0x00083124D37A50, 0x00077056074C56},
+    {0x00084124D3BA50, 0x000780560F30E5},
+    {0x00085124D3FA50, 0x000790561717F7},
+    {0x00086124D43A50, 0x0007A0561F015A},
+    {0x00087124D47A50, 0x0007B05626ED75},
+    {0x00088124D4BA50, 0x0007C0562EDBF8},
+    {0x00089124D4FA50, 0x0007D05636CD0B},
+    {0x0008A124D53A50, 0x0007E0563EC082},
+    {0x0008B124D57A50, 0x0007F05646B68F},
+    {0x0008C124D5BA50, 0x000800564EAF3E},
+    {0x0008D124D5FA50, 0x0008105656AA27},
+    {0x0008E124D63A50, 0x000820565EA7B2},
+    {0x0008F124D67A50, 0x0008305666A7DB},
+    {0x00090124D6BA50, 0x000840566EAA80},
+    {0x00091124D6FA50, 0x0008505676AF8A},
+    {0x00092124D73A50, 0x000860567EB72D},
+    {0x00093124D77A50, 0x0008705686C13E},
+    {0x00094124D7BA50, 0x000880568ECDEC},
+    {0x00095124D7FA50, 0x0008905696DD11},
+    {0x00096124D83A50, 0x0008A0569EEEAE},
+    {0x00097124D87A50, 0x0008B056A702CA},
+    {0x00098124D8BA50, 0x0008C056AF1965},
+    {0x00099124D8FA50, 0x0008D056B732B4},
+    {0x0009A124D93A50, 0x0008E056BF4E49},
+    {0x0009B124D97A50, 0x0008F056C76C71},
+    {0x0009C124D9BA50, 0x00090056CF8D18},
+    {0x0009D124D9FA50, 0x00091056D7B069},
+    {0x0009E124DA3A50, 0x00092056DFD605},
+    {0x0009F124DA7A50, 0x00093056E7FE3E},
+    {0x000A0124DABA50, 0x00094056F028F7},
+    {0x000A1124DAFA50, 0x00095056F85634},
+    {0x000A2124DB3A50, 0x000960570085DB},
+    {0x000A3124DB7A50, 0x0009705708B82A},
+    {0x000A4124DBBA50, 0x0009805710ECD9},
+    {0x000A5124DBFA50, 0x00099057192405},
+    {0x000A6124DC3A50, 0x0009A057215DE2},
+    {0x000A7124DC7A50, 0x0009B057299A1B},
+    {0x000A8124DCBA50, 0x0009C05731D8E5},
+    {0x000A9124DCFA50, 0x0009D0573A1A28},
+    {0x000AA124DD3A50, 0x0009E057425E0B},
+    {0x000AB124DD7A50, 0x0009F0574AA447},
+    {0x000AC124DDBA50, 0x000A005752ED1C},
+    {0x000AD124DDFA50, 0x000A10575B385C},
+    {0x000AE124DE3A50, 0x000A2057638636},
+    {0x000AF124DE7A50, 0x000A30576BD670},
+    {0x000B0124DEBA50, 0x000A405774295A},
+    {0x000B1124DEFA50, 0x000A50577C7E94},
+    {0x000B2124DF3A50, 0x000A605784D680},
+    {0x000B3124DF7A50, 0x000A70578D30D3},
+    {0x000B4124DFBA50, 0x000A8057958DA0},
+    {0x000B5124DFFA50, 0x000A90579DED0C},
+    {0x000B6124E03A50, 0x000AA057A64EE7},
+    {0x000B7124E07A50, 0x000AB057AEB342},
+    {0x000B8124E0BA50, 0x000AC057B71A2C},
+    {0x000B9124E0FA50, 0x000AD057BF838C},
+    {0x000BA124E13A50, 0x000AE057C7EF74},
+    {0x000BB124E17A50, 0x000AF057D05DDC},
+    {0x000BC124E1BA50, 0x000B0057D8CEBE},
+    {0x000BD124E1FA50, 0x000B1057E1423C},
+    {0x000BE124E23A50, 0x000B2057E9B827},
+    {0x000BF124E27A50, 0x000B3057F23092},
+    {0x000C0124E2BA50, 0x000B4057FAAB7A},
+    {0x000C1124E2FA50, 0x000B50580328EC},
+    {0x000C2124E33A50, 0x000B60580BA8F2},
+    {0x000C3124E37A50, 0x000B7058142B5A},
+    {0x000C4124E3BA50, 0x000B80581CB074},
+    {0x000C5124E3FA50, 0x000B90582537E1},
+    {0x000C6124E43A50, 0x000BA0582DC1DE},
+    {0x000C7124E47A50, 0x000BB058364E5E},
+    {0x000C8124E4BA50, 0x000BC0583EDD5A},
+    {0x000C9124E4FA50, 0x000BD058476ED5},
+    {0x000CA124E53A50, 0x000BE0585002C3},
+    {0x000CB124E57A50, 0x000BF05858996A},
+    {0x000CC124E5BA50, 0x000C005861326B},
+    {0x000CD124E5FA50, 0x000C105869CDF4},
+    {0x000CE124E63A50, 0x000C2058726C02},
+    {0x000CF124E67A50, 0x000C30587B0C85},
+    {0x000D0124E6BA50, 0x000C405883AF8B},
+    {0x000D1124E6FA50, 0x000C50588C5538},
+    {0x000D2124E73A50, 0x000C605894FD37},
+    {0x000D3124E77A50, 0x000C70589DA7CA},
+    {0x000D4124E7BA50, 0x000C8058A654EE},
+    {0x000D5124E7FA50, 0x000C9058AF048A},
+    {0x000D6124E83A50, 0x000CA058B7B6A4},
+    {0x000D7124E87A50, 0x000CB058C06B3A},
+    {0x000D8124E8BA50, 0x000CC058C92254},
+    {0x000D9124E8FA50, 0x000CD058D1DC0C},
+    {0x000DA124E93A50, 0x000CE058DA9822},
+    {0x000DB124E97A50, 0x000CF058E356B9},
+    {0x000DC124E9BA50, 0x000D0058EC17E6},
+    {0x000DD124E9FA50, 0x000D1058F4DB88},
+    {0x000DE124EA3A50, 0x000D2058FDA1B6},
+    {0x000DF124EA7A50, 0x000D3059066A65},
+    {0x000E0124EABA50, 0x000D40590F3590},
+    {0x000E1124EAFA50, 0x000D505918033E},
+    {0x000E2124EB3A50, 0x000D605920D386},
+    {0x000E3124EB7A50, 0x000D705929A620},
+    {0x000E4124EBBA50, 0x000D8059327B5C},
+    {0x000E5124EBFA50, 0x000D90593B5322},
+    {0x000E6124EC3A50, 0x000DA059442D3A},
+    {0x000E7124EC7A50, 0x000DB0594D09F3},
+    {0x000E8124ECBA50, 0x000DC05955E92B},
+    {0x000E9124ECFA50, 0x000DD0595ECAF7},
+    {0x000EA124ED3A50, 0x000DE05967AF48},
+    {0x000EB124ED7A50, 0x000DF0597095FD},
+    {0x000EC124EDBA50, 0x000E0059797F33},
+    {0x000ED124EDFA50, 0x000E1059826AEF},
+    {0x000EE124EE3A50, 0x000E20598B5944},
+    {0x000EF124EE7A50, 0x000E3059944A19},
+    {0x000F0124EEBA50, 0x000E40599D3D5D},
+    {0x000F1124EEFA50, 0x000E5059A6332B},
+    {0x000F2124EF3A50, 0x000E6059AF2B85},
+    {0x000F3124EF7A50, 0x000E7059B82651},
+    {0x000F4124EFBA50, 0x000E8059C1238E},
+    {0x000F5124EFFA50, 0x000E9059CA2375},
+    {0x000F6124F03A50, 0x000EA059D325B7},
+    {0x000F7124F07A50, 0x000EB059DC2A9E},
+    {0x000F8124F0BA50, 0x000EC059E531FB},
+    {0x000F9124F0FA50, 0x000ED059EE3BD6},
+    {0x000FA124F13A50, 0x000EE059F7482F},
+    {0x000FB124F17A50, 0x000EF05A00571B},
+    {0x000FC124F1BA50, 0x000F005A09688A},
+    {0x000FD124F1FA50, 0x000F105A127C6A},
+    {0x000FE124F23A50, 0x000F205A1B92CC},
+    {0x000FF124F27A50, 0x000F305A24AB9F},
+    {0x00100124F2BA50, 0x000F405A2DC707},
+    {0x00101124F2FA50, 0x000F505A36E4F8},
+    {0x00102124F33A50, 0x000F605A400579},
+    {0x00103124F37A50, 0x000F705A492869},
+    {0x00104124F3BA50, 0x000F805A524DD9},
+    {0x00105124F3FA50, 0x000F905A5B75B4},
+    {0x00106124F43A50, 0x000FA05A64A02D},
+    {0x00107124F47A50, 0x000FB05A6DCD10},
+    {0x00108124F4BA50, 0x000FC05A76FCA8},
+    {0x00109124F4FA50, 0x000FD05A802E91},
+    {0x0010A124F53A50, 0x000FE05A89630A},
+    {0x0010B124F57A50, 0x000FF05A929A13},
+    {0x0010C124F5BA50, 0x0010005A9BD3A2},
+    {0x0010D124F5FA50, 0x0010105AA50F8C},
+    {0x0010E124F63A50, 0x0010205AAE4E08},
+    {0x0010F124F67A50, 0x0010305AB78F17},
+    {0x00110124F6BA50, 0x0010405AC0D298},
+    {0x00111124F6FA50, 0x0010505ACA189B},
+    {0x00112124F73A50, 0x0010605AD36123},
+    {0x00113124F77A50, 0x0010705ADCAC44},
+    {0x00114124F7BA50, 0x0010805AE5F9E6},
+    {0x00115124F7FA50, 0x0010905AEF49DD},
+    {0x00116124F83A50, 0x0010A05AF89C76},
+    {0x00117124F87A50, 0x0010B05B01F172},
+    {0x00118124F8BA50, 0x0010C05B0B4911},
+    {0x00119124F8FA50, 0x0010D05B14A347},
+    {0x0011A124F93A50, 0x0010E05B1DFFCD},
+    {0x0011B124F97A50, 0x0010F05B275EE8},
+    {0x0011C124F9BA50, 0x0011005B30C098},
+    {0x0011D124F9FA50, 0x0011105B3A24AB},
+    {0x0011E124FA3A50, 0x0011205B438B40},
+    {0x0011F124FA7A50, 0x0011305B4CF466},
+    {0x00120124FABA50, 0x0011405B565FF9},
+    {0x00121124FAFA50, 0x0011505B5FCE36},
+    {0x00122124FB3A50, 0x0011605B693EDC},
+    {0x00123124FB7A50, 0x0011705B72B210},
+    {0x00124124FBBA50, 0x0011805B7C27AF},
+    {0x00125124FBFA50, 0x0011905B859FF7},
+    {0x00126124FC3A50, 0x0011A05B8F1A8F},
+    {0x00127124FC7A50, 0x0011B05B9897CC},
+    {0x00128124FCBA50, 0x0011C05BA2177C},
+    {0x00129124FCFA50, 0x0011D05BAB99B1},
+    {0x0012A124FD3A50, 0x0011E05BB51E62},
+    {0x0012B124FD7A50, 0x0011F05BBEA59B},
+    {0x0012C124FDBA50, 0x0012005BC82F57},
+    {0x0012D124FDFA50, 0x0012105BD1BB9F},
+    {0x0012E124FE3A50, 0x0012205BDB4A56},
+    {0x0012F124FE7A50, 0x0012305BE4DB8E},
+    {0x00130124FEBA50, 0x0012405BEE6F62},
+    {0x00131124FEFA50, 0x0012505BF805A6},
+    {0x00132124FF3A50, 0x0012605C019E77},
+    {0x00133124FF7A50, 0x0012705C0B39A7},
+    {0x00134124FFBA50, 0x0012805C14D779},
+    {0x00135124FFFA50, 0x0012905C1E77C2},
+    {0x00136125003A50, 0x0012A05C281A7A},
+    {0x00137125007A50, 0x0012B05C31BFE4},
+    {0x0013812500BA50, 0x0012C05C3B67A4},
+    {0x0013912500FA50, 0x0012D05C4511FF},
+    {0x0013A125013A50, 0x0012E05C4EBEDC},
+    {0x0013B125017A50, 0x0012F05C586E3A},
+    {0x0013C12501BA50, 0x0013005C62200D},
+    {0x0013D12501FA50, 0x0013105C6BD46C},
+    {0x0013E125023A50, 0x0013205C758B47},
+    {0x0013F125027A50, 0x0013305C7F448D},
+    {0x0014012502BA50, 0x0013405C89007B},
+    {0x0014112502FA50, 0x0013505C92BEE1},
+    {0x00142125033A50, 0x0013605C9C7FD9},
+    {0x00143125037A50, 0x0013705CA64329},
+    {0x0014412503BA50, 0x0013805CB00924},
+    {0x0014512503FA50, 0x0013905CB9D18E},
+    {0x00146125043A50, 0x0013A05CC39C72},
+    {0x00147125047A50, 0x0013B05CCD69E2},
+    {0x0014812504BA50, 0x0013C05CD739C8},
+    {0x0014912504FA50, 0x0013D05CE10C3E},
+    {0x0014A125053A50, 0x0013E05CEAE13A},
+    {0x0014B125057A50, 0x0013F05CF4B8BF},
+    {0x0014C12505BA50, 0x0014005CFE92A2},
+    {0x0014D12505FA50, 0x0014105D086F0D},
+    {0x0014E125063A50, 0x0014205D124E1F},
+    {0x0014F125067A50, 0x0014305D1C2F93},
+    {0x0015012506BA50, 0x0014405D261387},
+    {0x0015112506FA50, 0x0014505D2FFA15},
+    {0x00152125073A50, 0x0014605D39E31F},
+    {0x00153125077A50, 0x0014705D43CE7B},
+    {0x0015412507BA50, 0x0014805D4DBC95},
+    {0x0015512507FA50, 0x0014905D57AD47},
+    {0x00156125083A50, 0x0014A05D61A02C},
+    {0x00157125087A50, 0x0014B05D6B95CA},
+    {0x0015812508BA50, 0x0014C05D758DCE},
+    {0x0015912508FA50, 0x0014D05D7F884D},
+    {0x0015A125093A50, 0x0014E05D898579},
+    {0x0015B125097A50, 0x0014F05D9384FB},
+    {0x0015C12509BA50, 0x0015005D9D8712},
+    {0x0015D12509FA50, 0x0015105DA78B97},
+    {0x0015E1250A3A50, 0x0015205DB190C5},
+    {0x0015F1250A7A50, 0x0015305DBB95E8},
+    {0x001601250ABA50, 0x0015405DC59B13},
+    {0x001611250AFA50, 0x0015505DCFA03E},
+    {0x001621250B3A50, 0x0015605DD9A573},
+    {0x001631250B7A50, 0x0015705DE3AAAB},
+    {0x001641250BBA50, 0x0015805DEDAFD2},
+    {0x001651250BFA50, 0x0015905DF7B505},
+    {0x001661250C3A50, 0x0015A05E01BA3C},
+    {0x001671250C7A50, 0x0015B05E0BBF74},
+    {0x001681250CBA50, 0x0015C05E15C487},
+    {0x001691250CFA50, 0x0015D05E1FC9CA},
+    {0x0016A1250D3A50, 0x0015E05E29CEE7},
+    {0x0016B1250D7A50, 0x0015F05E33D428},
+    {0x0016C1250DBA50, 0x0016005E3DD963},
+    {0x0016D1250DFA50, 0x0016105E47DE97},
+    {0x0016E1250E3A50, 0x0016205E51E3BF},
+    {0x0016F1250E7A50, 0x0016305E5BE90B},
+    {0x001701250EBA50, 0x0016405E65EE23},
+    {0x001711250EFA50, 0x0016505E6FF351},
+    {0x001721250F3A50, 0x0016605E79F88D},
+    {0x001731250F7A50, 0x0016705E83FDB8},
+    {0x001741250FBA50, 0x0016805E8E02EB},
+    {0x001751250FFA50, 0x0016905E98083A},
+    {0x00176125103A50, 0x0016A05EA20D4E},
+    {0x00177125107A50, 0x0016B05EAC1289},
+    {0x0017812510BA50, 0x0016C05EB617A8},
+    {0x0017912510FA50, 0x0016D05EC01CE8},
+    {0x0017A125113A50, 0x0016E05ECA220C},
+    {0x0017B125117A50, 0x0016F05ED42743},
+    {0x0017C12511BA50, 0x0017005EDE2C7B},
+    {0x0017D12511FA50, 0x0017105EE831A2},
+    {0x0017E125123A50, 0x0017205EF236D0},
+    {0x0017F125127A50, 0x0017305EFC3C1B},
+    {0x0018012512BA50, 0x0017405F064141},
+    {0x0018112512FA50, 0x0017505F104665},
+    {0x00182125133A50, 0x0017605F1A4B9B},
+    {0x00183125137A50, 0x0017705F2450C0},
+    {0x0018412513BA50, 0x0017805F2E55E7},
+    {0x0018512513FA50, 0x0017905F385B2F},
+    {0x00186125143A50, 0x0017A05F42605A},
+    {0x00187125147A50, 0x0017B05F4C657F},
+    {0x0018812514BA50, 0x0017C05F566AB0},
+    {0x0018912514FA50, 0x0017D05F606FE2},
+    {0x0018A125153A50, 0x0017E05F6A7501},
+    {0x0018B125157A50, 0x0017F05F747A56},
+    {0x0018C12515BA50, 0x0018005F7E7F79},
+    {0x0018D12515FA50, 0x0018105F8884A2},
+    {0x0018E125163A50, 0x0018205F9289D7},
+    {0x0018F125167A50, 0x0018305F9C8F0C},
+    {0x0019012516BA50, 0x0018405FA6944C},
+    {0x0019112516FA50, 0x0018505FB09975},
+    {0x00192125173A50, 0x0018605FBA9EA7},
+    {0x00193125177A50, 0x0018705FC4A3CC},
+    {0x0019412517BA50, 0x0018805FCEA908},
+    {0x0019512517FA50, 0x0018905FD8AE4C},
+    {0x00196125183A50, 0x0018A05FE2B365},
+    {0x00197125187A50, 0x0018B05FECB87F},
+    {0x0019812518BA50, 0x0018C05FF6BDDE},
+    {0x0019912518FA50, 0x0018D06000C2F4},
+    {0x0019A125193A50, 0x0018E0600AC822},
+    {0x0019B125197A50, 0x0018F06014CD4E},
+    {0x0019C12519BA50, 0x001900601ED281},
+    {0x0019D12519FA50, 0x0019106028D7BC},
+    {0x0019E1251A3A50, 0x0019206032DCED},
+    {0x0019F1251A7A50, 0x001930603CE218},
+    {0x001A01251ABA50, 0x0019406046E741},
+    {0x001A11251AFA50, 0x0019506050EC69},
+    {0x001A21251B3A50, 0x001960605AF1AF},
+    {0x001A31251B7A50, 0x0019706064F6D9},
+    {0x001A41251BBA50, 0x001980606EFC17},
+    {0x001A51251BFA50, 0x00199060790121},
+    {0x001A61251C3A50, 0x0019A060830676},
+    {0x001A71251C7A50, 0x0019B0608D0B9B},
+    {0x001A81251CBA50, 0x0019C0609710C3},
+    {0x001A91251CFA50, 0x0019D060A1160E},
+    {0x001AA1251D3A50, 0x0019E060AB1B2A},
+    {0x001AB1251D7A50, 0x0019F060B52072},
+    {0x001AC1251DBA50, 0x001A0060BF258D},
+    {0x001AD1251DFA50, 0x001A1060C92AAC},
+    {0x001AE1251E3A50, 0x001A2060D32FE7},
+    {0x001AF1251E7A50, 0x001A3060DD3529},
+    {0x001B01251EBA50, 0x001A4060E73A46},
+    {0x001B11251EFA50, 0x001A5060F13F81},
+    {0x001B21251F3A50, 0x001A6060FB44B1},
+    {0x001B31251F7A50, 0x001A70610549D7},
+    {0x001B41251FBA50, 0x001A80610F4F14},
+    {0x001B51251FFA50, 0x001A9061195456},
+    {0x001B6125203A50, 0x001AA061235971},
+    {0x001B7125207A50, 0x001AB0612D5EAB},
+    {0x001B812520BA50, 0x001AC0613763D9},
+    {0x001B912520FA50, 0x001AD0614168EE},
+    {0x001BA125213A50, 0x001AE0614B6E32},
+    {0x001BB125217A50, 0x001AF06155736C},
+    {0x001BC12521BA50, 0x001B00615F78A3},
+    {0x001BD12521FA50, 0x001B1061697DCF},
+    {0x001BE125223A50, 0x001B2061738315},
+    {0x001BF125227A50, 0x001B30617D880C},
+    {0x001C012522BA50, 0x001B4061878D69},
+    {0x001C112522FA50, 0x001B506191928F},
+    {0x001C2125233A50, 0x001B60619B97C3},
+    {0x001C3125237A50, 0x001B7061A59CF3},
+    {0x001C412523BA50, 0x001B8061AFA22A},
+    {0x001C512523FA50, 0x001B9061B9A73E},
+    {0x001C6125243A50, 0x001BA061C3AC7C},
+    {0x001C7125247A50, 0x001BB061CDB1AB},
+    {0x001C812524BA50, 0x001BC061D7B6EC},
+    {0x001C912524FA50, 0x001BD061E1BC14},
+    {0x001CA125253A50, 0x001BE061EBC13C},
+    {0x001CB125257A50, 0x001BF061F5C66A},
+    {0x001CC12525BA50, 0x001C0061FFCB99},
+    {0x001CD12525FA50, 0x001C106209D0EF},
+    {0x001CE125263A50, 0x001C206213D612},
+    {0x001CF125267A50, 0x001C30621DDB37},
+    {0x001D012526BA50, 0x001C406227E063},
+    {0x001D112526FA50, 0x001C506231E598},
+    {0x001D2125273A50, 0x001C60623BEAD3},
+    {0x001D3125277A50, 0x001C706245EFFB},
+    {0x001D412527BA50, 0x001C80624FF531},
+    {0x001D512527FA50, 0x001C906259FA59},
+    {0x001D6125283A50, 0x001CA06263FF89},
+    {0x001D7125287A50, 0x001CB0626E04B8},
+    {0x001D812528BA50, 0x001CC0627809ED},
+    {0x001D912528FA50, 0x001CD062820F3B},
+    {0x001DA125293A50, 0x001CE0628C1447},
+    {0x001DB125297A50, 0x001CF062961984},
+    {0x001DC12529BA50, 0x001D0062A01EB9},
+    {0x001DD12529FA50, 0x001D1062AA23E1},
+    {0x001DE1252A3A50, 0x001D2062B42927},
+    {0x001DF1252A7A50, 0x001D3062BE2E3B},
+    {0x001E01252ABA50, 0x001D4062C83370},
+    {0x001E11252AFA50, 0x001D5062D238AC},
+    {0x001E21252B3A50, 0x001D6062DC3DC8},
+    {0x001E31252B7A50, 0x001D7062E642EC},
+    {0x001E41252BBA50, 0x001D8062F0483A},
+    {0x001E51252BFA50, 0x001D9062FA4D68},
+    {0x001E61252C3A50, 0x001DA063045295},
+    {0x001E71252C7A50, 0x001DB0630E57CA},
+    {0x001E81252CBA50, 0x001DC063185CFA},
+    {0x001E91252CFA50, 0x001DD063226227},
+    {0x001EA1252D3A50, 0x001DE0632C675F},
+    {0x001EB1252D7A50, 0x001DF063366C98},
+    {0x001EC1252DBA50, 0x001E00634071C2},
+    {0x001ED1252DFA50, 0x001E10634A76F2},
+    {0x001EE1252E3A50, 0x001E2063547C18},
+    {0x001EF1252E7A50, 0x001E30635E813D},
+    {0x001F01252EBA50, 0x001E4063688672},
+    {0x001F11252EFA50, 0x001E5063728BBA},
+    {0x001F21252F3A50, 0x001E60637C90DF},
+    {0x001F31252F7A50, 0x001E7063869619},
+    {0x001F41252FBA50, 0x001E8063909B48},
+    {0x001F51252FFA50, 0x001E90639AA073},
+    {0x001F6125303A50, 0x001EA063A4A5B6},
+    {0x001F7125307A50, 0x001EB063AEAAC2},
+    {0x001F812530BA50, 0x001EC063B8B002},
+    {0x001F912530FA50, 0x001ED063C2B52E},
+    {0x001FA125313A50, 0x001EE063CCBA58},
+    {0x001FB125317A50, 0x001EF063D6BF84},
+    {0x001FC12531BA50, 0x001F0063E0C4C5},
+    {0x001FD12531FA50, 0x001F1063EAC9FD},
+    {0x001FE125323A50, 0x001F2063F4CF1B},
+    {0x001FF125327A50, 0x001F3063FED459},
+    {0x0020012532BA50, 0x001F406408D999},
+    {0x0020112532FA50, 0x001F506412DEB5},
+    {0x00202125333A50, 0x001F60641CE3E4},
+    {0x00203125337A50, 0x001F706426E917},
+    {0x0020412533BA50, 0x001F806430EE4C},
+    {0x0020512533FA50, 0x001F90643AF36C},
+    {0x00206125343A50, 0x001FA06444F8B2},
+    {0x00207125347A50, 0x001FB0644EFDDA},
+    {0x0020812534BA50, 0x001FC064590313},
+    {0x0020912534FA50, 0x001FD06463082A},
+    {0x0020A125353A50, 0x001FE0646D0D60},
+    {0x0020B125357A50, 0x001FF06477129D},
+    {0x0020C12535BA50, 0x002000648117C7},
+    {0x0020D12535FA50, 0x002010648B1CFE},
+    {0x0020E125363A50, 0x0020206495223B},
+    {0x0020F125367A50, 0x002030649F276D},
+    {0x0021012536BA50, 0x00204064A92CA2},
+};
+
+const uint16_t g_wcs_test_trace_len = sizeof(g_wcs_test_trace) / sizeof(g_wcs_test_trace[0]);
@@ -0,0 +1,381 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file wcs_test_util.c
+ * @author agent <agent@local>
+ * @date 2018
+ * @brief Wireless clock synchronization on synthetic CCP traces
+ *
+ * @details The slave crystal runs at an offset that follows a temperature ramp, its epoch timestamps carry
+ * gaussian noise. Epochs are handed to wcs_update_cb() as ccp would, through the ccp instance of the simulated
+ * device. The recorded trace of wcs_test_trace.c is replayed the same way.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "wcs_test.h"
+#if !MYNEWT_VAL(WCS_FLOAT_ESTIMATOR)
+#include <timescale/timescale.h>
+#endif
+
+#define WCS_DTU MYNEWT_VAL(WCS_DTU)
+#define MASK40 0x0FFFFFFFFFFUL
+
+static double
+wcs_test_gauss(wcs_test_clock_t * clock){
+    double u[2];
+    for (uint8_t i = 0; i < 2; i++){
+        clock->seed ^= clock->seed << 13;
+        clock->seed ^= clock->seed >> 17;
+        clock->seed ^= clock->seed << 5;
+        u[i] = (clock->seed + 1.0) / 4294967297.0;
+    }
+    return sqrt(-2.0 * log(u[0])) * cos(2.0 * M_PI * u[1]);
+}
+
+//! Signed distance from b to a modulo 2^40
+static int64_t
+wcs_test_diff40(uint64_t a, uint64_t b){
+    return (int64_t)(((a - b) & MASK40) << 24) >> 24;
+}
+
+/**
+ * API to start a trace.
+ *
+ * @param clock     Pointer to wcs_test_clock_t.
+ * @param ppm       Slave crystal offset at the start of the trace.
+ * @param ramp      Slave crystal temperature ramp (ppm/s).
+ * @param noise     Standard deviation of the slave epoch timestamps (dtu).
+ * @return void
+ */
+void
+wcs_test_clock_init(wcs_test_clock_t * clock, double ppm, double ramp, double noise){
+    memset(clock, 0, sizeof(wcs_test_clock_t));
+    clock->master = 0x123456789AUL;
+    clock->local = 0x0ABCDEF012UL;
+    clock->ppm = ppm;
+    clock->ramp = ramp;
+    clock->noise = noise;
+    clock->seed = 0x2545F491;
+}
+
+/**
+ * API to advance the trace by one ccp period and hand the new epoch to the ccp instance, as received.
+ *
+ * @param ccp       Pointer to dw1000_ccp_instance_t.
+ * @param clock     Pointer to wcs_test_clock_t.
+ * @return void
+ */
+void
+wcs_test_advance(dw1000_ccp_instance_t * ccp, wcs_test_clock_t * clock){
+    uint64_t period = (uint64_t)ccp->period << 16;
+    double T = period / WCS_DTU;
+
+    // The crystal offset is linear in time, the mean over the period is exact
+    double ppm = clock->ppm + clock->ramp * (clock->t + T / 2);
+    clock->local += period * (1.0 + ppm * 1e-6);
+    clock->master += period;
+    clock->t += T;
+    clock->stamp = (uint64_t) llround(fmod(clock->local + clock->noise * wcs_test_gauss(clock), (double)(1ULL << 40)));
+
+    ccp_frame_t * frame = ccp->frames[(ccp->idx)%ccp->nframes];
+    double ratio = 1.0 / (1.0 + (clock->ppm + clock->ramp * clock->t) * 1e-6) - 1.0;
+    frame->carrier_integrator = (int32_t) round(ratio / dw1000_calc_clock_offset_ratio(ccp->parent, 1));
+
+    ccp->master_epoch.timestamp = clock->master;
+    ccp->local_epoch = clock->stamp;
+    ccp->status.valid = 1;
+}
+
+/**
+ * API to advance the trace by one ccp period and run wcs_update_cb() on the new epoch.
+ *
+ * @param ccp       Pointer to dw1000_ccp_instance_t.
+ * @param clock     Pointer to wcs_test_clock_t.
+ * @return void
+ */
+void
+wcs_test_epoch(dw1000_ccp_instance_t * ccp, wcs_test_clock_t * clock){
+    wcs_test_advance(ccp, clock);
+    wcs_update_cb(&ccp->callout_postprocess.c_ev);
+}
+
+//! Master time the clock model predicts delta local dtu after the epoch, unbounded
+static double
+wcs_test_model(wcs_instance_t * wcs, double delta){
+#if MYNEWT_VAL(WCS_FLOAT_ESTIMATOR)
+    return (double) wcs->estimator.time + delta * (1.0 + (double) wcs->estimator.rate);
+#else
+    return timescale_forward(wcs->timescale, delta / WCS_DTU);
+#endif
+}
+
+/*!
+ * Fixed point local to master mapping against the clock model it is computed from. Within a period the
+ * mapping is the chord of the model, it may depart from the model by the curvature term plus rounding.
+ */
+static void
+wcs_fixed_test(void){
+    dw1000_ccp_instance_t * ccp = hal_dw1000_inst(0)->ccp;
+    wcs_instance_t * wcs = ccp->wcs;
+    wcs_test_clock_t clock;
+    double max_error = 0, max_curvature = 0;
+
+    wcs_test_clock_init(&clock, MYNEWT_VAL(WCS_TEST_PPM), MYNEWT_VAL(WCS_TEST_RAMP), MYNEWT_VAL(WCS_TEST_NOISE));
+    wcs->status.initialized = 0;
+
+    for (uint16_t k = 0; k < MYNEWT_VAL(WCS_TEST_EPOCHS); k++){
+        wcs_test_epoch(ccp, &clock);
+        if (!wcs->status.valid)
+            continue;
+
+        // Across the next full period, the mapping is used until the following epoch
+        double T = (double)((uint64_t)ccp->period << 16) * (1.0 + MYNEWT_VAL(WCS_TEST_PPM) * 1e-6);
+        double m0 = wcs_test_model(wcs, 0);
+        double curvature = fabs(wcs_test_model(wcs, T) - 2 * wcs_test_model(wcs, T / 2) + m0) / 2;
+        max_curvature = (curvature > max_curvature) ? curvature : max_curvature;
+
+        for (uint16_t i = 0; i <= 64; i++){
+            double delta = T * i / 64;
+            uint64_t local = (wcs->fixed.local_epoch + (uint64_t) delta) & MASK40;
+            double model = wcs_test_model(wcs, floor(delta));
+            uint64_t master = wcs_local_to_master(wcs, local);
+            double error = (double) wcs_test_diff40(master, (uint64_t) llround(model))
+                            - (model - llround(model));
+            TEST_ASSERT(fabs(error) <= curvature + MYNEWT_VAL(WCS_TEST_FIXED_ERROR));
+            max_error = (fabs(error) > max_error) ? fabs(error) : max_error;
+        }
+        // 64 bit variant agrees with the 40 bit one
+        TEST_ASSERT((wcs_local_to_master64(wcs, wcs->fixed.local_epoch) & MASK40) == wcs_local_to_master(wcs, wcs->fixed.local_epoch));
+    }
+    TEST_ASSERT(wcs->status.valid);
+
+    printf("{\"test\": \"wcs_fixed\", \"epochs\": %d, \"max_error_dtu\": %d, \"max_curvature_dtu\": %d}\n",
+        MYNEWT_VAL(WCS_TEST_EPOCHS), (int) ceil(max_error), (int) ceil(max_curvature));
+}
+
+//! One period ahead prediction error of a filter over a trace
+typedef struct _wcs_test_stats_t{
+    double sum2;                    //!< Sum of squared time errors (dtu^2)
+    double max;                     //!< Largest time error (dtu)
+    double rate2;                   //!< Sum of squared rate errors
+    uint16_t n;                     //!< Epochs
+}wcs_test_stats_t;
+
+static void
+wcs_test_stats_add(wcs_test_stats_t * stats, double error, double rate_error){
+    stats->sum2 += error * error;
+    stats->max = (fabs(error) > stats->max) ? fabs(error) : stats->max;
+    stats->rate2 += rate_error * rate_error;
+    stats->n++;
+}
+
+static void
+wcs_test_stats_print(const char * trace, const char * filter, wcs_test_stats_t * stats){
+    printf("{\"test\": \"wcs_estimator\", \"trace\": \"%s\", \"filter\": \"%s\", \"epochs\": %d, \"rms_dtu\": %d, \"max_dtu\": %d, \"rate_rms_ppb\": %d}\n",
+        trace, filter, stats->n, (int) ceil(sqrt(stats->sum2 / stats->n)), (int) ceil(stats->max),
+        (int) ceil(1e9 * sqrt(stats->rate2 / stats->n))
+    );
+}
+
+/*!
+ * Single precision estimator against the configured wcs filter, the timescale filter unless WCS_FLOAT_ESTIMATOR
+ * is set, on the same trace. Both predict the master time of each epoch from the previous one, at the noise free
+ * local time of the epoch, and are scored against the master timestamp. Both are reported, only the single
+ * precision estimator is held to a bound.
+ */
+static void
+wcs_estimator_trace(const char * trace, double ppm, double ramp){
+    dw1000_ccp_instance_t * ccp = hal_dw1000_inst(0)->ccp;
+    wcs_instance_t * wcs = ccp->wcs;
+    wcs_test_clock_t clock;
+    wcs_estimator_t est = {.initialized = 0};
+    uint64_t est_local = 0;
+    wcs_test_stats_t reference = {0}, estimator = {0};
+
+    wcs_test_clock_init(&clock, ppm, ramp, MYNEWT_VAL(WCS_TEST_NOISE));
+    wcs->status.initialized = 0;
+
+    for (uint16_t k = 0; k < MYNEWT_VAL(WCS_TEST_EPOCHS); k++){
+        wcs_test_advance(ccp, &clock);
+        uint64_t local = (uint64_t) llround(fmod(clock.local, (double)(1ULL << 40)));
+        double rate = 1.0 / (1.0 + (clock.ppm + clock.ramp * clock.t) * 1e-6) - 1.0;
+
+        if (k >= MYNEWT_VAL(WCS_TEST_WARMUP) && wcs->status.valid && est.valid){
+            double error = wcs_test_diff40(wcs_local_to_master(wcs, local), clock.master);
+            wcs_test_stats_add(&reference, error, -wcs->skew - rate);
+
+            uint64_t delta = (local - est_local) & MASK40;
+            uint64_t master = est.time + delta + (int64_t) llround((double) delta * est.rate);
+            error = wcs_test_diff40(master, clock.master);
+            wcs_test_stats_add(&estimator, error, est.rate - rate);
+        }
+
+        wcs_update_cb(&ccp->callout_postprocess.c_ev);
+
+        // As wcs_update_cb() does with WCS_FLOAT_ESTIMATOR
+        if (est.initialized == 0){
+            ccp_frame_t * frame = ccp->frames[(ccp->idx)%ccp->nframes];
+            wcs_estimator_init(&est, clock.master & MASK40, dw1000_calc_clock_offset_ratio(ccp->parent, frame->carrier_integrator));
+        }else
+            wcs_estimator_update(&est, (clock.stamp - est_local) & MASK40, clock.master & MASK40);
+        est_local = clock.stamp;
+    }
+
+#if MYNEWT_VAL(WCS_FLOAT_ESTIMATOR)
+    wcs_test_stats_print(trace, "wcs_float", &reference);
+#else
+    wcs_test_stats_print(trace, "timescale", &reference);
+#endif
+    wcs_test_stats_print(trace, "float", &estimator);
+
+    // A two state filter lags a ramp by about ramp * T^2, beyond that it must neither restart nor drift off
+    double T = ((uint64_t)ccp->period << 16) / WCS_DTU;
+    double lag = fabs(ramp) * 1e-6 * T * T * MYNEWT_VAL(WCS_DTU_SI);
+    TEST_ASSERT(estimator.n == MYNEWT_VAL(WCS_TEST_EPOCHS) - MYNEWT_VAL(WCS_TEST_WARMUP));
+    TEST_ASSERT(sqrt(estimator.sum2 / estimator.n) <= MYNEWT_VAL(WCS_TEST_ESTIMATOR_ERROR) + lag);
+}
+
+/*!
+ * Both filters replayed on the recorded trace of wcs_test_trace.c. The clock model behind it is unknown, each
+ * filter predicts the master time of an epoch from the previous one at the recorded local timestamp, noise
+ * included, and is scored against the recorded master timestamp.
+ */
+static void
+wcs_estimator_fixture(void){
+    dw1000_ccp_instance_t * ccp = hal_dw1000_inst(0)->ccp;
+    wcs_instance_t * wcs = ccp->wcs;
+    wcs_estimator_t est = {.initialized = 0};
+    wcs_test_stats_t reference = {0}, estimator = {0};
+    const wcs_test_record_t * trace = g_wcs_test_trace;
+
+    TEST_ASSERT_FATAL(g_wcs_test_trace_len > MYNEWT_VAL(WCS_TEST_WARMUP) + 1);
+    wcs->status.initialized = 0;
+
+    for (uint16_t k = 0; k < g_wcs_test_trace_len; k++){
+        uint64_t master = trace[k].master & MASK40;
+        uint64_t local = trace[k].local & MASK40;
+        // The record carries no carrier integrator, the first rate is taken between the first two epochs
+        uint16_t i = (k == 0) ? 1 : k;
+        double rate = (double) wcs_test_diff40(trace[i].master, trace[i - 1].master)
+                    / wcs_test_diff40(trace[i].local, trace[i - 1].local) - 1.0;
+
+        if (k >= MYNEWT_VAL(WCS_TEST_WARMUP) && wcs->status.valid && est.valid){
+            double error = wcs_test_diff40(wcs_local_to_master(wcs, local), master);
+            wcs_test_stats_add(&reference, error, -wcs->skew - rate);
+
+            uint64_t delta = (local - (trace[k - 1].local & MASK40)) & MASK40;
+            error = wcs_test_diff40(est.time + delta + (int64_t) llround((double) delta * est.rate), master);
+            wcs_test_stats_add(&estimator, error, est.rate - rate);
+        }
+
+        ccp_frame_t * frame = ccp->frames[(ccp->idx)%ccp->nframes];
+        frame->carrier_integrator = (int32_t) round(rate / dw1000_calc_clock_offset_ratio(ccp->parent, 1));
+        ccp->master_epoch.timestamp = trace[k].master;
+        ccp->local_epoch = trace[k].local;
+        ccp->status.valid = 1;
+        wcs_update_cb(&ccp->callout_postprocess.c_ev);
+
+        if (est.initialized == 0)
+            wcs_estimator_init(&est, master, rate);
+        else
+            wcs_estimator_update(&est, (local - (trace[k - 1].local & MASK40)) & MASK40, master);
+    }
+
+#if MYNEWT_VAL(WCS_FLOAT_ESTIMATOR)
+    wcs_test_stats_print("recorded", "wcs_float", &reference);
+#else
+    wcs_test_stats_print("recorded", "timescale", &reference);
+#endif
+    wcs_test_stats_print("recorded", "float", &estimator);
+
+    TEST_ASSERT(estimator.n == g_wcs_test_trace_len - MYNEWT_VAL(WCS_TEST_WARMUP));
+    TEST_ASSERT(sqrt(estimator.sum2 / estimator.n) <= MYNEWT_VAL(WCS_TEST_FIXTURE_ERROR));
+}
+
+#if MYNEWT_VAL(WCS_QUALITY_ENABLED)
+/*!
+ * Clock quality on the steady trace. The slave phase is white noise of WCS_TEST_NOISE on a constant offset,
+ * its overlapping Allan deviation is sqrt(3) * noise / tau. The sync error is checked against the rms error
+ * of the previous epoch's model at the noise free local time of each epoch, the error it predicts, relative to
+ * that error or to the timestamp noise, whichever is larger.
+ */
+static void
+wcs_quality_test(void){
+    dw1000_ccp_instance_t * ccp = hal_dw1000_inst(0)->ccp;
+    wcs_instance_t * wcs = ccp->wcs;
+    wcs_quality_t * quality = &wcs->quality;
+    wcs_test_clock_t clock;
+    wcs_test_stats_t model = {0};
+
+    wcs_test_clock_init(&clock, MYNEWT_VAL(WCS_TEST_PPM), 0, MYNEWT_VAL(WCS_TEST_NOISE));
+    wcs->status.initialized = 0;
+
+    for (uint16_t k = 0; k < MYNEWT_VAL(WCS_TEST_EPOCHS); k++){
+        wcs_test_advance(ccp, &clock);
+        if (k >= MYNEWT_VAL(WCS_TEST_WARMUP) && wcs->status.valid){
+            uint64_t local = (uint64_t) llround(fmod(clock.local, (double)(1ULL << 40)));
+            wcs_test_stats_add(&model, wcs_test_diff40(wcs_local_to_master(wcs, local), clock.master), 0);
+        }
+        wcs_update_cb(&ccp->callout_postprocess.c_ev);
+    }
+
+    double rms = sqrt(model.sum2 / model.n);
+    printf("{\"test\": \"wcs_quality\", \"adev\": [%.3e,%.3e,%.3e,%.3e], \"sync_error_dtu\": %.1f, \"model_rms_dtu\": %.1f, \"time_error_dtu\": [%.1f,%.1f]}\n",
+        quality->adev[0], quality->adev[1], quality->adev[2], quality->adev[3], quality->sync_error, rms,
+        wcs_quality_time_error(quality, 1), wcs_quality_time_error(quality, 8));
+
+    TEST_ASSERT_FATAL(quality->tau0 == (uint64_t)ccp->period << 16);
+    for (uint16_t k = 0; k < WCS_QUALITY_NTAU; k++){
+        double adev = sqrt(3.0) * MYNEWT_VAL(WCS_TEST_NOISE) / ((double)(1 << k) * quality->tau0);
+        TEST_ASSERT(fabs(quality->adev[k] - adev) <= MYNEWT_VAL(WCS_TEST_QUALITY_TOLERANCE) * adev);
+    }
+    double scale = (rms > MYNEWT_VAL(WCS_TEST_NOISE)) ? rms : MYNEWT_VAL(WCS_TEST_NOISE);
+    TEST_ASSERT(fabs(quality->sync_error - rms) <= MYNEWT_VAL(WCS_TEST_QUALITY_TOLERANCE) * scale);
+    TEST_ASSERT(wcs_quality_time_error(quality, 1) >= quality->sync_error);
+    TEST_ASSERT(wcs_quality_time_error(quality, 8) > wcs_quality_time_error(quality, 1));
+}
+#endif
+
+static void
+wcs_estimator_test(void){
+    wcs_estimator_trace("steady", MYNEWT_VAL(WCS_TEST_PPM), 0);
+    wcs_estimator_trace("ramp", MYNEWT_VAL(WCS_TEST_PPM), MYNEWT_VAL(WCS_TEST_RAMP));
+    wcs_estimator_fixture();
+}
+
+void
+wcs_test_handler(void *arg)
+{
+    sysinit();
+
+    wcs_fixed_test();
+    wcs_estimator_test();
+#if MYNEWT_VAL(WCS_QUALITY_ENABLED)
+    wcs_quality_test();
+#endif
+
+    tu_restart();
+}